@@ -0,0 +1,194 @@
+#include "DrawBenchmark.h"
+
+#include <algorithm>
+#include <functional>
+#include <GLES3/gl3.h>
+#include <string>
+#include <vector>
+
+#include "AndroidOut.h"
+#include "GlState.h"
+#include "Model.h"
+#include "Shader.h"
+#include "SpriteBatch.h"
+#include "Utils/Benchmark.h"
+
+//! Textures the mixed sprite cases cycle through
+static constexpr uint32_t kMixedTextureCount = 8;
+
+/*!
+ * A quad of half size @a halfSize around (x, y), with the same layout as the demo square
+ */
+static Model createSprite(
+        float x,
+        float y,
+        float halfSize,
+        const std::shared_ptr<TextureAsset> &spTexture) {
+    std::vector<Vertex> vertices = {
+            Vertex(Vector3{x + halfSize, y + halfSize, 0}, Vector2{0, 0}),
+            Vertex(Vector3{x - halfSize, y + halfSize, 0}, Vector2{1, 0}),
+            Vertex(Vector3{x - halfSize, y - halfSize, 0}, Vector2{1, 1}),
+            Vertex(Vector3{x + halfSize, y - halfSize, 0}, Vector2{0, 1})
+    };
+    std::vector<Index> indices = {
+            0, 1, 2, 0, 2, 3
+    };
+    return Model(std::move(vertices), std::move(indices), spTexture);
+}
+
+/*!
+ * A grid of @a gridSize x @a gridSize quads covering -1..1
+ */
+static void createGrid(
+        uint32_t gridSize,
+        std::vector<Vertex> &outVertices,
+        std::vector<Index> &outIndices) {
+    const uint32_t side = gridSize + 1;
+    outVertices.clear();
+    outVertices.reserve(side * side);
+    for (uint32_t y = 0; y < side; y++) {
+        for (uint32_t x = 0; x < side; x++) {
+            float u = float(x) / gridSize;
+            float v = float(y) / gridSize;
+            outVertices.emplace_back(Vector3{u * 2 - 1, v * 2 - 1, 0}, Vector2{u, 1 - v});
+        }
+    }
+
+    outIndices.clear();
+    outIndices.reserve(gridSize * gridSize * 6);
+    for (uint32_t y = 0; y < gridSize; y++) {
+        for (uint32_t x = 0; x < gridSize; x++) {
+            Index topLeft = Index(y * side + x);
+            Index bottomLeft = Index((y + 1) * side + x);
+            outIndices.insert(outIndices.end(), {
+                    topLeft, Index(topLeft + 1), Index(bottomLeft + 1),
+                    topLeft, Index(bottomLeft + 1), bottomLeft
+            });
+        }
+    }
+}
+
+void runDrawBenchmark(
+        const Shader &shader,
+        const std::shared_ptr<TextureAsset> &spTexture,
+        uint32_t spriteCount,
+        uint32_t gridSize,
+        uint32_t frames) {
+    // Lay the sprites out on a square grid filling the view
+    std::vector<Model> sprites;
+    sprites.reserve(spriteCount);
+    uint32_t columns = 1;
+    while (columns * columns < spriteCount) {
+        columns++;
+    }
+    const float halfSize = 1.f / columns;
+    for (uint32_t i = 0; i < spriteCount; i++) {
+        float x = -1 + halfSize * (2 * (i % columns) + 1);
+        float y = -1 + halfSize * (2 * (i / columns) + 1);
+        sprites.push_back(createSprite(x, y, halfSize, spTexture));
+    }
+
+    gridSize = std::min(gridSize, 255u);
+    std::vector<Vertex> gridVertices;
+    std::vector<Index> gridIndices;
+    createGrid(gridSize, gridVertices, gridIndices);
+    Model mesh(gridVertices, gridIndices, spTexture);
+    Model dynamicMesh(gridVertices, gridIndices, spTexture, GeometryUsage::Dynamic);
+
+    // The same sprites spread over a few textures, to show what sorting by state saves
+    std::vector<std::shared_ptr<TextureAsset>> textures;
+    for (uint32_t i = 0; i < kMixedTextureCount; i++) {
+        const uint8_t pixel[4] = {uint8_t(i * 255 / kMixedTextureCount), 255, 255, 255};
+        textures.push_back(TextureAsset::createTexture(1, 1, pixel, false));
+    }
+    std::vector<Model> mixedSprites;
+    mixedSprites.reserve(spriteCount);
+    for (uint32_t i = 0; i < spriteCount; i++) {
+        float x = -1 + halfSize * (2 * (i % columns) + 1);
+        float y = -1 + halfSize * (2 * (i / columns) + 1);
+        mixedSprites.push_back(createSprite(x, y, halfSize, textures[i % kMixedTextureCount]));
+    }
+    std::vector<const Model *> sortedSprites;
+    for (const auto &sprite: mixedSprites) {
+        sortedSprites.push_back(&sprite);
+    }
+    std::stable_sort(sortedSprites.begin(), sortedSprites.end(), [](const Model *a, const Model *b) {
+        return a->getTexture().getTextureID() < b->getTexture().getTextureID();
+    });
+
+    // Times a case and logs the GL state calls of an average frame, the warm-up one included
+    auto runCase = [frames](const std::string &name, const std::function<void()> &drawFrame) {
+        GlState &state = GlState::current();
+        state.resetStats();
+        runBenchmark(name, frames, [&] {
+            drawFrame();
+            glFinish();
+        });
+        const GlStateStats &stats = state.getStats();
+        aout << name << ": " << stats.issued / (frames + 1) << " state calls issued, "
+             << stats.eliminated / (frames + 1) << " eliminated per frame" << std::endl;
+    };
+
+    const std::string spriteSuffix = " " + std::to_string(spriteCount) + " sprites";
+    const std::string meshSuffix = " " + std::to_string(gridIndices.size() / 3) + " triangle mesh";
+
+    runCase("Draw client arrays" + spriteSuffix, [&] {
+        for (const auto &sprite: sprites) {
+            shader.drawModelClientArrays(sprite);
+        }
+    });
+    // The untimed warm-up frame does the one time upload
+    runCase("Draw buffers" + spriteSuffix, [&] {
+        for (const auto &sprite: sprites) {
+            shader.drawModel(sprite);
+        }
+    });
+
+    runCase("Draw buffers interleaved textures" + spriteSuffix, [&] {
+        for (const auto &sprite: mixedSprites) {
+            shader.drawModel(sprite);
+        }
+    });
+    runCase("Draw buffers sorted textures" + spriteSuffix, [&] {
+        for (const Model *sprite: sortedSprites) {
+            shader.drawModel(*sprite);
+        }
+    });
+
+    // The same sprites through the batch, all on one texture so a single draw
+    SpriteBatch spriteBatch;
+    runCase("Draw sprite batch" + spriteSuffix, [&] {
+        spriteBatch.begin();
+        for (uint32_t i = 0; i < spriteCount; i++) {
+            float x = -1 + halfSize * (2 * (i % columns) + 1);
+            float y = -1 + halfSize * (2 * (i / columns) + 1);
+            spriteBatch.draw(
+                    shader,
+                    BlendMode::Alpha,
+                    spTexture->getTextureID(),
+                    x,
+                    y,
+                    halfSize,
+                    halfSize,
+                    0,
+                    0,
+                    1,
+                    1);
+        }
+        spriteBatch.end();
+    });
+
+    runCase("Draw client arrays" + meshSuffix, [&] {
+        shader.drawModelClientArrays(mesh);
+    });
+    runCase("Draw buffers" + meshSuffix, [&] {
+        shader.drawModel(mesh);
+    });
+    runCase("Draw orphaned buffers" + meshSuffix, [&] {
+        dynamicMesh.setGeometry(gridVertices, gridIndices);
+        shader.drawModel(dynamicMesh);
+    });
+
+    // Leave the GL state as the renderer expects it
+    GlState::current().bindVertexArray(0);
+}
@@ -0,0 +1,36 @@
+#ifndef ANDROIDGLINVESTIGATIONS_DRAWBENCHMARK_H
+#define ANDROIDGLINVESTIGATIONS_DRAWBENCHMARK_H
+
+#include <cstdint>
+#include <memory>
+
+class Shader;
+class TextureAsset;
+
+/*!
+ * Draw call microbenchmark for static scenes, comparing client side arrays with buffer objects
+ * and vertex arrays:
+ *  - sprites: @a spriteCount textured quads, one model and one draw each, and the same quads
+ *    through a SpriteBatch
+ *  - mixed sprites: the quads cycling through a few textures, drawn in that order and sorted by
+ *    texture, with the GL state calls each frame issues and saves through GlState
+ *  - mesh: a single grid of @a gridSize x @a gridSize quads, plus the same grid as a dynamic model
+ *    whose geometry is replaced before every draw
+ *
+ * Every timed frame ends with glFinish so GPU time is included. Results go to the log under the
+ * "Benchmark" tag. Needs a current GLES 3 context with @a shader active and a projection set.
+ *
+ * @param shader the shader to draw with
+ * @param spTexture the texture every model uses
+ * @param spriteCount the number of sprites
+ * @param gridSize quads per side of the mesh, at most 255 to fit 16 bit indices
+ * @param frames timed frames per case
+ */
+void runDrawBenchmark(
+        const Shader &shader,
+        const std::shared_ptr<TextureAsset> &spTexture,
+        uint32_t spriteCount = 1000,
+        uint32_t gridSize = 128,
+        uint32_t frames = 100);
+
+#endif //ANDROIDGLINVESTIGATIONS_DRAWBENCHMARK_H
@@ -0,0 +1,44 @@
+#include "FrameState.h"
+
+#include <glm/gtc/quaternion.hpp>
+
+glm::mat4 interpolateTransform(const glm::mat4& from, const glm::mat4& to, float alpha)
+{
+    glm::vec3 fromScale(glm::length(glm::vec3(from[0])), glm::length(glm::vec3(from[1])), glm::length(glm::vec3(from[2])));
+    glm::vec3 toScale(glm::length(glm::vec3(to[0])), glm::length(glm::vec3(to[1])), glm::length(glm::vec3(to[2])));
+    if (fromScale.x == 0.0f || fromScale.y == 0.0f || fromScale.z == 0.0f ||
+        toScale.x == 0.0f || toScale.y == 0.0f || toScale.z == 0.0f) {
+        // Degenerate, nothing to decompose
+        return alpha < 0.5f ? from : to;
+    }
+
+    glm::mat3 fromRotation(glm::vec3(from[0]) / fromScale.x, glm::vec3(from[1]) / fromScale.y, glm::vec3(from[2]) / fromScale.z);
+    glm::mat3 toRotation(glm::vec3(to[0]) / toScale.x, glm::vec3(to[1]) / toScale.y, glm::vec3(to[2]) / toScale.z);
+    glm::quat rotation = glm::slerp(glm::quat_cast(fromRotation), glm::quat_cast(toRotation), alpha);
+    glm::vec3 scale = glm::mix(fromScale, toScale, alpha);
+    glm::vec3 translation = glm::mix(glm::vec3(from[3]), glm::vec3(to[3]), alpha);
+
+    glm::mat4 result = glm::mat4_cast(rotation);
+    result[0] *= scale.x;
+    result[1] *= scale.y;
+    result[2] *= scale.z;
+    result[3] = glm::vec4(translation, 1.0f);
+    return result;
+}
+
+void interpolateFrameState(const FrameState& previous, const FrameState& current, float alpha, FrameState& out)
+{
+    out.tick = current.tick;
+    out.projection = current.projection;
+    // The inverse view is the camera's world transform, blending the view itself would move
+    // the camera along a curve
+    out.view = glm::inverse(interpolateTransform(glm::inverse(previous.view), glm::inverse(current.view), alpha));
+
+    out.transforms.resize(current.transforms.size());
+    for (size_t i = 0; i < current.transforms.size(); i++) {
+        // Objects that appeared this step have nothing to blend from
+        out.transforms[i] = i < previous.transforms.size()
+                ? interpolateTransform(previous.transforms[i], current.transforms[i], alpha)
+                : current.transforms[i];
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// What the renderer needs from the simulation for one frame. The simulation produces one per
+// fixed step, the renderer draws a blend of the last two.
+struct FrameState {
+    uint64_t tick{0};
+    glm::mat4 view{1.0f};
+    glm::mat4 projection{1.0f};
+    // Model matrix per mesh, in the device's mesh order
+    std::vector<glm::mat4> transforms;
+};
+
+// Blends two affine transforms made of translation, rotation and scale: position and scale
+// linearly, rotation along the shortest arc. Shear doesn't survive.
+glm::mat4 interpolateTransform(const glm::mat4& from, const glm::mat4& to, float alpha);
+
+// previous -> current at alpha 0..1, into out (reuses its storage). The camera is blended in
+// world space, the projection and the tick are taken from current.
+void interpolateFrameState(const FrameState& previous, const FrameState& current, float alpha, FrameState& out);
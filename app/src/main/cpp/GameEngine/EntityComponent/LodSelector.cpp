@@ -0,0 +1,70 @@
+#include <algorithm>
+
+#include "LodSelector.h"
+
+float LodSelector::projectedError(float error, float distance, float projectionScale, float viewportHeight)
+{
+    // Clamp so objects intersecting the near plane always resolve to the finest level.
+    distance = std::max(distance, 1e-4f);
+    return error / distance * projectionScale * viewportHeight * 0.5f;
+}
+
+void LodSelector::boundingSphere(const std::vector<Vertex>& vertices, glm::vec3& center, float& radius)
+{
+    glm::vec3 minPos(0.0f), maxPos(0.0f);
+    if (!vertices.empty())
+    {
+        minPos = maxPos = vertices[0].position;
+        for (const Vertex& vertex : vertices)
+        {
+            minPos = glm::min(minPos, vertex.position);
+            maxPos = glm::max(maxPos, vertex.position);
+        }
+    }
+    center = (minPos + maxPos) * 0.5f;
+    radius = 0.0f;
+    for (const Vertex& vertex : vertices)
+    {
+        radius = std::max(radius, glm::length(vertex.position - center));
+    }
+}
+
+float LodSelector::viewDistance(const glm::vec3& center, float radius, const glm::mat4& model, const glm::mat4& view,
+                                float& scale)
+{
+    scale = std::max(glm::length(glm::vec3(model[0])),
+                     std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+    glm::vec3 worldCenter = glm::vec3(model * glm::vec4(center, 1.0f));
+    glm::vec3 cameraPosition = glm::vec3(glm::inverse(view)[3]);
+    return glm::length(worldCenter - cameraPosition) - radius * scale;
+}
+
+uint32_t LodSelector::select(const std::vector<MeshLod>& lods, uint32_t currentLod,
+                             float distance, float errorScale, float projectionScale,
+                             float viewportHeight, const LodSettings& settings)
+{
+    if (lods.size() <= 1)
+    {
+        return 0;
+    }
+    uint32_t lod = std::min<uint32_t>(currentLod, static_cast<uint32_t>(lods.size() - 1));
+
+    auto pixels = [&](uint32_t level) {
+        return projectedError(lods[level].error * errorScale, distance, projectionScale, viewportHeight);
+    };
+    const float coarserLimit = settings.pixelErrorThreshold * (1.0f - settings.hysteresis);
+    const float finerLimit = settings.pixelErrorThreshold * (1.0f + settings.hysteresis);
+
+    // Go coarser only when the next level is comfortably below the threshold...
+    while (lod + 1 < lods.size() && pixels(lod + 1) <= coarserLimit)
+    {
+        lod++;
+    }
+    // ...and finer only when the current level is clearly above it.
+    while (lod > 0 && pixels(lod) > finerLimit)
+    {
+        lod--;
+    }
+    return lod;
+}
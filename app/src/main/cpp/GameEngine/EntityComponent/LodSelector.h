@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+
+struct LodSettings {
+    // Largest acceptable simplification error on screen, in pixels.
+    float pixelErrorThreshold{1.0f};
+    // Fraction around the threshold inside which the current level is kept, avoids popping
+    // when an object hovers right at a switch distance.
+    float hysteresis{0.25f};
+};
+
+class LodSelector {
+public:
+    // Projects an object space error at the given view distance onto the screen, in pixels.
+    // projectionScale is projection[1][1] (cot(fovY / 2)) of a perspective projection.
+    static float projectedError(float error, float distance, float projectionScale, float viewportHeight);
+
+    // Sphere around the centre of the vertices' bounding box, what screen sizes are measured with
+    static void boundingSphere(const std::vector<Vertex>& vertices, glm::vec3& center, float& radius);
+    // Distance from the camera to the object space sphere placed by model, and the largest axis
+    // scale of model, which object space errors and sizes grow by
+    static float viewDistance(const glm::vec3& center, float radius, const glm::mat4& model, const glm::mat4& view,
+                              float& scale);
+
+    // Picks the coarsest level whose projected error stays under the threshold, starting from
+    // currentLod and only moving once the error leaves the hysteresis band.
+    static uint32_t select(const std::vector<MeshLod>& lods, uint32_t currentLod,
+                           float distance, float errorScale, float projectionScale,
+                           float viewportHeight, const LodSettings& settings);
+};
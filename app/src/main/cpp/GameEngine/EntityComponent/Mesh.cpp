@@ -1,4 +1,10 @@
+#include <algorithm>
+
 #include "Mesh.h"
+#include "MeshSimplifier.h"
+#include "LodSelector.h"
+#include "Meshlet.h"
+
 /*
 uint32_t findMemoryTypeIndex(VkPhysicalDevice physicalDevice, uint32_t allowedTypes, VkMemoryPropertyFlags properties)
 {
@@ -125,15 +131,38 @@ void createBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize
 
 Mesh::Mesh()
 {
+    currentLod = 0;
+    boundingCenter = glm::vec3(0.0f);
+    boundingRadius = 0.0f;
 }
 
 Mesh::Mesh(/*VkPhysicalDevice newPhysicalDevice, VkDevice newDevice,
            VkQueue transferQueue, VkCommandPool transferCommandPool,*/
            std::vector<Vertex>* vertices, std::vector<uint32_t> * indices,
-           int newTexId)
+           int newTexId, int maxLodCount)
 {
+    // LOD levels are appended to the index list so they end up in the same index buffer
+    if (maxLodCount > 1)
+    {
+        lods = MeshSimplifier::buildLodChain(*vertices, *indices, static_cast<uint32_t>(maxLodCount));
+    }
+    else
+    {
+        lods.push_back({0, static_cast<uint32_t>(indices->size()), 0.0f});
+    }
+    currentLod = 0;
+
+    // Reorder the full detail range into clusters for cluster level culling
+    if (lods[0].indexCount / 3 >= kMinClusteredTriangles)
+    {
+        meshlets = MeshletBuilder::build(*vertices, *indices, lods[0].firstIndex, lods[0].indexCount);
+    }
+
     vertexCount = vertices->size();
     indexCount = indices->size();
+
+    // Bounding sphere used for screen size LOD selection
+    LodSelector::boundingSphere(*vertices, boundingCenter, boundingRadius);
     /*
     physicalDevice = newPhysicalDevice;
     device = newDevice;
@@ -160,6 +189,21 @@ int Mesh::getTexId()
     return texId;
 }
 
+void Mesh::setTexId(int newTexId)
+{
+    texId = newTexId;
+}
+
+int Mesh::getStreamedTexture()
+{
+    return streamedTexture;
+}
+
+void Mesh::setStreamedTexture(int handle)
+{
+    streamedTexture = handle;
+}
+
 int Mesh::getVertexCount()
 {
     return vertexCount;
@@ -173,7 +217,53 @@ VkBuffer Mesh::getVertexBuffer()
 
 int Mesh::getIndexCount()
 {
-    return indexCount;
+    return lods.empty() ? indexCount : static_cast<int>(lods[currentLod].indexCount);
+}
+
+int Mesh::getFirstIndex()
+{
+    return lods.empty() ? 0 : static_cast<int>(lods[currentLod].firstIndex);
+}
+
+const std::vector<Meshlet>& Mesh::getMeshlets()
+{
+    return meshlets;
+}
+
+int Mesh::getLodCount()
+{
+    return static_cast<int>(lods.size());
+}
+
+int Mesh::getCurrentLod()
+{
+    return static_cast<int>(currentLod);
+}
+
+void Mesh::selectLod(const glm::mat4& projection, const glm::mat4& view, float viewportHeight,
+                     const LodSettings& settings)
+{
+    if (lods.size() <= 1)
+    {
+        return;
+    }
+    // Errors are stored in object space, scale them by the largest model axis scale
+    float scale;
+    float distance = getViewDistance(view, scale);
+
+    currentLod = LodSelector::select(lods, currentLod, distance, scale, projection[1][1], viewportHeight, settings);
+}
+
+float Mesh::getProjectedSize(const glm::mat4& projection, const glm::mat4& view, float viewportHeight)
+{
+    float scale;
+    float distance = getViewDistance(view, scale);
+    return LodSelector::projectedError(2.0f * boundingRadius * scale, distance, projection[1][1], viewportHeight);
+}
+
+float Mesh::getViewDistance(const glm::mat4& view, float& scale)
+{
+    return LodSelector::viewDistance(boundingCenter, boundingRadius, model.model, view, scale);
 }
 
 /*
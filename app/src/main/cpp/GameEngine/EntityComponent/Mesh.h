@@ -14,37 +14,107 @@ struct Vertex {
     glm::vec2 tex;
 };
 
+// One level of detail inside the mesh index buffer. All levels share the vertex buffer,
+// a level is a range of indices plus the object space error it introduces.
+struct MeshLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;
+};
+
+// A cluster of up to kMaxVertices vertices / kMaxTriangles triangles stored as a contiguous
+// range of the mesh index buffer, so a visible cluster is exactly one indexed draw.
+struct Meshlet {
+    static constexpr uint32_t kMaxVertices = 64;
+    static constexpr uint32_t kMaxTriangles = 124;
+
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t vertexCount;
+
+    // Object space bounding sphere
+    glm::vec3 center;
+    float radius;
+
+    // Normal cone, the cluster is back facing when
+    // dot(normalize(coneApex - camera), coneAxis) >= coneCutoff. A cutoff of 1 disables the test.
+    glm::vec3 coneAxis;
+    float coneCutoff;
+    glm::vec3 coneApex;
+};
+
+// Same layout as VkDrawIndexedIndirectCommand so the result can be copied straight into an
+// indirect buffer without pulling Vulkan into the entity layer.
+struct DrawIndexedCommand {
+    uint32_t indexCount;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+    uint32_t firstInstance;
+};
+
+struct LodSettings;
+
 class Mesh{
 public:
     Mesh();
     Mesh(/*VkPhysicalDevice newPhysicalDevice, VkDevice newDevice,
          VkQueue transferQueue, VkCommandPool transferCommandPool,*/
          std::vector<Vertex> * vertices, std::vector<uint32_t> * indices,
-         int newTexId);
+         int newTexId, int maxLodCount = 1);
 
     void setModel(glm::mat4 newModel);
     Model* getModel();
 
     int getTexId();
+    void setTexId(int newTexId);
+    // Handle of a streamed texture (TextureStreamer), -1 when texId is a plain texture. The renderer
+    // then keeps texId pointing at the streamer's current image.
+    int getStreamedTexture();
+    void setStreamedTexture(int handle);
 
     int getVertexCount();
     // getVertexBuffer();
 
     int getIndexCount();
+    int getFirstIndex();
     //VkBuffer getIndexBuffer();
 
+    const std::vector<Meshlet>& getMeshlets();
+
+    int getLodCount();
+    int getCurrentLod();
+    // Picks the level for this frame from the projected screen size of the bounding sphere
+    void selectLod(const glm::mat4& projection, const glm::mat4& view, float viewportHeight,
+                   const LodSettings& settings);
+    // Diameter of the bounding sphere on screen in pixels, the size texture streaming picks the
+    // mip for (assumes the texture is mapped once across the mesh)
+    float getProjectedSize(const glm::mat4& projection, const glm::mat4& view, float viewportHeight);
+
     void destroyBuffers();
 
     ~Mesh();
 
 private:
+    // Below two full clusters per-object culling is as good as cluster culling
+    static constexpr uint32_t kMinClusteredTriangles = 2 * Meshlet::kMaxTriangles;
+
     Model model;
     int texId;
+    int streamedTexture = -1;
     int vertexCount;
     //VkBuffer vertexBuffer;
     //VkDeviceMemory vertexBufferMemory;
 
     int indexCount;
+    std::vector<MeshLod> lods;
+    std::vector<Meshlet> meshlets;
+    uint32_t currentLod;
+    glm::vec3 boundingCenter;
+    float boundingRadius;
+
+    // Largest model axis scale and the distance from the camera to the bounding sphere
+    float getViewDistance(const glm::mat4& view, float& scale);
     //VkBuffer indexBuffer;
     //VkDeviceMemory indexBufferMemory;
 
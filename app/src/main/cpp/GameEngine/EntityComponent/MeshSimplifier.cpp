@@ -0,0 +1,318 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include "MeshSimplifier.h"
+
+namespace {
+
+// Symmetric 4x4 matrix stored as upper triangle, plus the accumulated plane weight
+// so the error can be evaluated as a weighted mean squared distance.
+struct Quadric {
+    double a00{}, a01{}, a02{}, a03{};
+    double a11{}, a12{}, a13{};
+    double a22{}, a23{};
+    double a33{};
+    double w{};
+
+    void addPlane(double nx, double ny, double nz, double d, double weight)
+    {
+        a00 += weight * nx * nx; a01 += weight * nx * ny; a02 += weight * nx * nz; a03 += weight * nx * d;
+        a11 += weight * ny * ny; a12 += weight * ny * nz; a13 += weight * ny * d;
+        a22 += weight * nz * nz; a23 += weight * nz * d;
+        a33 += weight * d * d;
+        w += weight;
+    }
+
+    void add(const Quadric& q)
+    {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+        a11 += q.a11; a12 += q.a12; a13 += q.a13;
+        a22 += q.a22; a23 += q.a23;
+        a33 += q.a33;
+        w += q.w;
+    }
+
+    double error(const glm::vec3& p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double e = a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x
+                 + a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y
+                 + a22 * z * z + 2.0 * a23 * z
+                 + a33;
+        return w > 0.0 ? std::fabs(e) / w : std::fabs(e);
+    }
+};
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double cost;
+};
+
+uint64_t edgeKey(uint32_t a, uint32_t b)
+{
+    if (a > b) std::swap(a, b);
+    return (uint64_t(a) << 32) | b;
+}
+
+// Maps every vertex onto the first vertex sharing its exact position.
+std::vector<uint32_t> buildPositionRemap(const std::vector<Vertex>& vertices)
+{
+    struct PositionHash {
+        size_t operator()(const glm::vec3& p) const
+        {
+            uint32_t h[3];
+            std::memcpy(h, &p, sizeof(h));
+            return (h[0] * 73856093u) ^ (h[1] * 19349663u) ^ (h[2] * 83492791u);
+        }
+    };
+    std::unordered_map<glm::vec3, uint32_t, PositionHash> firstByPosition;
+    firstByPosition.reserve(vertices.size());
+
+    std::vector<uint32_t> remap(vertices.size());
+    for (uint32_t i = 0; i < vertices.size(); i++)
+    {
+        auto it = firstByPosition.emplace(vertices[i].position, i).first;
+        remap[i] = it->second;
+    }
+    return remap;
+}
+
+glm::vec3 triangleNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    return glm::cross(b - a, c - a);
+}
+
+} // namespace
+
+std::vector<uint32_t> MeshSimplifier::simplify(const std::vector<Vertex>& vertices,
+                                               const std::vector<uint32_t>& indices,
+                                               size_t targetIndexCount,
+                                               float maxError,
+                                               float* resultError)
+{
+    std::vector<uint32_t> result(indices);
+    double worstError = 0.0;
+    if (resultError) *resultError = 0.0f;
+    if (vertices.empty() || indices.size() < 3 || targetIndexCount >= indices.size())
+    {
+        return result;
+    }
+
+    const size_t vertexCount = vertices.size();
+    const std::vector<uint32_t> position = buildPositionRemap(vertices);
+
+    // Seams: more than one vertex per position. Moving them would tear the attribute split.
+    std::vector<uint8_t> locked(vertexCount, 0);
+    {
+        std::vector<uint32_t> sharing(vertexCount, 0);
+        for (uint32_t i = 0; i < vertexCount; i++) sharing[position[i]]++;
+        for (uint32_t i = 0; i < vertexCount; i++)
+        {
+            if (sharing[position[i]] > 1) locked[position[i]] = 1;
+        }
+    }
+
+    // Borders: edges referenced by a single triangle.
+    {
+        std::unordered_map<uint64_t, uint32_t> edgeUse;
+        edgeUse.reserve(result.size());
+        for (size_t t = 0; t + 2 < result.size(); t += 3)
+        {
+            for (int e = 0; e < 3; e++)
+            {
+                edgeUse[edgeKey(position[result[t + e]], position[result[t + (e + 1) % 3]])]++;
+            }
+        }
+        for (const auto& edge : edgeUse)
+        {
+            if (edge.second == 1)
+            {
+                locked[uint32_t(edge.first >> 32)] = 1;
+                locked[uint32_t(edge.first & 0xffffffffu)] = 1;
+            }
+        }
+    }
+
+    // Per position quadrics, weighted by triangle area.
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t t = 0; t + 2 < result.size(); t += 3)
+    {
+        const glm::vec3& p0 = vertices[result[t]].position;
+        const glm::vec3& p1 = vertices[result[t + 1]].position;
+        const glm::vec3& p2 = vertices[result[t + 2]].position;
+        glm::vec3 n = triangleNormal(p0, p1, p2);
+        float length = glm::length(n);
+        if (length <= 0.0f) continue;
+        n /= length;
+        double d = -glm::dot(n, p0);
+        double area = 0.5 * length;
+        for (int k = 0; k < 3; k++)
+        {
+            quadrics[position[result[t + k]]].addPlane(n.x, n.y, n.z, d, area);
+        }
+    }
+
+    const double maxCost = double(maxError) * double(maxError);
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<uint8_t> touched(vertexCount);
+    std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+    std::vector<uint32_t> triangleList;
+    std::vector<Collapse> collapses;
+
+    while (result.size() > targetIndexCount)
+    {
+        const size_t triangleCount = result.size() / 3;
+
+        // Position -> triangle adjacency for this pass.
+        std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+        for (uint32_t index : result) triangleOffsets[position[index] + 1]++;
+        for (size_t i = 0; i < vertexCount; i++) triangleOffsets[i + 1] += triangleOffsets[i];
+        triangleList.assign(result.size(), 0);
+        {
+            std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+            for (uint32_t t = 0; t < triangleCount; t++)
+            {
+                for (int k = 0; k < 3; k++) triangleList[fill[position[result[t * 3 + k]]]++] = t;
+            }
+        }
+
+        // Candidate collapses: vertex "from" moves onto vertex "to" of the same edge.
+        collapses.clear();
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            for (int e = 0; e < 3; e++)
+            {
+                uint32_t a = result[t * 3 + e];
+                uint32_t b = result[t * 3 + (e + 1) % 3];
+                for (int direction = 0; direction < 2; direction++)
+                {
+                    uint32_t from = direction ? b : a;
+                    uint32_t to = direction ? a : b;
+                    if (locked[position[from]] || position[from] == position[to]) continue;
+                    Quadric q = quadrics[position[from]];
+                    q.add(quadrics[position[to]]);
+                    collapses.push_back({from, to, q.error(vertices[to].position)});
+                }
+            }
+        }
+        if (collapses.empty()) break;
+        std::sort(collapses.begin(), collapses.end(),
+                  [](const Collapse& l, const Collapse& r) { return l.cost < r.cost; });
+
+        for (uint32_t i = 0; i < vertexCount; i++) remap[i] = i;
+        std::fill(touched.begin(), touched.end(), 0);
+
+        size_t removedTriangles = 0;
+        const size_t trianglesToRemove = triangleCount - targetIndexCount / 3;
+        for (const Collapse& collapse : collapses)
+        {
+            if (collapse.cost > maxCost || removedTriangles >= trianglesToRemove) break;
+
+            const uint32_t from = position[collapse.from];
+            const uint32_t to = position[collapse.to];
+            if (touched[from] || touched[to]) continue;
+
+            // Reject collapses that flip a surviving triangle around "from".
+            bool flips = false;
+            size_t collapsedHere = 0;
+            const glm::vec3& target = vertices[collapse.to].position;
+            for (uint32_t j = triangleOffsets[from]; j < triangleOffsets[from + 1] && !flips; j++)
+            {
+                const uint32_t* tri = &result[triangleList[j] * 3];
+                uint32_t p[3] = {position[tri[0]], position[tri[1]], position[tri[2]]};
+                if (p[0] == to || p[1] == to || p[2] == to)
+                {
+                    collapsedHere++;
+                    continue;
+                }
+                glm::vec3 before[3] = {vertices[tri[0]].position, vertices[tri[1]].position, vertices[tri[2]].position};
+                glm::vec3 after[3] = {before[0], before[1], before[2]};
+                for (int k = 0; k < 3; k++) if (p[k] == from) after[k] = target;
+                glm::vec3 n0 = triangleNormal(before[0], before[1], before[2]);
+                glm::vec3 n1 = triangleNormal(after[0], after[1], after[2]);
+                flips = glm::dot(n0, n1) <= 0.0f;
+            }
+            if (flips) continue;
+
+            remap[collapse.from] = collapse.to;
+            quadrics[to].add(quadrics[from]);
+            worstError = std::max(worstError, collapse.cost);
+            removedTriangles += collapsedHere;
+
+            // Lock the whole one-ring for the rest of this pass so collapses never overlap.
+            for (uint32_t j = triangleOffsets[from]; j < triangleOffsets[from + 1]; j++)
+            {
+                const uint32_t* tri = &result[triangleList[j] * 3];
+                for (int k = 0; k < 3; k++) touched[position[tri[k]]] = 1;
+            }
+            touched[to] = 1;
+        }
+        if (removedTriangles == 0) break;
+
+        size_t write = 0;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            uint32_t a = remap[result[t * 3]];
+            uint32_t b = remap[result[t * 3 + 1]];
+            uint32_t c = remap[result[t * 3 + 2]];
+            if (position[a] == position[b] || position[b] == position[c] || position[a] == position[c]) continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    if (resultError) *resultError = float(std::sqrt(worstError));
+    return result;
+}
+
+std::vector<MeshLod> MeshSimplifier::buildLodChain(const std::vector<Vertex>& vertices,
+                                                   std::vector<uint32_t>& indices,
+                                                   uint32_t maxLodCount,
+                                                   float reduction,
+                                                   float maxError)
+{
+    std::vector<MeshLod> lods;
+    const size_t sourceCount = indices.size();
+    lods.push_back({0, static_cast<uint32_t>(sourceCount), 0.0f});
+
+    // Always simplify from the full resolution source so the quadrics stay accurate,
+    // only the target triangle count shrinks per level.
+    const std::vector<uint32_t> source(indices.begin(), indices.end());
+
+    // The same relative error for any model size
+    glm::vec3 minPos(0.0f), maxPos(0.0f);
+    if (!vertices.empty())
+    {
+        minPos = maxPos = vertices[0].position;
+        for (const Vertex& vertex : vertices)
+        {
+            minPos = glm::min(minPos, vertex.position);
+            maxPos = glm::max(maxPos, vertex.position);
+        }
+    }
+    const float maxObjectError = maxError * glm::length(maxPos - minPos);
+    size_t previousCount = sourceCount;
+    float previousError = 0.0f;
+    for (uint32_t level = 1; level < maxLodCount; level++)
+    {
+        size_t target = static_cast<size_t>(float(previousCount / 3) * reduction) * 3;
+        if (target < 3) break;
+
+        float error = 0.0f;
+        std::vector<uint32_t> lodIndices = simplify(vertices, source, target, maxObjectError, &error);
+
+        // Stop once the simplifier cannot make meaningful progress (locked borders, error cap).
+        if (lodIndices.empty() || lodIndices.size() * 10 > previousCount * 9) break;
+
+        previousError = std::max(previousError, error);
+        lods.push_back({static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(lodIndices.size()), previousError});
+        indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+        previousCount = lodIndices.size();
+    }
+    return lods;
+}
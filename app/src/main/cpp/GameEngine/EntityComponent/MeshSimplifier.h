@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Mesh.h"
+
+// Quadric error metric edge-collapse simplifier (Garland & Heckbert).
+// Vertices are only ever collapsed onto existing vertices so the simplified index lists
+// stay valid against the original vertex buffer. Vertices on open borders and on
+// attribute seams (same position, different vertex) are locked to avoid cracks.
+class MeshSimplifier {
+public:
+    // Returns a new index list with at most targetIndexCount indices where possible.
+    // Collapses whose error exceeds maxError (object space distance) are rejected.
+    static std::vector<uint32_t> simplify(const std::vector<Vertex>& vertices,
+                                          const std::vector<uint32_t>& indices,
+                                          size_t targetIndexCount,
+                                          float maxError,
+                                          float* resultError = nullptr);
+
+    // Builds a LOD chain by repeatedly halving (reduction) the triangle count.
+    // Level indices are appended to indices, level 0 is the original index range.
+    // maxError is relative to the diagonal of the vertices' bounding box, the errors stored in
+    // the levels are object space distances.
+    static std::vector<MeshLod> buildLodChain(const std::vector<Vertex>& vertices,
+                                              std::vector<uint32_t>& indices,
+                                              uint32_t maxLodCount,
+                                              float reduction = 0.5f,
+                                              float maxError = 0.01f);
+};
@@ -0,0 +1,270 @@
+#include <algorithm>
+#include <cmath>
+
+#include "Meshlet.h"
+
+namespace {
+
+// Ritter's bounding sphere, good enough for culling and much cheaper than the minimal sphere.
+void computeSphere(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& meshletVertices,
+                   glm::vec3& center, float& radius)
+{
+    const glm::vec3& first = vertices[meshletVertices[0]].position;
+    glm::vec3 a = first;
+    float best = -1.0f;
+    for (uint32_t v : meshletVertices)
+    {
+        float d = glm::dot(vertices[v].position - first, vertices[v].position - first);
+        if (d > best) { best = d; a = vertices[v].position; }
+    }
+    glm::vec3 b = a;
+    best = -1.0f;
+    for (uint32_t v : meshletVertices)
+    {
+        float d = glm::dot(vertices[v].position - a, vertices[v].position - a);
+        if (d > best) { best = d; b = vertices[v].position; }
+    }
+    center = (a + b) * 0.5f;
+    radius = glm::length(b - a) * 0.5f;
+    for (uint32_t v : meshletVertices)
+    {
+        float d = glm::length(vertices[v].position - center);
+        if (d > radius)
+        {
+            // Grow the sphere just enough to include the outlier
+            float newRadius = (radius + d) * 0.5f;
+            center += (vertices[v].position - center) * ((newRadius - radius) / d);
+            radius = newRadius;
+        }
+    }
+}
+
+void computeCone(const std::vector<Vertex>& vertices, const uint32_t* triangles, uint32_t triangleCount,
+                 Meshlet& meshlet)
+{
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+    meshlet.coneApex = meshlet.center;
+
+    std::vector<glm::vec3> normals;
+    normals.reserve(triangleCount);
+    glm::vec3 sum(0.0f);
+    for (uint32_t t = 0; t < triangleCount; t++)
+    {
+        const glm::vec3& p0 = vertices[triangles[t * 3]].position;
+        const glm::vec3& p1 = vertices[triangles[t * 3 + 1]].position;
+        const glm::vec3& p2 = vertices[triangles[t * 3 + 2]].position;
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(n);
+        normals.push_back(length > 0.0f ? n / length : glm::vec3(0.0f));
+        sum += normals.back();
+    }
+    float sumLength = glm::length(sum);
+    if (sumLength <= 0.0f)
+    {
+        return;
+    }
+    glm::vec3 axis = sum / sumLength;
+
+    float minDot = 1.0f;
+    for (const glm::vec3& n : normals)
+    {
+        minDot = std::min(minDot, glm::dot(n, axis));
+    }
+    // Normals spread over a hemisphere or more, the cluster can never be fully back facing
+    if (minDot <= 0.1f)
+    {
+        return;
+    }
+
+    // Move the apex back along the axis until every triangle plane is in front of it
+    float maxT = 0.0f;
+    for (uint32_t t = 0; t < triangleCount; t++)
+    {
+        const glm::vec3& n = normals[t];
+        float dn = glm::dot(n, axis);
+        if (dn <= 0.0f) continue;
+        float dc = glm::dot(vertices[triangles[t * 3]].position - meshlet.center, n);
+        maxT = std::max(maxT, dc / dn);
+    }
+    meshlet.coneAxis = axis;
+    meshlet.coneApex = meshlet.center - axis * maxT;
+    meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+} // namespace
+
+std::vector<Meshlet> MeshletBuilder::build(const std::vector<Vertex>& vertices,
+                                           std::vector<uint32_t>& indices,
+                                           uint32_t firstIndex, uint32_t indexCount,
+                                           uint32_t maxVertices, uint32_t maxTriangles)
+{
+    std::vector<Meshlet> meshlets;
+    const uint32_t triangleCount = indexCount / 3;
+    if (triangleCount == 0 || vertices.empty())
+    {
+        return meshlets;
+    }
+    const uint32_t* source = indices.data() + firstIndex;
+
+    // Vertex -> triangle adjacency
+    std::vector<uint32_t> offsets(vertices.size() + 1, 0);
+    for (uint32_t i = 0; i < triangleCount * 3; i++) offsets[source[i] + 1]++;
+    for (size_t i = 0; i < vertices.size(); i++) offsets[i + 1] += offsets[i];
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (uint32_t t = 0; t < triangleCount; t++)
+        {
+            for (int k = 0; k < 3; k++) adjacency[fill[source[t * 3 + k]]++] = t;
+        }
+    }
+
+    std::vector<uint8_t> used(triangleCount, 0);
+    std::vector<uint32_t> localSlot(vertices.size(), ~0u);
+    std::vector<uint32_t> meshletVertices;
+    std::vector<uint32_t> ordered;
+    ordered.reserve(triangleCount * 3);
+
+    uint32_t seed = 0;
+    while (true)
+    {
+        while (seed < triangleCount && used[seed]) seed++;
+        if (seed == triangleCount) break;
+
+        Meshlet meshlet{};
+        meshlet.firstIndex = firstIndex + static_cast<uint32_t>(ordered.size());
+        meshletVertices.clear();
+        uint32_t meshletTriangles = 0;
+
+        auto newVertexCount = [&](uint32_t t) {
+            uint32_t count = 0;
+            for (int k = 0; k < 3; k++) count += localSlot[source[t * 3 + k]] == ~0u ? 1 : 0;
+            return count;
+        };
+        auto addTriangle = [&](uint32_t t) {
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t v = source[t * 3 + k];
+                if (localSlot[v] == ~0u)
+                {
+                    localSlot[v] = static_cast<uint32_t>(meshletVertices.size());
+                    meshletVertices.push_back(v);
+                }
+                ordered.push_back(v);
+            }
+            used[t] = 1;
+            meshletTriangles++;
+        };
+
+        addTriangle(seed);
+        while (meshletTriangles < maxTriangles)
+        {
+            // Grow through shared vertices, preferring triangles that add the fewest new vertices
+            uint32_t best = ~0u;
+            uint32_t bestCost = 4;
+            for (uint32_t v : meshletVertices)
+            {
+                for (uint32_t j = offsets[v]; j < offsets[v + 1]; j++)
+                {
+                    uint32_t t = adjacency[j];
+                    if (used[t]) continue;
+                    uint32_t cost = newVertexCount(t);
+                    if (meshletVertices.size() + cost > maxVertices) continue;
+                    if (cost < bestCost || (cost == bestCost && t < best))
+                    {
+                        best = t;
+                        bestCost = cost;
+                    }
+                }
+            }
+            if (best == ~0u) break;
+            addTriangle(best);
+        }
+
+        meshlet.indexCount = meshletTriangles * 3;
+        meshlet.vertexCount = static_cast<uint32_t>(meshletVertices.size());
+        computeSphere(vertices, meshletVertices, meshlet.center, meshlet.radius);
+        computeCone(vertices, ordered.data() + (meshlet.firstIndex - firstIndex), meshletTriangles, meshlet);
+        meshlets.push_back(meshlet);
+
+        for (uint32_t v : meshletVertices) localSlot[v] = ~0u;
+    }
+
+    std::copy(ordered.begin(), ordered.end(), indices.begin() + firstIndex);
+    return meshlets;
+}
+
+void ClusterCuller::extractFrustumPlanes(const glm::mat4& matrix, glm::vec4 planes[6])
+{
+    // Gribb/Hartmann, rows of the column major glm matrix
+    glm::vec4 row0(matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0]);
+    glm::vec4 row1(matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1]);
+    glm::vec4 row2(matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2]);
+    glm::vec4 row3(matrix[0][3], matrix[1][3], matrix[2][3], matrix[3][3]);
+
+    planes[0] = row3 + row0;    // left
+    planes[1] = row3 - row0;    // right
+    planes[2] = row3 + row1;    // bottom
+    planes[3] = row3 - row1;    // top
+    planes[4] = row3 + row2;    // near, conservative for both [-1,1] and [0,1] depth
+    planes[5] = row3 - row2;    // far
+    for (int i = 0; i < 6; i++)
+    {
+        float length = glm::length(glm::vec3(planes[i]));
+        if (length > 0.0f) planes[i] /= length;
+    }
+}
+
+bool ClusterCuller::isVisible(const Meshlet& meshlet, const glm::vec4 planes[6], const glm::vec3& cameraPosition)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        if (glm::dot(glm::vec3(planes[i]), meshlet.center) + planes[i].w < -meshlet.radius)
+        {
+            return false;
+        }
+    }
+    if (meshlet.coneCutoff < 1.0f)
+    {
+        glm::vec3 toApex = meshlet.coneApex - cameraPosition;
+        float length = glm::length(toApex);
+        if (length > 0.0f && glm::dot(toApex / length, meshlet.coneAxis) >= meshlet.coneCutoff)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t ClusterCuller::cull(const std::vector<Meshlet>& meshlets,
+                             const glm::mat4& viewProjection, const glm::mat4& model,
+                             const glm::vec3& cameraPosition, int32_t vertexOffset,
+                             std::vector<DrawIndexedCommand>& draws)
+{
+    // Test in object space: planes of viewProjection * model and the camera moved into the model.
+    // Cone culling assumes the model matrix has no non-uniform scale.
+    glm::vec4 planes[6];
+    extractFrustumPlanes(viewProjection * model, planes);
+    glm::vec3 localCamera = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.0f));
+
+    uint32_t emitted = 0;
+    for (const Meshlet& meshlet : meshlets)
+    {
+        if (!isVisible(meshlet, planes, localCamera))
+        {
+            continue;
+        }
+        // Merge with the previous draw when the clusters are adjacent in the index buffer
+        if (!draws.empty() && emitted > 0
+            && draws.back().firstIndex + draws.back().indexCount == meshlet.firstIndex
+            && draws.back().vertexOffset == vertexOffset)
+        {
+            draws.back().indexCount += meshlet.indexCount;
+            continue;
+        }
+        draws.push_back({meshlet.indexCount, 1, meshlet.firstIndex, vertexOffset, 0});
+        emitted++;
+    }
+    return emitted;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Mesh.h"
+
+class MeshletBuilder {
+public:
+    // Reorders the index range [firstIndex, firstIndex + indexCount) of indices into clusters and
+    // returns them. The triangle set is unchanged so other ranges (LODs) stay valid.
+    static std::vector<Meshlet> build(const std::vector<Vertex>& vertices,
+                                      std::vector<uint32_t>& indices,
+                                      uint32_t firstIndex, uint32_t indexCount,
+                                      uint32_t maxVertices = Meshlet::kMaxVertices,
+                                      uint32_t maxTriangles = Meshlet::kMaxTriangles);
+};
+
+class ClusterCuller {
+public:
+    // Six normalized planes (xyz normal, w distance) in the space described by matrix,
+    // e.g. pass projection * view * model to get object space planes.
+    static void extractFrustumPlanes(const glm::mat4& matrix, glm::vec4 planes[6]);
+
+    static bool isVisible(const Meshlet& meshlet, const glm::vec4 planes[6], const glm::vec3& cameraPosition);
+
+    // Frustum and back face cone culling on the CPU. Appends one draw per visible cluster and
+    // returns the number of draws emitted.
+    static uint32_t cull(const std::vector<Meshlet>& meshlets,
+                         const glm::mat4& viewProjection, const glm::mat4& model,
+                         const glm::vec3& cameraPosition, int32_t vertexOffset,
+                         std::vector<DrawIndexedCommand>& draws);
+};
@@ -1,4 +1,5 @@
 #include "EventHandler.h"
+#include "Utils/Profiler.h"
 
 void EventHandler::onRecieve(Event e, std::string arg...) {
     switch (e) {
@@ -12,6 +13,7 @@ void EventHandler::onRecieve(Event e, std::string arg...) {
 
 
 void EventHandler::handleEvents(android_app *app) {
+    PROFILE_FUNCTION();
     auto *inputBuffer = android_app_swap_input_buffers(app);
     if (!inputBuffer) {
         // no inputs yet.
@@ -1,12 +1,17 @@
 #pragma once
-#include <android/native_window_jni.h>
+#include "NativeWindow.h"
+
+struct FrameState;
 
 class IGfxDevice{
 public:
     virtual ~IGfxDevice() = 0;
     virtual bool isInitialized() = 0;
-    virtual void createSurface(ANativeWindow* window) = 0;
+    virtual void createSurface(NativeWindow* window) = 0;
     virtual void reCreateSwapchain() = 0;
+    virtual void draw() = 0;
+    // Camera and mesh transforms for the next draw()
+    virtual void setFrameState(const FrameState& state) = 0;
 
     virtual void init() = 0;
     virtual void deInit() = 0;
@@ -0,0 +1,16 @@
+#pragma once
+
+// The window a device presents to, by platform. The window system is chosen at build time: Android,
+// or XCB with VK_USE_PLATFORM_XCB_KHR on Linux. Built without one, devices can only render headless.
+#if defined(__ANDROID__)
+#include <android/native_window.h>
+using NativeWindow = ANativeWindow;
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+#include <xcb/xcb.h>
+struct NativeWindow {
+    xcb_connection_t* connection;
+    xcb_window_t window;
+};
+#else
+struct NativeWindow;
+#endif
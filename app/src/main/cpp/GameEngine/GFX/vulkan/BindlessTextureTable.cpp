@@ -0,0 +1,135 @@
+#include <algorithm>
+
+#include "BindlessTextureTable.h"
+#include "ShaderModuleCache.h"
+#include "GfxUtils.h"
+#include "../../Utils/Hash.h"
+
+BindlessTextureTable::BindlessTextureTable(const ThreadSafeGfxDevice& threadSafeDevice, ShaderModuleCache& shaderCache,
+                                           uint32_t maxTextures, uint32_t framesInFlight)
+    : m_FramesInFlight(framesInFlight)
+{
+    LOGD(m_TAG,__FUNCTION__);
+    auto dev = threadSafeDevice.lock();
+    if (dev == nullptr) {
+        throw std::runtime_error("BindlessTextureTable created without a device");
+    }
+    m_VkDevice = dev->getDevice();
+
+    // Stay within what the device allows for update-after-bind sampled images and samplers, a
+    // combined image sampler counts against both
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+    indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+    VkPhysicalDeviceProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &indexingProperties;
+    vkGetPhysicalDeviceProperties2(dev->getVkPhysicalDevice(), &properties);
+    m_Capacity = std::min({ maxTextures,
+                            indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+                            indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                            indexingProperties.maxDescriptorSetUpdateAfterBindSamplers,
+                            indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers });
+    LOGD(m_TAG,"%u texture slots (%u requested)", m_Capacity, maxTextures);
+
+    VkDescriptorSetLayoutBinding binding = {};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    binding.descriptorCount = m_Capacity;
+    binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    // Partially bound : unused slots may stay unwritten. Update after bind : slots can be written
+    // while command buffers using the set are pending, as long as those never sample that slot.
+    const VkDescriptorBindingFlagsEXT bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+                                                     VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    bindingFlagsInfo.bindingCount = 1;
+    bindingFlagsInfo.pBindingFlags = &bindingFlags;
+    Hasher pNextHasher;
+    pNextHasher.value(bindingFlagsInfo.sType).value(bindingFlags);
+    m_SetLayout = shaderCache.getDescriptorSetLayout({ binding },
+                                                     VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT,
+                                                     &bindingFlagsInfo, pNextHasher.get());
+
+    VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_Capacity };
+    VkDescriptorPoolCreateInfo poolCreateInfo = {};
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+    poolCreateInfo.maxSets = 1;
+    poolCreateInfo.poolSizeCount = 1;
+    poolCreateInfo.pPoolSizes = &poolSize;
+    CHECK_VK(vkCreateDescriptorPool(m_VkDevice, &poolCreateInfo, nullptr, &m_Pool));
+
+    VkDescriptorSetAllocateInfo setAllocInfo = {};
+    setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setAllocInfo.descriptorPool = m_Pool;
+    setAllocInfo.descriptorSetCount = 1;
+    setAllocInfo.pSetLayouts = &m_SetLayout;
+    CHECK_VK(vkAllocateDescriptorSets(m_VkDevice, &setAllocInfo, &m_Set));
+}
+
+BindlessTextureTable::~BindlessTextureTable()
+{
+    vkDestroyDescriptorPool(m_VkDevice, m_Pool, nullptr);
+}
+
+uint32_t BindlessTextureTable::addTexture(VkImageView imageView, VkSampler sampler)
+{
+    uint32_t slot;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_FreeSlots.empty()) {
+            slot = m_FreeSlots.back();
+            m_FreeSlots.pop_back();
+        } else if (m_NextUnused < m_Capacity) {
+            slot = m_NextUnused++;
+        } else {
+            LOGE(m_TAG,"All %u texture slots in use", m_Capacity);
+            throw std::runtime_error("bindless texture table full");
+        }
+    }
+    updateTexture(slot, imageView, sampler);
+    return slot;
+}
+
+void BindlessTextureTable::updateTexture(uint32_t slot, VkImageView imageView, VkSampler sampler)
+{
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.sampler = sampler;
+    imageInfo.imageView = imageView;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = m_Set;
+    write.dstBinding = 0;
+    write.dstArrayElement = slot;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.descriptorCount = 1;
+    write.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(m_VkDevice, 1, &write, 0, nullptr);
+}
+
+void BindlessTextureTable::removeTexture(uint32_t slot)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_RetiredSlots.push_back({ slot, m_Frame });
+}
+
+void BindlessTextureTable::nextFrame()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_Frame++;
+    auto firstPending = std::partition(m_RetiredSlots.begin(), m_RetiredSlots.end(),
+                                       [this](const RetiredSlot& retired) { return retired.frame + m_FramesInFlight <= m_Frame; });
+    for (auto it = m_RetiredSlots.begin(); it != firstPending; ++it) {
+        m_FreeSlots.push_back(it->slot);
+    }
+    m_RetiredSlots.erase(m_RetiredSlots.begin(), firstPending);
+}
+
+uint32_t BindlessTextureTable::getUsedCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_NextUnused - static_cast<uint32_t>(m_FreeSlots.size());
+}
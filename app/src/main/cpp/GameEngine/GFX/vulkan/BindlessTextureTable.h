@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../../Utils/Definitions.h"
+#include "GfxDevice.h"
+
+class ShaderModuleCache;
+
+// One partially bound, update-after-bind array of combined image samplers (VK_EXT_descriptor_indexing).
+// The set is bound once per frame and draws select their texture with an index, so texture changes
+// cost neither a vkCmdBindDescriptorSets nor a new descriptor set.
+// Slots come from a free list. A removed slot is only reused once the frames that may still
+// sample it have completed.
+class BindlessTextureTable {
+public:
+    NONCOPYABLE(BindlessTextureTable);
+    BindlessTextureTable(const ThreadSafeGfxDevice& threadSafeDevice, ShaderModuleCache& shaderCache,
+                         uint32_t maxTextures, uint32_t framesInFlight);
+    ~BindlessTextureTable();
+
+    uint32_t addTexture(VkImageView imageView, VkSampler sampler);
+    void updateTexture(uint32_t slot, VkImageView imageView, VkSampler sampler);
+    void removeTexture(uint32_t slot);
+    // Call once per frame, recycles slots retired framesInFlight frames ago
+    void nextFrame();
+
+    VkDescriptorSetLayout getSetLayout() const { return m_SetLayout; }
+    VkDescriptorSet getSet() const { return m_Set; }
+    uint32_t getCapacity() const { return m_Capacity; }
+    uint32_t getUsedCount() const;
+
+private:
+    struct RetiredSlot {
+        uint32_t slot;
+        uint64_t frame;
+    };
+
+    VkDevice m_VkDevice{VK_NULL_HANDLE};
+    VkDescriptorSetLayout m_SetLayout{VK_NULL_HANDLE};     // owned by the shader cache
+    VkDescriptorPool m_Pool{VK_NULL_HANDLE};
+    VkDescriptorSet m_Set{VK_NULL_HANDLE};
+    uint32_t m_Capacity{0};
+    uint32_t m_FramesInFlight{0};
+    uint64_t m_Frame{0};
+
+    mutable std::mutex m_mutex;
+    uint32_t m_NextUnused{0};
+    std::vector<uint32_t> m_FreeSlots;
+    std::vector<RetiredSlot> m_RetiredSlots;
+    static constexpr LogTag m_TAG{"BindlessTextureTable"};
+};
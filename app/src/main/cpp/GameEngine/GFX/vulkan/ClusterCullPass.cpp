@@ -0,0 +1,132 @@
+#include <array>
+
+#include "ClusterCullPass.h"
+#include "ShaderModuleCache.h"
+#include "GfxUtils.h"
+#include "../../EntityComponent/Meshlet.h"
+
+ClusterCullPass::ClusterCullPass(const ThreadSafeGfxDevice& threadSafeDevice, ShaderModuleCache& shaderCache,
+                                 const std::string& shaderPath)
+    : m_device(threadSafeDevice)
+{
+    LOGD(m_TAG,__FUNCTION__);
+    auto dev = m_device.lock();
+    if (dev == nullptr) {
+        throw std::runtime_error("ClusterCullPass created without a device");
+    }
+    m_VkDevice = dev->getDevice();
+    m_MultiDrawIndirect = dev->isMultiDrawIndirectSupported();
+
+    // Binding 0 : meshlets, binding 1 : indirect draws
+    const ShaderModule* shader = shaderCache.getShader(shaderPath);
+    const ProgramLayout* layout = shaderCache.getProgramLayout({ shader });
+    if (layout->setLayouts.size() != 1 || layout->pushConstants.empty() ||
+        layout->pushConstants[0].size != sizeof(ClusterCullParams))
+    {
+        throw std::runtime_error("unexpected interface in " + shaderPath);
+    }
+    m_SetLayout = layout->setLayouts[0];
+    m_PipelineLayout = layout->pipelineLayout;
+
+    VkComputePipelineCreateInfo pipelineCreateInfo = {};
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineCreateInfo.stage.module = shader->module;
+    pipelineCreateInfo.stage.pName = shader->entryPoint.c_str();
+    pipelineCreateInfo.layout = m_PipelineLayout;
+    CHECK_VK(vkCreateComputePipelines(m_VkDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &m_Pipeline));
+}
+
+ClusterCullPass::~ClusterCullPass()
+{
+    vkDestroyPipeline(m_VkDevice, m_Pipeline, nullptr);
+}
+
+std::vector<GpuMeshlet> ClusterCullPass::packMeshlets(const std::vector<Meshlet>& meshlets)
+{
+    std::vector<GpuMeshlet> packed(meshlets.size());
+    for (size_t i = 0; i < meshlets.size(); i++)
+    {
+        const Meshlet& meshlet = meshlets[i];
+        packed[i].sphere = glm::vec4(meshlet.center, meshlet.radius);
+        packed[i].cone = glm::vec4(meshlet.coneAxis, meshlet.coneCutoff);
+        packed[i].apex = glm::vec4(meshlet.coneApex, 0.0f);
+        packed[i].firstIndex = meshlet.firstIndex;
+        packed[i].indexCount = meshlet.indexCount;
+        packed[i].padding[0] = packed[i].padding[1] = 0;
+    }
+    return packed;
+}
+
+ClusterCullParams ClusterCullPass::makeParams(uint32_t firstMeshlet, uint32_t meshletCount,
+                                              const glm::mat4& viewProjection, const glm::mat4& model,
+                                              const glm::vec3& cameraPosition, int32_t vertexOffset)
+{
+    // Same object space setup as ClusterCuller::cull so both paths agree
+    ClusterCullParams params = {};
+    ClusterCuller::extractFrustumPlanes(viewProjection * model, params.planes);
+    params.cameraPosition = glm::inverse(model) * glm::vec4(cameraPosition, 1.0f);
+    params.meshletCount = meshletCount;
+    params.vertexOffset = vertexOffset;
+    params.firstMeshlet = firstMeshlet;
+    return params;
+}
+
+void ClusterCullPass::writeDescriptorSet(VkDescriptorSet set, VkBuffer meshletBuffer, VkBuffer drawBuffer) const
+{
+    std::array<VkDescriptorBufferInfo, 2> bufferInfos = {};
+    bufferInfos[0].buffer = meshletBuffer;
+    bufferInfos[0].range = VK_WHOLE_SIZE;
+    bufferInfos[1].buffer = drawBuffer;
+    bufferInfos[1].range = VK_WHOLE_SIZE;
+
+    std::array<VkWriteDescriptorSet, 2> writes = {};
+    for (uint32_t i = 0; i < writes.size(); i++)
+    {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &bufferInfos[i];
+    }
+    vkUpdateDescriptorSets(m_VkDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void ClusterCullPass::record(VkCommandBuffer commandBuffer, VkDescriptorSet set, VkBuffer drawBuffer,
+                             const ClusterCullParams& params) const
+{
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_Pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineLayout, 0, 1, &set, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ClusterCullParams), &params);
+    vkCmdDispatch(commandBuffer, (params.meshletCount + kGroupSize - 1) / kGroupSize, 1, 1);
+
+    // Compute writes -> indirect command reads
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = drawBuffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                         0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void ClusterCullPass::drawIndirect(VkCommandBuffer commandBuffer, VkBuffer drawBuffer, uint32_t meshletCount) const
+{
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    if (m_MultiDrawIndirect)
+    {
+        vkCmdDrawIndexedIndirect(commandBuffer, drawBuffer, 0, meshletCount, stride);
+        return;
+    }
+    // Without multiDrawIndirect every draw has to be issued on its own
+    for (uint32_t i = 0; i < meshletCount; i++)
+    {
+        vkCmdDrawIndexedIndirect(commandBuffer, drawBuffer, static_cast<VkDeviceSize>(i) * stride, 1, stride);
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include "glm/glm.hpp"
+
+#include "../../Utils/Definitions.h"
+#include "../../EntityComponent/Mesh.h"
+#include "GfxDevice.h"
+
+class ShaderModuleCache;
+
+// std430 layout of a meshlet as read by cluster_cull.comp
+struct GpuMeshlet {
+    glm::vec4 sphere;
+    glm::vec4 cone;
+    glm::vec4 apex;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t padding[2];
+};
+
+// Push constant block of cluster_cull.comp, exactly the guaranteed 128 bytes
+struct ClusterCullParams {
+    glm::vec4 planes[6];
+    glm::vec4 cameraPosition;
+    uint32_t meshletCount;
+    int32_t vertexOffset;
+    // Meshlets firstMeshlet up to firstMeshlet + meshletCount are culled into draws 0 up to meshletCount
+    uint32_t firstMeshlet;
+    uint32_t padding;
+};
+
+// GPU path of cluster culling. A compute dispatch writes one VkDrawIndexedIndirectCommand per
+// meshlet (instanceCount 0 when culled) which is then consumed by an indirect indexed draw.
+class ClusterCullPass {
+public:
+    // local_size_x of cluster_cull.comp
+    static constexpr uint32_t kGroupSize = 64;
+
+    NONCOPYABLE(ClusterCullPass);
+    // Module, set layout and pipeline layout are reflected and owned by shaderCache
+    ClusterCullPass(const ThreadSafeGfxDevice& threadSafeDevice, ShaderModuleCache& shaderCache,
+                    const std::string& shaderPath);
+    ~ClusterCullPass();
+
+    static std::vector<GpuMeshlet> packMeshlets(const std::vector<Meshlet>& meshlets);
+    static ClusterCullParams makeParams(uint32_t firstMeshlet, uint32_t meshletCount,
+                                        const glm::mat4& viewProjection, const glm::mat4& model,
+                                        const glm::vec3& cameraPosition, int32_t vertexOffset);
+
+    VkDescriptorSetLayout getSetLayout() const { return m_SetLayout; }
+    void writeDescriptorSet(VkDescriptorSet set, VkBuffer meshletBuffer, VkBuffer drawBuffer) const;
+
+    // Dispatch plus the barrier that makes the draws visible to the indirect stage
+    void record(VkCommandBuffer commandBuffer, VkDescriptorSet set, VkBuffer drawBuffer,
+                const ClusterCullParams& params) const;
+    void drawIndirect(VkCommandBuffer commandBuffer, VkBuffer drawBuffer, uint32_t meshletCount) const;
+
+private:
+    ThreadSafeGfxDevice m_device;
+    VkDevice m_VkDevice{VK_NULL_HANDLE};
+    VkDescriptorSetLayout m_SetLayout{VK_NULL_HANDLE};
+    VkPipelineLayout m_PipelineLayout{VK_NULL_HANDLE};
+    VkPipeline m_Pipeline{VK_NULL_HANDLE};
+    bool m_MultiDrawIndirect{false};
+    static constexpr LogTag m_TAG{"ClusterCullPass"};
+};
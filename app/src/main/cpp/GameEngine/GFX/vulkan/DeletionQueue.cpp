@@ -0,0 +1,111 @@
+#include "DeletionQueue.h"
+
+DeletionQueue::DeletionQueue(VkDevice device, uint32_t framesInFlight, std::function<void(uint32_t)> removeTexture)
+    : m_VkDevice(device)
+    , m_RemoveTexture(std::move(removeTexture))
+    , m_Frames(framesInFlight)
+{
+}
+
+DeletionQueue::~DeletionQueue()
+{
+    // The device may be gone already, GfxDevice::deInit released everything queued before it
+    const size_t pending = getPendingCount();
+    if (pending > 0) {
+        LOGW(m_TAG,"%zu objects freed after the device, leaked", pending);
+    }
+}
+
+void DeletionQueue::destroyImageView(VkImageView view)
+{
+    if (view == VK_NULL_HANDLE) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_Frames[m_FrameIndex].views.push_back(view);
+}
+
+void DeletionQueue::destroyImage(VkImage image, VkDeviceMemory memory)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Frame& frame = m_Frames[m_FrameIndex];
+    if (image != VK_NULL_HANDLE) {
+        frame.images.push_back(image);
+    }
+    if (memory != VK_NULL_HANDLE) {
+        frame.memory.push_back(memory);
+    }
+}
+
+void DeletionQueue::destroyBuffer(VkBuffer buffer, VkDeviceMemory memory)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Frame& frame = m_Frames[m_FrameIndex];
+    if (buffer != VK_NULL_HANDLE) {
+        frame.buffers.push_back(buffer);
+    }
+    if (memory != VK_NULL_HANDLE) {
+        frame.memory.push_back(memory);
+    }
+}
+
+void DeletionQueue::removeTexture(uint32_t textureId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_Frames[m_FrameIndex].textureIds.push_back(textureId);
+}
+
+void DeletionQueue::beginFrame(uint32_t frameIndex)
+{
+    Frame released;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::swap(released, m_Frames[frameIndex]);
+        m_FrameIndex = frameIndex;
+    }
+    release(released);
+}
+
+void DeletionQueue::releaseAll()
+{
+    std::vector<Frame> released(m_Frames.size());
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::swap(released, m_Frames);
+        m_Frames.resize(released.size());
+    }
+    for (Frame& frame : released) {
+        release(frame);
+    }
+}
+
+size_t DeletionQueue::getPendingCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t count = 0;
+    for (const Frame& frame : m_Frames) {
+        count += frame.textureIds.size() + frame.views.size() + frame.images.size() + frame.buffers.size() +
+                 frame.memory.size();
+    }
+    return count;
+}
+
+void DeletionQueue::release(Frame& frame)
+{
+    // Descriptors first, then the views they point at, then what the views and memory belong to
+    for (uint32_t textureId : frame.textureIds) {
+        m_RemoveTexture(textureId);
+    }
+    for (VkImageView view : frame.views) {
+        vkDestroyImageView(m_VkDevice, view, nullptr);
+    }
+    for (VkImage image : frame.images) {
+        vkDestroyImage(m_VkDevice, image, nullptr);
+    }
+    for (VkBuffer buffer : frame.buffers) {
+        vkDestroyBuffer(m_VkDevice, buffer, nullptr);
+    }
+    for (VkDeviceMemory memory : frame.memory) {
+        vkFreeMemory(m_VkDevice, memory, nullptr);
+    }
+}
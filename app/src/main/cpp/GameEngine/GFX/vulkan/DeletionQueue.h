@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../../Utils/Definitions.h"
+
+// Destruction of Vulkan objects submitted work may still use. A free is queued on the frame slot
+// being recorded and carried out when that slot comes around again, after its fence signaled: by
+// then every frame submitted before the free has completed. Frees may come from any thread, the
+// objects are destroyed on the render thread and nothing waits for the device to go idle.
+class DeletionQueue {
+public:
+    NONCOPYABLE(DeletionQueue);
+    // removeTexture gives back an id from GfxDevice::addTexture, on the render thread
+    DeletionQueue(VkDevice device, uint32_t framesInFlight, std::function<void(uint32_t)> removeTexture);
+    ~DeletionQueue();
+
+    void destroyImageView(VkImageView view);
+    // memory is freed along with the image / buffer, VK_NULL_HANDLE when it isn't theirs alone
+    void destroyImage(VkImage image, VkDeviceMemory memory);
+    void destroyBuffer(VkBuffer buffer, VkDeviceMemory memory);
+    void removeTexture(uint32_t textureId);
+
+    // The fence of frameIndex signaled: releases what was queued the last time the slot was
+    // recorded, frees queue onto the slot from now on
+    void beginFrame(uint32_t frameIndex);
+    // The device is idle, releases every slot
+    void releaseAll();
+
+    size_t getPendingCount() const;
+
+private:
+    struct Frame {
+        std::vector<uint32_t> textureIds;
+        std::vector<VkImageView> views;
+        std::vector<VkImage> images;
+        std::vector<VkBuffer> buffers;
+        std::vector<VkDeviceMemory> memory;
+    };
+
+    // Without the lock, the frame was taken out of m_Frames
+    void release(Frame& frame);
+
+    VkDevice m_VkDevice{VK_NULL_HANDLE};
+    std::function<void(uint32_t)> m_RemoveTexture;
+    mutable std::mutex m_mutex;
+    std::vector<Frame> m_Frames;
+    uint32_t m_FrameIndex{0};
+    static constexpr LogTag m_TAG{"DeletionQueue"};
+};
@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <array>
+
+#include "DescriptorAllocator.h"
+#include "GfxUtils.h"
+#include "../../Utils/Hash.h"
+
+#define MAX_SETS_PER_POOL 4096
+
+// Descriptors per set for each type a pool is created with
+static const std::array<std::pair<VkDescriptorType, float>, 7> s_PoolRatios = {{
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+    { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f },
+    { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.0f },
+    { VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f },
+    { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0.5f },
+}};
+
+DescriptorAllocator::DescriptorAllocator(const ThreadSafeGfxDevice& threadSafeDevice, uint32_t setsPerPool)
+    : m_device(threadSafeDevice), m_SetsPerPool(setsPerPool)
+{
+    auto dev = m_device.lock();
+    if (dev == nullptr) {
+        throw std::runtime_error("DescriptorAllocator created without a device");
+    }
+    m_VkDevice = dev->getDevice();
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+    for (auto pool : m_UsedPools) {
+        vkDestroyDescriptorPool(m_VkDevice, pool, nullptr);
+    }
+    for (auto pool : m_FreePools) {
+        vkDestroyDescriptorPool(m_VkDevice, pool, nullptr);
+    }
+}
+
+VkDescriptorPool DescriptorAllocator::createPool(uint32_t maxSets)
+{
+    std::vector<VkDescriptorPoolSize> poolSizes;
+    for (const auto& ratio : s_PoolRatios) {
+        poolSizes.push_back({ ratio.first, std::max(1u, static_cast<uint32_t>(ratio.second * maxSets)) });
+    }
+    VkDescriptorPoolCreateInfo poolCreateInfo = {};
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolCreateInfo.maxSets = maxSets;
+    poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolCreateInfo.pPoolSizes = poolSizes.data();
+
+    VkDescriptorPool pool;
+    CHECK_VK(vkCreateDescriptorPool(m_VkDevice, &poolCreateInfo, nullptr, &pool));
+    LOGD(m_TAG,"Created descriptor pool for %u sets", maxSets);
+    return pool;
+}
+
+VkDescriptorPool DescriptorAllocator::grabPool()
+{
+    if (!m_FreePools.empty()) {
+        VkDescriptorPool pool = m_FreePools.back();
+        m_FreePools.pop_back();
+        return pool;
+    }
+    // Every overflow doubles the next pool, so a busy allocator settles after a few frames
+    VkDescriptorPool pool = createPool(m_SetsPerPool);
+    m_SetsPerPool = std::min(m_SetsPerPool * 2, static_cast<uint32_t>(MAX_SETS_PER_POOL));
+    return pool;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout, const void* pNext)
+{
+    if (m_CurrentPool == VK_NULL_HANDLE) {
+        m_CurrentPool = grabPool();
+        m_UsedPools.push_back(m_CurrentPool);
+    }
+
+    VkDescriptorSetAllocateInfo setAllocInfo = {};
+    setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setAllocInfo.pNext = pNext;
+    setAllocInfo.descriptorPool = m_CurrentPool;
+    setAllocInfo.descriptorSetCount = 1;
+    setAllocInfo.pSetLayouts = &layout;
+
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    VkResult result = vkAllocateDescriptorSets(m_VkDevice, &setAllocInfo, &set);
+    if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+        // Chain a fresh pool and retry once, a second failure is a real error
+        m_CurrentPool = grabPool();
+        m_UsedPools.push_back(m_CurrentPool);
+        setAllocInfo.descriptorPool = m_CurrentPool;
+        result = vkAllocateDescriptorSets(m_VkDevice, &setAllocInfo, &set);
+    }
+    CHECK_VK(result);
+    m_Allocations++;
+    return set;
+}
+
+void DescriptorAllocator::reset()
+{
+    for (auto pool : m_UsedPools) {
+        CHECK_VK(vkResetDescriptorPool(m_VkDevice, pool, 0));
+        m_FreePools.push_back(pool);
+    }
+    m_UsedPools.clear();
+    m_CurrentPool = VK_NULL_HANDLE;
+    m_Allocations = 0;
+}
+
+DescriptorSetBuilder& DescriptorSetBuilder::bindBuffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer,
+                                                       VkDeviceSize offset, VkDeviceSize range)
+{
+    Binding entry = {};
+    entry.binding = binding;
+    entry.type = type;
+    entry.bufferInfo = { buffer, offset, range };
+    entry.isImage = false;
+    m_Bindings.push_back(entry);
+    return *this;
+}
+
+DescriptorSetBuilder& DescriptorSetBuilder::bindImage(uint32_t binding, VkDescriptorType type, VkImageView imageView,
+                                                      VkSampler sampler, VkImageLayout imageLayout)
+{
+    Binding entry = {};
+    entry.binding = binding;
+    entry.type = type;
+    entry.imageInfo = { sampler, imageView, imageLayout };
+    entry.isImage = true;
+    m_Bindings.push_back(entry);
+    return *this;
+}
+
+uint64_t DescriptorSetBuilder::hash(VkDescriptorSetLayout layout) const
+{
+    Hasher hasher;
+    hasher.value(layout);
+    for (const auto& entry : m_Bindings) {
+        hasher.value(entry.binding).value(entry.type);
+        if (entry.isImage) {
+            hasher.value(entry.imageInfo.sampler).value(entry.imageInfo.imageView).value(entry.imageInfo.imageLayout);
+        } else {
+            hasher.value(entry.bufferInfo.buffer).value(entry.bufferInfo.offset).value(entry.bufferInfo.range);
+        }
+    }
+    return hasher.get();
+}
+
+bool DescriptorSetBuilder::operator==(const DescriptorSetBuilder& other) const
+{
+    if (m_Bindings.size() != other.m_Bindings.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < m_Bindings.size(); i++) {
+        const Binding& a = m_Bindings[i];
+        const Binding& b = other.m_Bindings[i];
+        if (a.binding != b.binding || a.type != b.type || a.isImage != b.isImage) {
+            return false;
+        }
+        if (a.isImage ? (a.imageInfo.sampler != b.imageInfo.sampler || a.imageInfo.imageView != b.imageInfo.imageView ||
+                         a.imageInfo.imageLayout != b.imageInfo.imageLayout)
+                      : (a.bufferInfo.buffer != b.bufferInfo.buffer || a.bufferInfo.offset != b.bufferInfo.offset ||
+                         a.bufferInfo.range != b.bufferInfo.range)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void DescriptorSetBuilder::write(VkDevice device, VkDescriptorSet set) const
+{
+    std::vector<VkWriteDescriptorSet> writes(m_Bindings.size());
+    for (size_t i = 0; i < m_Bindings.size(); i++) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = set;
+        writes[i].dstBinding = m_Bindings[i].binding;
+        writes[i].dstArrayElement = 0;
+        writes[i].descriptorType = m_Bindings[i].type;
+        writes[i].descriptorCount = 1;
+        if (m_Bindings[i].isImage) {
+            writes[i].pImageInfo = &m_Bindings[i].imageInfo;
+        } else {
+            writes[i].pBufferInfo = &m_Bindings[i].bufferInfo;
+        }
+    }
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+DescriptorSetCache::DescriptorSetCache(const ThreadSafeGfxDevice& threadSafeDevice)
+    : m_Allocator(threadSafeDevice)
+{
+    m_VkDevice = threadSafeDevice.lock()->getDevice();
+}
+
+VkDescriptorSet DescriptorSetCache::getSet(VkDescriptorSetLayout layout, const DescriptorSetBuilder& builder)
+{
+    const uint64_t key = builder.hash(layout);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto range = m_Sets.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.layout == layout && it->second.builder == builder) {
+            m_Hits++;
+            it->second.users++;
+            return it->second.set;
+        }
+    }
+    m_Misses++;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    auto freeSets = m_FreeSets.find(layout);
+    if (freeSets != m_FreeSets.end() && !freeSets->second.empty()) {
+        set = freeSets->second.back();
+        freeSets->second.pop_back();
+    } else {
+        set = m_Allocator.allocate(layout);
+    }
+    builder.write(m_VkDevice, set);
+    m_Sets.emplace(key, Entry{ layout, builder, set, 1 });
+    return set;
+}
+
+void DescriptorSetCache::release(VkDescriptorSet set)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Linear, releases are as rare as destroyed textures
+    auto it = std::find_if(m_Sets.begin(), m_Sets.end(), [set](const auto& entry) { return entry.second.set == set; });
+    if (it == m_Sets.end()) {
+        LOGW(m_TAG,"release of a descriptor set the cache doesn't hold");
+        return;
+    }
+    if (--it->second.users == 0) {
+        m_FreeSets[it->second.layout].push_back(set);
+        m_Sets.erase(it);
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../../Utils/Definitions.h"
+#include "GfxDevice.h"
+
+// Chain of descriptor pools. When the current pool reports VK_ERROR_OUT_OF_POOL_MEMORY (or is
+// fragmented) the allocation moves on to the next pool, creating a bigger one if needed.
+// reset() returns every pool in one vkResetDescriptorPool each, nothing is freed individually.
+// Not thread safe, give each thread / frame its own allocator.
+class DescriptorAllocator {
+public:
+    NONCOPYABLE(DescriptorAllocator);
+    DescriptorAllocator(const ThreadSafeGfxDevice& threadSafeDevice, uint32_t setsPerPool = 64);
+    ~DescriptorAllocator();
+
+    // pNext is forwarded to VkDescriptorSetAllocateInfo (variable descriptor counts)
+    VkDescriptorSet allocate(VkDescriptorSetLayout layout, const void* pNext = nullptr);
+    void reset();
+
+    uint32_t getPoolCount() const { return static_cast<uint32_t>(m_UsedPools.size() + m_FreePools.size()); }
+    uint32_t getAllocationCount() const { return m_Allocations; }
+
+private:
+    VkDescriptorPool grabPool();
+    VkDescriptorPool createPool(uint32_t maxSets);
+
+    ThreadSafeGfxDevice m_device;
+    VkDevice m_VkDevice{VK_NULL_HANDLE};
+    uint32_t m_SetsPerPool;
+    VkDescriptorPool m_CurrentPool{VK_NULL_HANDLE};
+    std::vector<VkDescriptorPool> m_UsedPools;
+    std::vector<VkDescriptorPool> m_FreePools;
+    uint32_t m_Allocations{0};
+    static constexpr LogTag m_TAG{"DescriptorAllocator"};
+};
+
+// Collects the writes of one descriptor set. The same bindings hash and compare the same, which is
+// what DescriptorSetCache keys on.
+class DescriptorSetBuilder {
+public:
+    DescriptorSetBuilder& bindBuffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer,
+                                     VkDeviceSize offset, VkDeviceSize range);
+    DescriptorSetBuilder& bindImage(uint32_t binding, VkDescriptorType type, VkImageView imageView,
+                                    VkSampler sampler, VkImageLayout imageLayout);
+
+    uint64_t hash(VkDescriptorSetLayout layout) const;
+    bool operator==(const DescriptorSetBuilder& other) const;
+    void write(VkDevice device, VkDescriptorSet set) const;
+
+private:
+    struct Binding {
+        uint32_t binding;
+        VkDescriptorType type;
+        VkDescriptorBufferInfo bufferInfo;
+        VkDescriptorImageInfo imageInfo;
+        bool isImage;
+    };
+    std::vector<Binding> m_Bindings;
+};
+
+// Descriptor sets whose contents never change after the first write (per image UBOs, material
+// textures). A repeated request is a hash lookup plus a compare of the bindings, no driver call.
+class DescriptorSetCache {
+public:
+    NONCOPYABLE(DescriptorSetCache);
+    DescriptorSetCache(const ThreadSafeGfxDevice& threadSafeDevice);
+    ~DescriptorSetCache() = default;
+
+    VkDescriptorSet getSet(VkDescriptorSetLayout layout, const DescriptorSetBuilder& builder);
+    // Gives back a set from getSet once the GPU is done with it (DeletionQueue), before a resource
+    // it references is destroyed. The entry is evicted when every getSet returning it was released,
+    // the set is then rewritten by the next miss with the same layout.
+    void release(VkDescriptorSet set);
+
+    uint32_t getHits() const { return m_Hits; }
+    uint32_t getMisses() const { return m_Misses; }
+
+private:
+    VkDevice m_VkDevice{VK_NULL_HANDLE};
+    std::mutex m_mutex;
+    struct Entry {
+        VkDescriptorSetLayout layout;
+        DescriptorSetBuilder builder;
+        VkDescriptorSet set;
+        uint32_t users;
+    };
+
+    DescriptorAllocator m_Allocator;
+    // By hash, equal hashes are told apart by the stored layout and bindings
+    std::unordered_multimap<uint64_t, Entry> m_Sets;
+    // Evicted sets by layout, pools are never created with FREE_DESCRIPTOR_SET
+    std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSet>> m_FreeSets;
+    uint32_t m_Hits{0};
+    uint32_t m_Misses{0};
+    static constexpr LogTag m_TAG{"DescriptorSetCache"};
+};
@@ -0,0 +1,204 @@
+#include <algorithm>
+
+#include "FramePacer.h"
+
+FramePacer::FramePacer(const FramePacerConfig& config, Clock& clock)
+    : m_Config(config)
+    , m_Clock(clock)
+    , m_PresentMode(config.presentMode)
+{
+    m_SafetyNs = m_RefreshNs / 8;
+    updateInterval();
+    // Nothing measured yet, start a whole interval ahead of the vsync
+    m_WorkNs = m_IntervalNs;
+}
+
+VkPresentModeKHR FramePacer::choosePresentMode(VkPresentModeKHR preferred, const std::vector<VkPresentModeKHR>& available)
+{
+    if (std::find(available.begin(), available.end(), preferred) != available.end()) {
+        return preferred;
+    }
+    // The only mode every surface has to support
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+uint32_t FramePacer::chooseImageCount(uint32_t desired, const VkSurfaceCapabilitiesKHR& capabilities)
+{
+    uint32_t imageCount = std::max(desired, capabilities.minImageCount);
+    if (capabilities.maxImageCount > 0) {
+        imageCount = std::min(imageCount, capabilities.maxImageCount);
+    }
+    return imageCount;
+}
+
+std::string FramePacer::toString(VkPresentModeKHR presentMode)
+{
+    switch (presentMode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR: return "IMMEDIATE";
+        case VK_PRESENT_MODE_MAILBOX_KHR: return "MAILBOX";
+        case VK_PRESENT_MODE_FIFO_KHR: return "FIFO";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO_RELAXED";
+        default: return std::to_string(static_cast<int>(presentMode));
+    }
+}
+
+void FramePacer::setRefreshDuration(uint64_t refreshNs)
+{
+    if (refreshNs == 0 || refreshNs == m_RefreshNs) {
+        return;
+    }
+    LOGD(m_TAG,"refresh %.3f ms", refreshNs / 1e6);
+    m_RefreshNs = refreshNs;
+    m_SafetyNs = m_RefreshNs / 8;
+    updateInterval();
+}
+
+void FramePacer::setPresentMode(VkPresentModeKHR presentMode)
+{
+    m_PresentMode = presentMode;
+}
+
+void FramePacer::updateInterval()
+{
+    // Whole refresh cycles, a target a hair above a multiple (rounding) doesn't add one
+    uint64_t target = m_Config.targetFrameIntervalNs;
+    m_MinSwapInterval = std::max<uint32_t>(1, static_cast<uint32_t>((target + m_RefreshNs - m_RefreshNs / 20) / m_RefreshNs));
+    m_SwapInterval = std::min(std::max(m_SwapInterval, m_MinSwapInterval), std::max(kMaxSwapInterval, m_MinSwapInterval));
+    m_IntervalNs = m_SwapInterval * m_RefreshNs;
+    m_Stats.swapInterval = m_SwapInterval;
+    m_Stats.frameIntervalNs = m_IntervalNs;
+}
+
+uint64_t FramePacer::desiredPresentTime(uint32_t presentId) const
+{
+    if (!m_HasTiming) {
+        return 0;
+    }
+    // Slot on the vsync grid of the last presented frame, moved to the first one not yet past.
+    // Half a refresh early, so jitter in the refresh duration can't push it one vsync late.
+    uint64_t desired = m_AnchorPresentNs + static_cast<uint64_t>(presentId - m_AnchorPresentId) * m_IntervalNs - m_RefreshNs / 2;
+    uint64_t now = m_Clock.nowNs();
+    if (desired < now) {
+        desired += (now - desired + m_IntervalNs - 1) / m_IntervalNs * m_IntervalNs;
+    }
+    return desired;
+}
+
+void FramePacer::waitForNextFrame()
+{
+    uint64_t now = m_Clock.nowNs();
+    uint32_t presentId = m_PresentId + 1;
+    uint64_t desired = desiredPresentTime(presentId);
+
+    // FIFO blocks in acquire once the swap chain is full, no need to throttle one refresh per frame
+    bool backPressure = (m_PresentMode == VK_PRESENT_MODE_FIFO_KHR || m_PresentMode == VK_PRESENT_MODE_FIFO_RELAXED_KHR) &&
+                        m_SwapInterval == 1;
+    uint64_t wake = backPressure ? 0 : m_NextFrameStartNs;
+    // Latest start the slowest recent frame still makes its vsync from
+    if (desired > m_WorkNs + m_SafetyNs) {
+        wake = std::max(wake, desired - m_WorkNs - m_SafetyNs);
+    }
+    uint64_t plannedStart = now;
+    if (wake > now) {
+        m_Clock.sleepUntilNs(wake);
+        m_Stats.sleptNs += wake - now;
+        plannedStart = wake;
+    }
+
+    uint64_t start = m_Clock.nowNs();
+    if (m_LastFrameStartNs != 0) {
+        double frameMs = (start - m_LastFrameStartNs) / 1e6;
+        m_Stats.averageFrameMs = m_Stats.averageFrameMs == 0.0 ? frameMs : m_Stats.averageFrameMs * 0.9 + frameMs * 0.1;
+        if (!m_HasTiming) {
+            // Without present feedback a frame starting late is the best guess for a missed vsync
+            recordFrame(start - m_LastFrameStartNs > m_IntervalNs + m_RefreshNs / 2, now - m_LastFrameStartNs);
+        }
+    }
+    m_LastFrameStartNs = start;
+    // From the planned start, oversleeping doesn't accumulate
+    m_NextFrameStartNs = plannedStart + m_IntervalNs;
+    m_PresentId = presentId;
+    m_DesiredPresentNs = desired;
+    m_FrameStarts[presentId % kHistory] = { presentId, start };
+}
+
+void FramePacer::onPresentTiming(const PresentTiming& timing)
+{
+    if (!m_HasTiming) {
+        LOGD(m_TAG,"pacing with display timing");
+        m_HasTiming = true;
+    }
+    if (m_AnchorPresentNs == 0 || static_cast<int32_t>(timing.presentId - m_AnchorPresentId) > 0) {
+        m_AnchorPresentId = timing.presentId;
+        m_AnchorPresentNs = timing.actualPresentTimeNs;
+    }
+
+    bool missed = timing.desiredPresentTimeNs != 0 && timing.actualPresentTimeNs >= timing.desiredPresentTimeNs + m_RefreshNs;
+    // Frames already scheduled against the grid before a miss queue up behind it, only the
+    // first one counts
+    if (missed) {
+        if (static_cast<int32_t>(timing.presentId - m_MissScheduledId) <= 0) {
+            missed = false;
+        } else {
+            m_MissScheduledId = m_PresentId;
+        }
+    }
+    uint64_t workNs = 0;
+    const FrameStart& frameStart = m_FrameStarts[timing.presentId % kHistory];
+    if (frameStart.presentId == timing.presentId && frameStart.startNs != 0) {
+        // The present was processed presentMargin before the deadline of the earliest vsync it could make
+        uint64_t readyNs = timing.earliestPresentTimeNs > timing.presentMarginNs ? timing.earliestPresentTimeNs - timing.presentMarginNs : 0;
+        if (readyNs > frameStart.startNs) {
+            workNs = readyNs - frameStart.startNs;
+        }
+        if (timing.actualPresentTimeNs > frameStart.startNs) {
+            double latencyMs = (timing.actualPresentTimeNs - frameStart.startNs) / 1e6;
+            m_Stats.averageLatencyMs = m_Stats.averageLatencyMs == 0.0 ? latencyMs : m_Stats.averageLatencyMs * 0.9 + latencyMs * 0.1;
+        }
+    }
+    recordFrame(missed, workNs);
+}
+
+void FramePacer::recordFrame(bool missed, uint64_t workNs)
+{
+    m_Stats.frames++;
+    m_WindowFrames++;
+    m_WindowMaxWorkNs = std::max(m_WindowMaxWorkNs, workNs);
+    if (missed) {
+        m_Stats.missedFrames++;
+        m_WindowMisses++;
+        m_SafetyNs = std::min(m_SafetyNs * 2, m_RefreshNs);
+    }
+    if (m_WindowFrames >= kWindowFrames) {
+        adapt();
+    }
+}
+
+void FramePacer::adapt()
+{
+    if (m_WindowMaxWorkNs != 0) {
+        m_WorkNs = m_WindowMaxWorkNs;
+    }
+    if (m_WindowMisses == 0) {
+        m_SafetyNs = std::max(m_RefreshNs / 8, m_SafetyNs * 3 / 4);
+    }
+    if (m_Config.adaptiveInterval) {
+        uint32_t swapInterval = m_SwapInterval;
+        if (m_WindowMisses > kWindowFrames / 10 && m_SwapInterval < kMaxSwapInterval) {
+            swapInterval++;
+        } else if (m_WindowMisses == 0 && m_SwapInterval > m_MinSwapInterval &&
+                   (m_WindowMaxWorkNs + m_SafetyNs) * 10 < (m_SwapInterval - 1) * m_RefreshNs * 8) {
+            // Comfortably fits a shorter interval
+            swapInterval--;
+        }
+        if (swapInterval != m_SwapInterval) {
+            LOGD(m_TAG,"swap interval %u -> %u, %u of %u frames missed, slowest frame %.2f ms", m_SwapInterval, swapInterval,
+                 m_WindowMisses, m_WindowFrames, m_WindowMaxWorkNs / 1e6);
+            m_SwapInterval = swapInterval;
+            updateInterval();
+        }
+    }
+    m_WindowFrames = 0;
+    m_WindowMisses = 0;
+    m_WindowMaxWorkNs = 0;
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../../Utils/Definitions.h"
+#include "../../Utils/Clock.h"
+
+struct FramePacerConfig {
+    // FIFO is always available, FIFO_RELAXED and MAILBOX fall back to it when the surface lacks them
+    VkPresentModeKHR presentMode{VK_PRESENT_MODE_FIFO_KHR};
+    // Swap chain depth, clamped to the surface limits. 2 has the lowest latency, 3 absorbs uneven frames.
+    uint32_t swapchainImages{3};
+    // Shortest time between frames, 0 follows the display refresh (33333333 caps at 30 fps on 60 Hz)
+    uint64_t targetFrameIntervalNs{0};
+    // Lengthens the interval by whole refresh cycles while frames keep missing it, so they come
+    // out evenly at a lower rate instead of alternating between one and two refresh cycles
+    bool adaptiveInterval{true};
+};
+
+// One VkPastPresentationTimingGOOGLE, times in the clock's time base
+struct PresentTiming {
+    uint32_t presentId{0};
+    uint64_t desiredPresentTimeNs{0};
+    uint64_t actualPresentTimeNs{0};
+    uint64_t earliestPresentTimeNs{0};
+    uint64_t presentMarginNs{0};
+};
+
+// Passed to VkPresentTimeGOOGLE, desiredPresentTimeNs 0 presents as soon as possible
+struct PresentTarget {
+    uint32_t presentId{0};
+    uint64_t desiredPresentTimeNs{0};
+};
+
+struct FramePacerStats {
+    uint64_t frames{0};
+    uint64_t missedFrames{0};       // presented later than planned
+    uint32_t swapInterval{1};       // refresh cycles per frame
+    uint64_t frameIntervalNs{0};
+    uint64_t sleptNs{0};            // total CPU throttle
+    double averageFrameMs{0.0};     // between frame starts
+    double averageLatencyMs{0.0};   // frame start to on screen, display timing only
+};
+
+// Decides when the CPU starts a frame and when it should be presented.
+//  - Without display timing it throttles frame starts to the target interval (whole refresh
+//    cycles), FIFO at one refresh per frame is left to the swap chain's back pressure.
+//  - With VK_GOOGLE_display_timing every frame is scheduled for a vsync, and frame starts are
+//    delayed to the latest point the slowest recent frame would still make it, which removes
+//    the frames queued ahead in the swap chain (latency).
+//  - Misses double the safety margin right away, a window without misses lets it shrink again.
+// All time comes from the Clock, a SimulatedClock drives it without a device.
+class FramePacer {
+public:
+    NONCOPYABLE(FramePacer);
+    FramePacer(const FramePacerConfig& config, Clock& clock);
+
+    static VkPresentModeKHR choosePresentMode(VkPresentModeKHR preferred, const std::vector<VkPresentModeKHR>& available);
+    static uint32_t chooseImageCount(uint32_t desired, const VkSurfaceCapabilitiesKHR& capabilities);
+    static std::string toString(VkPresentModeKHR presentMode);
+
+    const FramePacerConfig& getConfig() const { return m_Config; }
+    // vkGetRefreshCycleDurationGOOGLE, 60 Hz is assumed until then
+    void setRefreshDuration(uint64_t refreshNs);
+    void setPresentMode(VkPresentModeKHR presentMode);
+
+    // Call once per frame before acquiring the swap chain image, may sleep
+    void waitForNextFrame();
+    // The frame started by the last waitForNextFrame()
+    PresentTarget getPresentTarget() const { return { m_PresentId, m_DesiredPresentNs }; }
+    // Feedback from vkGetPastPresentationTimingGOOGLE, in any order
+    void onPresentTiming(const PresentTiming& timing);
+
+    const FramePacerStats& getStats() const { return m_Stats; }
+
+private:
+    static constexpr uint32_t kHistory = 16;        // frames in flight whose start time is kept
+    static constexpr uint32_t kWindowFrames = 30;   // frames between adaptations
+    static constexpr uint32_t kMaxSwapInterval = 4;
+
+    struct FrameStart {
+        uint32_t presentId{0};
+        uint64_t startNs{0};
+    };
+
+    void updateInterval();
+    void recordFrame(bool missed, uint64_t workNs);
+    void adapt();
+    uint64_t desiredPresentTime(uint32_t presentId) const;
+
+    FramePacerConfig m_Config;
+    Clock& m_Clock;
+    FramePacerStats m_Stats{};
+    VkPresentModeKHR m_PresentMode{VK_PRESENT_MODE_FIFO_KHR};
+    uint64_t m_RefreshNs{16666667};
+    uint32_t m_MinSwapInterval{1};
+    uint32_t m_SwapInterval{1};
+    uint64_t m_IntervalNs{16666667};
+
+    uint32_t m_PresentId{0};
+    uint64_t m_DesiredPresentNs{0};
+    uint64_t m_NextFrameStartNs{0};
+    uint64_t m_LastFrameStartNs{0};
+    std::array<FrameStart, kHistory> m_FrameStarts{};
+
+    // display timing, anchors the vsync grid
+    bool m_HasTiming{false};
+    uint32_t m_AnchorPresentId{0};
+    uint64_t m_AnchorPresentNs{0};
+    uint32_t m_MissScheduledId{0};  // last frame scheduled when the latest miss was reported
+    // frame start to image ready, slowest of the last window
+    uint64_t m_WorkNs{0};
+    uint64_t m_SafetyNs{0};
+
+    uint32_t m_WindowFrames{0};
+    uint32_t m_WindowMisses{0};
+    uint64_t m_WindowMaxWorkNs{0};
+    static constexpr LogTag m_TAG{"FramePacer"};
+};
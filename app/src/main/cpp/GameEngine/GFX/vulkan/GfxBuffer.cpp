@@ -0,0 +1,22 @@
+#include "GfxBuffer.h"
+#include "GfxUtils.h"
+#include "GfxDevice.h"
+#include "DeletionQueue.h"
+
+GfxBuffer::GfxBuffer(GfxDevice& device, const GfxBufferDesc& desc)
+    : m_desc(desc)
+    , m_device(device.getDevice())
+    , m_deletionQueue(device.getDeletionQueue())
+{
+    GfxDevice::createBuffer(device.getVkPhysicalDevice(), m_device, desc.size, desc.usage, desc.memoryProperties,
+                            &m_buffer, &m_memory);
+    if (desc.memoryProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        CHECK_VK(vkMapMemory(m_device, m_memory, 0, desc.size, 0, &m_mapped));
+    }
+}
+
+GfxBuffer::~GfxBuffer()
+{
+    // Freeing the memory unmaps it
+    m_deletionQueue->destroyBuffer(m_buffer, m_memory);
+}
@@ -1,15 +1,46 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <cstdio>
+#include <memory>
 
 #include <vulkan/vulkan.h>
 
+#include "../../Utils/Definitions.h"
+
+class GfxDevice;
+class DeletionQueue;
+
+struct GfxBufferDesc{
+    std::string name{};
+    VkDeviceSize size{0};
+    VkBufferUsageFlags usage{0};
+    // Host visible buffers stay mapped for their whole lifetime
+    VkMemoryPropertyFlags memoryProperties{VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT};
+};
+
+// A buffer with its own memory, created from a GfxBufferDesc (GfxDevice::createBuffer). Like
+// GfxTexture, the last reference may go on any thread while frames using it are in flight.
 class GfxBuffer{
 public:
     GfxBuffer() = delete;
-    GfxBuffer(std::string name, uint32_t size);
+    GfxBuffer(GfxDevice& device, const GfxBufferDesc& desc);
+    NONCOPYABLE(GfxBuffer);
     virtual ~GfxBuffer();
 
+    const std::string& getName() const { return m_desc.name; }
+    const GfxBufferDesc& getDesc() const { return m_desc; }
+    VkBuffer getBuffer() const { return m_buffer; }
+    VkDeviceSize getSize() const { return m_desc.size; }
+    // Null unless host visible. Writes need no flush when the memory is host coherent too.
+    void* getMapped() const { return m_mapped; }
+
 private:
-    std::string m_name;
-};
\ No newline at end of file
+    GfxBufferDesc m_desc{};
+    VkDevice m_device{VK_NULL_HANDLE};
+    std::shared_ptr<DeletionQueue> m_deletionQueue;
+
+    VkBuffer m_buffer{VK_NULL_HANDLE};
+    VkDeviceMemory m_memory{VK_NULL_HANDLE};
+    void* m_mapped{nullptr};
+};
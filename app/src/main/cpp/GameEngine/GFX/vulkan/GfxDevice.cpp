@@ -1,14 +1,61 @@
+#include <algorithm>
+#include <cstring>
 #include <vector>
 #include <array>
 #include <fstream>
 
+#include "glm/gtc/matrix_transform.hpp"
+
 #include "GfxUtils.h"
 #include "GfxDevice.h"
 #include "TextureSampler.h"
+#include "ClusterCullPass.h"
+#include "ShaderModuleCache.h"
+#include "PipelineCache.h"
+#include "DescriptorAllocator.h"
+#include "BindlessTextureTable.h"
+#include "SamplerCache.h"
+#include "RenderGraph.h"
+#include "FramePacer.h"
+#include "GpuProfiler.h"
+#include "TextureStreamer.h"
+#include "DeletionQueue.h"
+#include "ParallelRecorder.h"
+#include "../../EntityComponent/FrameState.h"
+#include "../../EntityComponent/Meshlet.h"
+#include "../../EntityComponent/MeshSimplifier.h"
+#include "../../Utils/JobSystem.h"
+#include "../../Utils/Ktx2.h"
+#include "../../Utils/Profiler.h"
 #define MAX_OBJECTS 2
-std::string  GfxDevice::m_TAG = "GfxDevice";
+#define MAX_BINDLESS_TEXTURES 4096
+#define MAX_FRAME_DRAWS 2
+
+// Instance extension of the window system picked at build time (GFX/NativeWindow.h), none when
+// the build only renders headless
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+#define SURFACE_EXTENSION_NAME VK_KHR_ANDROID_SURFACE_EXTENSION_NAME
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+#define SURFACE_EXTENSION_NAME VK_KHR_XCB_SURFACE_EXTENSION_NAME
+#endif
+
 GfxDevice::GfxDevice(const DeviceConfig &config) {
 
+    m_thisPtr = ThreadSafeGfxDevice::makeNonOwningSharedPtr(this);
+    m_FramePacer = std::make_unique<FramePacer>(config.framePacing, m_Clock);
+    m_GpuProfiling = config.gpuProfiling;
+    m_TextureStreamingConfig = config.textureStreaming;
+    m_Headless = config.headless;
+    m_HeadlessExtent = config.headlessExtent;
+    m_HeadlessFormat = config.headlessFormat;
+    m_PhysicalDeviceName = config.physicalDeviceName;
+    m_RecordThreads = config.recordThreads;
+#ifndef SURFACE_EXTENSION_NAME
+    if (!m_Headless)
+    {
+        throw std::runtime_error("built without a window system, only headless devices are supported");
+    }
+#endif
     uint32_t queueIndex{};
     if(config.device != VK_NULL_HANDLE )
     {
@@ -46,10 +93,14 @@ GfxDevice::GfxDevice(const DeviceConfig &config) {
             //TODO need VKResult check?
             vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, availableInstanceExtensions.data());
 
-            std::vector<const char*> desiredExtensions = {
-                    VK_KHR_SURFACE_EXTENSION_NAME,
-                    "VK_KHR_android_surface"
-            };
+            std::vector<const char*> desiredExtensions;
+#ifdef SURFACE_EXTENSION_NAME
+            if (!m_Headless)
+            {
+                desiredExtensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+                desiredExtensions.push_back(SURFACE_EXTENSION_NAME);
+            }
+#endif
             if(config.debugLayer)
             {
                 desiredExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -136,8 +187,59 @@ GfxDevice::GfxDevice(const DeviceConfig &config) {
             }
              */
 
+            uint32_t extensionCount = 0;
+            CHECK_VK(vkEnumerateDeviceExtensionProperties(m_DeviceStruct.physicalDevice, nullptr, &extensionCount, nullptr));
+
+            std::vector<VkExtensionProperties> availableDeviceExtensions;
+            availableDeviceExtensions.resize(extensionCount);
+            CHECK_VK(vkEnumerateDeviceExtensionProperties(m_DeviceStruct.physicalDevice, nullptr, &extensionCount, availableDeviceExtensions.data()));
+            auto isExtensionAvailable = [&availableDeviceExtensions](const char* extName) -> bool {
+                return std::find_if(availableDeviceExtensions.begin(), availableDeviceExtensions.end(),
+                                    [extName](const VkExtensionProperties& extProps) -> bool { return std::strcmp(extProps.extensionName, extName) == 0; })
+                       != availableDeviceExtensions.end();
+            };
+
+            VkPhysicalDeviceFeatures supportedFeatures{};
+            vkGetPhysicalDeviceFeatures(m_DeviceStruct.physicalDevice, &supportedFeatures);
+
+            // Min / max reduction samplers (GfxSamplerType::MIN_SAMPLER)
+            m_SamplerMinMaxSupported = isExtensionAvailable(VK_EXT_SAMPLER_FILTER_MINMAX_EXTENSION_NAME);
+
+            // Bindless textures need runtime sized, partially bound, update after bind sampler arrays
+            VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures{};
+            indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+            if (isExtensionAvailable(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))
+            {
+                VkPhysicalDeviceFeatures2 supportedFeatures2{};
+                supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+                supportedFeatures2.pNext = &indexingFeatures;
+                vkGetPhysicalDeviceFeatures2(m_DeviceStruct.physicalDevice, &supportedFeatures2);
+                m_DescriptorIndexingSupported = indexingFeatures.runtimeDescriptorArray &&
+                                                indexingFeatures.descriptorBindingPartiallyBound &&
+                                                indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+                                                indexingFeatures.shaderSampledImageArrayNonUniformIndexing;
+            }
+            VkPhysicalDeviceDescriptorIndexingFeaturesEXT enabledIndexingFeatures{};
+            enabledIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+            enabledIndexingFeatures.runtimeDescriptorArray = m_DescriptorIndexingSupported;
+            enabledIndexingFeatures.descriptorBindingPartiallyBound = m_DescriptorIndexingSupported;
+            enabledIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = m_DescriptorIndexingSupported;
+            enabledIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = m_DescriptorIndexingSupported;
+            LOGD(m_TAG,"descriptor indexing %s", m_DescriptorIndexingSupported ? "supported" : "not supported");
+
             VkPhysicalDeviceFeatures features{};
-            features.samplerAnisotropy = VK_TRUE;
+            // Optional, the sampler cache turns anisotropy off without it
+            m_SamplerAnisotropySupported = supportedFeatures.samplerAnisotropy == VK_TRUE;
+            features.samplerAnisotropy = supportedFeatures.samplerAnisotropy;
+            // Lets cluster culling issue all indirect draws of a mesh in one call
+            features.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+            m_MultiDrawIndirectSupported = supportedFeatures.multiDrawIndirect == VK_TRUE;
+            // Only asked for when wanted, the counters cost a little on some GPUs
+            m_PipelineStatisticsSupported = config.pipelineStatistics && supportedFeatures.pipelineStatisticsQuery == VK_TRUE;
+            features.pipelineStatisticsQuery = m_PipelineStatisticsSupported;
+            // Secondary command buffers executed while the statistics query is active
+            m_InheritedQueriesSupported = m_PipelineStatisticsSupported && supportedFeatures.inheritedQueries == VK_TRUE;
+            features.inheritedQueries = m_InheritedQueriesSupported;
             // Needed for shaders, which use plain Texture2D in hlsl without explicit image format.
             features.shaderStorageImageReadWithoutFormat = true;
 
@@ -145,29 +247,36 @@ GfxDevice::GfxDevice(const DeviceConfig &config) {
             deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
             deviceInfo.queueCreateInfoCount = static_cast<uint32_t>(deviceQueueCreateInfos.size());
             deviceInfo.pQueueCreateInfos = deviceQueueCreateInfos.data();
-            deviceInfo.pNext = nullptr;
+            deviceInfo.pNext = m_DescriptorIndexingSupported ? &enabledIndexingFeatures : nullptr;
             deviceInfo.pEnabledFeatures = &features;
             deviceInfo.enabledExtensionCount = 0;
 
             {
-                uint32_t extensionCount = 0;
-                CHECK_VK(vkEnumerateDeviceExtensionProperties(m_DeviceStruct.physicalDevice, nullptr, &extensionCount, nullptr));
-
-                std::vector<VkExtensionProperties> availableDeviceExtensions;
-                availableDeviceExtensions.resize(extensionCount);
-                CHECK_VK(vkEnumerateDeviceExtensionProperties(m_DeviceStruct.physicalDevice, nullptr, &extensionCount, availableDeviceExtensions.data()));
-
                 // List of extensions that we would like to enable if they are available.
-                std::vector<const char*> desiredExtensions = {
-                        VK_KHR_SWAPCHAIN_EXTENSION_NAME
-                };
+                std::vector<const char*> desiredExtensions;
+                if (!m_Headless)
+                {
+                    desiredExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+                }
+                if (m_DescriptorIndexingSupported)
+                {
+                    desiredExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+                }
+                if (m_SamplerMinMaxSupported)
+                {
+                    desiredExtensions.push_back(VK_EXT_SAMPLER_FILTER_MINMAX_EXTENSION_NAME);
+                }
+                // Present timestamps for the frame pacer
+                m_DisplayTimingSupported = !m_Headless && isExtensionAvailable(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+                if (m_DisplayTimingSupported)
+                {
+                    desiredExtensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+                }
 
                 std::vector<const char*> enabledExtensions;
 
                 for (const auto& extName : desiredExtensions) {
-                    auto it = std::find_if(availableDeviceExtensions.begin(), availableDeviceExtensions.end(),
-                                           [&extName](const VkExtensionProperties& extProps) -> bool { return std::strcmp(extProps.extensionName, extName) == 0; });
-                    if (it != availableDeviceExtensions.end()) {
+                    if (isExtensionAvailable(extName)) {
                         enabledExtensions.push_back(extName);
                     }
                 }
@@ -182,9 +291,34 @@ GfxDevice::GfxDevice(const DeviceConfig &config) {
     vkGetDeviceQueue(m_DeviceStruct.device, m_BufferQueueStruct.computeQueueFamilyIndex, queueIndex, &m_BufferQueueStruct.computeQueue);
     vkGetDeviceQueue(m_DeviceStruct.device, m_BufferQueueStruct.graphicsQueueFamilyIndex, queueIndex, &m_BufferQueueStruct.graphicsQueue);
 
+    if (m_DisplayTimingSupported)
+    {
+        // Extension entry points aren't exported by the Android loader
+        m_vkGetRefreshCycleDuration = reinterpret_cast<PFN_vkGetRefreshCycleDurationGOOGLE>(
+                vkGetDeviceProcAddr(m_DeviceStruct.device, "vkGetRefreshCycleDurationGOOGLE"));
+        m_vkGetPastPresentationTiming = reinterpret_cast<PFN_vkGetPastPresentationTimingGOOGLE>(
+                vkGetDeviceProcAddr(m_DeviceStruct.device, "vkGetPastPresentationTimingGOOGLE"));
+        m_DisplayTimingSupported = m_vkGetRefreshCycleDuration && m_vkGetPastPresentationTiming;
+    }
+    LOGD(m_TAG,"display timing %s", m_DisplayTimingSupported ? "supported" : "not supported");
+
     // Read memory info to be able to alloc the resources later.
     vkGetPhysicalDeviceMemoryProperties(m_DeviceStruct.physicalDevice, &m_MemoryProps);
 
+    // Color and depth both have to support the MSAA sample count
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(m_DeviceStruct.physicalDevice, &deviceProperties);
+    VkSampleCountFlags sampleCounts = deviceProperties.limits.framebufferColorSampleCounts &
+                                      deviceProperties.limits.framebufferDepthSampleCounts;
+    if (sampleCounts & config.msaaSamples)
+    {
+        m_MsaaSamples = config.msaaSamples;
+    }
+    else
+    {
+        LOGW(m_TAG,"%dx MSAA not supported, rendering without", static_cast<int>(config.msaaSamples));
+    }
+
 /*    if (config.device == VK_NULL_HANDLE) {
         setDebugLabel("physical_device", VK_OBJECT_TYPE_PHYSICAL_DEVICE, reinterpret_cast<uint64_t>(getVkPhysicalDevice()));
         setDebugLabel("device", VK_OBJECT_TYPE_DEVICE, reinterpret_cast<uint64_t>(getVkDevice()));
@@ -208,22 +342,87 @@ GfxDevice::GfxDevice(const DeviceConfig &config) {
 void GfxDevice::init()
 {
     LOGD(m_TAG,__FUNCTION__);
-    createSwapChain();
+    PROFILE_FUNCTION();
+    m_JobSystem = std::make_unique<JobSystem>();
+    m_DeletionQueue = std::make_shared<DeletionQueue>(m_DeviceStruct.device, MAX_FRAME_DRAWS,
+                                                      [this](uint32_t textureId) { removeTexture(textureId); });
+    m_ParallelRecorder = std::make_unique<ParallelRecorder>(m_DeviceStruct.device,
+                                                            m_BufferQueueStruct.graphicsQueueFamilyIndex, *m_JobSystem,
+                                                            MAX_FRAME_DRAWS, m_RecordThreads);
+    m_RecordThreads = m_ParallelRecorder->getThreadCount();
+    m_SamplerCache = std::make_unique<SamplerCache>(m_thisPtr);
+    if (m_Headless)
+    {
+        createOffscreenImages();
+    }
+    else
+    {
+        createSwapChain();
+    }
     createRenderPass();
     createFrameBuffers();
+    createSamplers();
+    createTextureSampler();
     createDescriptorSetLayout();
     createPushConstantRange();
     createGraphicsPipeline();
     createCommandPool();
     createCommandBuffers();
-    createTextureSampler();
+    createProfiler();
     createUniformBuffers();
     createDescriptorPool();
     createDescriptorSets();
-    //createSynchronisation();
+    createClusterCulling();
+    createSynchronisation();
+    createTextureStreamer();
+}
+
+GfxDevice::~GfxDevice()
+{
 }
 void GfxDevice::deInit()
 {
+    vkDeviceWaitIdle(m_DeviceStruct.device);
+    for (size_t i = 0; i < m_DrawFences.size(); i++)
+    {
+        vkDestroySemaphore(m_DeviceStruct.device, m_ImageAvailable[i], nullptr);
+        vkDestroySemaphore(m_DeviceStruct.device, m_RenderFinished[i], nullptr);
+        vkDestroyFence(m_DeviceStruct.device, m_DrawFences[i], nullptr);
+    }
+    m_ImageAvailable.clear();
+    m_RenderFinished.clear();
+    m_DrawFences.clear();
+    m_ImageFences.clear();
+    m_ClusterCullPass.reset();
+    m_ParallelRecorder.reset();
+    m_RenderGraph.reset();
+    m_GpuProfiler.reset();
+    destroySwapchainImageViews();
+    if (m_SwapChain != VK_NULL_HANDLE)
+    {
+        vkDestroySwapchainKHR(m_DeviceStruct.device, m_SwapChain, nullptr);
+        m_SwapChain = VK_NULL_HANDLE;
+    }
+    if (m_Surface != VK_NULL_HANDLE)
+    {
+        vkDestroySurfaceKHR(m_DeviceStruct.instance, m_Surface, nullptr);
+        m_Surface = VK_NULL_HANDLE;
+    }
+    // Textures queue their ids and images, given back before the table and the descriptor cache go
+    m_TextureStreamer.reset();
+    m_textureMap.clear();
+    m_ClusterMeshes.clear();
+    m_DefaultTexture.reset();
+    m_DeletionQueue->releaseAll();
+    m_FrameDescriptors.clear();
+    m_DescriptorCache.reset();
+    m_BindlessTextures.reset();
+    m_PipelineCache.reset();
+    m_JobSystem.reset();
+    m_ShaderCache.reset();
+    // Set layouts may reference immutable samplers, so samplers go last
+    m_samplers.clear();
+    m_SamplerCache.reset();
     vkDestroyDevice(m_DeviceStruct.device, nullptr);
     vkDestroyInstance(m_DeviceStruct.instance, nullptr);
 }
@@ -231,48 +430,359 @@ void GfxDevice::deInit()
 void GfxDevice::createDescriptorPool()
 {
     LOGD(m_TAG,__FUNCTION__);
-    // CREATE UNIFORM DESCRIPTOR POOL
-    // Type of descriptors + how many DESCRIPTORS, not Descriptor Sets (combined makes the pool size)
-    // ViewProjection Pool
-    VkDescriptorPoolSize vpPoolSize = {};
-    vpPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    vpPoolSize.descriptorCount = static_cast<uint32_t>(vpUniformBuffer.size());
-
-    // Model Pool (DYNAMIC)
-    /*VkDescriptorPoolSize modelPoolSize = {};
-    modelPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-    modelPoolSize.descriptorCount = static_cast<uint32_t>(modelDUniformBuffer.size());*/
-
-    // List of pool sizes
-    std::vector<VkDescriptorPoolSize> descriptorPoolSizes = { vpPoolSize };
-
-    // Data to create Descriptor Pool
-    VkDescriptorPoolCreateInfo poolCreateInfo = {};
-    poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolCreateInfo.maxSets = static_cast<uint32_t>(m_SwapchainImages.size());					// Maximum number of Descriptor Sets that can be created from pool
-    poolCreateInfo.poolSizeCount = static_cast<uint32_t>(descriptorPoolSizes.size());		// Amount of Pool Sizes being passed
-    poolCreateInfo.pPoolSizes = descriptorPoolSizes.data();									// Pool Sizes to create pool with
-
-    // Create Descriptor Pool
-    VkResult result = vkCreateDescriptorPool(m_DeviceStruct.device, &poolCreateInfo, nullptr, &m_DescriptorPool);
-    if (result != VK_SUCCESS)
+    // Pools are no longer sized up front, both allocators chain a new pool when one runs out
+    // Long lived sets (per image UBOs, textures) : allocated once, looked up by binding hash
+    m_DescriptorCache = std::make_unique<DescriptorSetCache>(m_thisPtr);
+
+    // Short lived sets : one allocator per swapchain image, reset in bulk when that image is recorded again
+    m_FrameDescriptors.clear();
+    for (size_t i = 0; i < m_SwapchainImages.size(); i++)
+    {
+        m_FrameDescriptors.push_back(std::make_unique<DescriptorAllocator>(m_thisPtr, 256));
+    }
+}
+
+uint32_t GfxDevice::addTexture(VkImageView imageView)
+{
+    if (m_BindlessTextures)
+    {
+        return m_BindlessTextures->addTexture(imageView, m_TextureSampler);
+    }
+    // Fallback : one descriptor set per texture, bound before every draw using it
+    DescriptorSetBuilder builder;
+    builder.bindImage(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageView, m_TextureSampler,
+                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    VkDescriptorSet set = getDescriptorSet(m_SamplerSetLayout, builder);
+    auto freeSlot = std::find(m_SamplerDescriptorSets.begin(), m_SamplerDescriptorSets.end(), VK_NULL_HANDLE);
+    if (freeSlot != m_SamplerDescriptorSets.end())
+    {
+        *freeSlot = set;
+        return static_cast<uint32_t>(freeSlot - m_SamplerDescriptorSets.begin());
+    }
+    m_SamplerDescriptorSets.push_back(set);
+    return static_cast<uint32_t>(m_SamplerDescriptorSets.size() - 1);
+}
+
+void GfxDevice::removeTexture(uint32_t textureId)
+{
+    if (m_BindlessTextures)
+    {
+        m_BindlessTextures->removeTexture(textureId);
+        return;
+    }
+    // Called through the DeletionQueue, no frame in flight binds the set any more
+    m_DescriptorCache->release(m_SamplerDescriptorSets[textureId]);
+    m_SamplerDescriptorSets[textureId] = VK_NULL_HANDLE;
+}
+
+// KTX2 stores VkFormats, the engine's names for them must agree
+static_assert(kVkFormatR8G8B8A8Srgb == VK_FORMAT_R8G8B8A8_SRGB, "KTX2 format mismatch");
+static_assert(kVkFormatEtc2R8G8B8A8SrgbBlock == VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK, "KTX2 format mismatch");
+static_assert(kVkFormatAstc12x12SrgbBlock == VK_FORMAT_ASTC_12x12_SRGB_BLOCK, "KTX2 format mismatch");
+
+bool GfxDevice::isTextureFormatSupported(VkFormat format) const
+{
+    VkFormatProperties properties{};
+    vkGetPhysicalDeviceFormatProperties(m_DeviceStruct.physicalDevice, format, &properties);
+    const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+                                          VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT |
+                                          VK_FORMAT_FEATURE_TRANSFER_SRC_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    return (properties.optimalTilingFeatures & required) == required;
+}
+
+std::shared_ptr<GfxTexture> GfxDevice::loadTexture(const std::string& filename)
+{
+    auto it = m_textureMap.find(filename);
+    if (it != m_textureMap.end())
+    {
+        return it->second;
+    }
+    std::vector<char> data = readFile(filename);
+    Ktx2Image image;
+    std::string error;
+    if (!readKtx2(std::vector<uint8_t>(data.begin(), data.end()), image, error))
+    {
+        LOGE(m_TAG,"%s: %s", filename.c_str(), error.c_str());
+        return nullptr;
+    }
+    return createTexture(filename, image);
+}
+
+std::shared_ptr<GfxTexture> GfxDevice::createTexture(const std::string& name, const Ktx2Image& image)
+{
+    auto texture = uploadTexture(name, image);
+    if (texture)
+    {
+        m_textureMap[name] = texture;
+    }
+    return texture;
+}
+
+std::shared_ptr<GfxTexture> GfxDevice::uploadTexture(const std::string& name, const Ktx2Image& image)
+{
+    PROFILE_FUNCTION();
+    const auto format = static_cast<VkFormat>(image.vkFormat);
+    if (!isTextureFormatSupported(format))
+    {
+        LOGW(m_TAG,"%s: format %u can't be sampled on this device", name.c_str(), image.vkFormat);
+        return nullptr;
+    }
+    const auto mipLevels = static_cast<uint32_t>(image.levels.size());
+
+    // Stage all levels in one buffer. Offsets stay multiples of the block size, as copies require.
+    std::vector<VkBufferImageCopy> regions(mipLevels);
+    VkDeviceSize stagingSize = 0;
+    for (uint32_t level = 0; level < mipLevels; level++)
+    {
+        stagingSize = (stagingSize + image.formatInfo.bytesPerBlock - 1) / image.formatInfo.bytesPerBlock *
+                      image.formatInfo.bytesPerBlock;
+        VkBufferImageCopy& region = regions[level];
+        region.bufferOffset = stagingSize;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = level;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { image.levels[level].width, image.levels[level].height, 1 };
+        stagingSize += image.levels[level].size;
+    }
+
+    GfxBufferDesc stagingDesc;
+    stagingDesc.name = name + " staging";
+    stagingDesc.size = stagingSize;
+    stagingDesc.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    stagingDesc.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    auto staging = createBuffer(stagingDesc);
+    for (uint32_t level = 0; level < mipLevels; level++)
+    {
+        memcpy(static_cast<uint8_t*>(staging->getMapped()) + regions[level].bufferOffset, image.getLevelData(level),
+               image.levels[level].size);
+    }
+
+    GfxTextureDesc desc;
+    desc.name = name;
+    desc.width = image.width;
+    desc.height = image.height;
+    desc.mipLevels = mipLevels;
+    desc.format = format;
+    // Transfer source as well, a streamed texture's levels are copied into the image replacing it
+    desc.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    auto texture = createTexture(desc);
+    const VkImage vkImage = texture->getImage();
+
+    // Load time only
+    submitAndWait([&](VkCommandBuffer commandBuffer) {
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = vkImage;
+        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &barrier);
+
+        vkCmdCopyBufferToImage(commandBuffer, staging->getBuffer(), vkImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               mipLevels, regions.data());
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &barrier);
+    });
+
+    texture->setTextureId(addTexture(texture->getSRV()));
+    LOGD(m_TAG,"texture %s %ux%u, %u levels, format %u, %llu bytes", name.c_str(), image.width, image.height,
+         mipLevels, image.vkFormat, static_cast<unsigned long long>(stagingSize));
+    return texture;
+}
+
+const std::shared_ptr<GfxTexture>& GfxDevice::getDefaultTexture()
+{
+    if (!m_DefaultTexture)
+    {
+        // One opaque white texel, for draws that have to bind set 1 without a texture of their own
+        Ktx2Image image;
+        image.vkFormat = kVkFormatR8G8B8A8Srgb;
+        image.width = image.height = 1;
+        getTextureFormatInfo(image.vkFormat, image.formatInfo);
+        image.levels.push_back({ 0, 4, 1, 1 });
+        image.file.assign(4, 0xff);
+        m_DefaultTexture = uploadTexture("default", image);
+    }
+    return m_DefaultTexture;
+}
+
+std::shared_ptr<GfxTexture> GfxDevice::createTexture(const GfxTextureDesc& desc)
+{
+    return std::make_shared<GfxTexture>(*this, desc);
+}
+
+std::shared_ptr<GfxBuffer> GfxDevice::createBuffer(const GfxBufferDesc& desc)
+{
+    return std::make_shared<GfxBuffer>(*this, desc);
+}
+
+VkDescriptorSet GfxDevice::getDescriptorSet(VkDescriptorSetLayout layout, const DescriptorSetBuilder& builder)
+{
+    return m_DescriptorCache->getSet(layout, builder);
+}
+
+VkDescriptorSet GfxDevice::allocateFrameDescriptorSet(VkDescriptorSetLayout layout, const DescriptorSetBuilder& builder)
+{
+    VkDescriptorSet set = m_FrameDescriptors[m_RecordingImage]->allocate(layout);
+    builder.write(m_DeviceStruct.device, set);
+    return set;
+}
+
+void GfxDevice::createClusterCulling()
+{
+    LOGD(m_TAG,__FUNCTION__);
+    // Compute path of cluster culling, ClusterCuller::cull is the CPU reference
+    m_ClusterCullPass = std::make_unique<ClusterCullPass>(ThreadSafeGfxDevice(m_thisPtr), *m_ShaderCache,
+                                                          "Shaders/cluster_cull.comp.spv");
+}
+
+uint32_t GfxDevice::addClusterMesh(const std::vector<Vertex>& vertices, std::vector<uint32_t> indices, const glm::mat4& model,
+                                   uint32_t maxLodCount)
+{
+    PROFILE_FUNCTION();
+    ClusterMesh mesh;
+    // Levels are appended to indices, each level's range is then reordered into its own meshlets
+    if (maxLodCount > 1)
+    {
+        mesh.lods = MeshSimplifier::buildLodChain(vertices, indices, maxLodCount);
+    }
+    else
+    {
+        mesh.lods.push_back({ 0, static_cast<uint32_t>(indices.size()), 0.0f });
+    }
+    uint32_t maxLodMeshlets = 0;
+    for (const MeshLod& lod : mesh.lods)
+    {
+        const std::vector<Meshlet> meshlets = MeshletBuilder::build(vertices, indices, lod.firstIndex, lod.indexCount);
+        mesh.lodMeshlets.push_back(static_cast<uint32_t>(mesh.meshlets.size()));
+        mesh.meshlets.insert(mesh.meshlets.end(), meshlets.begin(), meshlets.end());
+        maxLodMeshlets = std::max(maxLodMeshlets, static_cast<uint32_t>(meshlets.size()));
+    }
+    mesh.lodMeshlets.push_back(static_cast<uint32_t>(mesh.meshlets.size()));
+    if (mesh.meshlets.empty())
     {
-        throw std::runtime_error("Failed to create a Descriptor Pool!");
+        throw std::runtime_error("cluster mesh without triangles");
     }
+    mesh.culledLods.assign(MAX_FRAME_DRAWS, 0);
+    mesh.model = model;
+    LodSelector::boundingSphere(vertices, mesh.boundingCenter, mesh.boundingRadius);
+
+    // Host visible, written once here. The draws are too so readClusterDraws can map them.
+    auto createHostBuffer = [this](const std::string& name, VkDeviceSize size, VkBufferUsageFlags usage,
+                                   const void* data)
+    {
+        GfxBufferDesc desc;
+        desc.name = name;
+        desc.size = size;
+        desc.usage = usage;
+        desc.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        auto buffer = createBuffer(desc);
+        if (data != nullptr)
+        {
+            memcpy(buffer->getMapped(), data, size);
+        }
+        return buffer;
+    };
+    const std::string name = "cluster mesh " + std::to_string(m_ClusterMeshes.size());
+    const std::vector<GpuMeshlet> packed = ClusterCullPass::packMeshlets(mesh.meshlets);
+    mesh.vertices = createHostBuffer(name + " vertices", sizeof(Vertex) * vertices.size(),
+                                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertices.data());
+    mesh.indices = createHostBuffer(name + " indices", sizeof(uint32_t) * indices.size(),
+                                    VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indices.data());
+    mesh.gpuMeshlets = createHostBuffer(name + " meshlets", sizeof(GpuMeshlet) * packed.size(),
+                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, packed.data());
+    // Per frame slot, the next frame's cull may run while the GPU still draws this one's
+    for (uint32_t frame = 0; frame < MAX_FRAME_DRAWS; frame++)
+    {
+        mesh.draws.push_back(createHostBuffer(name + " draws", sizeof(VkDrawIndexedIndirectCommand) * maxLodMeshlets,
+                                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                              nullptr));
+    }
+    // Untextured until setClusterStreamedTexture, set 1 still has to be bound
+    mesh.textureId = getDefaultTexture()->getTextureId();
+    m_ClusterMeshes.push_back(std::move(mesh));
+    return static_cast<uint32_t>(m_ClusterMeshes.size() - 1);
+}
+
+std::vector<Meshlet> GfxDevice::getClusterMeshlets(uint32_t mesh) const
+{
+    const ClusterMesh& clusterMesh = m_ClusterMeshes.at(mesh);
+    // draw() already moved on to the next frame slot
+    const uint32_t lod = clusterMesh.culledLods[(currentFrame + MAX_FRAME_DRAWS - 1) % MAX_FRAME_DRAWS];
+    return std::vector<Meshlet>(clusterMesh.meshlets.begin() + clusterMesh.lodMeshlets[lod],
+                                clusterMesh.meshlets.begin() + clusterMesh.lodMeshlets[lod + 1]);
+}
+
+std::vector<uint32_t> GfxDevice::getClusterIndices(uint32_t mesh) const
+{
+    const GfxBuffer& indices = *m_ClusterMeshes.at(mesh).indices;
+    const auto* data = static_cast<const uint32_t*>(indices.getMapped());
+    return std::vector<uint32_t>(data, data + indices.getSize() / sizeof(uint32_t));
+}
 
-    // CREATE SAMPLER DESCRIPTOR POOL
-    // Texture sampler pool
-    VkDescriptorPoolSize samplerPoolSize = {};
-    samplerPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    samplerPoolSize.descriptorCount = MAX_OBJECTS;
+void GfxDevice::setClusterStreamedTexture(uint32_t mesh, uint32_t handle)
+{
+    ClusterMesh& clusterMesh = m_ClusterMeshes.at(mesh);
+    clusterMesh.streamedTexture = static_cast<int>(handle);
+    clusterMesh.textureId = m_TextureStreamer->getTextureId(handle);
+}
 
-    VkDescriptorPoolCreateInfo samplerPoolCreateInfo = {};
-    samplerPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    samplerPoolCreateInfo.maxSets = MAX_OBJECTS;
-    samplerPoolCreateInfo.poolSizeCount = 1;
-    samplerPoolCreateInfo.pPoolSizes = &samplerPoolSize;
+std::vector<DrawIndexedCommand> GfxDevice::readClusterDraws(uint32_t mesh)
+{
+    PROFILE_FUNCTION();
+    const ClusterMesh& clusterMesh = m_ClusterMeshes.at(mesh);
+    // draw() already moved on to the next frame slot
+    const size_t frame = (currentFrame + MAX_FRAME_DRAWS - 1) % MAX_FRAME_DRAWS;
+    const GfxBuffer& draws = *clusterMesh.draws[frame];
+    const uint32_t lod = clusterMesh.culledLods[frame];
+    submitAndWait([&](VkCommandBuffer commandBuffer) {
+        // The frame was submitted earlier on the same queue, make the cull's writes visible to the host
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                             1, &barrier, 0, nullptr, 0, nullptr);
+    });
+    static_assert(sizeof(DrawIndexedCommand) == sizeof(VkDrawIndexedIndirectCommand), "indirect draw layout");
+    const auto* commands = static_cast<const DrawIndexedCommand*>(draws.getMapped());
+    return std::vector<DrawIndexedCommand>(commands, commands + clusterMesh.lodMeshlets[lod + 1] -
+                                                                clusterMesh.lodMeshlets[lod]);
+}
 
-    CHECK_VK(vkCreateDescriptorPool(m_DeviceStruct.device, &samplerPoolCreateInfo, nullptr, &m_SamplerDescriptorPool));
+void GfxDevice::recordClusterCull(VkCommandBuffer commandBuffer)
+{
+    // Culls with the projection before pre-rotation like the CPU path, turning clip space by a
+    // multiple of 90 degrees keeps what is inside the frustum
+    const glm::mat4 viewProjection = uboViewProjection.projection * uboViewProjection.view;
+    const glm::vec3 cameraPosition = glm::vec3(glm::inverse(uboViewProjection.view)[3]);
+    for (ClusterMesh& mesh : m_ClusterMeshes)
+    {
+        // The main pass draws the level culled here, whatever selectMeshLods picks next
+        const uint32_t lod = mesh.currentLod;
+        mesh.culledLods[currentFrame] = lod;
+        const uint32_t firstMeshlet = mesh.lodMeshlets[lod];
+        const uint32_t meshletCount = mesh.lodMeshlets[lod + 1] - firstMeshlet;
+        // From the frame's pool, it dies with the meshes' buffers instead of staying in the cache
+        const GfxBuffer& draws = *mesh.draws[currentFrame];
+        DescriptorSetBuilder builder;
+        builder.bindBuffer(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, mesh.gpuMeshlets->getBuffer(), 0, mesh.gpuMeshlets->getSize());
+        builder.bindBuffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, draws.getBuffer(), 0, draws.getSize());
+        const VkDescriptorSet set = allocateFrameDescriptorSet(m_ClusterCullPass->getSetLayout(), builder);
+        const ClusterCullParams params = ClusterCullPass::makeParams(firstMeshlet, meshletCount, viewProjection,
+                                                                     mesh.model, cameraPosition, 0);
+        m_ClusterCullPass->record(commandBuffer, set, draws.getBuffer(), params);
+    }
 }
 
 VkPhysicalDevice GfxDevice::getPhysicalDevice(VkInstance instance)
@@ -285,17 +795,64 @@ VkPhysicalDevice GfxDevice::getPhysicalDevice(VkInstance instance)
     }
     std::vector<VkPhysicalDevice> devices(deviceCount);
     CHECK_VK(vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data()));
-    // add code if more than one device in the system and need to get most matching physical Device
+    for (VkPhysicalDevice device : devices)
+    {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(device, &properties);
+        if (!m_PhysicalDeviceName.empty() && strstr(properties.deviceName, m_PhysicalDeviceName.c_str()) != nullptr)
+        {
+            LOGD(m_TAG,"physical device %s", properties.deviceName);
+            return device;
+        }
+    }
+    if (!m_PhysicalDeviceName.empty())
+    {
+        LOGW(m_TAG,"no physical device named %s, using the first", m_PhysicalDeviceName.c_str());
+    }
     return devices[0];
 }
 
 void GfxDevice::createSamplers() {
-    //m_samplers.insert()
+    LOGD(m_TAG,__FUNCTION__);
+    for (auto type : { GfxSamplerType::LINEAR_SAMPLER, GfxSamplerType::ANISO_SAMPLER, GfxSamplerType::MIN_SAMPLER,
+                       GfxSamplerType::LINEAR_CLAMP_SAMPLER, GfxSamplerType::LINEAR_WRAP_SAMPLER, GfxSamplerType::NEAREST_SAMPLER })
+    {
+        m_samplers.emplace(type, std::make_unique<TextureSampler>(m_thisPtr, type));
+    }
+}
 
+VkSampler GfxDevice::getSampler(GfxSamplerType type)
+{
+    return m_SamplerCache->getSampler(type);
+}
+
+VkSampler GfxDevice::getSampler(const VkSamplerCreateInfo& createInfo)
+{
+    return m_SamplerCache->getSampler(createInfo);
 }
 
-void GfxDevice::createSurface(ANativeWindow* window) {
+const TextureSampler& GfxDevice::getTextureSampler(GfxSamplerType type) const
+{
+    return *m_samplers.at(type);
+}
+
+void GfxDevice::createSurface(NativeWindow* window) {
     LOGD(m_TAG,__FUNCTION__);
+    if (m_Headless)
+    {
+        throw std::runtime_error("a headless device has no surface");
+    }
+    if (m_Surface != VK_NULL_HANDLE)
+    {
+        // New window: the old swap chain can't be handed to the new surface as oldSwapchain
+        vkDeviceWaitIdle(m_DeviceStruct.device);
+        destroySwapchainImageViews();
+        vkDestroySwapchainKHR(m_DeviceStruct.device, m_SwapChain, nullptr);
+        m_SwapChain = VK_NULL_HANDLE;
+        vkDestroySurfaceKHR(m_DeviceStruct.instance, m_Surface, nullptr);
+        m_Surface = VK_NULL_HANDLE;
+    }
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
     VkAndroidSurfaceCreateInfoKHR create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR;
     create_info.pNext = nullptr;
@@ -303,19 +860,104 @@ void GfxDevice::createSurface(ANativeWindow* window) {
     create_info.window = window;
 
     CHECK_VK(vkCreateAndroidSurfaceKHR(m_DeviceStruct.instance, &create_info, nullptr, &m_Surface));
+#elif defined(VK_USE_PLATFORM_XCB_KHR)
+    VkXcbSurfaceCreateInfoKHR create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR;
+    create_info.connection = window->connection;
+    create_info.window = window->window;
+
+    CHECK_VK(vkCreateXcbSurfaceKHR(m_DeviceStruct.instance, &create_info, nullptr, &m_Surface));
+#endif
 }
 
 
 void GfxDevice::reCreateSwapchain() {
+    LOGD(m_TAG,__FUNCTION__);
+    PROFILE_FUNCTION();
+    if (m_Headless)
+    {
+        // Offscreen images keep their size, nothing to follow
+        return;
+    }
+    vkDeviceWaitIdle(m_DeviceStruct.device);
+    VkExtent2D oldExtent = m_SwapchainExtent;
+    VkFormat oldFormat = m_SwapchainImageFormat;
+
+    createSwapChain();
+    // Command buffers, UBOs and descriptor sets are per image, pipelines per render pass format
+    if (m_SwapchainImages.size() != m_CommandBuffers.size())
+    {
+        throw std::runtime_error("Swap chain image count changed");
+    }
+    if (m_SwapchainImageFormat != oldFormat)
+    {
+        throw std::runtime_error("Swap chain format changed");
+    }
 
+    if (m_SwapchainExtent.width != oldExtent.width || m_SwapchainExtent.height != oldExtent.height)
+    {
+        // Same formats and samples, so the new render pass stays compatible with the pipelines
+        createRenderPass();
+    }
+    else
+    {
+        // Rotation only: with pre-rotation the identity size doesn't change, the graph and its
+        // transient images are kept and only the framebuffers of the old image views go
+        m_RenderGraph->releaseFramebuffers();
+    }
+    createFrameBuffers();
+    m_ImageFences.assign(m_SwapchainImages.size(), VK_NULL_HANDLE);
+}
+
+void GfxDevice::destroySwapchainImageViews() {
+    // Offscreen images own their views
+    if (m_OffscreenImages.empty()) {
+        for (const SwapchainImage& swapchainImage : m_SwapchainImages) {
+            vkDestroyImageView(m_DeviceStruct.device, swapchainImage.imageView, nullptr);
+        }
+    }
+    m_SwapchainImages.clear();
+    m_OffscreenImages.clear();
+}
+
+bool GfxDevice::surfaceChanged() {
+    VkSurfaceCapabilitiesKHR capabilities;
+    CHECK_VK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_DeviceStruct.physicalDevice, m_Surface,
+                                                       &capabilities));
+    return capabilities.currentTransform != m_PretransformFlag ||
+           capabilities.currentExtent.width != m_DisplaySize.width ||
+           capabilities.currentExtent.height != m_DisplaySize.height;
+}
+
+glm::mat4 GfxDevice::getPreRotation(VkSurfaceTransformFlagBitsKHR transform) {
+    float angle = 0.0f;
+    if (transform & VK_SURFACE_TRANSFORM_ROTATE_90_BIT_KHR) {
+        angle = 90.0f;
+    } else if (transform & VK_SURFACE_TRANSFORM_ROTATE_180_BIT_KHR) {
+        angle = 180.0f;
+    } else if (transform & VK_SURFACE_TRANSFORM_ROTATE_270_BIT_KHR) {
+        angle = 270.0f;
+    }
+    return glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 0.0f, 1.0f));
 }
 
 void GfxDevice::createSwapChain() {
     LOGD(m_TAG,__FUNCTION__);
+    PROFILE_FUNCTION();
     VkSurfaceCapabilitiesKHR capabilities;
     CHECK_VK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_DeviceStruct.physicalDevice, m_Surface,
                                                        &capabilities));
+    // Pre-rotation: render in the display's native orientation and rotate in the vertex stage,
+    // otherwise the compositor rotates every frame with an extra pass. currentExtent is the
+    // size in the current orientation, swap it back to the identity size for 90 / 270 degrees.
+    m_PretransformFlag = capabilities.currentTransform;
+    m_PreRotation = getPreRotation(m_PretransformFlag);
+    m_DisplaySize = capabilities.currentExtent;
     m_DisplaySizeIdentity = capabilities.currentExtent;
+    if (m_PretransformFlag & (VK_SURFACE_TRANSFORM_ROTATE_90_BIT_KHR | VK_SURFACE_TRANSFORM_ROTATE_270_BIT_KHR))
+    {
+        std::swap(m_DisplaySizeIdentity.width, m_DisplaySizeIdentity.height);
+    }
     uint32_t formatCount = 0;
     std::vector<VkSurfaceFormatKHR> formats;
     vkGetPhysicalDeviceSurfaceFormatsKHR(m_DeviceStruct.physicalDevice, m_Surface, &formatCount,
@@ -351,15 +993,13 @@ void GfxDevice::createSwapChain() {
     // https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkPresentModeKHR.html
     // for a discourse on different present modes.
     //
-    // VK_PRESENT_MODE_FIFO_KHR = Hard Vsync
-    // This is always supported on Android phones
-    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
-
-    uint32_t imageCount = capabilities.minImageCount + 1;
-    if (capabilities.maxImageCount > 0 && imageCount > capabilities.maxImageCount) {
-        imageCount = capabilities.maxImageCount;
-    }
-    m_PretransformFlag = capabilities.currentTransform;
+    // Present mode and swap chain depth come from DeviceConfig::framePacing, FIFO (hard vsync,
+    // always supported on Android phones) when the surface lacks the requested mode
+    const FramePacerConfig& pacing = m_FramePacer->getConfig();
+    VkPresentModeKHR presentMode = FramePacer::choosePresentMode(pacing.presentMode, presentModes);
+    m_FramePacer->setPresentMode(presentMode);
+    uint32_t imageCount = FramePacer::chooseImageCount(pacing.swapchainImages, capabilities);
+    LOGD(m_TAG,"present mode %s, %u images", FramePacer::toString(presentMode).c_str(), imageCount);
 
     VkSwapchainCreateInfoKHR createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -379,9 +1019,16 @@ void GfxDevice::createSwapChain() {
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR;
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    // Lets images of the old swap chain that are still queued finish presenting
+    VkSwapchainKHR oldSwapchain = m_SwapChain;
+    createInfo.oldSwapchain = oldSwapchain;
 
     CHECK_VK(vkCreateSwapchainKHR(m_DeviceStruct.device, &createInfo, nullptr, &m_SwapChain));
+    if (oldSwapchain != VK_NULL_HANDLE)
+    {
+        destroySwapchainImageViews();
+        vkDestroySwapchainKHR(m_DeviceStruct.device, oldSwapchain, nullptr);
+    }
     vkGetSwapchainImagesKHR(m_DeviceStruct.device, m_SwapChain, &imageCount, nullptr);
     std::vector<VkImage> images(imageCount);
     vkGetSwapchainImagesKHR(m_DeviceStruct.device, m_SwapChain, &imageCount,
@@ -390,6 +1037,15 @@ void GfxDevice::createSwapChain() {
     m_SwapchainImageFormat = surfaceFormat.format;
     m_SwapchainExtent = m_DisplaySizeIdentity;
 
+    if (m_DisplayTimingSupported)
+    {
+        VkRefreshCycleDurationGOOGLE refreshCycle{};
+        if (m_vkGetRefreshCycleDuration(m_DeviceStruct.device, m_SwapChain, &refreshCycle) == VK_SUCCESS)
+        {
+            m_FramePacer->setRefreshDuration(refreshCycle.refreshDuration);
+        }
+    }
+
     for (VkImage image: images) {
         // Store image handle
         SwapchainImage swapChainImage = {};
@@ -400,46 +1056,46 @@ void GfxDevice::createSwapChain() {
         // Add to swapchain image list
         m_SwapchainImages.push_back(swapChainImage);
     }
-
-
-    VkFormat depthFormat = chooseSupportedFormat(
-            { VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D32_SFLOAT, VK_FORMAT_D24_UNORM_S8_UINT },
-            VK_IMAGE_TILING_OPTIMAL,
-            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
-
-    // Create Depth Buffer Image
-    m_DepthBufferImage = createImage(m_SwapchainExtent.width, m_SwapchainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL,
-                                   VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_DepthBufferImageMemory);
-
-    // Create Depth Buffer Image View
-    m_DepthBufferImageView = createImageView(m_DepthBufferImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
 }
-void GfxDevice::createFrameBuffers()
+void GfxDevice::createOffscreenImages()
 {
     LOGD(m_TAG,__FUNCTION__);
-    m_SwapchainFramebuffers.resize(m_SwapchainImages.size());
-
-    // Create a framebuffer for each swap chain image
-    for (size_t i = 0; i < m_SwapchainFramebuffers.size(); i++)
+    // What createSwapChain fills in from the surface: identity transform, the configured size
+    m_PretransformFlag = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+    m_PreRotation = glm::mat4(1.0f);
+    m_DisplaySize = m_HeadlessExtent;
+    m_DisplaySizeIdentity = m_HeadlessExtent;
+    m_SwapchainExtent = m_HeadlessExtent;
+    m_SwapchainImageFormat = m_HeadlessFormat;
+
+    GfxTextureDesc desc;
+    desc.name = "offscreen";
+    desc.width = m_HeadlessExtent.width;
+    desc.height = m_HeadlessExtent.height;
+    desc.format = m_HeadlessFormat;
+    // Transfer source for readbackFrame
+    desc.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    for (uint32_t i = 0; i < MAX_FRAME_DRAWS; i++)
     {
-        std::array<VkImageView, 2> attachments = {
-                m_SwapchainImages[i].imageView,
-                m_DepthBufferImageView
-        };
-
-        VkFramebufferCreateInfo framebufferCreateInfo = {};
-        framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferCreateInfo.renderPass = m_RenderPass;										// Render Pass layout the Framebuffer will be used with
-        framebufferCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-        framebufferCreateInfo.pAttachments = attachments.data();							// List of attachments (1:1 with Render Pass)
-        framebufferCreateInfo.width = m_SwapchainExtent.width;								// Framebuffer width
-        framebufferCreateInfo.height = m_SwapchainExtent.height;								// Framebuffer height
-        framebufferCreateInfo.layers = 1;													// Framebuffer layers
+        auto image = createTexture(desc);
+        m_SwapchainImages.push_back({ image->getImage(), image->getView(0, 1) });
+        m_OffscreenImages.push_back(std::move(image));
+    }
+    LOGD(m_TAG,"headless, %u images of %ux%u", MAX_FRAME_DRAWS, m_HeadlessExtent.width, m_HeadlessExtent.height);
+}
 
-        CHECK_VK(vkCreateFramebuffer(m_DeviceStruct.device, &framebufferCreateInfo, nullptr, &m_SwapchainFramebuffers[i]));
+void GfxDevice::createFrameBuffers()
+{
+    LOGD(m_TAG,__FUNCTION__);
+    // Framebuffers are owned and cached by the render graph, create the one of every swap chain
+    // image now instead of during the first frames
+    for (const SwapchainImage& swapchainImage : m_SwapchainImages)
+    {
+        m_RenderGraph->setImportedImage(m_BackbufferTexture, swapchainImage.image, swapchainImage.imageView);
+        m_RenderGraph->prepareFramebuffers();
     }
 }
-VkImageView GfxDevice::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
+VkImageView GfxDevice::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels)
 {
     LOGD(m_TAG,__FUNCTION__);
     VkImageViewCreateInfo viewCreateInfo = {};
@@ -455,7 +1111,7 @@ VkImageView GfxDevice::createImageView(VkImage image, VkFormat format, VkImageAs
     // Subresources allow the view to view only a part of an image
     viewCreateInfo.subresourceRange.aspectMask = aspectFlags;				// Which aspect of image to view (e.g. COLOR_BIT for viewing colour)
     viewCreateInfo.subresourceRange.baseMipLevel = 0;						// Start mipmap level to view from
-    viewCreateInfo.subresourceRange.levelCount = 1;							// Number of mipmap levels to view
+    viewCreateInfo.subresourceRange.levelCount = mipLevels;					// Number of mipmap levels to view
     viewCreateInfo.subresourceRange.baseArrayLayer = 0;						// Start array level to view from
     viewCreateInfo.subresourceRange.layerCount = 1;							// Number of array levels to view
 
@@ -468,93 +1124,190 @@ VkImageView GfxDevice::createImageView(VkImage image, VkFormat format, VkImageAs
 void GfxDevice::createRenderPass()
 {
     LOGD(m_TAG,__FUNCTION__);
-    // ATTACHMENTS
-    // Colour attachment of render pass
-    VkAttachmentDescription colourAttachment = {};
-    colourAttachment.format = m_SwapchainImageFormat;						// Format to use for attachment
-    colourAttachment.samples = VK_SAMPLE_COUNT_1_BIT;					// Number of samples to write for multisampling
-    colourAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;				// Describes what to do with attachment before rendering
-    colourAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;			// Describes what to do with attachment after rendering
-    colourAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;	// Describes what to do with stencil before rendering
-    colourAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;	// Describes what to do with stencil after rendering
-
-    // Framebuffer data will be stored as an image, but images can be given different data layouts
-    // to give optimal use for certain operations
-    colourAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;			// Image data layout before render pass starts
-    colourAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;		// Image data layout after render pass (to change to)
-
-
-    // Depth attachment of render pass
-    VkAttachmentDescription depthAttachment = {};
-    depthAttachment.format = chooseSupportedFormat(
+    PROFILE_FUNCTION();
+    // The frame is a render graph: load / store ops, layouts, subpass dependencies and the depth
+    // buffer memory all follow from what the passes read and write
+    VkFormat depthFormat = chooseSupportedFormat(
             { VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D32_SFLOAT, VK_FORMAT_D24_UNORM_S8_UINT },
             VK_IMAGE_TILING_OPTIMAL,
             VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
-    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    // REFERENCES
-    // Attachment reference uses an attachment index that refers to index in the attachment list passed to renderPassCreateInfo
-    VkAttachmentReference colourAttachmentReference = {};
-    colourAttachmentReference.attachment = 0;
-    colourAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    // Depth Attachment Reference
-    VkAttachmentReference depthAttachmentReference = {};
-    depthAttachmentReference.attachment = 1;
-    depthAttachmentReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    // Information about a particular subpass the Render Pass is using
-    VkSubpassDescription subpass = {};
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;		// Pipeline type subpass is to be bound to
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &colourAttachmentReference;
-    subpass.pDepthStencilAttachment = &depthAttachmentReference;
-
-    // Need to determine when layout transitions occur using subpass dependencies
-    std::array<VkSubpassDependency, 2> subpassDependencies;
-
-    // Conversion from VK_IMAGE_LAYOUT_UNDEFINED to VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-    // Transition must happen after...
-    subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;						// Subpass index (VK_SUBPASS_EXTERNAL = Special value meaning outside of renderpass)
-    subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;		// Pipeline stage
-    subpassDependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;				// Stage access mask (memory access)
-    // But must happen before...
-    subpassDependencies[0].dstSubpass = 0;
-    subpassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    subpassDependencies[0].dependencyFlags = 0;
-
-
-    // Conversion from VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL to VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-    // Transition must happen after...
-    subpassDependencies[1].srcSubpass = 0;
-    subpassDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subpassDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;;
-    // But must happen before...
-    subpassDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-    subpassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-    subpassDependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-    subpassDependencies[1].dependencyFlags = 0;
-
-    std::array<VkAttachmentDescription, 2> renderPassAttachments = { colourAttachment, depthAttachment };
-
-    // Create info for Render Pass
-    VkRenderPassCreateInfo renderPassCreateInfo = {};
-    renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassCreateInfo.attachmentCount = static_cast<uint32_t>(renderPassAttachments.size());
-    renderPassCreateInfo.pAttachments = renderPassAttachments.data();
-    renderPassCreateInfo.subpassCount = 1;
-    renderPassCreateInfo.pSubpasses = &subpass;
-    renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(subpassDependencies.size());
-    renderPassCreateInfo.pDependencies = subpassDependencies.data();
-
-    CHECK_VK(vkCreateRenderPass(m_DeviceStruct.device, &renderPassCreateInfo, nullptr, &m_RenderPass));
+    RGTextureDesc backbufferDesc = { m_SwapchainImageFormat, m_SwapchainExtent.width, m_SwapchainExtent.height, VK_SAMPLE_COUNT_1_BIT };
+    RGTextureDesc depthDesc = backbufferDesc;
+    depthDesc.format = depthFormat;
+    depthDesc.samples = m_MsaaSamples;
+
+    m_RenderGraph = std::make_unique<RenderGraph>();
+    m_RenderGraph->setProfiler(m_GpuProfiler.get());
+    // Swap chain images arrive undefined after acquire and leave ready to present, offscreen
+    // images leave ready to be read back
+    m_BackbufferTexture = m_RenderGraph->importTexture("backbuffer", backbufferDesc, VK_IMAGE_LAYOUT_UNDEFINED,
+                                                       m_Headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                                                  : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    m_RenderGraph->markOutput(m_BackbufferTexture);
+    // Depth and the multisampled color are never stored, the graph makes them transient
+    // attachments in lazily allocated memory so they only ever exist in tile memory
+    uint32_t depth = m_RenderGraph->createTexture("depth", depthDesc);
+
+    // Cull dispatches of the cluster meshes, their draws are consumed by the main pass. The graph
+    // doesn't track the buffers it writes, so it must not be culled.
+    uint32_t clusterCull = m_RenderGraph->addComputePass("cluster cull", [this](VkCommandBuffer commandBuffer) {
+        recordClusterCull(commandBuffer);
+    });
+    m_RenderGraph->setSideEffect(clusterCull);
+    m_MainPass = m_RenderGraph->addPass("main", [this](VkCommandBuffer commandBuffer) { recordMainPass(commandBuffer); });
+    setSecondaryRecording(m_RecordThreads > 1);
+    if (m_MsaaSamples != VK_SAMPLE_COUNT_1_BIT)
+    {
+        RGTextureDesc colorDesc = backbufferDesc;
+        colorDesc.samples = m_MsaaSamples;
+        uint32_t color = m_RenderGraph->createTexture("msaa color", colorDesc);
+        m_RenderGraph->writeColor(m_MainPass, color, true, { { 0.6f, 0.65f, 0.4f, 1.0f } });
+        m_RenderGraph->resolve(m_MainPass, color, m_BackbufferTexture);
+    }
+    else
+    {
+        m_RenderGraph->writeColor(m_MainPass, m_BackbufferTexture, true, { { 0.6f, 0.65f, 0.4f, 1.0f } });
+    }
+    m_RenderGraph->writeDepth(m_MainPass, depth, true, 1.0f);
+
+    m_RenderGraph->compile();
+    m_RenderGraph->realize(m_thisPtr);
+    m_RenderPass = m_RenderGraph->getRenderPass(m_MainPass);
+    LOGD(m_TAG,"%s", m_RenderGraph->dump().c_str());
+}
+
+void GfxDevice::createProfiler()
+{
+    LOGD(m_TAG,__FUNCTION__);
+    PROFILE_FUNCTION();
+    if (!m_GpuProfiling)
+    {
+        return;
+    }
+    // One set of queries per command buffer, a slot is reused only after its fence was waited on
+    m_GpuProfiler = std::make_unique<GpuProfiler>(m_thisPtr, m_BufferQueueStruct.graphicsQueue,
+                                                  m_BufferQueueStruct.graphicsQueueFamilyIndex,
+                                                  static_cast<uint32_t>(m_CommandBuffers.size()),
+                                                  m_PipelineStatisticsSupported);
+    if (!m_GpuProfiler->isSupported())
+    {
+        m_GpuProfiler.reset();
+        return;
+    }
+    m_GpuProfiler->setTrace(&m_Trace);
+    m_RenderGraph->setProfiler(m_GpuProfiler.get());
+}
+
+const GpuFrameStats& GfxDevice::getGpuFrameStats() const
+{
+    static const GpuFrameStats empty{};
+    return m_GpuProfiler ? m_GpuProfiler->getLastFrame() : empty;
+}
+
+void GfxDevice::setRecordThreads(uint32_t threadCount)
+{
+    m_ParallelRecorder->setThreadCount(threadCount);
+    m_RecordThreads = m_ParallelRecorder->getThreadCount();
+    setSecondaryRecording(m_RecordThreads > 1);
+}
+
+void GfxDevice::setSecondaryRecording(bool secondary)
+{
+    m_SecondaryRecording = secondary;
+    m_RenderGraph->setSecondaryCommandBuffers(m_MainPass, secondary);
+}
+
+uint32_t GfxDevice::getMaxRecordThreads() const
+{
+    return m_ParallelRecorder->getMaxThreadCount();
+}
+
+const ParallelRecordingStats& GfxDevice::getRecordingStats() const
+{
+    return m_ParallelRecorder->getStats();
+}
+
+std::vector<BenchmarkResult> GfxDevice::benchmarkRecording(uint32_t drawCount, const std::vector<uint32_t>& threadCounts,
+                                                           uint32_t iterations)
+{
+    PROFILE_FUNCTION();
+    // The frame slot's pools and descriptors are reused below without waiting on its fence
+    vkDeviceWaitIdle(m_DeviceStruct.device);
+
+    GfxBufferDesc vertexDesc;
+    vertexDesc.name = "benchmark vertices";
+    vertexDesc.size = sizeof(Vertex) * 3;
+    vertexDesc.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    vertexDesc.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    auto vertices = createBuffer(vertexDesc);
+    memset(vertices->getMapped(), 0, vertexDesc.size);
+    // Set 1 has to be bound even though the triangles are never rasterized
+    getDefaultTexture();
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = m_GraphicsCommandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    CHECK_VK(vkAllocateCommandBuffers(m_DeviceStruct.device, &allocInfo, &commandBuffer));
+
+    const uint32_t recordThreads = m_RecordThreads;
+    m_BenchmarkDraws = drawCount;
+    m_BenchmarkVertexBuffer = vertices->getBuffer();
+    // Nothing is submitted, the profiler's queries would never be written
+    m_RenderGraph->setProfiler(nullptr);
+    m_RenderGraph->setImportedImage(m_BackbufferTexture, m_SwapchainImages[0].image, m_SwapchainImages[0].imageView);
+    m_RecordingImage = 0;
+
+    std::vector<BenchmarkResult> results;
+    for (uint32_t threadCount : threadCounts)
+    {
+        setRecordThreads(threadCount);
+        const std::string name = std::to_string(drawCount) + " draws, " + std::to_string(m_RecordThreads) + " threads";
+        results.push_back(runBenchmark(name, iterations, [&]() {
+            m_ParallelRecorder->beginFrame(static_cast<uint32_t>(currentFrame));
+            m_FrameDescriptors[m_RecordingImage]->reset();
+            VkCommandBufferBeginInfo beginInfo = {};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            CHECK_VK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+            m_RenderGraph->execute(commandBuffer);
+            CHECK_VK(vkEndCommandBuffer(commandBuffer));
+        }));
+    }
+
+    m_ParallelRecorder->beginFrame(static_cast<uint32_t>(currentFrame));
+    m_RenderGraph->setProfiler(m_GpuProfiler.get());
+    m_BenchmarkDraws = 0;
+    m_BenchmarkVertexBuffer = VK_NULL_HANDLE;
+    setRecordThreads(recordThreads);
+    vkFreeCommandBuffers(m_DeviceStruct.device, m_GraphicsCommandPool, 1, &commandBuffer);
+    return results;
+}
+
+void GfxDevice::createSynchronisation()
+{
+    LOGD(m_TAG,__FUNCTION__);
+    m_ImageAvailable.resize(MAX_FRAME_DRAWS);
+    m_RenderFinished.resize(MAX_FRAME_DRAWS);
+    m_DrawFences.resize(MAX_FRAME_DRAWS);
+    m_ImageFences.assign(m_SwapchainImages.size(), VK_NULL_HANDLE);
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+    semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    // Signaled, so the first wait on every frame returns immediately
+    VkFenceCreateInfo fenceCreateInfo = {};
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    for (size_t i = 0; i < MAX_FRAME_DRAWS; i++)
+    {
+        CHECK_VK(vkCreateSemaphore(m_DeviceStruct.device, &semaphoreCreateInfo, nullptr, &m_ImageAvailable[i]));
+        CHECK_VK(vkCreateSemaphore(m_DeviceStruct.device, &semaphoreCreateInfo, nullptr, &m_RenderFinished[i]));
+        CHECK_VK(vkCreateFence(m_DeviceStruct.device, &fenceCreateInfo, nullptr, &m_DrawFences[i]));
+    }
 }
 VkFormat GfxDevice::chooseSupportedFormat(const std::vector<VkFormat>& formats, VkImageTiling tiling, VkFormatFeatureFlags featureFlags)
 {
@@ -581,276 +1334,120 @@ VkFormat GfxDevice::chooseSupportedFormat(const std::vector<VkFormat>& formats,
 void GfxDevice::createDescriptorSetLayout()
 {
     LOGD(m_TAG,__FUNCTION__);
-    // UNIFORM VALUES DESCRIPTOR SET LAYOUT
-    // UboViewProjection Binding Info
-    VkDescriptorSetLayoutBinding vpLayoutBinding = {};
-    vpLayoutBinding.binding = 0;											// Binding point in shader (designated by binding number in shader)
-    vpLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;	// Type of descriptor (uniform, dynamic uniform, image sampler, etc)
-    vpLayoutBinding.descriptorCount = 1;									// Number of descriptors for binding
-    vpLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;				// Shader stage to bind to
-    vpLayoutBinding.pImmutableSamplers = nullptr;							// For Texture: Can make sampler data unchangeable (immutable) by specifying in layout
-
-    // Model Binding Info
-    /*VkDescriptorSetLayoutBinding modelLayoutBinding = {};
-    modelLayoutBinding.binding = 1;
-    modelLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-    modelLayoutBinding.descriptorCount = 1;
-    modelLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-    modelLayoutBinding.pImmutableSamplers = nullptr;*/
-
-    std::vector<VkDescriptorSetLayoutBinding> layoutBindings = { vpLayoutBinding };
-
-    // Create Descriptor Set Layout with given bindings
-    VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
-    layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutCreateInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size());	// Number of binding infos
-    layoutCreateInfo.pBindings = layoutBindings.data();								// Array of binding infos
-
-    // Create Descriptor Set Layout
-    CHECK_VK(vkCreateDescriptorSetLayout(m_DeviceStruct.device, &layoutCreateInfo, nullptr, &m_DescriptorSetLayout));
-
-    // CREATE TEXTURE SAMPLER DESCRIPTOR SET LAYOUT
-    // Texture binding info
-    VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
-    samplerLayoutBinding.binding = 0;
-    samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    samplerLayoutBinding.descriptorCount = 1;
-    samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-    samplerLayoutBinding.pImmutableSamplers = nullptr;
-
-    // Create a Descriptor Set Layout with given bindings for texture
-    VkDescriptorSetLayoutCreateInfo textureLayoutCreateInfo = {};
-    textureLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    textureLayoutCreateInfo.bindingCount = 1;
-    textureLayoutCreateInfo.pBindings = &samplerLayoutBinding;
-
-    // Create Descriptor Set Layout
-    CHECK_VK(vkCreateDescriptorSetLayout(m_DeviceStruct.device, &textureLayoutCreateInfo, nullptr, &m_SamplerSetLayout));
+    // Layouts are reflected from the SPIR-V instead of being written by hand, so they can't drift from the shaders
+    m_ShaderCache = std::make_unique<ShaderModuleCache>(m_thisPtr);
+    m_VertexShader = m_ShaderCache->getShader("Shaders/mesh.vert.spv");
+    if (m_DescriptorIndexingSupported)
+    {
+        // set 1 is the bindless texture array, its layout needs flags reflection doesn't provide
+        m_BindlessTextures = std::make_unique<BindlessTextureTable>(m_thisPtr, *m_ShaderCache, MAX_BINDLESS_TEXTURES,
+                                                                    static_cast<uint32_t>(m_SwapchainImages.size()));
+        m_FragmentShader = m_ShaderCache->getShader("Shaders/textured_bindless.frag.spv");
+        ProgramLayoutOptions options;
+        options.setOverrides[1] = m_BindlessTextures->getSetLayout();
+        m_ProgramLayout = m_ShaderCache->getProgramLayout({ m_VertexShader, m_FragmentShader }, options);
+    }
+    else
+    {
+        m_FragmentShader = m_ShaderCache->getShader("Shaders/textured.frag.spv");
+        // Every texture uses the same sampler, bake it into the layout instead of each descriptor
+        ProgramLayoutOptions options;
+        options.immutableSamplers[{ 1, 0 }] = m_TextureSampler;
+        m_ProgramLayout = m_ShaderCache->getProgramLayout({ m_VertexShader, m_FragmentShader }, options);
+    }
+
+    // set 0 : UboViewProjection, set 1 : texture sampler (one set per texture, or the bindless table)
+    if (m_ProgramLayout->setLayouts.size() < 2)
+    {
+        throw std::runtime_error("Vertex + fragment shader must use descriptor sets 0 and 1");
+    }
+    m_DescriptorSetLayout = m_ProgramLayout->setLayouts[0];
+    m_SamplerSetLayout = m_ProgramLayout->setLayouts[1];
 }
 
 void GfxDevice::createPushConstantRange()
 {
     LOGD(m_TAG,__FUNCTION__);
     // Define push constant values (no 'create' needed!)
-    m_pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;	// Shader stage push constant will go to
-    m_pushConstantRange.offset = 0;								// Offset into given data to pass to push constant
-    m_pushConstantRange.size = sizeof(Model);						// Size of data being passed
+    if (m_ProgramLayout->pushConstants.empty())
+    {
+        throw std::runtime_error("Shaders/mesh.vert.spv has no push constant block for the Model");
+    }
+    m_pushConstantRange = m_ProgramLayout->pushConstants[0];		// Stages, offset and size as reflected from the shaders
+    if (m_pushConstantRange.size < sizeof(Model))
+    {
+        LOGE(m_TAG,"push constant block is %u bytes, Model needs %zu", m_pushConstantRange.size, sizeof(Model));
+        throw std::runtime_error("push constant block too small for Model");
+    }
 }
 
 
 void GfxDevice::createGraphicsPipeline()
 {
     LOGD(m_TAG,__FUNCTION__);
-    // Read in SPIR-V code of shaders
-    auto vertexShaderCode = readFile("Shaders/vert.spv");
-    auto fragmentShaderCode = readFile("Shaders/frag.spv");
-
-    // Create Shader Modules
-    VkShaderModule vertexShaderModule = createShaderModule(vertexShaderCode);
-    VkShaderModule fragmentShaderModule = createShaderModule(fragmentShaderCode);
-
-    // -- SHADER STAGE CREATION INFORMATION --
-    // Vertex Stage creation information
-    VkPipelineShaderStageCreateInfo vertexShaderCreateInfo = {};
-    vertexShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertexShaderCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;				// Shader Stage name
-    vertexShaderCreateInfo.module = vertexShaderModule;						// Shader module to be used by stage
-    vertexShaderCreateInfo.pName = "main";									// Entry point in to shader
-
-    // Fragment Stage creation information
-    VkPipelineShaderStageCreateInfo fragmentShaderCreateInfo = {};
-    fragmentShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;				// Shader Stage name
-    fragmentShaderCreateInfo.module = fragmentShaderModule;						// Shader module to be used by stage
-    fragmentShaderCreateInfo.pName = "main";									// Entry point in to shader
-
-    // Put shader stage creation info in to array
-    // Graphics Pipeline creation info requires array of shader stage creates
-    VkPipelineShaderStageCreateInfo shaderStages[] = { vertexShaderCreateInfo, fragmentShaderCreateInfo };
+    PROFILE_FUNCTION();
+    m_PipelineCache = std::make_unique<PipelineCache>(m_thisPtr, *m_JobSystem);
 
     // How the data for a single vertex (including info such as position, colour, texture coords, normals, etc) is as a whole
     VkVertexInputBindingDescription bindingDescription = {};
     bindingDescription.binding = 0;									// Can bind multiple streams of data, this defines which one
     bindingDescription.stride = sizeof(Vertex);						// Size of a single vertex object
     bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;		// How to move between data after each vertex.
-    // VK_VERTEX_INPUT_RATE_INDEX		: Move on to the next vertex
-    // VK_VERTEX_INPUT_RATE_INSTANCE	: Move to a vertex for the next instance
 
     // How the data for an attribute is defined within a vertex
-    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions;
-
-    // Position Attribute
-    attributeDescriptions[0].binding = 0;							// Which binding the data is at (should be same as above)
-    attributeDescriptions[0].location = 0;							// Location in shader where data will be read from
-    attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;	// Format the data will take (also helps define size of data)
-    attributeDescriptions[0].offset = offsetof(Vertex, position);		// Where this attribute is defined in the data for a single vertex
-
-    // Colour Attribute
-    attributeDescriptions[1].binding = 0;
-    attributeDescriptions[1].location = 1;
-    attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-    // Texture Attribute
-    attributeDescriptions[2].binding = 0;
-    attributeDescriptions[2].location = 2;
-    attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-    attributeDescriptions[2].offset = offsetof(Vertex, tex);
-
-    // -- VERTEX INPUT --
-    VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
-    vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputCreateInfo.vertexBindingDescriptionCount = 1;
-    vertexInputCreateInfo.pVertexBindingDescriptions = &bindingDescription;											// List of Vertex Binding Descriptions (data spacing/stride information)
-    vertexInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputCreateInfo.pVertexAttributeDescriptions = attributeDescriptions.data();								// List of Vertex Attribute Descriptions (data format and where to bind to/from)
-
-
-    // -- INPUT ASSEMBLY --
-    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;		// Primitive type to assemble vertices as
-    inputAssembly.primitiveRestartEnable = VK_FALSE;					// Allow overriding of "strip" topology to start new primitives
-
-
-    // -- VIEWPORT & SCISSOR --
-    // Create a viewport info struct
-    VkViewport viewport = {};
-    viewport.x = 0.0f;									// x start coordinate
-    viewport.y = 0.0f;									// y start coordinate
-    viewport.width = (float)m_SwapchainExtent.width;		// width of viewport
-    viewport.height = (float)m_SwapchainExtent.height;	// height of viewport
-    viewport.minDepth = 0.0f;							// min framebuffer depth
-    viewport.maxDepth = 1.0f;							// max framebuffer depth
-
-    // Create a scissor info struct
-    VkRect2D scissor = {};
-    scissor.offset = { 0,0 };							// Offset to use region from
-    scissor.extent = m_SwapchainExtent;					// Extent to describe region to use, starting at offset
-
-    VkPipelineViewportStateCreateInfo viewportStateCreateInfo = {};
-    viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportStateCreateInfo.viewportCount = 1;
-    viewportStateCreateInfo.pViewports = &viewport;
-    viewportStateCreateInfo.scissorCount = 1;
-    viewportStateCreateInfo.pScissors = &scissor;
-
-
-    // -- DYNAMIC STATES --
-    // Dynamic states to enable
-    //std::vector<VkDynamicState> dynamicStateEnables;
-    //dynamicStateEnables.push_back(VK_DYNAMIC_STATE_VIEWPORT);	// Dynamic Viewport : Can resize in command buffer with vkCmdSetViewport(commandbuffer, 0, 1, &viewport);
-    //dynamicStateEnables.push_back(VK_DYNAMIC_STATE_SCISSOR);	// Dynamic Scissor	: Can resize in command buffer with vkCmdSetScissor(commandbuffer, 0, 1, &scissor);
-
-    //// Dynamic State creation info
-    //VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo = {};
-    //dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    //dynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStateEnables.size());
-    //dynamicStateCreateInfo.pDynamicStates = dynamicStateEnables.data();
-
-
-    // -- RASTERIZER --
-    VkPipelineRasterizationStateCreateInfo rasterizerCreateInfo = {};
-    rasterizerCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizerCreateInfo.depthClampEnable = VK_FALSE;					// Change if fragments beyond near/far planes are clipped (default) or clamped to plane
-    rasterizerCreateInfo.rasterizerDiscardEnable = VK_FALSE;			// Whether to discard data and skip rasterizer. Never creates fragments, only suitable for pipeline without framebuffer output
-    rasterizerCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;			// How to handle filling points between vertices
-    rasterizerCreateInfo.lineWidth = 1.0f;								// How thick lines should be when drawn
-    rasterizerCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;				// Which face of a tri to cull
-    rasterizerCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;	// Winding to determine which side is front
-    rasterizerCreateInfo.depthBiasEnable = VK_FALSE;					// Whether to add depth bias to fragments (good for stopping "shadow acne" in shadow mapping)
-
-
-    // -- MULTISAMPLING --
-    VkPipelineMultisampleStateCreateInfo multisamplingCreateInfo = {};
-    multisamplingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisamplingCreateInfo.sampleShadingEnable = VK_FALSE;					// Enable multisample shading or not
-    multisamplingCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;	// Number of samples to use per fragment
-
-
-    // -- BLENDING --
-    // Blending decides how to blend a new colour being written to a fragment, with the old value
-
-    // Blend Attachment State (how blending is handled)
-    VkPipelineColorBlendAttachmentState colourState = {};
-    colourState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT	// Colours to apply blending to
-                                 | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colourState.blendEnable = VK_TRUE;													// Enable blending
-
-    // Blending uses equation: (srcColorBlendFactor * new colour) colorBlendOp (dstColorBlendFactor * old colour)
-    colourState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-    colourState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-    colourState.colorBlendOp = VK_BLEND_OP_ADD;
-
-    // Summarised: (VK_BLEND_FACTOR_SRC_ALPHA * new colour) + (VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA * old colour)
-    //			   (new colour alpha * new colour) + ((1 - new colour alpha) * old colour)
-
-    colourState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    colourState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    colourState.alphaBlendOp = VK_BLEND_OP_ADD;
-    // Summarised: (1 * new alpha) + (0 * old alpha) = new alpha
-
-    VkPipelineColorBlendStateCreateInfo colourBlendingCreateInfo = {};
-    colourBlendingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colourBlendingCreateInfo.logicOpEnable = VK_FALSE;				// Alternative to calculations is to use logical operations
-    colourBlendingCreateInfo.attachmentCount = 1;
-    colourBlendingCreateInfo.pAttachments = &colourState;
+    // Locations and formats come from reflection, offsets from where the Vertex struct stores each location
+    const std::array<uint32_t, 3> vertexOffsets = { offsetof(Vertex, position), offsetof(Vertex, color), offsetof(Vertex, tex) };
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+    for (const auto& input : m_ProgramLayout->vertexInputs)
+    {
+        if (input.location >= vertexOffsets.size())
+        {
+            LOGE(m_TAG,"vertex shader input location %u has no Vertex member", input.location);
+            throw std::runtime_error("vertex shader input not provided by Vertex");
+        }
+        VkVertexInputAttributeDescription attribute = {};
+        attribute.binding = 0;									// Which binding the data is at (should be same as above)
+        attribute.location = input.location;					// Location in shader where data will be read from
+        attribute.format = input.format;						// Format the data will take (also helps define size of data)
+        attribute.offset = vertexOffsets[input.location];		// Where this attribute is defined in the data for a single vertex
+        attributeDescriptions.push_back(attribute);
+    }
+    m_VertexLayoutId = m_PipelineCache->registerVertexLayout(bindingDescription, attributeDescriptions);
 
     // -- PIPELINE LAYOUT --
-    std::array<VkDescriptorSetLayout, 2> descriptorSetLayouts = { m_DescriptorSetLayout, m_SamplerSetLayout };
+    // Shared with every other program reflecting to the same sets and push constants, owned by the shader cache
+    m_PipelineLayout = m_ProgramLayout->pipelineLayout;
 
-    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
-    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
-    pipelineLayoutCreateInfo.pSetLayouts = descriptorSetLayouts.data();
-    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
-    pipelineLayoutCreateInfo.pPushConstantRanges = &m_pushConstantRange;
-
-    // Create Pipeline Layout
-    VkResult result = vkCreatePipelineLayout(m_DeviceStruct.device, &pipelineLayoutCreateInfo, nullptr, &m_PipelineLayout);
-    if (result != VK_SUCCESS)
+    // Default state (alpha blended, back face culled, depth tested) compiled up front, it is also
+    // what variants draw with while they compile in the background
+    m_GraphicsPipeline = m_PipelineCache->getPipelineBlocking(getDefaultPipelineDesc());
+    if (m_GraphicsPipeline == VK_NULL_HANDLE)
     {
-        throw std::runtime_error("Failed to create Pipeline Layout!");
+        throw std::runtime_error("Failed to create the default Graphics Pipeline!");
     }
+    m_PipelineCache->setFallbackPipeline(m_GraphicsPipeline);
+}
 
+PipelineDesc GfxDevice::getDefaultPipelineDesc() const
+{
+    PipelineDesc desc = {};
+    desc.vertexShader = m_VertexShader;
+    desc.fragmentShader = m_FragmentShader;
+    desc.renderPass = m_RenderPass;
+    desc.layout = m_PipelineLayout;
+    desc.state.vertexLayoutId = m_VertexLayoutId;
+    desc.state.sampleCount = static_cast<uint8_t>(m_MsaaSamples);
+    return desc;
+}
 
-    // -- DEPTH STENCIL TESTING --
-    VkPipelineDepthStencilStateCreateInfo depthStencilCreateInfo = {};
-    depthStencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depthStencilCreateInfo.depthTestEnable = VK_TRUE;				// Enable checking depth to determine fragment write
-    depthStencilCreateInfo.depthWriteEnable = VK_TRUE;				// Enable writing to depth buffer (to replace old values)
-    depthStencilCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;		// Comparison operation that allows an overwrite (is in front)
-    depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;		// Depth Bounds Test: Does the depth value exist between two bounds
-    depthStencilCreateInfo.stencilTestEnable = VK_FALSE;			// Enable Stencil Test
-
-
-    // -- GRAPHICS PIPELINE CREATION --
-    VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
-    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineCreateInfo.stageCount = 2;									// Number of shader stages
-    pipelineCreateInfo.pStages = shaderStages;							// List of shader stages
-    pipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo;		// All the fixed function pipeline states
-    pipelineCreateInfo.pInputAssemblyState = &inputAssembly;
-    pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-    pipelineCreateInfo.pDynamicState = nullptr;
-    pipelineCreateInfo.pRasterizationState = &rasterizerCreateInfo;
-    pipelineCreateInfo.pMultisampleState = &multisamplingCreateInfo;
-    pipelineCreateInfo.pColorBlendState = &colourBlendingCreateInfo;
-    pipelineCreateInfo.pDepthStencilState = &depthStencilCreateInfo;
-    pipelineCreateInfo.layout = m_PipelineLayout;							// Pipeline Layout pipeline should use
-    pipelineCreateInfo.renderPass = m_RenderPass;							// Render pass description the pipeline is compatible with
-    pipelineCreateInfo.subpass = 0;										// Subpass of render pass to use with pipeline
-
-    // Pipeline Derivatives : Can create multiple pipelines that derive from one another for optimisation
-    pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;	// Existing pipeline to derive from...
-    pipelineCreateInfo.basePipelineIndex = -1;				// or index of pipeline being created to derive from (in case creating multiple at once)
-
-    // Create Graphics Pipeline
-    CHECK_VK(vkCreateGraphicsPipelines(m_DeviceStruct.device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &m_GraphicsPipeline));
+VkPipeline GfxDevice::getPipeline(const PipelineDesc& desc)
+{
+    return m_PipelineCache->getPipeline(desc);
+}
 
-    // Destroy Shader Modules, no longer needed after Pipeline created
-    vkDestroyShaderModule(m_DeviceStruct.device, fragmentShaderModule, nullptr);
-    vkDestroyShaderModule(m_DeviceStruct.device, vertexShaderModule, nullptr);
+PipelineCacheStats GfxDevice::getPipelineStats()
+{
+    return m_PipelineCache->getStats();
 }
 
 std::vector<char> GfxDevice::readFile(const std::string &filename)
@@ -896,7 +1493,7 @@ VkShaderModule GfxDevice::createShaderModule(const std::vector<char>& code)
     return shaderModule;
 }
 
-VkImage GfxDevice::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags, VkMemoryPropertyFlags propFlags, VkDeviceMemory * imageMemory)
+VkImage GfxDevice::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags, VkMemoryPropertyFlags propFlags, VkDeviceMemory * imageMemory, uint32_t mipLevels)
 {
     // CREATE IMAGE
     // Image Creation Info
@@ -906,7 +1503,7 @@ VkImage GfxDevice::createImage(uint32_t width, uint32_t height, VkFormat format,
     imageCreateInfo.extent.width = width;								// Width of image extent
     imageCreateInfo.extent.height = height;								// Height of image extent
     imageCreateInfo.extent.depth = 1;									// Depth of image (just 1, no 3D aspect)
-    imageCreateInfo.mipLevels = 1;										// Number of mipmap levels
+    imageCreateInfo.mipLevels = mipLevels;								// Number of mipmap levels
     imageCreateInfo.arrayLayers = 1;									// Number of levels in image array
     imageCreateInfo.format = format;									// Format type of image
     imageCreateInfo.tiling = tiling;									// How image data should be "tiled" (arranged for optimal reading)
@@ -978,7 +1575,7 @@ void GfxDevice::createCommandBuffers()
 {
     LOGD(m_TAG,__FUNCTION__);
     // Resize command buffer count to have one for each framebuffer
-    m_CommandBuffers.resize(m_SwapchainFramebuffers.size());
+    m_CommandBuffers.resize(m_SwapchainImages.size());
 
     VkCommandBufferAllocateInfo cbAllocInfo = {};
     cbAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -1006,16 +1603,18 @@ void GfxDevice::createTextureSampler()
     samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;		// Mipmap interpolation mode
     samplerCreateInfo.mipLodBias = 0.0f;								// Level of Details bias for mip level
     samplerCreateInfo.minLod = 0.0f;									// Minimum Level of Detail to pick mip level
-    samplerCreateInfo.maxLod = 0.0f;									// Maximum Level of Detail to pick mip level
+    samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;						// Maximum Level of Detail to pick mip level, all a texture has
     samplerCreateInfo.anisotropyEnable = VK_TRUE;						// Enable Anisotropy
-    samplerCreateInfo.maxAnisotropy = 16;								// Anisotropy sample level
+    samplerCreateInfo.maxAnisotropy = 16;								// Anisotropy sample level, clamped to the device limit by the cache
 
-    CHECK_VK(vkCreateSampler(m_DeviceStruct.device, &samplerCreateInfo, nullptr, &m_TextureSampler));
+    // Owned by the sampler cache, shared with any other texture asking for the same state
+    m_TextureSampler = getSampler(samplerCreateInfo);
 }
 
 void GfxDevice::createUniformBuffers()
 {
     LOGD(m_TAG,__FUNCTION__);
+    PROFILE_FUNCTION();
     // ViewProjection buffer size
     VkDeviceSize vpBufferSize = sizeof(UboViewProjection);
 
@@ -1042,76 +1641,30 @@ void GfxDevice::createUniformBuffers()
 void GfxDevice::createDescriptorSets()
 {
     LOGD(m_TAG,__FUNCTION__);
+    PROFILE_FUNCTION();
     // Resize Descriptor Set list so one for every buffer
     m_DescriptorSets.resize(m_SwapchainImages.size());
 
-    std::vector<VkDescriptorSetLayout> setLayouts(m_SwapchainImages.size(), m_DescriptorSetLayout);
-
-    // Descriptor Set Allocation Info
-    VkDescriptorSetAllocateInfo setAllocInfo = {};
-    setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    setAllocInfo.descriptorPool = m_DescriptorPool;									// Pool to allocate Descriptor Set from
-    setAllocInfo.descriptorSetCount = static_cast<uint32_t>(m_SwapchainImages.size());// Number of sets to allocate
-    setAllocInfo.pSetLayouts = setLayouts.data();									// Layouts to use to allocate sets (1:1 relationship)
-
-    // Allocate descriptor sets (multiple)
-    VkResult result = vkAllocateDescriptorSets(m_DeviceStruct.device, &setAllocInfo, m_DescriptorSets.data());
-    if (result != VK_SUCCESS)
-    {
-        throw std::runtime_error("Failed to allocate Descriptor Sets!");
-    }
-
-    // Update all of descriptor set buffer bindings
     for (size_t i = 0; i < m_SwapchainImages.size(); i++)
     {
         // VIEW PROJECTION DESCRIPTOR
-        // Buffer info and data offset info
-        VkDescriptorBufferInfo vpBufferInfo = {};
-        vpBufferInfo.buffer = vpUniformBuffer[i];		// Buffer to get data from
-        vpBufferInfo.offset = 0;						// Position of start of data
-        vpBufferInfo.range = sizeof(UboViewProjection);				// Size of data
-
-        // Data about connection between binding and buffer
-        VkWriteDescriptorSet vpSetWrite = {};
-        vpSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        vpSetWrite.dstSet = m_DescriptorSets[i];								// Descriptor Set to update
-        vpSetWrite.dstBinding = 0;											// Binding to update (matches with binding on layout/shader)
-        vpSetWrite.dstArrayElement = 0;									// Index in array to update
-        vpSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;		// Type of descriptor
-        vpSetWrite.descriptorCount = 1;									// Amount to update
-        vpSetWrite.pBufferInfo = &vpBufferInfo;							// Information about buffer data to bind
-
-        // MODEL DESCRIPTOR
-        // Model Buffer Binding Info
-        /*VkDescriptorBufferInfo modelBufferInfo = {};
-        modelBufferInfo.buffer = modelDUniformBuffer[i];
-        modelBufferInfo.offset = 0;
-        modelBufferInfo.range = modelUniformAlignment;
-
-        VkWriteDescriptorSet modelSetWrite = {};
-        modelSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        modelSetWrite.dstSet = descriptorSets[i];
-        modelSetWrite.dstBinding = 1;
-        modelSetWrite.dstArrayElement = 0;
-        modelSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-        modelSetWrite.descriptorCount = 1;
-        modelSetWrite.pBufferInfo = &modelBufferInfo;*/
-
-        // List of Descriptor Set Writes
-        std::vector<VkWriteDescriptorSet> setWrites = { vpSetWrite };
-
-        // Update the descriptor sets with new buffer/binding info
-        vkUpdateDescriptorSets(m_DeviceStruct.device, static_cast<uint32_t>(setWrites.size()), setWrites.data(),
-                               0, nullptr);
+        // Never changes for a given buffer, so the set comes from the cache
+        DescriptorSetBuilder builder;
+        builder.bindBuffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, vpUniformBuffer[i], 0, sizeof(UboViewProjection));
+        m_DescriptorSets[i] = getDescriptorSet(m_DescriptorSetLayout, builder);
     }
 }
 
 void GfxDevice::updateUniformBuffers(uint32_t imageIndex)
 {
+    PROFILE_FUNCTION();
     // Copy VP data
     void * data;
+    // The swap chain is in the display's native orientation, rotate clip space to match (pre-rotation)
+    UboViewProjection viewProjection = uboViewProjection;
+    viewProjection.projection = m_PreRotation * uboViewProjection.projection;
     vkMapMemory(m_DeviceStruct.device, vpUniformBufferMemory[imageIndex], 0, sizeof(UboViewProjection), 0, &data);
-    memcpy(data, &uboViewProjection, sizeof(UboViewProjection));
+    memcpy(data, &viewProjection, sizeof(UboViewProjection));
     vkUnmapMemory(m_DeviceStruct.device, vpUniformBufferMemory[imageIndex]);
 
     // Copy Model data
@@ -1127,27 +1680,344 @@ void GfxDevice::updateUniformBuffers(uint32_t imageIndex)
     vkUnmapMemory(mainDevice.logicalDevice, modelDUniformBufferMemory[imageIndex]);*/
 }
 
-void GfxDevice::recordCommands(uint32_t currentImage)
+void GfxDevice::setFrameState(const FrameState& state)
 {
-    // Information about how to begin each command buffer
-    VkCommandBufferBeginInfo bufferBeginInfo = {};
-    bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    uboViewProjection.view = state.view;
+    uboViewProjection.projection = state.projection;
+    const size_t count = std::min(state.transforms.size(), meshList.size());
+    for (size_t i = 0; i < count; i++)
+    {
+        meshList[i].setModel(state.transforms[i]);
+    }
+}
+
+void GfxDevice::selectMeshLods()
+{
+    // Pick per mesh detail level from the projected screen size with the current camera
+    for (auto& mesh : meshList)
+    {
+        mesh.selectLod(uboViewProjection.projection, uboViewProjection.view,
+                       static_cast<float>(m_DisplaySize.height), m_LodSettings);
+        if (mesh.getStreamedTexture() >= 0)
+        {
+            m_TextureStreamer->reportUsage(static_cast<uint32_t>(mesh.getStreamedTexture()),
+                                           mesh.getProjectedSize(uboViewProjection.projection, uboViewProjection.view,
+                                                                 static_cast<float>(m_DisplaySize.height)));
+        }
+    }
+    for (ClusterMesh& mesh : m_ClusterMeshes)
+    {
+        float scale;
+        const float distance = LodSelector::viewDistance(mesh.boundingCenter, mesh.boundingRadius, mesh.model,
+                                                         uboViewProjection.view, scale);
+        mesh.currentLod = LodSelector::select(mesh.lods, mesh.currentLod, distance, scale,
+                                              uboViewProjection.projection[1][1],
+                                              static_cast<float>(m_DisplaySize.height), m_LodSettings);
+        if (mesh.streamedTexture >= 0)
+        {
+            // Whole mesh, the texture is assumed to be mapped once across it like for meshList
+            m_TextureStreamer->reportUsage(static_cast<uint32_t>(mesh.streamedTexture),
+                                           LodSelector::projectedError(2.0f * mesh.boundingRadius * scale, distance,
+                                                                       uboViewProjection.projection[1][1],
+                                                                       static_cast<float>(m_DisplaySize.height)));
+        }
+    }
+}
+
+void GfxDevice::updateStreamedTextures(VkCommandBuffer commandBuffer)
+{
+    PROFILE_FUNCTION();
+    // Uploads and evictions replace images, the draws recorded after this use the new ids
+    m_TextureStreamer->update(commandBuffer);
+    for (auto& mesh : meshList)
+    {
+        if (mesh.getStreamedTexture() >= 0)
+        {
+            mesh.setTexId(static_cast<int>(m_TextureStreamer->getTextureId(static_cast<uint32_t>(mesh.getStreamedTexture()))));
+        }
+    }
+    for (auto& mesh : m_ClusterMeshes)
+    {
+        if (mesh.streamedTexture >= 0)
+        {
+            mesh.textureId = m_TextureStreamer->getTextureId(static_cast<uint32_t>(mesh.streamedTexture));
+        }
+    }
+}
+
+void GfxDevice::createTextureStreamer()
+{
+    LOGD(m_TAG,__FUNCTION__);
+    m_TextureStreamer = std::make_unique<TextureStreamer>(m_thisPtr, *m_JobSystem, m_TextureStreamingConfig);
+}
+
+const TextureStreamingStats& GfxDevice::getTextureStreamingStats() const
+{
+    return m_TextureStreamer->getStats();
+}
+
+void GfxDevice::draw()
+{
+    if (m_Headless)
+    {
+        drawOffscreen();
+        return;
+    }
+    // Zones of the previous frame, and of init on the first one
+    PROFILE_FRAME(m_Trace);
+    {
+        // Sleeps to the frame's planned start, before anything of the frame is sampled or recorded
+        PROFILE_ZONE("pace");
+        m_FramePacer->waitForNextFrame();
+    }
+    PROFILE_ZONE("frame");
+
+    uint32_t imageIndex = 0;
+    VkResult result;
+    const uint64_t waitStartNs = m_Clock.nowNs();
+    {
+        PROFILE_ZONE("acquire");
+        // Semaphores and fence of this frame slot are free once its previous submission finished
+        vkWaitForFences(m_DeviceStruct.device, 1, &m_DrawFences[currentFrame], VK_TRUE, UINT64_MAX);
+        // So are the objects freed while the slot was last recorded, and everything freed before
+        m_DeletionQueue->beginFrame(static_cast<uint32_t>(currentFrame));
+        result = vkAcquireNextImageKHR(m_DeviceStruct.device, m_SwapChain, UINT64_MAX,
+                                       m_ImageAvailable[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    }
+    if (result == VK_ERROR_OUT_OF_DATE_KHR)
+    {
+        reCreateSwapchain();
+        return;
+    }
+    // VK_SUBOPTIMAL_KHR still delivers a presentable image, the swap chain is recreated after present
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+    {
+        throw std::runtime_error("Failed to acquire a swap chain image!");
+    }
+
+    // Command buffer, UBO and frame descriptors of the image may still be used by an older frame
+    if (m_ImageFences[imageIndex] != VK_NULL_HANDLE)
+    {
+        vkWaitForFences(m_DeviceStruct.device, 1, &m_ImageFences[imageIndex], VK_TRUE, UINT64_MAX);
+    }
+    m_ImageFences[imageIndex] = m_DrawFences[currentFrame];
+
+    const uint64_t recordStartNs = m_Clock.nowNs();
+    {
+        PROFILE_ZONE("record");
+        updateUniformBuffers(imageIndex);
+        recordCommands(imageIndex);
+    }
+    PROFILE_ZONE("submit");
+    const uint64_t submitStartNs = m_Clock.nowNs();
+
+    VkPipelineStageFlags waitStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = &m_ImageAvailable[currentFrame];
+    submitInfo.pWaitDstStageMask = &waitStages;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &m_CommandBuffers[imageIndex];
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &m_RenderFinished[currentFrame];
+
+    vkResetFences(m_DeviceStruct.device, 1, &m_DrawFences[currentFrame]);
+    CHECK_VK(vkQueueSubmit(m_BufferQueueStruct.graphicsQueue, 1, &submitInfo, m_DrawFences[currentFrame]));
+
+    VkPresentInfoKHR presentInfo = {};
+    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.pWaitSemaphores = &m_RenderFinished[currentFrame];
+    presentInfo.swapchainCount = 1;
+    presentInfo.pSwapchains = &m_SwapChain;
+    presentInfo.pImageIndices = &imageIndex;
+
+    // Schedules the image for the vsync the pacer planned it for
+    PresentTarget target = m_FramePacer->getPresentTarget();
+    VkPresentTimeGOOGLE presentTime = { target.presentId, target.desiredPresentTimeNs };
+    VkPresentTimesInfoGOOGLE presentTimesInfo = {};
+    presentTimesInfo.sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE;
+    presentTimesInfo.swapchainCount = 1;
+    presentTimesInfo.pTimes = &presentTime;
+    if (m_DisplayTimingSupported)
+    {
+        presentInfo.pNext = &presentTimesInfo;
+    }
+    result = vkQueuePresentKHR(m_BufferQueueStruct.graphicsQueue, &presentInfo);
+    m_CpuFrameStats.waitMs = static_cast<double>(recordStartNs - waitStartNs) * 1e-6;
+    m_CpuFrameStats.recordMs = static_cast<double>(submitStartNs - recordStartNs) * 1e-6;
+    m_CpuFrameStats.submitMs = static_cast<double>(m_Clock.nowNs() - submitStartNs) * 1e-6;
+    pollPresentTiming();
+
+    m_LastImage = imageIndex;
+    currentFrame = (currentFrame + 1) % MAX_FRAME_DRAWS;
+
+    // Android reports a rotation the swap chain wasn't created for as suboptimal. Presenting still
+    // works, but the compositor rotates every frame until the pre-transform matches again.
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || (result == VK_SUBOPTIMAL_KHR && surfaceChanged()))
+    {
+        reCreateSwapchain();
+    }
+    else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+    {
+        throw std::runtime_error("Failed to present a swap chain image!");
+    }
+}
 
-    // Information about how to begin a render pass (only needed for graphical applications)
-    VkRenderPassBeginInfo renderPassBeginInfo = {};
-    renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassBeginInfo.renderPass = m_RenderPass;							// Render Pass to begin
-    renderPassBeginInfo.renderArea.offset = { 0, 0 };						// Start point of render pass in pixels
-    renderPassBeginInfo.renderArea.extent = m_SwapchainExtent;				// Size of region to run render pass on (starting at offset)
+void GfxDevice::drawOffscreen()
+{
+    PROFILE_FRAME(m_Trace);
+    PROFILE_ZONE("frame");
 
-    std::array<VkClearValue, 2> clearValues = {};
-    clearValues[0].color = { 0.6f, 0.65f, 0.4f, 1.0f };
-    clearValues[1].depthStencil.depth = 1.0f;
+    // Nothing to pace or acquire, a frame starts as soon as its slot is free
+    const uint64_t waitStartNs = m_Clock.nowNs();
+    {
+        PROFILE_ZONE("wait");
+        vkWaitForFences(m_DeviceStruct.device, 1, &m_DrawFences[currentFrame], VK_TRUE, UINT64_MAX);
+        m_DeletionQueue->beginFrame(static_cast<uint32_t>(currentFrame));
+    }
+    // One image per frame slot, the submission just waited for was its last use
+    const auto imageIndex = static_cast<uint32_t>(currentFrame);
+    m_ImageFences[imageIndex] = m_DrawFences[currentFrame];
 
-    renderPassBeginInfo.pClearValues = clearValues.data();					// List of clear values
-    renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    const uint64_t recordStartNs = m_Clock.nowNs();
+    {
+        PROFILE_ZONE("record");
+        updateUniformBuffers(imageIndex);
+        recordCommands(imageIndex);
+    }
+    PROFILE_ZONE("submit");
+    const uint64_t submitStartNs = m_Clock.nowNs();
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &m_CommandBuffers[imageIndex];
+    vkResetFences(m_DeviceStruct.device, 1, &m_DrawFences[currentFrame]);
+    CHECK_VK(vkQueueSubmit(m_BufferQueueStruct.graphicsQueue, 1, &submitInfo, m_DrawFences[currentFrame]));
+
+    m_CpuFrameStats.waitMs = static_cast<double>(recordStartNs - waitStartNs) * 1e-6;
+    m_CpuFrameStats.recordMs = static_cast<double>(submitStartNs - recordStartNs) * 1e-6;
+    m_CpuFrameStats.submitMs = static_cast<double>(m_Clock.nowNs() - submitStartNs) * 1e-6;
+    m_LastImage = imageIndex;
+    currentFrame = (currentFrame + 1) % MAX_FRAME_DRAWS;
+}
 
-    renderPassBeginInfo.framebuffer = m_SwapchainFramebuffers[currentImage];
+std::vector<uint8_t> GfxDevice::readbackFrame()
+{
+    PROFILE_FUNCTION();
+    if (!m_Headless)
+    {
+        throw std::runtime_error("readbackFrame needs a headless device");
+    }
+    GfxBufferDesc desc;
+    desc.name = "readback";
+    desc.size = VkDeviceSize(m_SwapchainExtent.width) * m_SwapchainExtent.height * 4;
+    desc.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    desc.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    auto buffer = createBuffer(desc);
+
+    submitAndWait([&](VkCommandBuffer commandBuffer) {
+        // The frame was submitted earlier on the same queue, wait for its writes and the layout
+        // transition of its render pass
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             1, &barrier, 0, nullptr, 0, nullptr);
+
+        VkBufferImageCopy region = {};
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.imageExtent = { m_SwapchainExtent.width, m_SwapchainExtent.height, 1 };
+        vkCmdCopyImageToBuffer(commandBuffer, m_SwapchainImages[m_LastImage].image,
+                               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer->getBuffer(), 1, &region);
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                             1, &barrier, 0, nullptr, 0, nullptr);
+    });
+    const auto* texels = static_cast<const uint8_t*>(buffer->getMapped());
+    return std::vector<uint8_t>(texels, texels + desc.size);
+}
+
+void GfxDevice::submitAndWait(const std::function<void(VkCommandBuffer)>& record)
+{
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = m_GraphicsCommandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    CHECK_VK(vkAllocateCommandBuffers(m_DeviceStruct.device, &allocInfo, &commandBuffer));
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    CHECK_VK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+    record(commandBuffer);
+    CHECK_VK(vkEndCommandBuffer(commandBuffer));
+
+    // Waiting keeps the command buffer's lifetime simple
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    CHECK_VK(vkQueueSubmit(m_BufferQueueStruct.graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE));
+    CHECK_VK(vkQueueWaitIdle(m_BufferQueueStruct.graphicsQueue));
+    vkFreeCommandBuffers(m_DeviceStruct.device, m_GraphicsCommandPool, 1, &commandBuffer);
+}
+
+void GfxDevice::pollPresentTiming()
+{
+    PROFILE_FUNCTION();
+    if (!m_DisplayTimingSupported)
+    {
+        return;
+    }
+    // Timestamps are CLOCK_MONOTONIC, the time base of the pacer's SteadyClock
+    uint32_t count = 0;
+    if (m_vkGetPastPresentationTiming(m_DeviceStruct.device, m_SwapChain, &count, nullptr) != VK_SUCCESS || count == 0)
+    {
+        return;
+    }
+    std::vector<VkPastPresentationTimingGOOGLE> timings(count);
+    if (m_vkGetPastPresentationTiming(m_DeviceStruct.device, m_SwapChain, &count, timings.data()) != VK_SUCCESS)
+    {
+        return;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        PresentTiming timing;
+        timing.presentId = timings[i].presentID;
+        timing.desiredPresentTimeNs = timings[i].desiredPresentTime;
+        timing.actualPresentTimeNs = timings[i].actualPresentTime;
+        timing.earliestPresentTimeNs = timings[i].earliestPresentTime;
+        timing.presentMarginNs = timings[i].presentMargin;
+        m_FramePacer->onPresentTiming(timing);
+    }
+}
+
+void GfxDevice::recordCommands(uint32_t currentImage)
+{
+    PROFILE_FUNCTION();
+    selectMeshLods();
+
+    // The previous use of this image has been waited for, everything allocated for it can go
+    m_RecordingImage = currentImage;
+    m_FrameDescriptors[currentImage]->reset();
+    // Secondary command buffers go by frame slot, whose fence was waited for along with the image's
+    m_ParallelRecorder->beginFrame(static_cast<uint32_t>(currentFrame));
+    if (m_BindlessTextures)
+    {
+        m_BindlessTextures->nextFrame();
+    }
+
+    // Information about how to begin each command buffer
+    VkCommandBufferBeginInfo bufferBeginInfo = {};
+    bufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
     // Start recording commands to command buffer!
     VkResult result = vkBeginCommandBuffer(m_CommandBuffers[currentImage], &bufferBeginInfo);
@@ -1155,47 +2025,164 @@ void GfxDevice::recordCommands(uint32_t currentImage)
     {
         throw std::runtime_error("Failed to start recording a Command Buffer!");
     }
-    // Begin Render Pass
-    vkCmdBeginRenderPass(m_CommandBuffers[currentImage], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    // Reads back the timestamps this command buffer recorded last time, its fence was waited on
+    if (m_GpuProfiler)
+    {
+        m_GpuProfiler->beginFrame(m_CommandBuffers[currentImage], currentImage);
+    }
+    // Without inheritedQueries secondary command buffers can't run inside the frame's statistics
+    // query, the main pass is recorded inline then
+    const bool statisticsActive = m_GpuProfiler && m_GpuProfiler->getActiveStatistics() != 0;
+    setSecondaryRecording(m_RecordThreads > 1 && (m_InheritedQueriesSupported || !statisticsActive));
+    updateStreamedTextures(m_CommandBuffers[currentImage]);
+
+    // Barriers, render passes and the pass callbacks (recordMainPass)
+    m_RenderGraph->setImportedImage(m_BackbufferTexture, m_SwapchainImages[currentImage].image,
+                                    m_SwapchainImages[currentImage].imageView);
+    m_RenderGraph->execute(m_CommandBuffers[currentImage]);
+    if (m_GpuProfiler)
+    {
+        m_GpuProfiler->endFrame(m_CommandBuffers[currentImage]);
+    }
 
+    // Stop recording to command buffer
+    CHECK_VK(vkEndCommandBuffer(m_CommandBuffers[currentImage]));
+}
+
+void GfxDevice::recordMainPass(VkCommandBuffer commandBuffer)
+{
+    PROFILE_FUNCTION();
+    // Only what recordDrawRange records: meshList draws are still disabled there, counting them
+    // would hand the parallel recorder empty ranges
+    const uint32_t drawCount = m_BenchmarkDraws > 0 ? m_BenchmarkDraws
+                                                    : static_cast<uint32_t>(m_ClusterMeshes.size());
+    if (!m_SecondaryRecording)
+    {
+        recordDrawRange(commandBuffer, 0, drawCount);
+        return;
+    }
+    // The subpass was begun for secondary command buffers, this only executes them
+    VkCommandBufferInheritanceInfo inheritance = m_RenderGraph->getInheritanceInfo(m_MainPass);
+    inheritance.pipelineStatistics = m_InheritedQueriesSupported && m_GpuProfiler ? m_GpuProfiler->getActiveStatistics() : 0;
+    m_ParallelRecorder->record(commandBuffer, inheritance, drawCount,
+                               [this](VkCommandBuffer secondary, uint32_t firstDraw, uint32_t rangeCount)
+                               {
+                                   recordDrawRange(secondary, firstDraw, rangeCount);
+                               });
+}
+
+void GfxDevice::recordDrawRange(VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t drawCount)
+{
+    // Nothing carries over between secondary command buffers, every range binds its own state.
+    // Runs on several threads at once: only read device state here.
     // Bind Pipeline to be used in render pass
-    vkCmdBindPipeline(m_CommandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS,m_GraphicsPipeline);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline);
 
-    /* TODO
-    for (size_t j = 0; j < meshList.size(); j++)
+    // Viewport and scissor are dynamic state in every cached pipeline
+    VkViewport viewport = { 0.0f, 0.0f, (float)m_SwapchainExtent.width, (float)m_SwapchainExtent.height, 0.0f, 1.0f };
+    VkRect2D scissor = { { 0, 0 }, m_SwapchainExtent };
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    if (m_BenchmarkDraws > 0)
+    {
+        // benchmarkRecording: what a mesh costs to record minus its buffers, never submitted
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_BenchmarkVertexBuffer, &offset);
+        const uint32_t textureId = m_DefaultTexture->getTextureId();
+        bindDrawSets(commandBuffer, textureId);
+        Model model = {};
+        for (uint32_t j = firstDraw; j < firstDraw + drawCount; j++)
+        {
+            model.model = glm::translate(glm::mat4(1.0f), glm::vec3(static_cast<float>(j % 64), static_cast<float>(j / 64 % 64), 0.0f));
+            pushDrawConstants(commandBuffer, model, textureId);
+            vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+        }
+        return;
+    }
+
+    // Cluster meshes come first, the cluster cull pass wrote their draws for this frame slot
+    const uint32_t clusterEnd = std::min(firstDraw + drawCount, static_cast<uint32_t>(m_ClusterMeshes.size()));
+    for (uint32_t j = firstDraw; j < clusterEnd; j++)
+    {
+        const ClusterMesh& mesh = m_ClusterMeshes[j];
+        bindDrawSets(commandBuffer, mesh.textureId);
+        VkBuffer vertexBuffer = mesh.vertices->getBuffer();
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+        vkCmdBindIndexBuffer(commandBuffer, mesh.indices->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+        pushDrawConstants(commandBuffer, Model{ mesh.model }, mesh.textureId);
+        const uint32_t lod = mesh.culledLods[currentFrame];
+        m_ClusterCullPass->drawIndirect(commandBuffer, mesh.draws[currentFrame]->getBuffer(),
+                                        mesh.lodMeshlets[lod + 1] - mesh.lodMeshlets[lod]);
+    }
+
+    /* TODO meshList follows the cluster meshes, draw j is meshList[j - m_ClusterMeshes.size()]
+    for (uint32_t j = firstDraw; j < firstDraw + drawCount; j++)
     {
         VkBuffer vertexBuffers[] = { meshList[j].getVertexBuffer() };					// Buffers to bind
         VkDeviceSize offsets[] = { 0 };												// Offsets into buffers being bound
-        vkCmdBindVertexBuffers(m_CommandBuffers[currentImage], 0, 1, vertexBuffers, offsets);	// Command to bind vertex buffer before drawing with them
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);	// Command to bind vertex buffer before drawing with them
 
         // Bind mesh index buffer, with 0 offset and using the uint32 type
-        vkCmdBindIndexBuffer(m_CommandBuffers[currentImage], meshList[j].getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+        vkCmdBindIndexBuffer(commandBuffer, meshList[j].getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
 
         // Dynamic Offset Amount
         // uint32_t dynamicOffset = static_cast<uint32_t>(modelUniformAlignment) * j;
         // "Push" constants to given shader stage directly (no buffer)
         vkCmdPushConstants(
-                m_CommandBuffers[currentImage],
+                commandBuffer,
                 m_PipelineLayout,
                 VK_SHADER_STAGE_VERTEX_BIT,		// Stage to push constants to
                 0,								// Offset of push constants to update
                 sizeof(Model),					// Size of data being pushed
                 meshList[j].getModel());		// Actual data being pushed (can be array)
 
-        std::array<VkDescriptorSet, 2> descriptorSetGroup = { m_DescriptorSets[currentImage],
-                                                              m_SamplerDescriptorSets[meshList[j].getTexId()] };
-        // Bind Descriptor Sets
-        vkCmdBindDescriptorSets(m_CommandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout,
-                                0, static_cast<uint32_t>(descriptorSetGroup.size()), descriptorSetGroup.data(), 0, nullptr);
+        if (m_BindlessTextures)
+        {
+            // Texture table is bound once per range, each draw only pushes its texture slot
+            if (j == firstDraw)
+            {
+                std::array<VkDescriptorSet, 2> descriptorSetGroup = { m_DescriptorSets[m_RecordingImage], m_BindlessTextures->getSet() };
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout,
+                                        0, static_cast<uint32_t>(descriptorSetGroup.size()), descriptorSetGroup.data(), 0, nullptr);
+            }
+            uint32_t materialIndex = meshList[j].getTexId();
+            vkCmdPushConstants(commandBuffer, m_PipelineLayout, m_pushConstantRange.stageFlags,
+                               sizeof(Model), sizeof(uint32_t), &materialIndex);
+        }
+        else
+        {
+            std::array<VkDescriptorSet, 2> descriptorSetGroup = { m_DescriptorSets[m_RecordingImage],
+                                                                  m_SamplerDescriptorSets[meshList[j].getTexId()] };
+            // Bind Descriptor Sets
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout,
+                                    0, static_cast<uint32_t>(descriptorSetGroup.size()), descriptorSetGroup.data(), 0, nullptr);
+        }
         // Execute pipeline
-        vkCmdDrawIndexed(m_CommandBuffers[currentImage], meshList[j].getIndexCount(), 1, 0, 0, 0);
+        vkCmdDrawIndexed(commandBuffer, meshList[j].getIndexCount(), 1, meshList[j].getFirstIndex(), 0, 0);
     }
      */
-    // End Render Pass
-    vkCmdEndRenderPass(m_CommandBuffers[currentImage]);
+}
 
-    // Stop recording to command buffer
-    CHECK_VK(vkEndCommandBuffer(m_CommandBuffers[currentImage]));
+void GfxDevice::bindDrawSets(VkCommandBuffer commandBuffer, uint32_t textureId)
+{
+    std::array<VkDescriptorSet, 2> descriptorSetGroup = { m_DescriptorSets[m_RecordingImage],
+                                                          m_BindlessTextures ? m_BindlessTextures->getSet()
+                                                                             : m_SamplerDescriptorSets[textureId] };
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout,
+                            0, static_cast<uint32_t>(descriptorSetGroup.size()), descriptorSetGroup.data(), 0, nullptr);
+}
+
+void GfxDevice::pushDrawConstants(VkCommandBuffer commandBuffer, const Model& model, uint32_t textureId)
+{
+    vkCmdPushConstants(commandBuffer, m_PipelineLayout, m_pushConstantRange.stageFlags, 0, sizeof(Model), &model);
+    if (m_BindlessTextures)
+    {
+        // The texture slot follows the Model in the same range
+        vkCmdPushConstants(commandBuffer, m_PipelineLayout, m_pushConstantRange.stageFlags,
+                           sizeof(Model), sizeof(uint32_t), &textureId);
+    }
 }
 
 void GfxDevice::createBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsage,
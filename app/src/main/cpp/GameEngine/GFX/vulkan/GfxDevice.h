@@ -1,11 +1,13 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <unordered_map>
 #include <map>
 #include <vector>
 #include <mutex>
+#include <memory>
 
 #include "glm/glm.hpp"
 #include <vulkan/vulkan.h>
@@ -13,11 +15,38 @@
 #include "../IGfxDevice.h"
 #include "GfxTypes.h"
 #include "../../Utils/ThreadSafeHandle.h"
+#include "../../Utils/Clock.h"
+#include "../../Utils/ChromeTrace.h"
+#include "../../Utils/Benchmark.h"
+#include "FramePacer.h"
 #include "GfxTexture.h"
 #include "GfxBuffer.h"
+#include "TextureResidency.h"
 
 #include "../../EntityComponent/Mesh.h"
-//class TextureSampler;
+#include "../../EntityComponent/LodSelector.h"
+class TextureSampler;
+class SamplerCache;
+class ClusterCullPass;
+class ShaderModuleCache;
+class PipelineCache;
+class JobSystem;
+class DescriptorAllocator;
+class DescriptorSetCache;
+class DescriptorSetBuilder;
+class BindlessTextureTable;
+class RenderGraph;
+class GpuProfiler;
+class TextureStreamer;
+class DeletionQueue;
+class ParallelRecorder;
+struct GpuFrameStats;
+struct ParallelRecordingStats;
+struct Ktx2Image;
+struct PipelineDesc;
+struct PipelineCacheStats;
+struct ShaderModule;
+struct ProgramLayout;
 
 struct DeviceConfig {
     VkInstance instance{VK_NULL_HANDLE};
@@ -27,7 +56,35 @@ struct DeviceConfig {
     uint32_t graphicsQueueFamilyIndex{};
     uint32_t transferQueueFamilyIndex{};
     std::string applicationName{};
+    // Picks the first physical device whose name contains this, e.g. "llvmpipe". The first one
+    // when empty or none matches.
+    std::string physicalDeviceName{};
     bool debugLayer{false};
+    // Renders into offscreen images of headlessExtent instead of a swap chain: no window, surface
+    // or swap chain extension, draw() neither paces nor presents. The only mode of builds without
+    // a window system (GFX/NativeWindow.h).
+    bool headless{false};
+    VkExtent2D headlessExtent{1280, 720};
+    VkFormat headlessFormat{VK_FORMAT_R8G8B8A8_SRGB};
+    // Resolved inside the render pass, falls back to 1 when the device doesn't support the count
+    VkSampleCountFlagBits msaaSamples{VK_SAMPLE_COUNT_1_BIT};
+    // Present mode, swap chain depth and target frame interval
+    FramePacerConfig framePacing{};
+    // GPU timestamps per render graph pass, read back a swap chain length later
+    bool gpuProfiling{true};
+    // Vertex / primitive / fragment invocation counts per frame, needs pipelineStatisticsQuery
+    bool pipelineStatistics{false};
+    // Memory budget and pacing of streamed textures
+    TextureStreamingConfig textureStreaming{};
+    // Threads recording the main pass, see GfxDevice::setRecordThreads. 0 for every core.
+    uint32_t recordThreads{0};
+};
+
+// CPU side of the last draw(), in milliseconds
+struct CpuFrameStats {
+    double waitMs{0.0};     // for the frame slot's fence and, with a swap chain, the acquire
+    double recordMs{0.0};   // uniforms, LOD selection, streaming and command buffer recording
+    double submitMs{0.0};   // vkQueueSubmit, and vkQueuePresentKHR with a swap chain
 };
 
 struct DeviceStruct{
@@ -65,26 +122,139 @@ class GfxDevice : public IGfxDevice
 public:
     GfxDevice()= delete;
     GfxDevice(const DeviceConfig& config);
-    ~GfxDevice(){}
+    ~GfxDevice();
     VkPhysicalDevice getPhysicalDevice(VkInstance instance);
 
     const VkDevice getDevice()const { return m_DeviceStruct.device; }
+    const VkPhysicalDevice getVkPhysicalDevice()const { return m_DeviceStruct.physicalDevice; }
+    bool isMultiDrawIndirectSupported() const { return m_MultiDrawIndirectSupported; }
+    bool isDescriptorIndexingSupported() const { return m_DescriptorIndexingSupported; }
+    bool isSamplerMinMaxSupported() const { return m_SamplerMinMaxSupported; }
+    bool isSamplerAnisotropySupported() const { return m_SamplerAnisotropySupported; }
+    bool isPipelineStatisticsSupported() const { return m_PipelineStatisticsSupported; }
     bool threadAssigned() { return true; }
 
-    bool isInitialized() override {return false; }
+    bool isInitialized() override { return m_SwapChain != VK_NULL_HANDLE || !m_OffscreenImages.empty(); }
+    bool isHeadless() const { return m_Headless; }
 
-    void createSurface(ANativeWindow* window) override;
+    void createSurface(NativeWindow* window) override;
 
+    // Keeps render graph images and pipelines when the identity size didn't change (rotation)
     void reCreateSwapchain() override;
 
+    // Acquire, record, submit and present one frame
+    void draw() override;
+    void setFrameState(const FrameState& state) override;
+
+    // Size in the current orientation, what the projection aspect ratio has to follow. The swap
+    // chain itself stays in the display's native orientation (m_SwapchainExtent).
+    VkExtent2D getDisplaySize() const { return m_DisplaySize; }
+    const FramePacerStats& getFramePacerStats() const { return m_FramePacer->getStats(); }
+    // Latest complete GPU frame, empty when profiling is off or unsupported
+    const GpuFrameStats& getGpuFrameStats() const;
+    // CPU zones of the frame loop and GPU zones, start() / stop() / write() a capture
+    ChromeTrace& getTrace() { return m_Trace; }
+    const CpuFrameStats& getCpuFrameStats() const { return m_CpuFrameStats; }
+
+    // Threads recording the main pass's draws, the render thread included. With more than one the
+    // draws are split into ranges recorded into secondary command buffers on the job system, 1
+    // records them inline into the primary. Clamped to the job system's workers + 1. With
+    // DeviceConfig::pipelineStatistics on a device without inheritedQueries frames record inline too.
+    void setRecordThreads(uint32_t threadCount);
+    uint32_t getRecordThreads() const { return m_RecordThreads; }
+    uint32_t getMaxRecordThreads() const;
+    const ParallelRecordingStats& getRecordingStats() const;
+    // Recording cost of drawCount draws in the main pass per thread count: each iteration records
+    // the frame's render graph into a spare primary command buffer that is never submitted. The
+    // draws are stand-ins (a model push constant and a triangle each) as long as meshList has
+    // none. Waits for the device to go idle first.
+    std::vector<BenchmarkResult> benchmarkRecording(uint32_t drawCount, const std::vector<uint32_t>& threadCounts,
+                                                    uint32_t iterations);
+
+    // Meshes drawn through GPU cluster culling: the "cluster cull" compute pass culls their meshlets
+    // against the frame's camera (ClusterCullPass) and the main pass draws what survived with
+    // indirect draws, ahead of meshList. With maxLodCount > 1 a LOD chain is simplified
+    // (MeshSimplifier) and split into meshlets level by level, each frame culls and draws the level
+    // picked from the mesh's screen size like for meshList. indices are reordered into meshlets.
+    // On the render thread between frames, returns the mesh's index.
+    uint32_t addClusterMesh(const std::vector<Vertex>& vertices, std::vector<uint32_t> indices, const glm::mat4& model,
+                            uint32_t maxLodCount = 1);
+    // The meshlets of the level the last draw() culled, in the order of readClusterDraws
+    std::vector<Meshlet> getClusterMeshlets(uint32_t mesh) const;
+    // The mesh's index buffer as reordered into meshlets, all levels
+    std::vector<uint32_t> getClusterIndices(uint32_t mesh) const;
+    // Draws the mesh with a streamed texture (TextureStreamer handle) instead of the default one,
+    // the mesh's screen size is reported to the streamer every frame
+    void setClusterStreamedTexture(uint32_t mesh, uint32_t handle);
+    // The indirect draws the last draw() culled the mesh to, one per meshlet of getClusterMeshlets
+    // with instanceCount 0 when culled. Waits for the frame to finish.
+    std::vector<DrawIndexedCommand> readClusterDraws(uint32_t mesh);
+
+    // Headless only: waits for the last frame drawn and copies its image out, rows of
+    // headlessExtent.width texels of 4 bytes in headlessFormat's order, tightly packed
+    std::vector<uint8_t> readbackFrame();
+
     void init() override;
 
     void deInit() override;
 
+    static std::vector<char> readFile(const std::string &filename);
+
+    // Material variants: start from the default and change PipelineDesc::state. getPipeline never
+    // blocks, it returns the default pipeline until the variant finished compiling on a worker.
+    PipelineDesc getDefaultPipelineDesc() const;
+    VkPipeline getPipeline(const PipelineDesc& desc);
+    PipelineCacheStats getPipelineStats();
+
+    // Shared, deduplicated samplers owned by the device, never destroy them
+    VkSampler getSampler(GfxSamplerType type);
+    VkSampler getSampler(const VkSamplerCreateInfo& createInfo);
+    const TextureSampler& getTextureSampler(GfxSamplerType type) const;
+
+    // Returns the id to store in Mesh::texId. A bindless slot with descriptor indexing, otherwise an
+    // index into the per texture descriptor sets
+    uint32_t addTexture(VkImageView imageView);
+    void removeTexture(uint32_t textureId);
+
+    // Textures from KTX2 files (Utils/Ktx2.h, cooked by tools/texture_cooker), the mip chain is
+    // uploaded as stored, compressed formats stay compressed. Loaded once per name, null when the
+    // device can't sample the format (ASTC and ETC2 are both optional in Vulkan).
+    std::shared_ptr<GfxTexture> loadTexture(const std::string& filename);
+    std::shared_ptr<GfxTexture> createTexture(const std::string& name, const Ktx2Image& image);
+    // The same without keeping the texture by name, the caller owns it
+    std::shared_ptr<GfxTexture> uploadTexture(const std::string& name, const Ktx2Image& image);
+    // Empty resources, views and contents are up to the caller
+    std::shared_ptr<GfxTexture> createTexture(const GfxTextureDesc& desc);
+    std::shared_ptr<GfxBuffer> createBuffer(const GfxBufferDesc& desc);
+    bool isTextureFormatSupported(VkFormat format) const;
+
+    // Streamed textures: the low mips are resident at once, finer ones load as draws need them,
+    // within DeviceConfig::textureStreaming.budgetBytes. Meshes with a streamed texture report
+    // their screen size every frame and have their texId updated.
+    TextureStreamer& getTextureStreamer() { return *m_TextureStreamer; }
+    const TextureStreamingStats& getTextureStreamingStats() const;
+
+    // Objects submitted frames may still use are destroyed through this, from any thread. GfxTexture
+    // and GfxBuffer do so on their own.
+    const std::shared_ptr<DeletionQueue>& getDeletionQueue() const { return m_DeletionQueue; }
+
+    // Cached for the lifetime of the referenced resources, no driver call after the first request
+    VkDescriptorSet getDescriptorSet(VkDescriptorSetLayout layout, const DescriptorSetBuilder& builder);
+    // Valid for the command buffer being recorded only
+    VkDescriptorSet allocateFrameDescriptorSet(VkDescriptorSetLayout layout, const DescriptorSetBuilder& builder);
+
+    static uint32_t findMemoryTypeIndex(VkPhysicalDevice physicalDevice, uint32_t allowedTypes, VkMemoryPropertyFlags properties);
+    VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels = 1);
+    VkImage createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags,
+                        VkMemoryPropertyFlags propFlags, VkDeviceMemory * imageMemory, uint32_t mipLevels = 1);
+    static void createBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsage,
+                                 VkMemoryPropertyFlags bufferProperties, VkBuffer * buffer, VkDeviceMemory * bufferMemory);
 
 private:
     void createSamplers();
     void createSwapChain();
+    // Headless stand-in for the swap chain, one image per frame in flight
+    void createOffscreenImages();
     void createRenderPass();
     void createFrameBuffers();
     void createDescriptorSetLayout();
@@ -96,24 +266,59 @@ private:
     void createUniformBuffers();
     void createDescriptorPool();
     void createDescriptorSets();
+    void createClusterCulling();
+    void createSynchronisation();
+    void createProfiler();
+    void createTextureStreamer();
+    void destroySwapchainImageViews();
+    // Created on first use
+    const std::shared_ptr<GfxTexture>& getDefaultTexture();
+    bool surfaceChanged();
+    static glm::mat4 getPreRotation(VkSurfaceTransformFlagBitsKHR transform);
 
     void updateUniformBuffers(uint32_t imageIndex);
+    void selectMeshLods();
+    void updateStreamedTextures(VkCommandBuffer commandBuffer);
     void recordCommands(uint32_t currentImage);
+    void drawOffscreen();
+    // Records into a one time command buffer, submits it and waits for the queue. Load time and
+    // tools only.
+    void submitAndWait(const std::function<void(VkCommandBuffer)>& record);
+    void pollPresentTiming();
+    void recordClusterCull(VkCommandBuffer commandBuffer);
+    void recordMainPass(VkCommandBuffer commandBuffer);
+    // Whether the main pass is recorded into secondary command buffers, its subpass is begun to match
+    void setSecondaryRecording(bool secondary);
+    // Draws [firstDraw, firstDraw + drawCount) of the main pass with every state they need, into
+    // the primary or a secondary command buffer
+    void recordDrawRange(VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t drawCount);
+    // Sets 0 and 1, and the push constants, of a draw sampling textureId
+    void bindDrawSets(VkCommandBuffer commandBuffer, uint32_t textureId);
+    void pushDrawConstants(VkCommandBuffer commandBuffer, const Model& model, uint32_t textureId);
 
     VkFormat chooseSupportedFormat(const std::vector<VkFormat>& formats, VkImageTiling tiling, VkFormatFeatureFlags featureFlags);
     VkShaderModule createShaderModule(const std::vector<char>& code);
-    VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
-    VkImage createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags useFlags,
-                        VkMemoryPropertyFlags propFlags, VkDeviceMemory * imageMemory);
-
-    static std::vector<char> readFile(const std::string &filename);
-    static uint32_t findMemoryTypeIndex(VkPhysicalDevice physicalDevice, uint32_t allowedTypes, VkMemoryPropertyFlags properties);
-    static void createBuffer(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize bufferSize, VkBufferUsageFlags bufferUsage,
-                                 VkMemoryPropertyFlags bufferProperties, VkBuffer * buffer, VkDeviceMemory * bufferMemory);
 
 private:
         // consolidated vulkan info
     DeviceStruct m_DeviceStruct{};
+    // non owning, lets helper objects hold a ThreadSafeGfxDevice to this device
+    std::shared_ptr<GfxDevice> m_thisPtr;
+    bool m_MultiDrawIndirectSupported{false};
+    bool m_DescriptorIndexingSupported{false};
+    bool m_SamplerMinMaxSupported{false};
+    bool m_SamplerAnisotropySupported{false};
+    bool m_DisplayTimingSupported{false};
+    bool m_PipelineStatisticsSupported{false};
+    bool m_InheritedQueriesSupported{false};
+    bool m_GpuProfiling{false};
+    PFN_vkGetRefreshCycleDurationGOOGLE m_vkGetRefreshCycleDuration{nullptr};
+    PFN_vkGetPastPresentationTimingGOOGLE m_vkGetPastPresentationTiming{nullptr};
+    VkSampleCountFlagBits m_MsaaSamples{VK_SAMPLE_COUNT_1_BIT};
+    bool m_Headless{false};
+    VkExtent2D m_HeadlessExtent{};
+    VkFormat m_HeadlessFormat{VK_FORMAT_UNDEFINED};
+    std::string m_PhysicalDeviceName;
     BufferQueueStruct m_BufferQueueStruct{};
 
     // - Pools
@@ -121,32 +326,51 @@ private:
 
     VkPhysicalDeviceMemoryProperties m_MemoryProps{};
     VkSurfaceKHR m_Surface{VK_NULL_HANDLE};
-    //std::unordered_map<GfxSamplerType, std::unique_ptr<TextureSampler>> m_samplers;
-    VkSurfaceTransformFlagBitsKHR m_PretransformFlag;
+    std::unique_ptr<SamplerCache> m_SamplerCache;
+    std::unordered_map<GfxSamplerType, std::unique_ptr<TextureSampler>> m_samplers;
+    VkSurfaceTransformFlagBitsKHR m_PretransformFlag{VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR};
+    // Applied to the projection so the image is already rotated when the compositor gets it
+    glm::mat4 m_PreRotation{1.0f};
     VkSwapchainKHR m_SwapChain{VK_NULL_HANDLE};
+    // owns the render passes, framebuffers and transient attachments (depth)
+    std::unique_ptr<RenderGraph> m_RenderGraph;
+    uint32_t m_BackbufferTexture{0};
+    uint32_t m_MainPass{0};
     VkRenderPass m_RenderPass {VK_NULL_HANDLE};
     VkPipeline m_GraphicsPipeline{VK_NULL_HANDLE};
     VkPipelineLayout m_PipelineLayout{VK_NULL_HANDLE};
     VkExtent2D m_DisplaySizeIdentity;
+    VkExtent2D m_DisplaySize{};
     VkExtent2D m_SwapchainExtent;
     std::vector<SwapchainImage> m_SwapchainImages;
-    std::vector<VkFramebuffer> m_SwapchainFramebuffers;
+    // Headless: own the images and views in m_SwapchainImages
+    std::vector<std::shared_ptr<GfxTexture>> m_OffscreenImages;
+    // Drawn by the last draw(), what readbackFrame copies
+    uint32_t m_LastImage{0};
     std::vector<VkCommandBuffer> m_CommandBuffers;
+    // Per thread command pools and secondary command buffers of the main pass
+    std::unique_ptr<ParallelRecorder> m_ParallelRecorder;
+    uint32_t m_RecordThreads{0};
+    // m_RecordThreads > 1, unless the frame's statistics query rules secondary command buffers out
+    bool m_SecondaryRecording{false};
+    // benchmarkRecording: stand-in draws replacing meshList, and the vertices they read
+    uint32_t m_BenchmarkDraws{0};
+    VkBuffer m_BenchmarkVertexBuffer{VK_NULL_HANDLE};
     VkFormat m_SwapchainImageFormat;
     std::mutex m_mutex;
     std::map<std::string, std::shared_ptr<GfxTexture>> m_textureMap;
+    std::shared_ptr<GfxTexture> m_DefaultTexture;
     std::map<std::string, std::shared_ptr<GfxBuffer>> m_BufferMap;
 
-    VkImage m_DepthBufferImage;
-    VkDeviceMemory m_DepthBufferImageMemory;
-    VkImageView m_DepthBufferImageView;
     VkSampler m_TextureSampler;
 
     VkDescriptorSetLayout m_DescriptorSetLayout;
     VkDescriptorSetLayout m_SamplerSetLayout;
     VkPushConstantRange m_pushConstantRange;
-    VkDescriptorPool m_DescriptorPool;
-    VkDescriptorPool m_SamplerDescriptorPool;
+    std::unique_ptr<DescriptorSetCache> m_DescriptorCache;
+    std::vector<std::unique_ptr<DescriptorAllocator>> m_FrameDescriptors;
+    uint32_t m_RecordingImage{0};
+    std::unique_ptr<BindlessTextureTable> m_BindlessTextures;
     std::vector<VkDescriptorSet> m_DescriptorSets;
     std::vector<VkDescriptorSet> m_SamplerDescriptorSets;
 
@@ -163,9 +387,61 @@ private:
 
     int currentFrame = 0;
 
+    // - Synchronisation, one set per frame in flight
+    std::vector<VkSemaphore> m_ImageAvailable;
+    std::vector<VkSemaphore> m_RenderFinished;
+    std::vector<VkFence> m_DrawFences;
+    // Shared with the resources queueing frees, drained per frame slot once its fence signaled
+    std::shared_ptr<DeletionQueue> m_DeletionQueue;
+    // Fence of the frame that last used each swap chain image, its command buffer and UBO
+    std::vector<VkFence> m_ImageFences;
+    SteadyClock m_Clock;
+    CpuFrameStats m_CpuFrameStats{};
+    std::unique_ptr<FramePacer> m_FramePacer;
+    ChromeTrace m_Trace;
+    std::unique_ptr<GpuProfiler> m_GpuProfiler;
+
     // Scene Objects
     std::vector<Mesh> meshList;
-
-    static std::string m_TAG;
+    LodSettings m_LodSettings{};
+    std::unique_ptr<ClusterCullPass> m_ClusterCullPass;
+    struct ClusterMesh {
+        // Meshlets of every level, level after level. Level l owns meshlets lodMeshlets[l] up to
+        // lodMeshlets[l + 1].
+        std::vector<Meshlet> meshlets;
+        std::vector<MeshLod> lods;
+        std::vector<uint32_t> lodMeshlets;
+        // Picked by selectMeshLods. Per frame slot, the level the cull wrote the draws for.
+        uint32_t currentLod{0};
+        std::vector<uint32_t> culledLods;
+        glm::mat4 model{1.0f};
+        // Object space, for the screen size LODs and texture streaming pick from
+        glm::vec3 boundingCenter{0.0f};
+        float boundingRadius{0.0f};
+        // TextureStreamer handle, -1 to draw with m_DefaultTexture. textureId follows the
+        // streamer's current image.
+        int streamedTexture{-1};
+        uint32_t textureId{0};
+        std::shared_ptr<GfxBuffer> vertices;
+        std::shared_ptr<GfxBuffer> indices;
+        std::shared_ptr<GfxBuffer> gpuMeshlets;
+        // Per frame slot, the indirect draws the cull writes, room for the largest level. Its
+        // descriptor set comes from the frame's pool (allocateFrameDescriptorSet) each time the
+        // cull is recorded.
+        std::vector<std::shared_ptr<GfxBuffer>> draws;
+    };
+    std::vector<ClusterMesh> m_ClusterMeshes;
+    // owns shader modules, set layouts and pipeline layouts
+    std::unique_ptr<ShaderModuleCache> m_ShaderCache;
+    const ShaderModule* m_VertexShader{nullptr};
+    const ShaderModule* m_FragmentShader{nullptr};
+    const ProgramLayout* m_ProgramLayout{nullptr};
+    std::unique_ptr<JobSystem> m_JobSystem;
+    TextureStreamingConfig m_TextureStreamingConfig{};
+    std::unique_ptr<TextureStreamer> m_TextureStreamer;
+    std::unique_ptr<PipelineCache> m_PipelineCache;
+    uint32_t m_VertexLayoutId{0};
+
+    static constexpr LogTag m_TAG{"GfxDevice"};
 };
 using ThreadSafeGfxDevice = ThreadSafeHandle<GfxDevice>;
\ No newline at end of file
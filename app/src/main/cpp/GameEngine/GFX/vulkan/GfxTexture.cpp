@@ -1,3 +1,57 @@
+#include <stdexcept>
+
 #include "GfxTexture.h"
+#include "GfxUtils.h"
+#include "GfxDevice.h"
+#include "DeletionQueue.h"
+
+GfxTexture::GfxTexture(GfxDevice& device, const GfxTextureDesc& desc)
+    : m_desc(desc)
+    , m_device(device.getDevice())
+    , m_deletionQueue(device.getDeletionQueue())
+{
+    m_image = device.createImage(desc.width, desc.height, desc.format, VK_IMAGE_TILING_OPTIMAL, desc.usage,
+                                 desc.memoryProperties, &m_memory, desc.mipLevels);
+}
+
+GfxTexture::~GfxTexture()
+{
+    if (m_textureId != kNoTextureId) {
+        m_deletionQueue->removeTexture(m_textureId);
+    }
+    for (const View& view : m_views) {
+        m_deletionQueue->destroyImageView(view.view);
+    }
+    m_deletionQueue->destroyImage(m_image, m_memory);
+}
+
+VkImageView GfxTexture::getUAV(uint32_t mip) const
+{
+    if ((m_desc.usage & VK_IMAGE_USAGE_STORAGE_BIT) == 0) {
+        throw std::runtime_error(m_desc.name + ": storage view of a texture created without storage usage");
+    }
+    return getView(mip, 1);
+}
+
+VkImageView GfxTexture::getView(uint32_t baseMip, uint32_t mipCount) const
+{
+    std::lock_guard<std::mutex> lock(m_viewMutex);
+    for (const View& view : m_views) {
+        if (view.baseMip == baseMip && view.mipCount == mipCount) {
+            return view.view;
+        }
+    }
 
-GfxTexture::GfxTexture(std::string name, uint32_t width, uint32_t height):m_name(name) {}
\ No newline at end of file
+    VkImageViewCreateInfo viewCreateInfo = {};
+    viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewCreateInfo.image = m_image;
+    viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewCreateInfo.format = m_desc.format;
+    viewCreateInfo.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
+                                  VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+    viewCreateInfo.subresourceRange = { m_desc.aspect, baseMip, mipCount, 0, 1 };
+    VkImageView imageView;
+    CHECK_VK(vkCreateImageView(m_device, &viewCreateInfo, nullptr, &imageView));
+    m_views.push_back({ baseMip, mipCount, imageView });
+    return imageView;
+}
@@ -1,20 +1,79 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include <vulkan/vulkan.h>
 
+#include "../../Utils/Definitions.h"
+
+class GfxDevice;
+class DeletionQueue;
+
+struct GfxTextureDesc
+{
+    std::string name{};
+    uint32_t width{1};
+    uint32_t height{1};
+    uint32_t mipLevels{1};
+    VkFormat format{VK_FORMAT_R8G8B8A8_UNORM};
+    // Add VK_IMAGE_USAGE_STORAGE_BIT for getUAV
+    VkImageUsageFlags usage{VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT};
+    VkImageAspectFlags aspect{VK_IMAGE_ASPECT_COLOR_BIT};
+    VkMemoryPropertyFlags memoryProperties{VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT};
+};
+
+// A 2D image with its own memory, created from a GfxTextureDesc (GfxDevice::createTexture). Views
+// are created the first time they are asked for and live as long as the texture. Releasing the last
+// reference is safe on any thread while frames using the texture are in flight: the image, its
+// views and texture id go through the device's DeletionQueue.
 class GfxTexture
 {
 public:
+    static constexpr uint32_t kNoTextureId = UINT32_MAX;
+
     GfxTexture() = delete;
-    GfxTexture(std::string name, uint32_t width, uint32_t height);
+    GfxTexture(GfxDevice& device, const GfxTextureDesc& desc);
+    NONCOPYABLE(GfxTexture);
     virtual ~GfxTexture();
 
+    const std::string& getName() const { return m_desc.name; }
+    const GfxTextureDesc& getDesc() const { return m_desc; }
+    VkImage getImage() const { return m_image; }
+    VkFormat getFormat() const { return m_desc.format; }
+    uint32_t getWidth() const { return m_desc.width; }
+    uint32_t getHeight() const { return m_desc.height; }
+    uint32_t getMipLevels() const { return m_desc.mipLevels; }
+
+    // Every level, for sampling
+    VkImageView getSRV() const { return getView(0, m_desc.mipLevels); }
+    // One level, for storage image access
+    VkImageView getUAV(uint32_t mip = 0) const;
+    // Levels [baseMip, baseMip + mipCount)
+    VkImageView getView(uint32_t baseMip, uint32_t mipCount) const;
+
+    // What GfxDevice::addTexture returned for the SRV, the value for Mesh::texId. The texture gives
+    // it back when destroyed.
+    uint32_t getTextureId() const { return m_textureId; }
+    void setTextureId(uint32_t textureId) { m_textureId = textureId; }
+
 private:
-    std::string m_name{};
+    struct View {
+        uint32_t baseMip;
+        uint32_t mipCount;
+        VkImageView view;
+    };
 
-    VkImageView m_SRV{VK_NULL_HANDLE};
-    VkImageView m_UAV{VK_NULL_HANDLE};
+    GfxTextureDesc m_desc{};
+    VkDevice m_device{VK_NULL_HANDLE};
+    std::shared_ptr<DeletionQueue> m_deletionQueue;
 
     VkImage m_image{VK_NULL_HANDLE};
+    VkDeviceMemory m_memory{VK_NULL_HANDLE};
+    // Few per texture, a linear search is enough
+    mutable std::mutex m_viewMutex;
+    mutable std::vector<View> m_views;
+    uint32_t m_textureId{kNoTextureId};
 };
@@ -9,3 +9,10 @@ enum class GfxSamplerType : uint32_t {
     LINEAR_WRAP_SAMPLER,
     NEAREST_SAMPLER,
 };
+
+enum class GfxBlendMode : uint8_t {
+    OPAQUE = 0,
+    ALPHA,                  // src * a + dst * (1 - a)
+    ADDITIVE,               // src * a + dst
+    PREMULTIPLIED_ALPHA,    // src + dst * (1 - a)
+};
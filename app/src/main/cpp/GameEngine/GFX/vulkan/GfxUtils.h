@@ -8,7 +8,7 @@
     do {                                                                                    \
         VkResult res = (cmd);                                                               \
         if (res != VK_SUCCESS) {                                                            \
-            LOGE(std::string(__FUNCTION__),"%s failed at %s:%d with %d", #cmd, __FILE__, __LINE__, res); \
+            LOGE(LogTag(__FUNCTION__),"%s failed at %s:%d with %d", #cmd, __FILE__, __LINE__, res); \
             throw std::runtime_error("Vulkan failure : "+std::string(#cmd));                                                    \
         }                                                                                    \
     } while (0);
@@ -0,0 +1,286 @@
+#include <algorithm>
+
+#include "GpuProfiler.h"
+#include "GfxUtils.h"
+#include "../../Utils/ChromeTrace.h"
+
+namespace {
+// Results come back in bit order
+constexpr VkQueryPipelineStatisticFlags kStatistics =
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+constexpr uint32_t kStatisticCount = 7;
+}
+
+GpuProfiler::Scope::Scope(GpuProfiler* profiler, VkCommandBuffer commandBuffer, const std::string& name)
+    : m_Profiler(profiler)
+    , m_CommandBuffer(commandBuffer)
+    , m_Zone(profiler != nullptr ? profiler->beginZone(commandBuffer, name) : kInvalidZone)
+{
+}
+
+GpuProfiler::Scope::~Scope()
+{
+    if (m_Profiler != nullptr) {
+        m_Profiler->endZone(m_CommandBuffer, m_Zone);
+    }
+}
+
+GpuProfiler::GpuProfiler(const ThreadSafeGfxDevice& threadSafeDevice, VkQueue queue, uint32_t queueFamilyIndex,
+                         uint32_t slotCount, bool pipelineStatistics, uint32_t maxZones)
+    : m_Queue(queue)
+    , m_QueueFamilyIndex(queueFamilyIndex)
+    , m_MaxZones(maxZones)
+{
+    auto dev = threadSafeDevice.lock();
+    if (dev == nullptr) {
+        throw std::runtime_error("GpuProfiler created without a device");
+    }
+    m_VkDevice = dev->getDevice();
+
+    VkPhysicalDeviceProperties properties = {};
+    vkGetPhysicalDeviceProperties(dev->getVkPhysicalDevice(), &properties);
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(dev->getVkPhysicalDevice(), &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(dev->getVkPhysicalDevice(), &familyCount, families.data());
+    uint32_t validBits = queueFamilyIndex < familyCount ? families[queueFamilyIndex].timestampValidBits : 0;
+
+    m_Supported = validBits > 0 && properties.limits.timestampPeriod > 0.0f;
+    if (!m_Supported) {
+        LOGW(m_TAG,"timestamps not supported on queue family %u", queueFamilyIndex);
+        return;
+    }
+    m_TimestampPeriod = properties.limits.timestampPeriod;
+    m_TimestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    m_PipelineStatistics = pipelineStatistics && dev->isPipelineStatisticsSupported();
+
+    // Frame begin / end plus a pair per zone
+    const uint32_t queryCount = 2 + 2 * m_MaxZones;
+    m_Slots.resize(slotCount);
+    for (Slot& slot : m_Slots) {
+        VkQueryPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = queryCount;
+        CHECK_VK(vkCreateQueryPool(m_VkDevice, &poolInfo, nullptr, &slot.timestamps));
+        if (m_PipelineStatistics) {
+            poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            poolInfo.queryCount = 1;
+            poolInfo.pipelineStatistics = kStatistics;
+            CHECK_VK(vkCreateQueryPool(m_VkDevice, &poolInfo, nullptr, &slot.statistics));
+        }
+        slot.zones.resize(m_MaxZones);
+    }
+    m_Results.resize(queryCount);
+    LOGD(m_TAG,"%u slots, %u zones per frame, %.2f ns per tick, %u valid bits, pipeline statistics %s",
+         slotCount, m_MaxZones, m_TimestampPeriod, validBits, m_PipelineStatistics ? "on" : "off");
+    calibrate();
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    for (Slot& slot : m_Slots) {
+        vkDestroyQueryPool(m_VkDevice, slot.timestamps, nullptr);
+        if (slot.statistics != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(m_VkDevice, slot.statistics, nullptr);
+        }
+    }
+}
+
+uint64_t GpuProfiler::toNs(uint64_t ticks) const
+{
+    return static_cast<uint64_t>(static_cast<double>(ticks) * m_TimestampPeriod);
+}
+
+uint64_t GpuProfiler::elapsedNs(uint64_t beginTicks, uint64_t endTicks) const
+{
+    // Subtract first: masking the difference stays right when the counter wraps past its valid bits
+    return toNs((endTicks - beginTicks) & m_TimestampMask);
+}
+
+void GpuProfiler::calibrate()
+{
+    if (!m_Supported || m_Slots.empty()) {
+        return;
+    }
+    // VK_EXT_calibrated_timestamps would do this without a queue round trip, but it is rare on
+    // mobile. The midpoint of submit and fence wait is accurate to a fraction of a millisecond.
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = m_QueueFamilyIndex;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    CHECK_VK(vkCreateCommandPool(m_VkDevice, &poolInfo, nullptr, &commandPool));
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    CHECK_VK(vkAllocateCommandBuffers(m_VkDevice, &allocInfo, &commandBuffer));
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    CHECK_VK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+    // Query 0 of the first slot, beginFrame resets it again before the slot is used
+    vkCmdResetQueryPool(commandBuffer, m_Slots[0].timestamps, 0, 1);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_Slots[0].timestamps, 0);
+    CHECK_VK(vkEndCommandBuffer(commandBuffer));
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VkFence fence = VK_NULL_HANDLE;
+    CHECK_VK(vkCreateFence(m_VkDevice, &fenceInfo, nullptr, &fence));
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    uint64_t cpuBefore = ChromeTrace::nowNs();
+    CHECK_VK(vkQueueSubmit(m_Queue, 1, &submitInfo, fence));
+    CHECK_VK(vkWaitForFences(m_VkDevice, 1, &fence, VK_TRUE, UINT64_MAX));
+    uint64_t cpuAfter = ChromeTrace::nowNs();
+
+    uint64_t ticks = 0;
+    CHECK_VK(vkGetQueryPoolResults(m_VkDevice, m_Slots[0].timestamps, 0, 1, sizeof(ticks), &ticks, sizeof(ticks),
+                                   VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+    m_GpuToCpuNs = static_cast<int64_t>(cpuBefore + (cpuAfter - cpuBefore) / 2) - static_cast<int64_t>(toNs(ticks & m_TimestampMask));
+
+    vkDestroyFence(m_VkDevice, fence, nullptr);
+    vkDestroyCommandPool(m_VkDevice, commandPool, nullptr);
+    LOGD(m_TAG,"calibrated, round trip %.3f ms", (cpuAfter - cpuBefore) / 1e6);
+}
+
+VkQueryPipelineStatisticFlags GpuProfiler::getActiveStatistics() const
+{
+    return m_Supported && m_PipelineStatistics ? kStatistics : 0;
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t slot)
+{
+    if (!m_Supported) {
+        return;
+    }
+    Slot& current = m_Slots.at(slot);
+    if (current.pending) {
+        readBack(current);
+    }
+
+    current.frame = ++m_FrameCounter;
+    current.zoneCount = 0;
+    current.queryCount = 2;
+    current.pending = false;
+    m_Current = &current;
+    m_Depth = 0;
+
+    vkCmdResetQueryPool(commandBuffer, current.timestamps, 0, 2 + 2 * m_MaxZones);
+    if (m_PipelineStatistics) {
+        vkCmdResetQueryPool(commandBuffer, current.statistics, 0, 1);
+        vkCmdBeginQuery(commandBuffer, current.statistics, 0, 0);
+    }
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, current.timestamps, 0);
+}
+
+void GpuProfiler::endFrame(VkCommandBuffer commandBuffer)
+{
+    if (m_Current == nullptr) {
+        return;
+    }
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_Current->timestamps, 1);
+    if (m_PipelineStatistics) {
+        vkCmdEndQuery(commandBuffer, m_Current->statistics, 0);
+    }
+    m_Current->pending = true;
+    m_Current = nullptr;
+}
+
+uint32_t GpuProfiler::beginZone(VkCommandBuffer commandBuffer, const std::string& name)
+{
+    if (m_Current == nullptr || m_Current->zoneCount >= m_MaxZones) {
+        return kInvalidZone;
+    }
+    uint32_t index = m_Current->zoneCount++;
+    Zone& zone = m_Current->zones[index];
+    // Reuses the string's capacity from earlier frames
+    zone.name.assign(name);
+    zone.depth = m_Depth++;
+    zone.beginQuery = m_Current->queryCount++;
+    zone.endQuery = zone.beginQuery;
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_Current->timestamps, zone.beginQuery);
+    return index;
+}
+
+void GpuProfiler::endZone(VkCommandBuffer commandBuffer, uint32_t zone)
+{
+    if (m_Current == nullptr || zone == kInvalidZone) {
+        return;
+    }
+    Zone& target = m_Current->zones[zone];
+    target.endQuery = m_Current->queryCount++;
+    m_Depth--;
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_Current->timestamps, target.endQuery);
+}
+
+void GpuProfiler::readBack(Slot& slot)
+{
+    slot.pending = false;
+    // No WAIT bit: the submission has finished, anything else is reported and skipped
+    VkResult result = vkGetQueryPoolResults(m_VkDevice, slot.timestamps, 0, slot.queryCount,
+                                            slot.queryCount * sizeof(uint64_t), m_Results.data(), sizeof(uint64_t),
+                                            VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        m_LastFrame.droppedFrames++;
+        return;
+    }
+
+    GpuFrameStats& frame = m_LastFrame;
+    const uint64_t frameStartTicks = m_Results[0];
+    const uint64_t frameStartNs = toNs(frameStartTicks & m_TimestampMask);
+    frame.frame = slot.frame;
+    frame.gpuMs = elapsedNs(frameStartTicks, m_Results[1]) / 1e6;
+    frame.zones.resize(slot.zoneCount);
+    const bool tracing = m_Trace != nullptr && m_Trace->isCapturing();
+    for (uint32_t i = 0; i < slot.zoneCount; i++) {
+        const Zone& zone = slot.zones[i];
+        GpuZoneResult& zoneResult = frame.zones[i];
+        // Offsets from the frame start, a zone left open ends with the frame
+        uint64_t beginNs = elapsedNs(frameStartTicks, m_Results[zone.beginQuery]);
+        uint64_t endNs = elapsedNs(frameStartTicks, m_Results[zone.endQuery != zone.beginQuery ? zone.endQuery : 1]);
+        zoneResult.name = zone.name;
+        zoneResult.depth = zone.depth;
+        zoneResult.startMs = beginNs / 1e6;
+        zoneResult.durationMs = endNs > beginNs ? (endNs - beginNs) / 1e6 : 0.0;
+        if (tracing) {
+            m_Trace->addZone(zone.name, "gpu", ChromeTrace::kGpuProcess, 0, frameStartNs + beginNs + m_GpuToCpuNs,
+                             endNs > beginNs ? endNs - beginNs : 0);
+        }
+    }
+    if (tracing) {
+        m_Trace->addZone("frame", "gpu", ChromeTrace::kGpuProcess, 0, frameStartNs + m_GpuToCpuNs,
+                         static_cast<uint64_t>(frame.gpuMs * 1e6));
+    }
+
+    frame.hasPipelineStatistics = false;
+    if (m_PipelineStatistics) {
+        uint64_t statistics[kStatisticCount] = {};
+        if (vkGetQueryPoolResults(m_VkDevice, slot.statistics, 0, 1, sizeof(statistics), statistics, sizeof(statistics),
+                                  VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+            frame.hasPipelineStatistics = true;
+            frame.pipelineStatistics.inputAssemblyVertices = statistics[0];
+            frame.pipelineStatistics.inputAssemblyPrimitives = statistics[1];
+            frame.pipelineStatistics.vertexShaderInvocations = statistics[2];
+            frame.pipelineStatistics.clippingInvocations = statistics[3];
+            frame.pipelineStatistics.clippingPrimitives = statistics[4];
+            frame.pipelineStatistics.fragmentShaderInvocations = statistics[5];
+            frame.pipelineStatistics.computeShaderInvocations = statistics[6];
+        }
+    }
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../../Utils/Definitions.h"
+#include "GfxDevice.h"
+
+class ChromeTrace;
+
+struct GpuZoneResult {
+    std::string name;
+    uint32_t depth{0};
+    double startMs{0.0};        // from the start of the frame
+    double durationMs{0.0};
+};
+
+struct GpuPipelineStatistics {
+    uint64_t inputAssemblyVertices{0};
+    uint64_t inputAssemblyPrimitives{0};
+    uint64_t vertexShaderInvocations{0};
+    uint64_t clippingInvocations{0};
+    uint64_t clippingPrimitives{0};
+    uint64_t fragmentShaderInvocations{0};
+    uint64_t computeShaderInvocations{0};
+};
+
+struct GpuFrameStats {
+    uint64_t frame{0};          // GpuProfiler frame number the results belong to
+    double gpuMs{0.0};          // first to last timestamp of the frame
+    std::vector<GpuZoneResult> zones;
+    bool hasPipelineStatistics{false};
+    GpuPipelineStatistics pipelineStatistics{};
+    uint64_t droppedFrames{0};  // results that weren't available when read back
+};
+
+// Timestamp queries around named zones of a command buffer, plus optional pipeline statistics
+// for the whole frame. Every slot (one per swap chain image) owns its query pools. Results are
+// read back when the slot is recorded again, the caller has waited for its previous submission
+// by then, so reading never stalls. They are one swap chain length behind.
+class GpuProfiler {
+public:
+    static constexpr uint32_t kInvalidZone = ~0u;
+
+    class Scope {
+    public:
+        NONCOPYABLE(Scope);
+        Scope(GpuProfiler* profiler, VkCommandBuffer commandBuffer, const std::string& name);
+        ~Scope();
+
+    private:
+        GpuProfiler* m_Profiler;
+        VkCommandBuffer m_CommandBuffer;
+        uint32_t m_Zone;
+    };
+
+    NONCOPYABLE(GpuProfiler);
+    GpuProfiler(const ThreadSafeGfxDevice& threadSafeDevice, VkQueue queue, uint32_t queueFamilyIndex,
+                uint32_t slotCount, bool pipelineStatistics, uint32_t maxZones = 64);
+    ~GpuProfiler();
+
+    // False when the queue has no timestamp support, every call is a no-op then
+    bool isSupported() const { return m_Supported; }
+    // GPU zones of captured frames go to the trace, on the CPU clock
+    void setTrace(ChromeTrace* trace) { m_Trace = trace; }
+
+    // Outside a render pass, first thing in the command buffer of that slot
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t slot);
+    // Outside a render pass, last thing in the command buffer
+    void endFrame(VkCommandBuffer commandBuffer);
+    uint32_t beginZone(VkCommandBuffer commandBuffer, const std::string& name);
+    void endZone(VkCommandBuffer commandBuffer, uint32_t zone);
+
+    // Statistics query active between beginFrame and endFrame, what secondary command buffers
+    // executed in between inherit (VkCommandBufferInheritanceInfo::pipelineStatistics)
+    VkQueryPipelineStatisticFlags getActiveStatistics() const;
+
+    // Latest frame with complete results
+    const GpuFrameStats& getLastFrame() const { return m_LastFrame; }
+
+    // Measures the offset between GPU timestamps and the CPU clock by waiting for a
+    // timestamp on the queue. Done once at creation.
+    void calibrate();
+
+private:
+    struct Zone {
+        std::string name;
+        uint32_t depth{0};
+        uint32_t beginQuery{0};
+        uint32_t endQuery{0};
+    };
+    struct Slot {
+        VkQueryPool timestamps{VK_NULL_HANDLE};
+        VkQueryPool statistics{VK_NULL_HANDLE};
+        std::vector<Zone> zones;    // reused, only the first zoneCount are valid
+        uint32_t zoneCount{0};
+        uint32_t queryCount{0};
+        uint64_t frame{0};
+        bool pending{false};
+    };
+
+    void readBack(Slot& slot);
+    uint64_t toNs(uint64_t ticks) const;
+    uint64_t elapsedNs(uint64_t beginTicks, uint64_t endTicks) const;
+
+    VkDevice m_VkDevice{VK_NULL_HANDLE};
+    VkQueue m_Queue{VK_NULL_HANDLE};
+    uint32_t m_QueueFamilyIndex{0};
+    bool m_Supported{false};
+    bool m_PipelineStatistics{false};
+    uint32_t m_MaxZones{0};
+    double m_TimestampPeriod{1.0};      // ns per tick
+    uint64_t m_TimestampMask{~0ull};
+    int64_t m_GpuToCpuNs{0};
+
+    std::vector<Slot> m_Slots;
+    Slot* m_Current{nullptr};
+    uint32_t m_Depth{0};
+    uint64_t m_FrameCounter{0};
+    std::vector<uint64_t> m_Results;
+    GpuFrameStats m_LastFrame;
+    ChromeTrace* m_Trace{nullptr};
+    static constexpr LogTag m_TAG{"GpuProfiler"};
+};
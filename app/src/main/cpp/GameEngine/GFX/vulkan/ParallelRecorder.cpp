@@ -0,0 +1,104 @@
+#include <algorithm>
+
+#include "ParallelRecorder.h"
+#include "GfxUtils.h"
+#include "../../Utils/JobSystem.h"
+#include "../../Utils/Profiler.h"
+
+ParallelRecorder::ParallelRecorder(VkDevice device, uint32_t queueFamilyIndex, JobSystem& jobSystem,
+                                   uint32_t framesInFlight, uint32_t threadCount)
+    : m_VkDevice(device)
+    , m_JobSystem(jobSystem)
+{
+    const uint32_t maxThreads = jobSystem.getThreadCount() + 1;
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    // Reset as a whole every frame
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = queueFamilyIndex;
+    m_Frames.resize(framesInFlight);
+    for (auto& frame : m_Frames) {
+        frame.resize(maxThreads);
+        for (ThreadPool& threadPool : frame) {
+            CHECK_VK(vkCreateCommandPool(m_VkDevice, &poolInfo, nullptr, &threadPool.pool));
+        }
+    }
+    setThreadCount(threadCount == 0 ? maxThreads : threadCount);
+    LOGD(m_TAG,"%u command pools per frame, recording on %u threads", maxThreads, m_ThreadCount);
+}
+
+ParallelRecorder::~ParallelRecorder()
+{
+    // Destroying a pool frees its command buffers
+    for (auto& frame : m_Frames) {
+        for (ThreadPool& threadPool : frame) {
+            vkDestroyCommandPool(m_VkDevice, threadPool.pool, nullptr);
+        }
+    }
+}
+
+void ParallelRecorder::beginFrame(uint32_t frameIndex)
+{
+    m_FrameIndex = frameIndex;
+    for (ThreadPool& threadPool : m_Frames[frameIndex]) {
+        if (threadPool.used > 0) {
+            CHECK_VK(vkResetCommandPool(m_VkDevice, threadPool.pool, 0));
+            threadPool.used = 0;
+        }
+    }
+}
+
+void ParallelRecorder::setThreadCount(uint32_t threadCount)
+{
+    m_ThreadCount = std::min(std::max(threadCount, 1u), getMaxThreadCount());
+}
+
+VkCommandBuffer ParallelRecorder::acquire(ThreadPool& threadPool)
+{
+    if (threadPool.used == threadPool.buffers.size()) {
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = threadPool.pool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        CHECK_VK(vkAllocateCommandBuffers(m_VkDevice, &allocInfo, &commandBuffer));
+        threadPool.buffers.push_back(commandBuffer);
+    }
+    return threadPool.buffers[threadPool.used++];
+}
+
+void ParallelRecorder::record(VkCommandBuffer primary, const VkCommandBufferInheritanceInfo& inheritance,
+                              uint32_t drawCount, const RecordRange& recordRange)
+{
+    PROFILE_FUNCTION();
+    m_Stats.draws = drawCount;
+    m_Stats.threads = m_ThreadCount;
+    m_Stats.ranges = 0;
+    if (drawCount == 0) {
+        return;
+    }
+    // One range per thread balances uniform draws, fewer when the ranges would get too small
+    const uint32_t rangeCount = std::min(m_ThreadCount, (drawCount + m_MinDrawsPerRange - 1) / m_MinDrawsPerRange);
+    m_Secondaries.assign(rangeCount, VK_NULL_HANDLE);
+    std::vector<ThreadPool>& pools = m_Frames[m_FrameIndex];
+
+    m_JobSystem.parallelFor(rangeCount, m_ThreadCount, [&](uint32_t range, uint32_t slot) {
+        PROFILE_ZONE("record range");
+        const uint32_t first = static_cast<uint32_t>(uint64_t(drawCount) * range / rangeCount);
+        const uint32_t end = static_cast<uint32_t>(uint64_t(drawCount) * (range + 1) / rangeCount);
+        VkCommandBuffer commandBuffer = acquire(pools[slot]);
+
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        beginInfo.pInheritanceInfo = &inheritance;
+        CHECK_VK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+        recordRange(commandBuffer, first, end - first);
+        CHECK_VK(vkEndCommandBuffer(commandBuffer));
+        m_Secondaries[range] = commandBuffer;
+    });
+
+    vkCmdExecuteCommands(primary, rangeCount, m_Secondaries.data());
+    m_Stats.ranges = rangeCount;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../../Utils/Definitions.h"
+
+class JobSystem;
+
+struct ParallelRecordingStats {
+    uint32_t draws{0};
+    uint32_t ranges{0};     // secondary command buffers executed
+    uint32_t threads{0};    // threads that could take part, the recording one included
+};
+
+// Records the draws of one subpass on several threads: [0, drawCount) is split into contiguous
+// ranges, JobSystem::parallelFor records each into a secondary command buffer and the primary
+// executes them in range order, so draw order is kept. Command pools aren't thread safe, every
+// thread slot owns one per frame slot. beginFrame resets a frame slot's pools at once, which is
+// cheaper than freeing or resetting the buffers one by one; allocated buffers are reused.
+class ParallelRecorder {
+public:
+    using RecordRange = std::function<void(VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t drawCount)>;
+
+    NONCOPYABLE(ParallelRecorder);
+    // threadCount 0 uses every job system worker plus the recording thread
+    ParallelRecorder(VkDevice device, uint32_t queueFamilyIndex, JobSystem& jobSystem, uint32_t framesInFlight,
+                     uint32_t threadCount = 0);
+    ~ParallelRecorder();
+
+    // The fence of frameIndex signaled, the secondary command buffers recorded for it are free
+    void beginFrame(uint32_t frameIndex);
+
+    // Inside a subpass begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS of primary: records
+    // the ranges with recordRange and executes them. Returns once recorded. recordRange runs on
+    // several threads at once and must set every state it draws with, nothing is inherited.
+    void record(VkCommandBuffer primary, const VkCommandBufferInheritanceInfo& inheritance, uint32_t drawCount,
+                const RecordRange& recordRange);
+
+    // Clamped to [1, job system workers + 1]
+    void setThreadCount(uint32_t threadCount);
+    uint32_t getThreadCount() const { return m_ThreadCount; }
+    uint32_t getMaxThreadCount() const { return static_cast<uint32_t>(m_Frames.front().size()); }
+    // Fewer draws than this per range don't pay for a secondary command buffer and a job
+    void setMinDrawsPerRange(uint32_t drawCount) { m_MinDrawsPerRange = drawCount > 0 ? drawCount : 1; }
+    const ParallelRecordingStats& getStats() const { return m_Stats; }
+
+private:
+    struct ThreadPool {
+        VkCommandPool pool{VK_NULL_HANDLE};
+        std::vector<VkCommandBuffer> buffers;
+        uint32_t used{0};
+    };
+
+    VkCommandBuffer acquire(ThreadPool& threadPool);
+
+    VkDevice m_VkDevice{VK_NULL_HANDLE};
+    JobSystem& m_JobSystem;
+    std::vector<std::vector<ThreadPool>> m_Frames;  // [frame slot][thread slot]
+    uint32_t m_FrameIndex{0};
+    uint32_t m_ThreadCount{1};
+    uint32_t m_MinDrawsPerRange{64};
+    std::vector<VkCommandBuffer> m_Secondaries;     // per range of the current record()
+    ParallelRecordingStats m_Stats{};
+    static constexpr LogTag m_TAG{"ParallelRecorder"};
+};
@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+
+#include "PipelineCache.h"
+#include "ShaderModuleCache.h"
+#include "GfxUtils.h"
+#include "../../Utils/Hash.h"
+#include "../../Utils/JobSystem.h"
+
+PipelineCache::PipelineCache(const ThreadSafeGfxDevice& threadSafeDevice, JobSystem& jobSystem)
+    : m_device(threadSafeDevice), m_JobSystem(jobSystem)
+{
+    LOGD(m_TAG,__FUNCTION__);
+    auto dev = m_device.lock();
+    if (dev == nullptr) {
+        throw std::runtime_error("PipelineCache created without a device");
+    }
+    m_VkDevice = dev->getDevice();
+
+    // Driver side cache, shared by all variants so related pipelines compile faster
+    VkPipelineCacheCreateInfo cacheCreateInfo = {};
+    cacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    CHECK_VK(vkCreatePipelineCache(m_VkDevice, &cacheCreateInfo, nullptr, &m_VkPipelineCache));
+}
+
+PipelineCache::~PipelineCache()
+{
+    // Compile jobs reference this cache, let them finish first
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_CompileDone.wait(lock, [this] { return m_Stats.pending == 0; });
+    }
+    for (auto& entry : m_Pipelines) {
+        VkPipeline pipeline = entry.second->pipeline.load();
+        if (pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(m_VkDevice, pipeline, nullptr);
+        }
+    }
+    vkDestroyPipelineCache(m_VkDevice, m_VkPipelineCache, nullptr);
+    LOGD(m_TAG,"%u pipelines compiled, %u failed, %.2f ms total, %.2f ms max",
+         m_Stats.compiled, m_Stats.failed, m_Stats.totalCompileMs, m_Stats.maxCompileMs);
+}
+
+uint32_t PipelineCache::registerVertexLayout(const VkVertexInputBindingDescription& binding,
+                                             const std::vector<VkVertexInputAttributeDescription>& attributes)
+{
+    Hasher hasher;
+    hasher.value(binding.binding).value(binding.stride).value(binding.inputRate);
+    for (const auto& attribute : attributes) {
+        hasher.value(attribute.location).value(attribute.binding).value(attribute.format).value(attribute.offset);
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto range = m_VertexLayoutIds.equal_range(hasher.get());
+    for (auto it = range.first; it != range.second; ++it) {
+        const VertexLayout& layout = m_VertexLayouts[it->second];
+        if (layout.binding.binding != binding.binding || layout.binding.stride != binding.stride ||
+            layout.binding.inputRate != binding.inputRate || layout.attributes.size() != attributes.size()) {
+            continue;
+        }
+        bool same = true;
+        for (size_t i = 0; i < attributes.size() && same; i++) {
+            const auto& l = layout.attributes[i];
+            const auto& r = attributes[i];
+            same = l.location == r.location && l.binding == r.binding && l.format == r.format && l.offset == r.offset;
+        }
+        if (same) {
+            return it->second;
+        }
+    }
+    const auto id = static_cast<uint32_t>(m_VertexLayouts.size());
+    m_VertexLayouts.push_back({binding, attributes});
+    m_VertexLayoutIds.emplace(hasher.get(), id);
+    return id;
+}
+
+bool PipelineDesc::operator==(const PipelineDesc& other) const
+{
+    return vertexShader->id == other.vertexShader->id && fragmentShader->id == other.fragmentShader->id &&
+           renderPass == other.renderPass && layout == other.layout && state == other.state;
+}
+
+uint64_t PipelineCache::hashDesc(const PipelineDesc& desc)
+{
+    Hasher hasher;
+    hasher.value(desc.vertexShader->id).value(desc.fragmentShader->id).value(desc.renderPass).value(desc.layout)
+          .value(desc.state);
+    return hasher.get();
+}
+
+PipelineCache::Entry* PipelineCache::findEntry(uint64_t key, const PipelineDesc& desc)
+{
+    const auto range = m_Pipelines.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second->desc == desc) {
+            return it->second.get();
+        }
+    }
+    return nullptr;
+}
+
+VkPipeline PipelineCache::getPipelineBlocking(const PipelineDesc& desc)
+{
+    const uint64_t key = hashDesc(desc);
+    Entry* entry = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        entry = findEntry(key, desc);
+        if (entry != nullptr) {
+            // Possibly queued by getPipeline, wait for the worker instead of compiling twice
+            m_CompileDone.wait(lock, [entry] { return entry->done; });
+            m_Stats.hits++;
+            return entry->pipeline.load();
+        }
+        m_Stats.misses++;
+        m_Stats.pending++;
+        entry = m_Pipelines.emplace(key, std::make_unique<Entry>(desc))->second.get();
+    }
+    compileEntry(desc, entry, key);
+    return entry->pipeline.load();
+}
+
+VkPipeline PipelineCache::getPipeline(const PipelineDesc& desc)
+{
+    const uint64_t key = hashDesc(desc);
+    Entry* entry = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        entry = findEntry(key, desc);
+        if (entry != nullptr) {
+            VkPipeline pipeline = entry->pipeline.load();
+            if (pipeline != VK_NULL_HANDLE) {
+                m_Stats.hits++;
+                return pipeline;
+            }
+            // Still compiling or failed to compile
+            m_Stats.fallbacks++;
+            return m_Fallback;
+        }
+        m_Stats.misses++;
+        m_Stats.fallbacks++;
+        m_Stats.pending++;
+        entry = m_Pipelines.emplace(key, std::make_unique<Entry>(desc))->second.get();
+    }
+    // desc is copied, the caller's may be gone by the time a worker picks the job up
+    m_JobSystem.submit([this, desc, entry, key]() { compileEntry(desc, entry, key); });
+    return m_Fallback;
+}
+
+void PipelineCache::compileEntry(const PipelineDesc& desc, Entry* entry, uint64_t key)
+{
+    VertexLayout vertexLayout;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        vertexLayout = m_VertexLayouts.at(desc.state.vertexLayoutId);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    try {
+        pipeline = compile(desc, vertexLayout);
+    } catch (const std::exception& e) {
+        // Keep using the fallback for this variant rather than taking the worker thread down
+        LOGE(m_TAG,"pipeline %llx failed to compile : %s", static_cast<unsigned long long>(key), e.what());
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        entry->pipeline.store(pipeline);
+        entry->done = true;
+        m_Stats.pending--;
+        if (pipeline == VK_NULL_HANDLE) {
+            m_Stats.failed++;
+        } else {
+            m_Stats.compiled++;
+            m_Stats.totalCompileMs += ms;
+            m_Stats.maxCompileMs = std::max(m_Stats.maxCompileMs, ms);
+        }
+    }
+    m_CompileDone.notify_all();
+    LOGD(m_TAG,"pipeline %llx compiled in %.2f ms", static_cast<unsigned long long>(key), ms);
+}
+
+PipelineCacheStats PipelineCache::getStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_Stats;
+}
+
+VkPipeline PipelineCache::compile(const PipelineDesc& desc, const VertexLayout& vertexLayout)
+{
+    std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = {};
+    const std::array<const ShaderModule*, 2> modules = { desc.vertexShader, desc.fragmentShader };
+    for (size_t i = 0; i < shaderStages.size(); i++)
+    {
+        shaderStages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[i].stage = modules[i]->stage;
+        shaderStages[i].module = modules[i]->module;
+        shaderStages[i].pName = modules[i]->entryPoint.c_str();
+    }
+
+    VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
+    vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputCreateInfo.vertexBindingDescriptionCount = 1;
+    vertexInputCreateInfo.pVertexBindingDescriptions = &vertexLayout.binding;
+    vertexInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexLayout.attributes.size());
+    vertexInputCreateInfo.pVertexAttributeDescriptions = vertexLayout.attributes.data();
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = static_cast<VkPrimitiveTopology>(desc.state.topology);
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    // Set with vkCmdSetViewport / vkCmdSetScissor, only the counts are baked in
+    VkPipelineViewportStateCreateInfo viewportStateCreateInfo = {};
+    viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportStateCreateInfo.viewportCount = 1;
+    viewportStateCreateInfo.scissorCount = 1;
+
+    std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo = {};
+    dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
+
+    VkPipelineRasterizationStateCreateInfo rasterizerCreateInfo = {};
+    rasterizerCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizerCreateInfo.depthClampEnable = VK_FALSE;
+    rasterizerCreateInfo.rasterizerDiscardEnable = VK_FALSE;
+    rasterizerCreateInfo.polygonMode = static_cast<VkPolygonMode>(desc.state.polygonMode);
+    rasterizerCreateInfo.lineWidth = 1.0f;
+    rasterizerCreateInfo.cullMode = desc.state.cullMode;
+    rasterizerCreateInfo.frontFace = static_cast<VkFrontFace>(desc.state.frontFace);
+    rasterizerCreateInfo.depthBiasEnable = VK_FALSE;
+
+    VkPipelineMultisampleStateCreateInfo multisamplingCreateInfo = {};
+    multisamplingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisamplingCreateInfo.sampleShadingEnable = VK_FALSE;
+    multisamplingCreateInfo.rasterizationSamples = static_cast<VkSampleCountFlagBits>(desc.state.sampleCount);
+
+    VkPipelineColorBlendAttachmentState colourState = {};
+    colourState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
+                                 | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colourState.blendEnable = desc.state.blendMode == GfxBlendMode::OPAQUE ? VK_FALSE : VK_TRUE;
+    colourState.colorBlendOp = VK_BLEND_OP_ADD;
+    colourState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colourState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    colourState.alphaBlendOp = VK_BLEND_OP_ADD;
+    switch (desc.state.blendMode)
+    {
+        case GfxBlendMode::OPAQUE:
+        case GfxBlendMode::ALPHA:
+            colourState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+            colourState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            break;
+        case GfxBlendMode::ADDITIVE:
+            colourState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+            colourState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+            break;
+        case GfxBlendMode::PREMULTIPLIED_ALPHA:
+            colourState.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+            colourState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            colourState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            break;
+    }
+
+    VkPipelineColorBlendStateCreateInfo colourBlendingCreateInfo = {};
+    colourBlendingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colourBlendingCreateInfo.logicOpEnable = VK_FALSE;
+    colourBlendingCreateInfo.attachmentCount = 1;
+    colourBlendingCreateInfo.pAttachments = &colourState;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencilCreateInfo = {};
+    depthStencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencilCreateInfo.depthTestEnable = desc.state.depthTest;
+    depthStencilCreateInfo.depthWriteEnable = desc.state.depthWrite;
+    depthStencilCreateInfo.depthCompareOp = static_cast<VkCompareOp>(desc.state.depthCompare);
+    depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;
+    depthStencilCreateInfo.stencilTestEnable = VK_FALSE;
+
+    VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+    pipelineCreateInfo.pStages = shaderStages.data();
+    pipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo;
+    pipelineCreateInfo.pInputAssemblyState = &inputAssembly;
+    pipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
+    pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
+    pipelineCreateInfo.pRasterizationState = &rasterizerCreateInfo;
+    pipelineCreateInfo.pMultisampleState = &multisamplingCreateInfo;
+    pipelineCreateInfo.pColorBlendState = &colourBlendingCreateInfo;
+    pipelineCreateInfo.pDepthStencilState = &depthStencilCreateInfo;
+    pipelineCreateInfo.layout = desc.layout;
+    pipelineCreateInfo.renderPass = desc.renderPass;
+    pipelineCreateInfo.subpass = desc.state.subpass;
+    pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineCreateInfo.basePipelineIndex = -1;
+
+    VkPipeline pipeline;
+    CHECK_VK(vkCreateGraphicsPipelines(m_VkDevice, m_VkPipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
+    return pipeline;
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../../Utils/Definitions.h"
+#include "GfxTypes.h"
+#include "GfxDevice.h"
+
+class JobSystem;
+struct ShaderModule;
+
+// Every fixed function field a material can vary. Hashed as raw bytes, so it stays padding free
+// and members are stored in the narrowest type that holds the Vulkan enum.
+struct PipelineState {
+    uint32_t vertexLayoutId{0};     // from PipelineCache::registerVertexLayout
+    uint8_t topology{VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST};
+    uint8_t polygonMode{VK_POLYGON_MODE_FILL};
+    uint8_t cullMode{VK_CULL_MODE_BACK_BIT};
+    uint8_t frontFace{VK_FRONT_FACE_COUNTER_CLOCKWISE};
+    GfxBlendMode blendMode{GfxBlendMode::ALPHA};
+    uint8_t depthTest{VK_TRUE};
+    uint8_t depthWrite{VK_TRUE};
+    uint8_t depthCompare{VK_COMPARE_OP_LESS};
+    uint8_t sampleCount{VK_SAMPLE_COUNT_1_BIT};
+    uint8_t subpass{0};
+    uint8_t padding[2]{};
+
+    bool operator==(const PipelineState& other) const { return std::memcmp(this, &other, sizeof(*this)) == 0; }
+};
+static_assert(sizeof(PipelineState) == 16, "PipelineState must not contain padding");
+
+struct PipelineDesc {
+    const ShaderModule* vertexShader{nullptr};
+    const ShaderModule* fragmentShader{nullptr};
+    VkRenderPass renderPass{VK_NULL_HANDLE};
+    VkPipelineLayout layout{VK_NULL_HANDLE};     // from the program's ProgramLayout
+    PipelineState state{};
+
+    bool operator==(const PipelineDesc& other) const;
+};
+
+struct PipelineCacheStats {
+    uint32_t hits{0};
+    uint32_t misses{0};
+    uint32_t fallbacks{0};          // requests answered with the fallback pipeline
+    uint32_t compiled{0};
+    uint32_t failed{0};
+    uint32_t pending{0};
+    double totalCompileMs{0.0};
+    double maxCompileMs{0.0};
+};
+
+// Graphics pipelines keyed by shader IDs, render pass, layout and PipelineState, bucketed by their hash.
+// Viewport and scissor are dynamic so pipelines survive swapchain recreation.
+class PipelineCache {
+public:
+    NONCOPYABLE(PipelineCache);
+    PipelineCache(const ThreadSafeGfxDevice& threadSafeDevice, JobSystem& jobSystem);
+    ~PipelineCache();
+
+    // Deduplicated, returns the id to put in PipelineState::vertexLayoutId
+    uint32_t registerVertexLayout(const VkVertexInputBindingDescription& binding,
+                                  const std::vector<VkVertexInputAttributeDescription>& attributes);
+
+    // Compiles on the calling thread when missing, for pipelines needed before the first frame
+    VkPipeline getPipelineBlocking(const PipelineDesc& desc);
+    // Never blocks. A miss queues the compile on the job system and returns the fallback
+    // until the variant is ready. The fallback has to share the variant's pipeline layout.
+    VkPipeline getPipeline(const PipelineDesc& desc);
+    void setFallbackPipeline(VkPipeline pipeline) { m_Fallback = pipeline; }
+
+    static uint64_t hashDesc(const PipelineDesc& desc);
+    PipelineCacheStats getStats();
+
+private:
+    struct Entry {
+        explicit Entry(const PipelineDesc& desc) : desc(desc) {}
+        const PipelineDesc desc;    // equal hashes are told apart by comparing it
+        std::atomic<VkPipeline> pipeline{VK_NULL_HANDLE};
+        bool done{false};
+    };
+    struct VertexLayout {
+        VkVertexInputBindingDescription binding;
+        std::vector<VkVertexInputAttributeDescription> attributes;
+    };
+
+    // m_mutex held
+    Entry* findEntry(uint64_t key, const PipelineDesc& desc);
+    VkPipeline compile(const PipelineDesc& desc, const VertexLayout& vertexLayout);
+    void compileEntry(const PipelineDesc& desc, Entry* entry, uint64_t key);
+
+    ThreadSafeGfxDevice m_device;
+    VkDevice m_VkDevice{VK_NULL_HANDLE};
+    JobSystem& m_JobSystem;
+    VkPipelineCache m_VkPipelineCache{VK_NULL_HANDLE};
+    VkPipeline m_Fallback{VK_NULL_HANDLE};
+
+    std::mutex m_mutex;
+    std::condition_variable m_CompileDone;
+    std::unordered_multimap<uint64_t, std::unique_ptr<Entry>> m_Pipelines;
+    // Index into m_VertexLayouts by hash, compared against the stored layout on hit
+    std::unordered_multimap<uint64_t, uint32_t> m_VertexLayoutIds;
+    std::vector<VertexLayout> m_VertexLayouts;
+    PipelineCacheStats m_Stats{};
+    static constexpr LogTag m_TAG{"PipelineCache"};
+};
@@ -0,0 +1,1332 @@
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
+
+#include "RenderGraph.h"
+#include "GfxUtils.h"
+#include "GpuProfiler.h"
+#include "../../Utils/Hash.h"
+
+namespace {
+
+constexpr VkAccessFlags kWriteAccess = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                       VK_ACCESS_SHADER_WRITE_BIT;
+
+// What is known about a texture while walking the compiled frame
+struct TrackState {
+    VkImageLayout layout{VK_IMAGE_LAYOUT_UNDEFINED};
+    VkPipelineStageFlags writeStages{0};    // last write or layout transition, later accesses wait for it
+    VkAccessFlags writeAccess{0};
+    VkPipelineStageFlags readStages{0};     // reads since then, the write is already visible to them
+    VkPipelineStageFlags preSynced{0};      // the next use was synchronised by the previous render pass
+    bool hasContents{false};
+};
+
+const char* layoutName(VkImageLayout layout)
+{
+    switch (layout) {
+        case VK_IMAGE_LAYOUT_UNDEFINED: return "UNDEFINED";
+        case VK_IMAGE_LAYOUT_GENERAL: return "GENERAL";
+        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL: return "COLOR_ATTACHMENT";
+        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL: return "DEPTH_ATTACHMENT";
+        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL: return "DEPTH_READ_ONLY";
+        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL: return "SHADER_READ_ONLY";
+        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL: return "TRANSFER_SRC";
+        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL: return "TRANSFER_DST";
+        case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR: return "PRESENT_SRC";
+        default: return "OTHER";
+    }
+}
+
+uint32_t findLazyMemoryType(const VkPhysicalDeviceMemoryProperties& properties, uint32_t allowedTypes)
+{
+    for (uint32_t i = 0; i < properties.memoryTypeCount; i++) {
+        if ((allowedTypes & (1u << i)) && (properties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+            return i;
+        }
+    }
+    return RenderGraph::kInvalid;
+}
+
+const char* loadOpName(VkAttachmentLoadOp op)
+{
+    switch (op) {
+        case VK_ATTACHMENT_LOAD_OP_LOAD: return "LOAD";
+        case VK_ATTACHMENT_LOAD_OP_CLEAR: return "CLEAR";
+        default: return "DONT_CARE";
+    }
+}
+
+} // namespace
+
+RenderGraph::~RenderGraph()
+{
+    destroyVulkanObjects();
+}
+
+uint32_t RenderGraph::createTexture(const std::string& name, const RGTextureDesc& desc)
+{
+    if (desc.width == 0 || desc.height == 0 || desc.format == VK_FORMAT_UNDEFINED) {
+        throw std::runtime_error("invalid render graph texture " + name);
+    }
+    Texture texture;
+    texture.name = name;
+    texture.desc = desc;
+    m_Textures.push_back(texture);
+    m_Compiled = false;
+    return static_cast<uint32_t>(m_Textures.size() - 1);
+}
+
+uint32_t RenderGraph::importTexture(const std::string& name, const RGTextureDesc& desc,
+                                    VkImageLayout initialLayout, VkImageLayout finalLayout)
+{
+    uint32_t index = createTexture(name, desc);
+    m_Textures[index].imported = true;
+    m_Textures[index].initialLayout = initialLayout;
+    m_Textures[index].finalLayout = finalLayout;
+    return index;
+}
+
+void RenderGraph::markOutput(uint32_t texture)
+{
+    m_Textures.at(texture).output = true;
+    m_Compiled = false;
+}
+
+uint32_t RenderGraph::addPass(const std::string& name, PassCallback execute)
+{
+    Pass pass;
+    pass.name = name;
+    pass.execute = std::move(execute);
+    m_Passes.push_back(std::move(pass));
+    m_Compiled = false;
+    return static_cast<uint32_t>(m_Passes.size() - 1);
+}
+
+uint32_t RenderGraph::addComputePass(const std::string& name, PassCallback execute)
+{
+    uint32_t index = addPass(name, std::move(execute));
+    m_Passes[index].compute = true;
+    return index;
+}
+
+void RenderGraph::setSideEffect(uint32_t pass)
+{
+    m_Passes.at(pass).sideEffect = true;
+    m_Compiled = false;
+}
+
+void RenderGraph::setSecondaryCommandBuffers(uint32_t pass, bool secondary)
+{
+    m_Passes.at(pass).secondary = secondary;
+}
+
+void RenderGraph::writeColor(uint32_t pass, uint32_t texture, bool clear, VkClearColorValue clearValue)
+{
+    VkClearValue value = {};
+    value.color = clearValue;
+    addUse(pass, texture, UseType::COLOR_WRITE, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, clear, value);
+}
+
+void RenderGraph::writeDepth(uint32_t pass, uint32_t texture, bool clear, float clearDepth)
+{
+    VkClearValue value = {};
+    value.depthStencil.depth = clearDepth;
+    addUse(pass, texture, UseType::DEPTH_WRITE,
+           VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, clear, value);
+}
+
+void RenderGraph::readDepth(uint32_t pass, uint32_t texture)
+{
+    addUse(pass, texture, UseType::DEPTH_READ,
+           VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, false, {});
+}
+
+void RenderGraph::resolve(uint32_t pass, uint32_t source, uint32_t target)
+{
+    const Use* sourceUse = findUse(m_Passes.at(pass), source);
+    const RGTextureDesc& sourceDesc = m_Textures.at(source).desc;
+    const RGTextureDesc& targetDesc = m_Textures.at(target).desc;
+    if (sourceUse == nullptr || sourceUse->type != UseType::COLOR_WRITE) {
+        throw std::runtime_error(m_Textures[source].name + " is resolved but not written by " + m_Passes[pass].name);
+    }
+    if (sourceDesc.samples == VK_SAMPLE_COUNT_1_BIT || targetDesc.samples != VK_SAMPLE_COUNT_1_BIT ||
+        sourceDesc.format != targetDesc.format) {
+        throw std::runtime_error("can't resolve " + m_Textures[source].name + " into " + m_Textures[target].name);
+    }
+    addUse(pass, target, UseType::RESOLVE, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, false, {});
+    m_Passes[pass].uses.back().resolveSource = source;
+}
+
+void RenderGraph::readAttachment(uint32_t pass, uint32_t texture)
+{
+    addUse(pass, texture, UseType::INPUT_ATTACHMENT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, false, {});
+}
+
+void RenderGraph::readTexture(uint32_t pass, uint32_t texture, VkPipelineStageFlags stages)
+{
+    addUse(pass, texture, UseType::SAMPLED, stages, false, {});
+}
+
+void RenderGraph::readStorage(uint32_t pass, uint32_t texture, VkPipelineStageFlags stages)
+{
+    addUse(pass, texture, UseType::STORAGE_READ, stages, false, {});
+}
+
+void RenderGraph::writeStorage(uint32_t pass, uint32_t texture, VkPipelineStageFlags stages)
+{
+    addUse(pass, texture, UseType::STORAGE_WRITE, stages, false, {});
+}
+
+void RenderGraph::addUse(uint32_t pass, uint32_t texture, UseType type, VkPipelineStageFlags stages,
+                         bool clear, VkClearValue clearValue)
+{
+    Pass& target = m_Passes.at(pass);
+    const Texture& tex = m_Textures.at(texture);
+    if (findUse(target, texture) != nullptr) {
+        throw std::runtime_error("pass " + target.name + " uses " + tex.name + " twice");
+    }
+    if (target.compute && isAttachmentUse(type)) {
+        throw std::runtime_error("compute pass " + target.name + " can't use " + tex.name + " as attachment");
+    }
+    bool depth = isDepthFormat(tex.desc.format);
+    if (((type == UseType::COLOR_WRITE || type == UseType::RESOLVE) && depth) ||
+        ((type == UseType::DEPTH_WRITE || type == UseType::DEPTH_READ) && !depth)) {
+        throw std::runtime_error("format of " + tex.name + " doesn't match its use in " + target.name);
+    }
+    target.uses.push_back({ texture, type, stages, clear, clearValue });
+    m_Compiled = false;
+}
+
+const RenderGraph::Use* RenderGraph::findUse(const Pass& pass, uint32_t texture) const
+{
+    for (const Use& use : pass.uses) {
+        if (use.texture == texture) {
+            return &use;
+        }
+    }
+    return nullptr;
+}
+
+bool RenderGraph::isAttachmentUse(UseType type)
+{
+    return type == UseType::COLOR_WRITE || type == UseType::RESOLVE || type == UseType::DEPTH_WRITE ||
+           type == UseType::DEPTH_READ || type == UseType::INPUT_ATTACHMENT;
+}
+
+bool RenderGraph::isWriteUse(UseType type)
+{
+    return type == UseType::COLOR_WRITE || type == UseType::RESOLVE || type == UseType::DEPTH_WRITE ||
+           type == UseType::STORAGE_WRITE;
+}
+
+bool RenderGraph::overwrites(const Use& use)
+{
+    return (isWriteUse(use.type) && use.clear) || use.type == UseType::RESOLVE;
+}
+
+RenderGraph::ImageState RenderGraph::stateForUse(const Use& use, bool depthFormat)
+{
+    ImageState state;
+    state.stages = use.stages;
+    state.written = isWriteUse(use.type);
+    switch (use.type) {
+        case UseType::COLOR_WRITE:
+            state.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            state.access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            break;
+        case UseType::RESOLVE:
+            state.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            state.access = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            break;
+        case UseType::DEPTH_WRITE:
+            state.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            state.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+            break;
+        case UseType::DEPTH_READ:
+            state.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+            state.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+            break;
+        case UseType::INPUT_ATTACHMENT:
+            state.layout = depthFormat ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            state.access = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+            break;
+        case UseType::SAMPLED:
+            state.layout = depthFormat ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            state.access = VK_ACCESS_SHADER_READ_BIT;
+            break;
+        case UseType::STORAGE_READ:
+            state.layout = VK_IMAGE_LAYOUT_GENERAL;
+            state.access = VK_ACCESS_SHADER_READ_BIT;
+            break;
+        case UseType::STORAGE_WRITE:
+            state.layout = VK_IMAGE_LAYOUT_GENERAL;
+            state.access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            break;
+    }
+    return state;
+}
+
+bool RenderGraph::isDepthFormat(VkFormat format)
+{
+    switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+VkImageAspectFlags RenderGraph::aspectMask(VkFormat format)
+{
+    switch (format) {
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return isDepthFormat(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+uint32_t RenderGraph::bytesPerPixel(VkFormat format)
+{
+    // Only used to estimate memory before realize(), unknown formats count as 4 bytes
+    switch (format) {
+        case VK_FORMAT_R8_UNORM:
+            return 1;
+        case VK_FORMAT_R8G8_UNORM:
+        case VK_FORMAT_R5G6B5_UNORM_PACK16:
+        case VK_FORMAT_R16_SFLOAT:
+        case VK_FORMAT_D16_UNORM:
+            return 2;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+        case VK_FORMAT_R32G32_SFLOAT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return 8;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            return 16;
+        default:
+            return 4;
+    }
+}
+
+void RenderGraph::compile()
+{
+    auto start = std::chrono::steady_clock::now();
+    resetCompiledState();
+    cullPasses();
+    buildSteps();
+    computeLifetimes();
+    assignAliasSlots();
+    computeAttachmentsAndBarriers();
+
+    m_Stats.passes = static_cast<uint32_t>(m_Passes.size());
+    for (const Pass& pass : m_Passes) {
+        m_Stats.culledPasses += pass.culled ? 1 : 0;
+    }
+    for (const Step& step : m_Steps) {
+        if (!step.compute) {
+            m_Stats.renderPasses++;
+            m_Stats.subpasses += static_cast<uint32_t>(step.passes.size());
+        }
+        m_Stats.barriers += static_cast<uint32_t>(step.barriers.size());
+    }
+    m_Stats.barriers += static_cast<uint32_t>(m_FinalBarriers.size());
+    m_Stats.aliasSlots = static_cast<uint32_t>(m_AliasSlots.size());
+    for (const AliasSlot& slot : m_AliasSlots) {
+        m_Stats.aliasedBytes += slot.size;
+        for (uint32_t texture : slot.textures) {
+            m_Stats.transientTextures++;
+            m_Stats.transientBytes += m_Textures[texture].estimatedSize;
+        }
+    }
+    m_Stats.compileMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    m_Compiled = true;
+}
+
+void RenderGraph::resetCompiledState()
+{
+    // Compiled steps own the render passes, a recompile needs a new realize()
+    destroyVulkanObjects();
+    for (Pass& pass : m_Passes) {
+        pass.culled = false;
+        pass.step = kInvalid;
+        pass.subpass = 0;
+    }
+    for (Texture& texture : m_Textures) {
+        texture.estimatedSize = 0;
+        texture.firstStep = kInvalid;
+        texture.lastStep = 0;
+        texture.aliasSlot = kInvalid;
+        texture.usage = 0;
+        texture.tileOnly = false;
+    }
+    m_Steps.clear();
+    m_AliasSlots.clear();
+    m_FinalBarriers.clear();
+    m_Stats = {};
+    m_Compiled = false;
+}
+
+void RenderGraph::cullPasses()
+{
+    // Backwards: a pass lives if it writes something a later live pass or an output needs.
+    // A clearing write kills the need for older contents, everything else keeps it.
+    std::vector<bool> needed(m_Textures.size());
+    for (size_t i = 0; i < m_Textures.size(); i++) {
+        needed[i] = m_Textures[i].output;
+    }
+    for (size_t i = m_Passes.size(); i-- > 0;) {
+        Pass& pass = m_Passes[i];
+        bool alive = pass.sideEffect;
+        for (const Use& use : pass.uses) {
+            alive = alive || (isWriteUse(use.type) && needed[use.texture]);
+        }
+        pass.culled = !alive;
+        if (!alive) {
+            continue;
+        }
+        for (const Use& use : pass.uses) {
+            needed[use.texture] = !overwrites(use);
+        }
+    }
+}
+
+void RenderGraph::buildSteps()
+{
+    for (uint32_t i = 0; i < m_Passes.size(); i++) {
+        Pass& pass = m_Passes[i];
+        if (pass.culled) {
+            continue;
+        }
+
+        // Resolve targets are single sampled, everything else shares the sample count
+        const RGTextureDesc* extent = nullptr;
+        for (const Use& use : pass.uses) {
+            if (!isAttachmentUse(use.type) || use.type == UseType::RESOLVE) {
+                continue;
+            }
+            const RGTextureDesc& desc = m_Textures[use.texture].desc;
+            if (extent == nullptr) {
+                extent = &desc;
+            } else if (desc.width != extent->width || desc.height != extent->height || desc.samples != extent->samples) {
+                throw std::runtime_error("attachments of " + pass.name + " differ in size or sample count");
+            }
+        }
+        if (!pass.compute && extent == nullptr) {
+            throw std::runtime_error("render pass " + pass.name + " has no attachments");
+        }
+
+        if (!pass.compute && !m_Steps.empty() && canMerge(m_Steps.back(), pass)) {
+            m_Steps.back().passes.push_back(i);
+            m_Steps.back().name += "+" + pass.name;
+        } else {
+            Step step;
+            step.name = pass.name;
+            step.compute = pass.compute;
+            step.passes.push_back(i);
+            if (extent != nullptr) {
+                step.width = extent->width;
+                step.height = extent->height;
+                step.samples = extent->samples;
+            }
+            m_Steps.push_back(std::move(step));
+        }
+        pass.step = static_cast<uint32_t>(m_Steps.size() - 1);
+        pass.subpass = static_cast<uint32_t>(m_Steps.back().passes.size() - 1);
+    }
+}
+
+bool RenderGraph::canMerge(const Step& step, const Pass& pass) const
+{
+    if (step.compute || pass.compute) {
+        return false;
+    }
+    for (const Use& use : pass.uses) {
+        if (!isAttachmentUse(use.type) || use.type == UseType::RESOLVE) {
+            continue;
+        }
+        const RGTextureDesc& desc = m_Textures[use.texture].desc;
+        if (desc.width != step.width || desc.height != step.height || desc.samples != step.samples) {
+            return false;
+        }
+        break;
+    }
+
+    for (uint32_t other : step.passes) {
+        for (const Use& use : m_Passes[other].uses) {
+            if (use.type == UseType::STORAGE_WRITE) {
+                return false;
+            }
+        }
+    }
+    for (const Use& use : pass.uses) {
+        if (use.type == UseType::STORAGE_WRITE) {
+            return false;
+        }
+        bool attachment = isAttachmentUse(use.type);
+        for (uint32_t other : step.passes) {
+            const Use* previous = findUse(m_Passes[other], use.texture);
+            if (previous == nullptr) {
+                continue;
+            }
+            // Only same pixel dependencies stay inside a render pass, a sampled read of something
+            // written here has to wait for the whole render pass
+            if (attachment != isAttachmentUse(previous->type)) {
+                return false;
+            }
+            // One layout per render pass for textures read by shaders
+            if (!attachment && previous->type != use.type) {
+                return false;
+            }
+            // Clears happen at the start of the render pass
+            if (overwrites(use)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void RenderGraph::computeLifetimes()
+{
+    for (const Pass& pass : m_Passes) {
+        if (pass.culled) {
+            continue;
+        }
+        for (const Use& use : pass.uses) {
+            Texture& texture = m_Textures[use.texture];
+            texture.firstStep = std::min(texture.firstStep, pass.step);
+            texture.lastStep = std::max(texture.lastStep, pass.step);
+            switch (use.type) {
+                case UseType::COLOR_WRITE:
+                case UseType::RESOLVE: texture.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; break;
+                case UseType::DEPTH_WRITE:
+                case UseType::DEPTH_READ: texture.usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT; break;
+                case UseType::INPUT_ATTACHMENT: texture.usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT; break;
+                case UseType::SAMPLED: texture.usage |= VK_IMAGE_USAGE_SAMPLED_BIT; break;
+                case UseType::STORAGE_READ:
+                case UseType::STORAGE_WRITE: texture.usage |= VK_IMAGE_USAGE_STORAGE_BIT; break;
+            }
+        }
+    }
+    const VkImageUsageFlags attachmentUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                                              VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+    for (Texture& texture : m_Textures) {
+        // Created, used and discarded inside one render pass: never loaded or stored, so the
+        // contents never have to leave tile memory
+        texture.tileOnly = !texture.imported && !texture.output && texture.firstStep != kInvalid &&
+                           texture.firstStep == texture.lastStep &&
+                           (texture.usage & ~attachmentUsage) == 0;
+        if (texture.tileOnly) {
+            texture.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        }
+        const RGTextureDesc& desc = texture.desc;
+        texture.estimatedSize = static_cast<uint64_t>(desc.width) * desc.height * desc.samples * bytesPerPixel(desc.format);
+    }
+}
+
+void RenderGraph::assignAliasSlots()
+{
+    std::vector<uint32_t> transients;
+    for (uint32_t i = 0; i < m_Textures.size(); i++) {
+        if (!m_Textures[i].imported && m_Textures[i].firstStep != kInvalid) {
+            transients.push_back(i);
+        }
+    }
+    std::sort(transients.begin(), transients.end(), [this](uint32_t a, uint32_t b) {
+        const Texture& ta = m_Textures[a];
+        const Texture& tb = m_Textures[b];
+        return ta.firstStep != tb.firstStep ? ta.firstStep < tb.firstStep : ta.estimatedSize > tb.estimatedSize;
+    });
+
+    // Greedy best fit: the smallest free slot that is big enough, otherwise grow the biggest free one
+    for (uint32_t index : transients) {
+        Texture& texture = m_Textures[index];
+        uint32_t best = kInvalid;
+        bool bestFits = false;
+        for (uint32_t s = 0; s < m_AliasSlots.size(); s++) {
+            const AliasSlot& slot = m_AliasSlots[s];
+            if (slot.lastStep >= texture.firstStep) {
+                continue;
+            }
+            bool fits = slot.size >= texture.estimatedSize;
+            if (best == kInvalid ||
+                (fits && (!bestFits || slot.size < m_AliasSlots[best].size)) ||
+                (!fits && !bestFits && slot.size > m_AliasSlots[best].size)) {
+                best = s;
+                bestFits = fits;
+            }
+        }
+        if (best == kInvalid) {
+            m_AliasSlots.emplace_back();
+            best = static_cast<uint32_t>(m_AliasSlots.size() - 1);
+        }
+        AliasSlot& slot = m_AliasSlots[best];
+        slot.size = std::max(slot.size, texture.estimatedSize);
+        slot.lastStep = texture.lastStep;
+        slot.textures.push_back(index);
+        texture.aliasSlot = best;
+    }
+}
+
+void RenderGraph::computeAttachmentsAndBarriers()
+{
+    // Uses of every texture in execution order, with the step they are in
+    std::vector<std::vector<std::pair<const Use*, uint32_t>>> textureUses(m_Textures.size());
+    for (uint32_t stepIndex = 0; stepIndex < m_Steps.size(); stepIndex++) {
+        for (uint32_t passIndex : m_Steps[stepIndex].passes) {
+            for (const Use& use : m_Passes[passIndex].uses) {
+                textureUses[use.texture].emplace_back(&use, stepIndex);
+            }
+        }
+    }
+    auto depthFormat = [this](uint32_t texture) { return isDepthFormat(m_Textures[texture].desc.format); };
+
+    std::vector<TrackState> tracks(m_Textures.size());
+    for (uint32_t i = 0; i < m_Textures.size(); i++) {
+        const Texture& texture = m_Textures[i];
+        if (texture.firstStep == kInvalid) {
+            continue;
+        }
+        TrackState& track = tracks[i];
+        if (texture.imported) {
+            // External producers (e.g. the acquire semaphore) are waited for at the first use
+            track.layout = texture.initialLayout;
+            track.writeStages = textureUses[i].front().first->stages;
+            track.hasContents = texture.initialLayout != VK_IMAGE_LAYOUT_UNDEFINED;
+        } else {
+            // The memory was last touched by a tenant of the same slot, in this frame or the previous one
+            for (uint32_t tenant : m_AliasSlots[texture.aliasSlot].textures) {
+                for (const auto& use : textureUses[tenant]) {
+                    ImageState state = stateForUse(*use.first, depthFormat(tenant));
+                    track.writeStages |= state.stages;
+                    track.writeAccess |= state.access & kWriteAccess;
+                }
+            }
+        }
+    }
+
+    // Returns true with the source scope when `use` has to wait for earlier accesses
+    auto sync = [](TrackState& track, const ImageState& use, ImageState& src) {
+        src = {};
+        src.layout = track.layout;
+        bool needed;
+        if (track.preSynced != 0 && track.layout == use.layout && (use.stages & ~track.preSynced) == 0) {
+            needed = false;
+        } else if (track.layout != use.layout || use.written) {
+            src.stages = track.writeStages | track.readStages;
+            src.access = track.writeAccess;
+            needed = track.layout != use.layout || src.stages != 0;
+        } else {
+            // Read after read in the same layout only waits if the write isn't visible yet
+            src.stages = track.writeStages;
+            src.access = track.writeAccess;
+            needed = track.writeStages != 0 && (use.stages & ~track.readStages) != 0;
+        }
+        track.preSynced = 0;
+        if (use.written || track.layout != use.layout) {
+            // Layout transitions count as writes
+            track.writeStages = use.stages;
+            track.writeAccess = use.access & kWriteAccess;
+            track.readStages = use.written ? 0 : use.stages;
+        } else {
+            track.readStages |= use.stages;
+        }
+        track.layout = use.layout;
+        track.hasContents = track.hasContents || use.written;
+        return needed;
+    };
+    auto addDependency = [](Step& step, uint32_t srcSubpass, uint32_t dstSubpass, const ImageState& src,
+                            const ImageState& dst) {
+        VkPipelineStageFlags srcStages = src.stages != 0 ? src.stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        VkPipelineStageFlags dstStages = dst.stages != 0 ? dst.stages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        for (VkSubpassDependency& dependency : step.dependencies) {
+            if (dependency.srcSubpass == srcSubpass && dependency.dstSubpass == dstSubpass) {
+                dependency.srcStageMask |= srcStages;
+                dependency.dstStageMask |= dstStages;
+                dependency.srcAccessMask |= src.access;
+                dependency.dstAccessMask |= dst.access;
+                return;
+            }
+        }
+        VkSubpassDependency dependency = {};
+        dependency.srcSubpass = srcSubpass;
+        dependency.dstSubpass = dstSubpass;
+        dependency.srcStageMask = srcStages;
+        dependency.dstStageMask = dstStages;
+        dependency.srcAccessMask = src.access;
+        dependency.dstAccessMask = dst.access;
+        bool internal = srcSubpass != VK_SUBPASS_EXTERNAL && dstSubpass != VK_SUBPASS_EXTERNAL;
+        dependency.dependencyFlags = internal ? VK_DEPENDENCY_BY_REGION_BIT : 0;
+        step.dependencies.push_back(dependency);
+    };
+    // Combined state of every use of a texture by the non attachment uses of a step
+    auto stepState = [&](const Step& step, uint32_t texture, ImageState& state) {
+        bool found = false;
+        for (uint32_t passIndex : step.passes) {
+            const Use* use = findUse(m_Passes[passIndex], texture);
+            if (use == nullptr || isAttachmentUse(use->type)) {
+                continue;
+            }
+            ImageState useState = stateForUse(*use, depthFormat(texture));
+            if (!found) {
+                state = useState;
+                found = true;
+            } else {
+                state.stages |= useState.stages;
+                state.access |= useState.access;
+                state.written = state.written || useState.written;
+            }
+        }
+        return found;
+    };
+
+    for (uint32_t stepIndex = 0; stepIndex < m_Steps.size(); stepIndex++) {
+        Step& step = m_Steps[stepIndex];
+
+        // Textures read by shaders: one barrier before the step covers every subpass
+        std::vector<uint32_t> shaderTextures;
+        for (uint32_t passIndex : step.passes) {
+            for (const Use& use : m_Passes[passIndex].uses) {
+                if (!isAttachmentUse(use.type) &&
+                    std::find(shaderTextures.begin(), shaderTextures.end(), use.texture) == shaderTextures.end()) {
+                    shaderTextures.push_back(use.texture);
+                }
+            }
+        }
+        for (uint32_t texture : shaderTextures) {
+            ImageState dst;
+            ImageState src;
+            stepState(step, texture, dst);
+            if (sync(tracks[texture], dst, src)) {
+                step.barriers.push_back({ texture, src, dst });
+            }
+        }
+        if (step.compute) {
+            continue;
+        }
+
+        // Attachments: the render pass does the layout transitions, subpass dependencies the rest
+        std::vector<uint32_t> lastSubpass;
+        for (uint32_t subpass = 0; subpass < step.passes.size(); subpass++) {
+            for (const Use& use : m_Passes[step.passes[subpass]].uses) {
+                if (!isAttachmentUse(use.type)) {
+                    continue;
+                }
+                TrackState& track = tracks[use.texture];
+                ImageState dst = stateForUse(use, depthFormat(use.texture));
+                ImageState src;
+
+                uint32_t index = 0;
+                while (index < step.attachments.size() && step.attachments[index].texture != use.texture) {
+                    index++;
+                }
+                if (index == step.attachments.size()) {
+                    Attachment attachment = {};
+                    attachment.texture = use.texture;
+                    if (isWriteUse(use.type) && use.clear) {
+                        attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+                        attachment.clearValue = use.clearValue;
+                    } else if (overwrites(use)) {
+                        attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                    } else {
+                        attachment.loadOp = track.hasContents ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                    }
+                    // Discarded contents don't need their old layout, tilers then skip the load
+                    attachment.initialLayout = attachment.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD ? track.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+                    step.attachments.push_back(attachment);
+                    lastSubpass.push_back(subpass);
+                    if (sync(track, dst, src) && src.stages != 0) {
+                        addDependency(step, VK_SUBPASS_EXTERNAL, subpass, src, dst);
+                    }
+                } else {
+                    if (sync(track, dst, src)) {
+                        addDependency(step, lastSubpass[index], subpass, src, dst);
+                    }
+                    lastSubpass[index] = subpass;
+                }
+            }
+        }
+
+        // Final layouts: straight into the layout of the next use when that one is outside a
+        // render pass, which saves the barrier there
+        for (uint32_t index = 0; index < step.attachments.size(); index++) {
+            Attachment& attachment = step.attachments[index];
+            const Texture& texture = m_Textures[attachment.texture];
+            TrackState& track = tracks[attachment.texture];
+            ImageState src;
+            src.stages = track.writeStages | track.readStages;
+            src.access = track.writeAccess;
+
+            const Use* next = nullptr;
+            uint32_t nextStep = kInvalid;
+            for (const auto& use : textureUses[attachment.texture]) {
+                if (use.second > stepIndex) {
+                    next = use.first;
+                    nextStep = use.second;
+                    break;
+                }
+            }
+
+            bool keep = texture.output || texture.imported || (next != nullptr && !overwrites(*next));
+            attachment.storeOp = keep ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+            ImageState dst;
+            if (next != nullptr && !isAttachmentUse(next->type) && stepState(m_Steps[nextStep], attachment.texture, dst)) {
+                attachment.finalLayout = dst.layout;
+                addDependency(step, lastSubpass[index], VK_SUBPASS_EXTERNAL, src, dst);
+                track.layout = dst.layout;
+                track.writeStages = dst.stages;
+                track.writeAccess = 0;
+                track.readStages = dst.stages;
+                track.preSynced = dst.stages;
+            } else if (next == nullptr && texture.imported && texture.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED) {
+                // Presentation waits on a semaphore, only the layout transition has to be ordered
+                attachment.finalLayout = texture.finalLayout;
+                dst.layout = texture.finalLayout;
+                addDependency(step, lastSubpass[index], VK_SUBPASS_EXTERNAL, src, dst);
+                track.layout = texture.finalLayout;
+            } else {
+                attachment.finalLayout = track.layout;
+            }
+        }
+        for (const Attachment& attachment : step.attachments) {
+            step.clearValues.push_back(attachment.clearValue);
+        }
+    }
+
+    // Imported textures last used outside a render pass
+    for (uint32_t i = 0; i < m_Textures.size(); i++) {
+        const Texture& texture = m_Textures[i];
+        if (!texture.imported || texture.firstStep == kInvalid || texture.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED ||
+            tracks[i].layout == texture.finalLayout) {
+            continue;
+        }
+        Barrier barrier = {};
+        barrier.texture = i;
+        barrier.before.layout = tracks[i].layout;
+        barrier.before.stages = tracks[i].writeStages | tracks[i].readStages;
+        barrier.before.access = tracks[i].writeAccess;
+        barrier.after.layout = texture.finalLayout;
+        m_FinalBarriers.push_back(barrier);
+    }
+}
+
+std::string RenderGraph::dump() const
+{
+    std::ostringstream out;
+    out << m_Stats.passes << " passes (" << m_Stats.culledPasses << " culled), "
+        << m_Stats.renderPasses << " render passes, " << m_Stats.subpasses << " subpasses, "
+        << m_Stats.barriers << " barriers, compiled in " << m_Stats.compileMs << " ms\n";
+    for (const Pass& pass : m_Passes) {
+        if (pass.culled) {
+            out << "  culled " << pass.name << "\n";
+        }
+    }
+    for (uint32_t s = 0; s < m_Steps.size(); s++) {
+        const Step& step = m_Steps[s];
+        for (const Barrier& barrier : step.barriers) {
+            out << "  barrier " << m_Textures[barrier.texture].name << " " << layoutName(barrier.before.layout)
+                << " -> " << layoutName(barrier.after.layout) << "\n";
+        }
+        if (step.compute) {
+            out << "  [" << s << "] compute " << m_Passes[step.passes[0]].name << "\n";
+            continue;
+        }
+        out << "  [" << s << "] render pass " << step.width << "x" << step.height << " x" << step.samples
+            << ", " << step.dependencies.size() << " dependencies\n";
+        for (uint32_t subpass = 0; subpass < step.passes.size(); subpass++) {
+            out << "      subpass " << subpass << " " << m_Passes[step.passes[subpass]].name << "\n";
+        }
+        for (const Attachment& attachment : step.attachments) {
+            out << "      " << m_Textures[attachment.texture].name << " " << loadOpName(attachment.loadOp) << "/"
+                << (attachment.storeOp == VK_ATTACHMENT_STORE_OP_STORE ? "STORE" : "DONT_CARE") << " "
+                << layoutName(attachment.initialLayout) << " -> " << layoutName(attachment.finalLayout) << "\n";
+        }
+    }
+    for (const Barrier& barrier : m_FinalBarriers) {
+        out << "  barrier " << m_Textures[barrier.texture].name << " " << layoutName(barrier.before.layout)
+            << " -> " << layoutName(barrier.after.layout) << "\n";
+    }
+    for (uint32_t s = 0; s < m_AliasSlots.size(); s++) {
+        out << "  memory " << s << " (" << m_AliasSlots[s].size / 1024 << " KiB):";
+        for (uint32_t texture : m_AliasSlots[s].textures) {
+            out << " " << m_Textures[texture].name << "[" << m_Textures[texture].firstStep << "-"
+                << m_Textures[texture].lastStep << "]" << (m_Textures[texture].tileOnly ? "(tile only)" : "");
+        }
+        out << "\n";
+    }
+    out << "  transient " << m_Stats.transientBytes / 1024 << " KiB, aliased " << m_Stats.aliasedBytes / 1024
+        << " KiB, lazily allocated " << m_Stats.lazyBytes / 1024 << " KiB\n";
+    return out.str();
+}
+
+void RenderGraph::realize(const ThreadSafeGfxDevice& threadSafeDevice)
+{
+    LOGD(m_TAG,__FUNCTION__);
+    auto dev = threadSafeDevice.lock();
+    if (dev == nullptr) {
+        throw std::runtime_error("RenderGraph realized without a device");
+    }
+    if (!m_Compiled) {
+        throw std::runtime_error("RenderGraph realized before compile");
+    }
+    destroyVulkanObjects();
+    m_VkDevice = dev->getDevice();
+
+    for (Step& step : m_Steps) {
+        if (!step.compute) {
+            createRenderPass(step);
+        }
+    }
+
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(dev->getVkPhysicalDevice(), &memoryProperties);
+    m_Stats.transientBytes = 0;
+    m_Stats.aliasedBytes = 0;
+    m_Stats.lazyTextures = 0;
+    m_Stats.lazyBytes = 0;
+    for (const AliasSlot& slot : m_AliasSlots) {
+        std::vector<VkMemoryRequirements> requirements(slot.textures.size());
+        for (size_t i = 0; i < slot.textures.size(); i++) {
+            Texture& texture = m_Textures[slot.textures[i]];
+            VkImageCreateInfo imageCreateInfo = {};
+            imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageCreateInfo.format = texture.desc.format;
+            imageCreateInfo.extent = { texture.desc.width, texture.desc.height, 1 };
+            imageCreateInfo.mipLevels = 1;
+            imageCreateInfo.arrayLayers = 1;
+            imageCreateInfo.samples = texture.desc.samples;
+            imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageCreateInfo.usage = texture.usage;
+            imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            CHECK_VK(vkCreateImage(m_VkDevice, &imageCreateInfo, nullptr, &texture.image));
+            vkGetImageMemoryRequirements(m_VkDevice, texture.image, &requirements[i]);
+            m_Stats.transientBytes += requirements[i].size;
+        }
+
+        // Tile only attachments go to lazily allocated memory when the device has it, tilers never
+        // back that with real memory. The others share one allocation.
+        std::vector<uint32_t> lazyTypes(slot.textures.size(), kInvalid);
+        VkDeviceSize size = 0;
+        uint32_t memoryTypeBits = ~0u;
+        uint32_t sharedCount = 0;
+        for (size_t i = 0; i < slot.textures.size(); i++) {
+            if (m_Textures[slot.textures[i]].tileOnly) {
+                lazyTypes[i] = findLazyMemoryType(memoryProperties, requirements[i].memoryTypeBits);
+            }
+            if (lazyTypes[i] == kInvalid) {
+                size = std::max(size, requirements[i].size);
+                memoryTypeBits &= requirements[i].memoryTypeBits;
+                sharedCount++;
+            }
+        }
+        // Every tenant syncs against all others, so dedicated memory stays correct as a fallback
+        bool shared = memoryTypeBits != 0;
+        if (!shared) {
+            LOGW(m_TAG,"no common memory type for alias slot, allocating %u images separately", sharedCount);
+        }
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        for (size_t i = 0; i < slot.textures.size(); i++) {
+            VkDeviceMemory bound = memory;
+            if (lazyTypes[i] != kInvalid) {
+                VkMemoryAllocateInfo memoryAllocInfo = {};
+                memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+                memoryAllocInfo.allocationSize = requirements[i].size;
+                memoryAllocInfo.memoryTypeIndex = lazyTypes[i];
+                CHECK_VK(vkAllocateMemory(m_VkDevice, &memoryAllocInfo, nullptr, &bound));
+                m_OwnedMemory.push_back(bound);
+                m_LazyMemory.push_back(bound);
+                m_Stats.lazyTextures++;
+                m_Stats.lazyBytes += memoryAllocInfo.allocationSize;
+            } else if (memory == VK_NULL_HANDLE || !shared) {
+                VkMemoryAllocateInfo memoryAllocInfo = {};
+                memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+                memoryAllocInfo.allocationSize = shared ? size : requirements[i].size;
+                memoryAllocInfo.memoryTypeIndex = GfxDevice::findMemoryTypeIndex(dev->getVkPhysicalDevice(),
+                        shared ? memoryTypeBits : requirements[i].memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                CHECK_VK(vkAllocateMemory(m_VkDevice, &memoryAllocInfo, nullptr, &memory));
+                m_OwnedMemory.push_back(memory);
+                m_Stats.aliasedBytes += memoryAllocInfo.allocationSize;
+                bound = memory;
+            }
+            Texture& texture = m_Textures[slot.textures[i]];
+            CHECK_VK(vkBindImageMemory(m_VkDevice, texture.image, bound, 0));
+
+            VkImageViewCreateInfo viewCreateInfo = {};
+            viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewCreateInfo.image = texture.image;
+            viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewCreateInfo.format = texture.desc.format;
+            viewCreateInfo.subresourceRange.aspectMask = isDepthFormat(texture.desc.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+            viewCreateInfo.subresourceRange.levelCount = 1;
+            viewCreateInfo.subresourceRange.layerCount = 1;
+            CHECK_VK(vkCreateImageView(m_VkDevice, &viewCreateInfo, nullptr, &texture.view));
+        }
+    }
+    // Memory report: what the transient textures would need on their own against what is really
+    // allocated, lazily allocated memory only counts once the driver commits it
+    LOGI(m_TAG,"%u transient textures need %llu KiB, allocated %llu KiB, %u tile only textures (%llu KiB) lazily allocated, saved %llu KiB",
+         m_Stats.transientTextures, static_cast<unsigned long long>(m_Stats.transientBytes / 1024),
+         static_cast<unsigned long long>(m_Stats.aliasedBytes / 1024), m_Stats.lazyTextures,
+         static_cast<unsigned long long>(m_Stats.lazyBytes / 1024),
+         static_cast<unsigned long long>((m_Stats.transientBytes - m_Stats.aliasedBytes) / 1024));
+}
+
+uint64_t RenderGraph::getLazyCommittedBytes() const
+{
+    uint64_t committed = 0;
+    for (VkDeviceMemory memory : m_LazyMemory) {
+        VkDeviceSize bytes = 0;
+        vkGetDeviceMemoryCommitment(m_VkDevice, memory, &bytes);
+        committed += bytes;
+    }
+    return committed;
+}
+
+void RenderGraph::createRenderPass(Step& step)
+{
+    const size_t subpassCount = step.passes.size();
+    auto attachmentIndex = [&step](uint32_t texture) {
+        uint32_t index = 0;
+        while (step.attachments[index].texture != texture) {
+            index++;
+        }
+        return index;
+    };
+
+    std::vector<VkAttachmentDescription> descriptions(step.attachments.size());
+    for (size_t i = 0; i < step.attachments.size(); i++) {
+        const Attachment& attachment = step.attachments[i];
+        descriptions[i].format = m_Textures[attachment.texture].desc.format;
+        descriptions[i].samples = m_Textures[attachment.texture].desc.samples;
+        descriptions[i].loadOp = attachment.loadOp;
+        descriptions[i].storeOp = attachment.storeOp;
+        descriptions[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        descriptions[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        descriptions[i].initialLayout = attachment.initialLayout;
+        descriptions[i].finalLayout = attachment.finalLayout;
+    }
+
+    std::vector<std::vector<VkAttachmentReference>> colorRefs(subpassCount);
+    std::vector<std::vector<VkAttachmentReference>> inputRefs(subpassCount);
+    std::vector<std::vector<VkAttachmentReference>> resolveRefs(subpassCount);
+    std::vector<std::vector<uint32_t>> preserveRefs(subpassCount);
+    std::vector<VkAttachmentReference> depthRefs(subpassCount, { VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED });
+    std::vector<uint32_t> firstSubpass(step.attachments.size(), kInvalid);
+    std::vector<uint32_t> lastSubpass(step.attachments.size(), 0);
+    for (uint32_t subpass = 0; subpass < subpassCount; subpass++) {
+        for (const Use& use : m_Passes[step.passes[subpass]].uses) {
+            if (!isAttachmentUse(use.type)) {
+                continue;
+            }
+            uint32_t index = attachmentIndex(use.texture);
+            VkAttachmentReference reference = { index, stateForUse(use, isDepthFormat(m_Textures[use.texture].desc.format)).layout };
+            if (use.type == UseType::COLOR_WRITE) {
+                colorRefs[subpass].push_back(reference);
+            } else if (use.type == UseType::RESOLVE) {
+                // Parallel to the color attachments, the source was added before
+                uint32_t source = attachmentIndex(use.resolveSource);
+                uint32_t color = 0;
+                while (colorRefs[subpass][color].attachment != source) {
+                    color++;
+                }
+                resolveRefs[subpass].resize(colorRefs[subpass].size(), { VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED });
+                resolveRefs[subpass][color] = reference;
+            } else if (use.type == UseType::INPUT_ATTACHMENT) {
+                inputRefs[subpass].push_back(reference);
+            } else {
+                depthRefs[subpass] = reference;
+            }
+            firstSubpass[index] = std::min(firstSubpass[index], subpass);
+            lastSubpass[index] = subpass;
+        }
+    }
+    // Contents written earlier and needed later survive the subpasses in between
+    for (uint32_t subpass = 0; subpass < subpassCount; subpass++) {
+        for (uint32_t index = 0; index < step.attachments.size(); index++) {
+            bool neededLater = lastSubpass[index] > subpass || step.attachments[index].storeOp == VK_ATTACHMENT_STORE_OP_STORE;
+            if (firstSubpass[index] < subpass && neededLater &&
+                findUse(m_Passes[step.passes[subpass]], step.attachments[index].texture) == nullptr) {
+                preserveRefs[subpass].push_back(index);
+            }
+        }
+    }
+
+    std::vector<VkSubpassDescription> subpasses(subpassCount);
+    for (size_t i = 0; i < subpassCount; i++) {
+        subpasses[i].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpasses[i].colorAttachmentCount = static_cast<uint32_t>(colorRefs[i].size());
+        subpasses[i].pColorAttachments = colorRefs[i].data();
+        if (!resolveRefs[i].empty()) {
+            resolveRefs[i].resize(colorRefs[i].size(), { VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED });
+            subpasses[i].pResolveAttachments = resolveRefs[i].data();
+        }
+        subpasses[i].inputAttachmentCount = static_cast<uint32_t>(inputRefs[i].size());
+        subpasses[i].pInputAttachments = inputRefs[i].data();
+        subpasses[i].preserveAttachmentCount = static_cast<uint32_t>(preserveRefs[i].size());
+        subpasses[i].pPreserveAttachments = preserveRefs[i].data();
+        subpasses[i].pDepthStencilAttachment = depthRefs[i].attachment != VK_ATTACHMENT_UNUSED ? &depthRefs[i] : nullptr;
+    }
+
+    VkRenderPassCreateInfo renderPassCreateInfo = {};
+    renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassCreateInfo.attachmentCount = static_cast<uint32_t>(descriptions.size());
+    renderPassCreateInfo.pAttachments = descriptions.data();
+    renderPassCreateInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+    renderPassCreateInfo.pSubpasses = subpasses.data();
+    renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(step.dependencies.size());
+    renderPassCreateInfo.pDependencies = step.dependencies.data();
+    CHECK_VK(vkCreateRenderPass(m_VkDevice, &renderPassCreateInfo, nullptr, &step.renderPass));
+}
+
+void RenderGraph::setImportedImage(uint32_t texture, VkImage image, VkImageView view)
+{
+    Texture& target = m_Textures.at(texture);
+    if (!target.imported) {
+        throw std::runtime_error(target.name + " is not imported");
+    }
+    target.image = image;
+    target.view = view;
+}
+
+VkFramebuffer RenderGraph::getFramebuffer(const Step& step)
+{
+    std::vector<VkImageView> views(step.attachments.size());
+    Hasher hasher;
+    hasher.value(step.renderPass).value(step.width).value(step.height);
+    for (size_t i = 0; i < step.attachments.size(); i++) {
+        views[i] = m_Textures[step.attachments[i].texture].view;
+        if (views[i] == VK_NULL_HANDLE) {
+            throw std::runtime_error("no image view for " + m_Textures[step.attachments[i].texture].name);
+        }
+        hasher.value(views[i]);
+    }
+    const uint64_t key = hasher.get();
+    const auto range = m_Framebuffers.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        const Framebuffer& cached = it->second;
+        if (cached.renderPass == step.renderPass && cached.views == views &&
+            cached.width == step.width && cached.height == step.height) {
+            return cached.framebuffer;
+        }
+    }
+
+    VkFramebufferCreateInfo framebufferCreateInfo = {};
+    framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferCreateInfo.renderPass = step.renderPass;
+    framebufferCreateInfo.attachmentCount = static_cast<uint32_t>(views.size());
+    framebufferCreateInfo.pAttachments = views.data();
+    framebufferCreateInfo.width = step.width;
+    framebufferCreateInfo.height = step.height;
+    framebufferCreateInfo.layers = 1;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    CHECK_VK(vkCreateFramebuffer(m_VkDevice, &framebufferCreateInfo, nullptr, &framebuffer));
+    m_Framebuffers.emplace(key, Framebuffer{step.renderPass, std::move(views), step.width, step.height, framebuffer});
+    return framebuffer;
+}
+
+void RenderGraph::prepareFramebuffers()
+{
+    for (const Step& step : m_Steps) {
+        if (!step.compute) {
+            getFramebuffer(step);
+        }
+    }
+}
+
+void RenderGraph::releaseFramebuffers()
+{
+    for (auto& framebuffer : m_Framebuffers) {
+        vkDestroyFramebuffer(m_VkDevice, framebuffer.second.framebuffer, nullptr);
+    }
+    m_Framebuffers.clear();
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer)
+{
+    auto recordBarriers = [this, commandBuffer](const std::vector<Barrier>& barriers) {
+        if (barriers.empty()) {
+            return;
+        }
+        std::vector<VkImageMemoryBarrier> imageBarriers(barriers.size());
+        VkPipelineStageFlags srcStages = 0;
+        VkPipelineStageFlags dstStages = 0;
+        for (size_t i = 0; i < barriers.size(); i++) {
+            const Texture& texture = m_Textures[barriers[i].texture];
+            VkImageMemoryBarrier& imageBarrier = imageBarriers[i];
+            imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            imageBarrier.srcAccessMask = barriers[i].before.access;
+            imageBarrier.dstAccessMask = barriers[i].after.access;
+            imageBarrier.oldLayout = barriers[i].before.layout;
+            imageBarrier.newLayout = barriers[i].after.layout;
+            imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.image = texture.image;
+            imageBarrier.subresourceRange = { aspectMask(texture.desc.format), 0, 1, 0, 1 };
+            srcStages |= barriers[i].before.stages;
+            dstStages |= barriers[i].after.stages;
+        }
+        vkCmdPipelineBarrier(commandBuffer,
+                             srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             dstStages != 0 ? dstStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+    };
+
+    for (const Step& step : m_Steps) {
+        recordBarriers(step.barriers);
+        GpuProfiler::Scope zone(m_Profiler, commandBuffer, step.name);
+        if (step.compute) {
+            m_Passes[step.passes[0]].execute(commandBuffer);
+            continue;
+        }
+
+        VkRenderPassBeginInfo renderPassBeginInfo = {};
+        renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassBeginInfo.renderPass = step.renderPass;
+        m_ExecutingFramebuffer = getFramebuffer(step);
+        renderPassBeginInfo.framebuffer = m_ExecutingFramebuffer;
+        renderPassBeginInfo.renderArea.offset = { 0, 0 };
+        renderPassBeginInfo.renderArea.extent = { step.width, step.height };
+        renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(step.clearValues.size());
+        renderPassBeginInfo.pClearValues = step.clearValues.data();
+        for (size_t subpass = 0; subpass < step.passes.size(); subpass++) {
+            const Pass& pass = m_Passes[step.passes[subpass]];
+            const VkSubpassContents contents = pass.secondary ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                                                              : VK_SUBPASS_CONTENTS_INLINE;
+            if (subpass == 0) {
+                vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, contents);
+            } else {
+                vkCmdNextSubpass(commandBuffer, contents);
+            }
+            pass.execute(commandBuffer);
+        }
+        vkCmdEndRenderPass(commandBuffer);
+    }
+    m_ExecutingFramebuffer = VK_NULL_HANDLE;
+    recordBarriers(m_FinalBarriers);
+}
+
+VkRenderPass RenderGraph::getRenderPass(uint32_t pass) const
+{
+    const Pass& target = m_Passes.at(pass);
+    if (target.culled || target.step == kInvalid || m_Steps[target.step].compute) {
+        throw std::runtime_error(target.name + " has no render pass");
+    }
+    return m_Steps[target.step].renderPass;
+}
+
+VkCommandBufferInheritanceInfo RenderGraph::getInheritanceInfo(uint32_t pass) const
+{
+    VkCommandBufferInheritanceInfo inheritance = {};
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance.renderPass = getRenderPass(pass);
+    inheritance.subpass = m_Passes[pass].subpass;
+    inheritance.framebuffer = m_ExecutingFramebuffer;
+    return inheritance;
+}
+
+void RenderGraph::destroyVulkanObjects()
+{
+    if (m_VkDevice == VK_NULL_HANDLE) {
+        return;
+    }
+    releaseFramebuffers();
+    for (Texture& texture : m_Textures) {
+        if (texture.imported) {
+            continue;
+        }
+        vkDestroyImageView(m_VkDevice, texture.view, nullptr);
+        vkDestroyImage(m_VkDevice, texture.image, nullptr);
+        texture.view = VK_NULL_HANDLE;
+        texture.image = VK_NULL_HANDLE;
+    }
+    for (VkDeviceMemory memory : m_OwnedMemory) {
+        vkFreeMemory(m_VkDevice, memory, nullptr);
+    }
+    m_OwnedMemory.clear();
+    m_LazyMemory.clear();
+    for (Step& step : m_Steps) {
+        vkDestroyRenderPass(m_VkDevice, step.renderPass, nullptr);
+        step.renderPass = VK_NULL_HANDLE;
+    }
+    m_VkDevice = VK_NULL_HANDLE;
+}
+
+BenchmarkResult RenderGraph::benchmarkCompile(uint32_t passCount, uint32_t iterations)
+{
+    const RGTextureDesc color = { VK_FORMAT_R8G8B8A8_UNORM, 1920, 1080, VK_SAMPLE_COUNT_1_BIT };
+    const RGTextureDesc hdr = { VK_FORMAT_R16G16B16A16_SFLOAT, 1920, 1080, VK_SAMPLE_COUNT_1_BIT };
+    const RGTextureDesc depth = { VK_FORMAT_D32_SFLOAT, 1920, 1080, VK_SAMPLE_COUNT_1_BIT };
+    auto noop = [](VkCommandBuffer) {};
+
+    RenderGraph graph;
+    uint32_t backbuffer = graph.importTexture("backbuffer", color, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    graph.markOutput(backbuffer);
+    uint32_t albedo = kInvalid;
+    uint32_t sceneDepth = kInvalid;
+    uint32_t lit = kInvalid;
+    uint32_t post = kInvalid;
+    for (uint32_t i = 0; i < passCount; i++) {
+        std::string index = std::to_string(i);
+        uint32_t pass;
+        switch (i % 4) {
+            case 0:
+                albedo = graph.createTexture("albedo" + index, color);
+                sceneDepth = graph.createTexture("depth" + index, depth);
+                pass = graph.addPass("gbuffer" + index, noop);
+                graph.writeColor(pass, albedo, true);
+                graph.writeDepth(pass, sceneDepth, true);
+                break;
+            case 1: {
+                // Input attachments only, merges with the g-buffer pass
+                lit = graph.createTexture("lit" + index, hdr);
+                pass = graph.addPass("lighting" + index, noop);
+                graph.readAttachment(pass, albedo);
+                graph.readDepth(pass, sceneDepth);
+                graph.writeColor(pass, lit, true);
+                break;
+            }
+            case 2: {
+                uint32_t accumulated = graph.createTexture("post" + index, hdr);
+                pass = graph.addPass("post" + index, noop);
+                graph.readTexture(pass, lit);
+                if (post != kInvalid) {
+                    graph.readTexture(pass, post);
+                }
+                graph.writeColor(pass, accumulated, true);
+                post = accumulated;
+                break;
+            }
+            default: {
+                // Debug view nobody reads, culled
+                uint32_t debug = graph.createTexture("debug" + index, color);
+                pass = graph.addPass("debug" + index, noop);
+                graph.writeColor(pass, debug, true);
+                break;
+            }
+        }
+    }
+    uint32_t composite = graph.addPass("composite", noop);
+    uint32_t source = post != kInvalid ? post : (lit != kInvalid ? lit : albedo);
+    if (source != kInvalid) {
+        graph.readTexture(composite, source);
+    }
+    graph.writeColor(composite, backbuffer, true);
+
+    BenchmarkResult result = runBenchmark("RenderGraph::compile " + std::to_string(passCount + 1) + " passes",
+                                          iterations, [&graph]() { graph.compile(); });
+    LOGI(m_TAG,"%s", graph.dump().c_str());
+    return result;
+}
@@ -0,0 +1,249 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../../Utils/Definitions.h"
+#include "../../Utils/Benchmark.h"
+#include "GfxDevice.h"
+
+class GpuProfiler;
+
+struct RGTextureDesc {
+    VkFormat format{VK_FORMAT_UNDEFINED};
+    uint32_t width{0};
+    uint32_t height{0};
+    VkSampleCountFlagBits samples{VK_SAMPLE_COUNT_1_BIT};
+};
+
+struct RenderGraphStats {
+    uint32_t passes{0};
+    uint32_t culledPasses{0};
+    uint32_t renderPasses{0};       // VkRenderPasses after merging, compute passes not counted
+    uint32_t subpasses{0};
+    uint32_t barriers{0};           // image barriers recorded per frame
+    uint32_t transientTextures{0};
+    uint32_t aliasSlots{0};         // memory blocks backing the transient textures
+    uint64_t transientBytes{0};     // without aliasing
+    uint64_t aliasedBytes{0};       // with aliasing, lazily allocated memory not included
+    uint32_t lazyTextures{0};       // tile only attachments in lazily allocated memory (after realize)
+    uint64_t lazyBytes{0};
+    double compileMs{0.0};
+};
+
+// Frame graph of render and compute passes. Passes declare which textures they read and write,
+// compile() then
+//  - culls passes that contribute nothing to an output,
+//  - merges consecutive compatible graphics passes into subpasses of one VkRenderPass so
+//    attachments stay in tile memory (only attachment / input attachment dependencies merge),
+//  - picks load / store ops, so attachments nobody reads later are never written back,
+//  - computes the image barriers and layout transitions between render passes, skipping
+//    read after read in the same layout,
+//  - lets transient textures with disjoint lifetimes share memory,
+//  - marks attachments that live inside one render pass and are never stored as transient, they
+//    get lazily allocated memory where available so tilers keep them in tile memory only.
+// realize() creates the Vulkan objects, execute() records a frame.
+class RenderGraph {
+public:
+    using PassCallback = std::function<void(VkCommandBuffer)>;
+    static constexpr uint32_t kInvalid = ~0u;
+
+    NONCOPYABLE(RenderGraph);
+    RenderGraph() = default;
+    ~RenderGraph();
+
+    // Owned by the graph, memory may be aliased with other transient textures
+    uint32_t createTexture(const std::string& name, const RGTextureDesc& desc);
+    // Owned elsewhere (swapchain), the image is provided every frame with setImportedImage
+    uint32_t importTexture(const std::string& name, const RGTextureDesc& desc,
+                           VkImageLayout initialLayout, VkImageLayout finalLayout);
+    void markOutput(uint32_t texture);
+
+    uint32_t addPass(const std::string& name, PassCallback execute);
+    uint32_t addComputePass(const std::string& name, PassCallback execute);
+    // Never culled (e.g. writes buffers the graph doesn't know about)
+    void setSideEffect(uint32_t pass);
+    // The pass's subpass is recorded into secondary command buffers, its callback may only
+    // vkCmdExecuteCommands them. Doesn't change the compiled graph, may change between frames.
+    void setSecondaryCommandBuffers(uint32_t pass, bool secondary);
+
+    void writeColor(uint32_t pass, uint32_t texture, bool clear = false, VkClearColorValue clearValue = {});
+    void writeDepth(uint32_t pass, uint32_t texture, bool clear = false, float clearDepth = 1.0f);
+    void readDepth(uint32_t pass, uint32_t texture);
+    // Resolves the multisampled color `source` written by the pass into the single sampled
+    // `target` at the end of the subpass, call after writeColor(pass, source)
+    void resolve(uint32_t pass, uint32_t source, uint32_t target);
+    // Read at the same pixel through an input attachment, the pass can merge with the writer
+    void readAttachment(uint32_t pass, uint32_t texture);
+    void readTexture(uint32_t pass, uint32_t texture, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    void readStorage(uint32_t pass, uint32_t texture, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    void writeStorage(uint32_t pass, uint32_t texture, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+    // Pure CPU, no Vulkan calls
+    void compile();
+    std::string dump() const;
+    const RenderGraphStats& getStats() const { return m_Stats; }
+
+    // Creates render passes, transient images and their (aliased) memory. Call again after the
+    // graph changed, previous objects are destroyed.
+    void realize(const ThreadSafeGfxDevice& threadSafeDevice);
+    void setImportedImage(uint32_t texture, VkImage image, VkImageView view);
+    // Framebuffers are cached per set of image views, this creates them up front for the
+    // currently imported images instead of on first use in execute()
+    void prepareFramebuffers();
+    // Destroys the cached framebuffers, call when the imported image views were recreated
+    void releaseFramebuffers();
+    void execute(VkCommandBuffer commandBuffer);
+    // Every render pass / compute pass gets a GPU timestamp zone, nullptr turns it off
+    void setProfiler(GpuProfiler* profiler) { m_Profiler = profiler; }
+
+    VkRenderPass getRenderPass(uint32_t pass) const;
+    uint32_t getSubpass(uint32_t pass) const { return m_Passes[pass].subpass; }
+    // What the pass's secondary command buffers inherit, only valid inside its callback
+    VkCommandBufferInheritanceInfo getInheritanceInfo(uint32_t pass) const;
+    bool isCulled(uint32_t pass) const { return m_Passes[pass].culled; }
+    // Memory the driver actually committed for the lazily allocated attachments
+    uint64_t getLazyCommittedBytes() const;
+
+    // Builds and compiles a synthetic deferred style frame of passCount passes
+    static BenchmarkResult benchmarkCompile(uint32_t passCount, uint32_t iterations);
+
+private:
+    enum class UseType : uint8_t {
+        COLOR_WRITE,
+        RESOLVE,
+        DEPTH_WRITE,
+        DEPTH_READ,
+        INPUT_ATTACHMENT,
+        SAMPLED,
+        STORAGE_READ,
+        STORAGE_WRITE,
+    };
+    struct Use {
+        uint32_t texture;
+        UseType type;
+        VkPipelineStageFlags stages;
+        bool clear;
+        VkClearValue clearValue;
+        uint32_t resolveSource{kInvalid};
+    };
+    struct ImageState {
+        VkImageLayout layout{VK_IMAGE_LAYOUT_UNDEFINED};
+        VkPipelineStageFlags stages{0};
+        VkAccessFlags access{0};
+        bool written{false};
+    };
+    struct Texture {
+        std::string name;
+        RGTextureDesc desc;
+        bool imported{false};
+        bool output{false};
+        VkImageLayout initialLayout{VK_IMAGE_LAYOUT_UNDEFINED};
+        VkImageLayout finalLayout{VK_IMAGE_LAYOUT_UNDEFINED};
+        // compiled
+        uint64_t estimatedSize{0};
+        uint32_t firstStep{kInvalid};
+        uint32_t lastStep{0};
+        uint32_t aliasSlot{kInvalid};
+        VkImageUsageFlags usage{0};
+        bool tileOnly{false};
+        // realized / imported
+        VkImage image{VK_NULL_HANDLE};
+        VkImageView view{VK_NULL_HANDLE};
+    };
+    struct Pass {
+        std::string name;
+        bool compute{false};
+        bool sideEffect{false};
+        bool secondary{false};
+        PassCallback execute;
+        std::vector<Use> uses;
+        // compiled
+        bool culled{false};
+        uint32_t step{kInvalid};
+        uint32_t subpass{0};
+    };
+    struct Attachment {
+        uint32_t texture;
+        VkAttachmentLoadOp loadOp;
+        VkAttachmentStoreOp storeOp;
+        VkImageLayout initialLayout;
+        VkImageLayout finalLayout;
+        VkClearValue clearValue;
+    };
+    struct Barrier {
+        uint32_t texture;
+        ImageState before;
+        ImageState after;
+    };
+    // One VkRenderPass with its subpasses, or a single compute pass
+    struct Step {
+        std::string name;                       // merged pass names, for profiling
+        bool compute{false};
+        std::vector<uint32_t> passes;
+        std::vector<Attachment> attachments;
+        std::vector<Barrier> barriers;          // recorded before the step
+        std::vector<VkSubpassDependency> dependencies;
+        std::vector<VkClearValue> clearValues;  // one per attachment
+        uint32_t width{0};
+        uint32_t height{0};
+        VkSampleCountFlagBits samples{VK_SAMPLE_COUNT_1_BIT};
+        VkRenderPass renderPass{VK_NULL_HANDLE};
+    };
+    struct AliasSlot {
+        uint64_t size{0};
+        uint32_t lastStep{0};
+        std::vector<uint32_t> textures;         // tenants ordered by lifetime
+    };
+    // Keyed by everything the create info depends on, equal hashes are told apart by comparing it
+    struct Framebuffer {
+        VkRenderPass renderPass;
+        std::vector<VkImageView> views;
+        uint32_t width;
+        uint32_t height;
+        VkFramebuffer framebuffer;
+    };
+
+    static bool isAttachmentUse(UseType type);
+    static bool isWriteUse(UseType type);
+    // Writes every pixel, older contents are dead
+    static bool overwrites(const Use& use);
+    static ImageState stateForUse(const Use& use, bool depthFormat);
+    static bool isDepthFormat(VkFormat format);
+    static VkImageAspectFlags aspectMask(VkFormat format);
+    static uint32_t bytesPerPixel(VkFormat format);
+    void addUse(uint32_t pass, uint32_t texture, UseType type, VkPipelineStageFlags stages, bool clear, VkClearValue clearValue);
+    const Use* findUse(const Pass& pass, uint32_t texture) const;
+
+    void resetCompiledState();
+    void cullPasses();
+    void buildSteps();
+    bool canMerge(const Step& step, const Pass& pass) const;
+    void computeLifetimes();
+    void assignAliasSlots();
+    void computeAttachmentsAndBarriers();
+
+    void createRenderPass(Step& step);
+    VkFramebuffer getFramebuffer(const Step& step);
+    void destroyVulkanObjects();
+
+    std::vector<Texture> m_Textures;
+    std::vector<Pass> m_Passes;
+    std::vector<Step> m_Steps;
+    std::vector<AliasSlot> m_AliasSlots;
+    std::vector<Barrier> m_FinalBarriers;       // imported textures left outside a render pass
+    RenderGraphStats m_Stats{};
+    bool m_Compiled{false};
+
+    VkDevice m_VkDevice{VK_NULL_HANDLE};
+    std::vector<VkDeviceMemory> m_OwnedMemory;
+    std::vector<VkDeviceMemory> m_LazyMemory;   // subset of m_OwnedMemory
+    std::unordered_multimap<uint64_t, Framebuffer> m_Framebuffers;
+    VkFramebuffer m_ExecutingFramebuffer{VK_NULL_HANDLE};
+    GpuProfiler* m_Profiler{nullptr};
+    static constexpr LogTag m_TAG{"RenderGraph"};
+};
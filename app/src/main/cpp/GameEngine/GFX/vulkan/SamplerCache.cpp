@@ -0,0 +1,125 @@
+#include <algorithm>
+
+#include "SamplerCache.h"
+#include "TextureSampler.h"
+#include "GfxUtils.h"
+#include "../../Utils/Hash.h"
+
+SamplerCache::SamplerCache(const ThreadSafeGfxDevice& threadSafeDevice)
+{
+    auto dev = threadSafeDevice.lock();
+    if (dev == nullptr) {
+        throw std::runtime_error("SamplerCache created without a device");
+    }
+    m_VkDevice = dev->getDevice();
+    m_MinMaxFilterSupported = dev->isSamplerMinMaxSupported();
+
+    VkPhysicalDeviceProperties properties = {};
+    vkGetPhysicalDeviceProperties(dev->getVkPhysicalDevice(), &properties);
+    m_MaxSamplers = properties.limits.maxSamplerAllocationCount;
+    // 0 without the samplerAnisotropy feature: anisotropic create infos are downgraded to plain filtering
+    m_MaxAnisotropy = dev->isSamplerAnisotropySupported() ? properties.limits.maxSamplerAnisotropy : 0.0f;
+}
+
+SamplerCache::~SamplerCache()
+{
+    for (auto& sampler : m_Samplers) {
+        vkDestroySampler(m_VkDevice, sampler.second.sampler, nullptr);
+    }
+}
+
+const VkSamplerReductionModeCreateInfoEXT* SamplerCache::findReductionMode(const VkSamplerCreateInfo& createInfo)
+{
+    const VkSamplerReductionModeCreateInfoEXT* reduction = nullptr;
+    for (auto* next = static_cast<const VkBaseInStructure*>(createInfo.pNext); next != nullptr; next = next->pNext) {
+        if (next->sType != VK_STRUCTURE_TYPE_SAMPLER_REDUCTION_MODE_CREATE_INFO_EXT) {
+            throw std::runtime_error("SamplerCache can't hash sampler pNext structure");
+        }
+        reduction = reinterpret_cast<const VkSamplerReductionModeCreateInfoEXT*>(next);
+    }
+    return reduction;
+}
+
+uint64_t SamplerCache::hashCreateInfo(const VkSamplerCreateInfo& createInfo)
+{
+    // Field by field, the struct has padding and a pNext pointer
+    Hasher hasher;
+    hasher.value(createInfo.flags).value(createInfo.magFilter).value(createInfo.minFilter)
+          .value(createInfo.mipmapMode).value(createInfo.addressModeU).value(createInfo.addressModeV)
+          .value(createInfo.addressModeW).value(createInfo.mipLodBias).value(createInfo.anisotropyEnable)
+          .value(createInfo.maxAnisotropy).value(createInfo.compareEnable).value(createInfo.compareOp)
+          .value(createInfo.minLod).value(createInfo.maxLod).value(createInfo.borderColor)
+          .value(createInfo.unnormalizedCoordinates);
+    if (auto* reduction = findReductionMode(createInfo)) {
+        hasher.value(reduction->sType).value(reduction->reductionMode);
+    }
+    return hasher.get();
+}
+
+bool SamplerCache::matches(const Entry& entry, const VkSamplerCreateInfo& createInfo)
+{
+    const VkSamplerCreateInfo& l = entry.createInfo;
+    const VkSamplerCreateInfo& r = createInfo;
+    if (l.flags != r.flags || l.magFilter != r.magFilter || l.minFilter != r.minFilter ||
+        l.mipmapMode != r.mipmapMode || l.addressModeU != r.addressModeU || l.addressModeV != r.addressModeV ||
+        l.addressModeW != r.addressModeW || l.mipLodBias != r.mipLodBias || l.anisotropyEnable != r.anisotropyEnable ||
+        l.maxAnisotropy != r.maxAnisotropy || l.compareEnable != r.compareEnable || l.compareOp != r.compareOp ||
+        l.minLod != r.minLod || l.maxLod != r.maxLod || l.borderColor != r.borderColor ||
+        l.unnormalizedCoordinates != r.unnormalizedCoordinates) {
+        return false;
+    }
+    const auto* reduction = findReductionMode(createInfo);
+    if (reduction == nullptr) {
+        return !entry.hasReductionMode;
+    }
+    return entry.hasReductionMode && entry.reductionMode == reduction->reductionMode;
+}
+
+VkSampler SamplerCache::getSampler(const VkSamplerCreateInfo& requestedCreateInfo)
+{
+    // Requests above what the device allows share the sampler created at the limit
+    VkSamplerCreateInfo createInfo = requestedCreateInfo;
+    if (createInfo.anisotropyEnable == VK_TRUE) {
+        if (m_MaxAnisotropy < 1.0f) {
+            createInfo.anisotropyEnable = VK_FALSE;
+            createInfo.maxAnisotropy = 1.0f;
+        } else {
+            createInfo.maxAnisotropy = std::min(createInfo.maxAnisotropy, m_MaxAnisotropy);
+        }
+    }
+    const uint64_t key = hashCreateInfo(createInfo);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto range = m_Samplers.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (matches(it->second, createInfo)) {
+            return it->second.sampler;
+        }
+    }
+    if (m_Samplers.size() >= m_MaxSamplers) {
+        LOGE(m_TAG,"maxSamplerAllocationCount (%u) reached", m_MaxSamplers);
+        throw std::runtime_error("too many unique samplers");
+    }
+
+    VkSampler sampler;
+    CHECK_VK(vkCreateSampler(m_VkDevice, &createInfo, nullptr, &sampler));
+    Entry entry = {createInfo, false, VK_SAMPLER_REDUCTION_MODE_WEIGHTED_AVERAGE_EXT, sampler};
+    entry.createInfo.pNext = nullptr;
+    if (auto* reduction = findReductionMode(createInfo)) {
+        entry.hasReductionMode = true;
+        entry.reductionMode = reduction->reductionMode;
+    }
+    m_Samplers.emplace(key, entry);
+    LOGD(m_TAG,"%zu unique samplers", m_Samplers.size());
+    return sampler;
+}
+
+VkSampler SamplerCache::getSampler(GfxSamplerType type)
+{
+    if (type == GfxSamplerType::MIN_SAMPLER && !m_MinMaxFilterSupported) {
+        // Without VK_EXT_sampler_filter_minmax a nearest sampler is the closest match, callers
+        // reducing depth have to take the min of the 4 texels themselves
+        LOGW(m_TAG,"MIN_SAMPLER not supported, using NEAREST_SAMPLER");
+        type = GfxSamplerType::NEAREST_SAMPLER;
+    }
+    return getSampler(TextureSampler::getCreateInfo(type));
+}
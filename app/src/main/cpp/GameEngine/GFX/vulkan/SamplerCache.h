@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <vulkan/vulkan.h>
+
+#include "../../Utils/Definitions.h"
+#include "GfxTypes.h"
+#include "GfxDevice.h"
+
+// Deduplicates VkSamplers by the full VkSamplerCreateInfo, bucketed by its hash. Samplers are immutable and
+// shared, so they are owned here and live as long as the cache. Keeps the device well below
+// maxSamplerAllocationCount no matter how many textures ask for the same state.
+class SamplerCache {
+public:
+    NONCOPYABLE(SamplerCache);
+    SamplerCache(const ThreadSafeGfxDevice& threadSafeDevice);
+    ~SamplerCache();
+
+    // The only pNext understood is VkSamplerReductionModeCreateInfoEXT. maxAnisotropy is clamped to
+    // maxSamplerAnisotropy, anisotropy is turned off when the device doesn't support it
+    VkSampler getSampler(const VkSamplerCreateInfo& requestedCreateInfo);
+    VkSampler getSampler(GfxSamplerType type);
+
+    uint32_t getSamplerCount() const { return static_cast<uint32_t>(m_Samplers.size()); }
+
+private:
+    struct Entry {
+        VkSamplerCreateInfo createInfo;     // pNext cleared, the reduction mode is kept below
+        bool hasReductionMode;
+        VkSamplerReductionModeEXT reductionMode;
+        VkSampler sampler;
+    };
+
+    // Throws on any pNext structure other than the reduction mode
+    static const VkSamplerReductionModeCreateInfoEXT* findReductionMode(const VkSamplerCreateInfo& createInfo);
+    static uint64_t hashCreateInfo(const VkSamplerCreateInfo& createInfo);
+    static bool matches(const Entry& entry, const VkSamplerCreateInfo& createInfo);
+
+    VkDevice m_VkDevice{VK_NULL_HANDLE};
+    uint32_t m_MaxSamplers{0};
+    float m_MaxAnisotropy{0.0f};
+    bool m_MinMaxFilterSupported{false};
+    std::mutex m_mutex;
+    std::unordered_multimap<uint64_t, Entry> m_Samplers;
+    static constexpr LogTag m_TAG{"SamplerCache"};
+};
@@ -0,0 +1,345 @@
+#include <algorithm>
+#include <map>
+
+#include "spirv_reflect/spirv_reflect.h"
+
+#include "ShaderModuleCache.h"
+#include "GfxUtils.h"
+#include "../../Utils/Hash.h"
+
+ShaderModuleCache::ShaderModuleCache(const ThreadSafeGfxDevice& threadSafeDevice) : m_device(threadSafeDevice)
+{
+    auto dev = m_device.lock();
+    if (dev == nullptr) {
+        throw std::runtime_error("ShaderModuleCache created without a device");
+    }
+    m_VkDevice = dev->getDevice();
+}
+
+ShaderModuleCache::~ShaderModuleCache()
+{
+    for (auto& layout : m_PipelineLayouts) {
+        vkDestroyPipelineLayout(m_VkDevice, layout.second.layout, nullptr);
+    }
+    for (auto& layout : m_SetLayouts) {
+        vkDestroyDescriptorSetLayout(m_VkDevice, layout.second.layout, nullptr);
+    }
+    for (auto& shader : m_Shaders) {
+        vkDestroyShaderModule(m_VkDevice, shader.second->module, nullptr);
+    }
+}
+
+bool ShaderModuleCache::ProgramKey::operator==(const ProgramKey& other) const
+{
+    return stageIds == other.stageIds && setOverrides == other.setOverrides &&
+           immutableSamplers == other.immutableSamplers;
+}
+
+bool ShaderModuleCache::SetLayoutKey::operator==(const SetLayoutKey& other) const
+{
+    if (flags != other.flags || pNextHash != other.pNextHash || bindings.size() != other.bindings.size() ||
+        immutableSamplers != other.immutableSamplers) {
+        return false;
+    }
+    for (size_t i = 0; i < bindings.size(); i++) {
+        const auto& l = bindings[i];
+        const auto& r = other.bindings[i];
+        if (l.binding != r.binding || l.descriptorType != r.descriptorType ||
+            l.descriptorCount != r.descriptorCount || l.stageFlags != r.stageFlags) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ShaderModuleCache::PipelineLayoutKey::operator==(const PipelineLayoutKey& other) const
+{
+    if (setLayouts != other.setLayouts || pushConstants.size() != other.pushConstants.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < pushConstants.size(); i++) {
+        const auto& l = pushConstants[i];
+        const auto& r = other.pushConstants[i];
+        if (l.stageFlags != r.stageFlags || l.offset != r.offset || l.size != r.size) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const ShaderModule* ShaderModuleCache::getShader(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_Shaders.find(path);
+    if (it != m_Shaders.end()) {
+        return it->second.get();
+    }
+
+    LOGD(m_TAG,"Loading shader %s", path.c_str());
+    auto code = GfxDevice::readFile(path);
+    auto shader = std::make_unique<ShaderModule>();
+    shader->id = static_cast<uint32_t>(m_Shaders.size());
+    shader->path = path;
+    reflect(code, *shader);
+
+    VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
+    shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shaderModuleCreateInfo.codeSize = code.size();
+    shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+    CHECK_VK(vkCreateShaderModule(m_VkDevice, &shaderModuleCreateInfo, nullptr, &shader->module));
+
+    const ShaderModule* result = shader.get();
+    m_Shaders.emplace(path, std::move(shader));
+    return result;
+}
+
+void ShaderModuleCache::reflect(const std::vector<char>& code, ShaderModule& shader)
+{
+    SpvReflectShaderModule module;
+    if (spvReflectCreateShaderModule(code.size(), code.data(), &module) != SPV_REFLECT_RESULT_SUCCESS) {
+        LOGE(m_TAG,"SPIR-V reflection failed for %s", shader.path.c_str());
+        throw std::runtime_error("SPIR-V reflection failed : " + shader.path);
+    }
+    // SpvReflectShaderStageFlagBits and VkShaderStageFlagBits share their values
+    shader.stage = static_cast<VkShaderStageFlagBits>(module.shader_stage);
+    shader.entryPoint = module.entry_point_name ? module.entry_point_name : "main";
+
+    uint32_t count = 0;
+    spvReflectEnumerateDescriptorBindings(&module, &count, nullptr);
+    std::vector<SpvReflectDescriptorBinding*> bindings(count);
+    spvReflectEnumerateDescriptorBindings(&module, &count, bindings.data());
+    for (const auto* binding : bindings) {
+        // Runtime arrays (bindless) reflect as 0, such sets are expected to be overridden
+        uint32_t descriptorCount = 1;
+        for (uint32_t d = 0; d < binding->array.dims_count; d++) {
+            descriptorCount *= binding->array.dims[d];
+        }
+        shader.bindings.push_back({binding->set, binding->binding,
+                                   static_cast<VkDescriptorType>(binding->descriptor_type),
+                                   descriptorCount, static_cast<VkShaderStageFlags>(shader.stage)});
+    }
+
+    count = 0;
+    spvReflectEnumeratePushConstantBlocks(&module, &count, nullptr);
+    std::vector<SpvReflectBlockVariable*> blocks(count);
+    spvReflectEnumeratePushConstantBlocks(&module, &count, blocks.data());
+    for (const auto* block : blocks) {
+        VkPushConstantRange range = {};
+        range.stageFlags = shader.stage;
+        range.offset = block->offset;
+        range.size = block->size;
+        shader.pushConstants.push_back(range);
+    }
+
+    if (shader.stage == VK_SHADER_STAGE_VERTEX_BIT) {
+        count = 0;
+        spvReflectEnumerateInputVariables(&module, &count, nullptr);
+        std::vector<SpvReflectInterfaceVariable*> inputs(count);
+        spvReflectEnumerateInputVariables(&module, &count, inputs.data());
+        for (const auto* input : inputs) {
+            if (input->decoration_flags & SPV_REFLECT_DECORATION_BUILT_IN) {
+                continue;
+            }
+            uint32_t components = std::max(1u, input->numeric.vector.component_count);
+            uint32_t size = components * input->numeric.scalar.width / 8;
+            // SpvReflectFormat values match VkFormat
+            shader.vertexInputs.push_back({input->location, static_cast<VkFormat>(input->format), size});
+        }
+        std::sort(shader.vertexInputs.begin(), shader.vertexInputs.end(),
+                  [](const ReflectedVertexInput& l, const ReflectedVertexInput& r) { return l.location < r.location; });
+    }
+
+    spvReflectDestroyShaderModule(&module);
+}
+
+const ProgramLayout* ShaderModuleCache::getProgramLayout(const std::vector<const ShaderModule*>& stages,
+                                                         const ProgramLayoutOptions& options)
+{
+    const auto& setOverrides = options.setOverrides;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ProgramKey programKey{{}, setOverrides, options.immutableSamplers};
+    Hasher hasher;
+    for (const auto* stage : stages) {
+        programKey.stageIds.push_back(stage->id);
+        hasher.value(stage->id);
+    }
+    for (const auto& setOverride : setOverrides) {
+        hasher.value(setOverride.first).value(setOverride.second);
+    }
+    for (const auto& immutableSampler : options.immutableSamplers) {
+        hasher.value(immutableSampler.first.first).value(immutableSampler.first.second).value(immutableSampler.second);
+    }
+    const uint64_t key = hasher.get();
+    const auto range = m_Programs.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.key == programKey) {
+            return it->second.program.get();
+        }
+    }
+
+    // Merge the bindings of all stages, the same binding seen by several stages ORs the stage flags
+    std::map<std::pair<uint32_t, uint32_t>, ReflectedBinding> merged;
+    uint32_t pushBegin = UINT32_MAX, pushEnd = 0;
+    VkShaderStageFlags pushStages = 0;
+    auto program = std::make_unique<ProgramLayout>();
+    for (const auto* stage : stages) {
+        for (const auto& binding : stage->bindings) {
+            auto slot = std::make_pair(binding.set, binding.binding);
+            auto found = merged.find(slot);
+            if (found == merged.end()) {
+                merged.emplace(slot, binding);
+                continue;
+            }
+            if (found->second.type != binding.type) {
+                LOGE(m_TAG,"set %u binding %u has different types across stages", binding.set, binding.binding);
+                throw std::runtime_error("conflicting descriptor types across shader stages");
+            }
+            found->second.stages |= binding.stages;
+            found->second.count = std::max(found->second.count, binding.count);
+        }
+        for (const auto& range : stage->pushConstants) {
+            pushBegin = std::min(pushBegin, range.offset);
+            pushEnd = std::max(pushEnd, range.offset + range.size);
+            pushStages |= range.stageFlags;
+        }
+        if (stage->stage == VK_SHADER_STAGE_VERTEX_BIT) {
+            program->vertexInputs = stage->vertexInputs;
+        }
+    }
+    // One range covering every stage keeps vkCmdPushConstants calls simple
+    if (pushStages != 0) {
+        program->pushConstants.push_back({pushStages, pushBegin, pushEnd - pushBegin});
+    }
+
+    uint32_t setCount = merged.empty() ? 0 : merged.rbegin()->first.first + 1;
+    if (!setOverrides.empty()) {
+        setCount = std::max(setCount, setOverrides.rbegin()->first + 1);
+    }
+    std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets(setCount);
+    // pImmutableSamplers storage, one sampler per array element
+    std::vector<std::vector<VkSampler>> immutableSamplers;
+    immutableSamplers.reserve(options.immutableSamplers.size());
+    for (const auto& entry : merged) {
+        VkDescriptorSetLayoutBinding binding = {};
+        binding.binding = entry.second.binding;
+        binding.descriptorType = entry.second.type;
+        binding.descriptorCount = entry.second.count;
+        binding.stageFlags = entry.second.stages;
+        binding.pImmutableSamplers = nullptr;
+        auto immutableSampler = options.immutableSamplers.find(entry.first);
+        if (immutableSampler != options.immutableSamplers.end()) {
+            immutableSamplers.emplace_back(binding.descriptorCount, immutableSampler->second);
+            binding.pImmutableSamplers = immutableSamplers.back().data();
+        }
+        sets[entry.second.set].push_back(binding);
+    }
+    // Gaps in the set numbering still need a (empty) layout
+    for (uint32_t set = 0; set < setCount; set++) {
+        auto setOverride = setOverrides.find(set);
+        if (setOverride != setOverrides.end()) {
+            program->setLayouts.push_back(setOverride->second);
+            continue;
+        }
+        program->setLayouts.push_back(getDescriptorSetLayoutLocked(sets[set], 0, nullptr, 0));
+    }
+    program->pipelineLayout = getPipelineLayoutLocked(program->setLayouts, program->pushConstants);
+
+    LOGD(m_TAG,"Program layout with %u sets, %u unique set layouts, %u unique pipeline layouts",
+         setCount, getSetLayoutCount(), getPipelineLayoutCount());
+    const ProgramLayout* result = program.get();
+    m_Programs.emplace(key, ProgramEntry{std::move(programKey), std::move(program)});
+    return result;
+}
+
+VkDescriptorSetLayout ShaderModuleCache::getDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+                                                                VkDescriptorSetLayoutCreateFlags flags,
+                                                                const void* pNext, uint64_t pNextHash)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return getDescriptorSetLayoutLocked(bindings, flags, pNext, pNextHash);
+}
+
+VkPipelineLayout ShaderModuleCache::getPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts,
+                                                      const std::vector<VkPushConstantRange>& pushConstants)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return getPipelineLayoutLocked(setLayouts, pushConstants);
+}
+
+VkDescriptorSetLayout ShaderModuleCache::getDescriptorSetLayoutLocked(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+                                                                      VkDescriptorSetLayoutCreateFlags flags,
+                                                                      const void* pNext, uint64_t pNextHash)
+{
+    // Binding order does not matter to Vulkan, sort so equal layouts hash equal
+    std::vector<VkDescriptorSetLayoutBinding> sorted(bindings);
+    std::sort(sorted.begin(), sorted.end(),
+              [](const VkDescriptorSetLayoutBinding& l, const VkDescriptorSetLayoutBinding& r) { return l.binding < r.binding; });
+
+    SetLayoutKey layoutKey{flags, pNextHash, sorted, {}};
+    Hasher hasher;
+    hasher.value(flags).value(pNextHash);
+    for (const auto& binding : sorted) {
+        hasher.value(binding.binding).value(binding.descriptorType).value(binding.descriptorCount).value(binding.stageFlags);
+        layoutKey.immutableSamplers.emplace_back();
+        if (binding.pImmutableSamplers) {
+            hasher.data(binding.pImmutableSamplers, sizeof(VkSampler) * binding.descriptorCount);
+            layoutKey.immutableSamplers.back().assign(binding.pImmutableSamplers,
+                                                      binding.pImmutableSamplers + binding.descriptorCount);
+        }
+    }
+    // The stored copy must not point into the caller's sampler arrays
+    for (auto& binding : layoutKey.bindings) {
+        binding.pImmutableSamplers = nullptr;
+    }
+    const uint64_t key = hasher.get();
+    const auto range = m_SetLayouts.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.key == layoutKey) {
+            return it->second.layout;
+        }
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+    layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutCreateInfo.pNext = pNext;
+    layoutCreateInfo.flags = flags;
+    layoutCreateInfo.bindingCount = static_cast<uint32_t>(sorted.size());
+    layoutCreateInfo.pBindings = sorted.empty() ? nullptr : sorted.data();
+
+    VkDescriptorSetLayout layout;
+    CHECK_VK(vkCreateDescriptorSetLayout(m_VkDevice, &layoutCreateInfo, nullptr, &layout));
+    m_SetLayouts.emplace(key, SetLayoutEntry{std::move(layoutKey), layout});
+    return layout;
+}
+
+VkPipelineLayout ShaderModuleCache::getPipelineLayoutLocked(const std::vector<VkDescriptorSetLayout>& setLayouts,
+                                                            const std::vector<VkPushConstantRange>& pushConstants)
+{
+    Hasher hasher;
+    for (auto setLayout : setLayouts) {
+        hasher.value(setLayout);
+    }
+    for (const auto& range : pushConstants) {
+        hasher.value(range.stageFlags).value(range.offset).value(range.size);
+    }
+    PipelineLayoutKey layoutKey{setLayouts, pushConstants};
+    const uint64_t key = hasher.get();
+    const auto range = m_PipelineLayouts.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.key == layoutKey) {
+            return it->second.layout;
+        }
+    }
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutCreateInfo.pSetLayouts = setLayouts.empty() ? nullptr : setLayouts.data();
+    pipelineLayoutCreateInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstants.size());
+    pipelineLayoutCreateInfo.pPushConstantRanges = pushConstants.empty() ? nullptr : pushConstants.data();
+
+    VkPipelineLayout layout;
+    CHECK_VK(vkCreatePipelineLayout(m_VkDevice, &pipelineLayoutCreateInfo, nullptr, &layout));
+    m_PipelineLayouts.emplace(key, PipelineLayoutEntry{std::move(layoutKey), layout});
+    return layout;
+}
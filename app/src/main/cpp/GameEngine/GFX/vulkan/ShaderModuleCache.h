@@ -0,0 +1,131 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../../Utils/Definitions.h"
+#include "GfxDevice.h"
+
+struct ReflectedBinding {
+    uint32_t set;
+    uint32_t binding;
+    VkDescriptorType type;
+    uint32_t count;
+    VkShaderStageFlags stages;
+};
+
+struct ReflectedVertexInput {
+    uint32_t location;
+    VkFormat format;
+    uint32_t size;      // bytes
+};
+
+// A SPIR-V module loaded and reflected exactly once
+struct ShaderModule {
+    uint32_t id;
+    std::string path;
+    VkShaderModule module{VK_NULL_HANDLE};
+    VkShaderStageFlagBits stage;
+    std::string entryPoint;
+    std::vector<ReflectedBinding> bindings;
+    std::vector<VkPushConstantRange> pushConstants;
+    std::vector<ReflectedVertexInput> vertexInputs;   // vertex stage only, sorted by location
+};
+
+// Merged interface of all stages of a program, layouts are shared with every other program
+// that reflects to the same sets / push constants
+struct ProgramLayout {
+    std::vector<VkDescriptorSetLayout> setLayouts;
+    std::vector<VkPushConstantRange> pushConstants;
+    std::vector<ReflectedVertexInput> vertexInputs;
+    VkPipelineLayout pipelineLayout{VK_NULL_HANDLE};
+};
+
+struct ProgramLayoutOptions {
+    // Replaces the reflected layout of a set, for layouts that need flags reflection can't know
+    // about (update after bind, partially bound arrays)
+    std::map<uint32_t, VkDescriptorSetLayout> setOverrides;
+    // Samplers baked into the set layout at (set, binding). Descriptor writes to such a binding
+    // only provide the image view, the sampler is ignored.
+    std::map<std::pair<uint32_t, uint32_t>, VkSampler> immutableSamplers;
+};
+
+class ShaderModuleCache {
+public:
+    NONCOPYABLE(ShaderModuleCache);
+    ShaderModuleCache(const ThreadSafeGfxDevice& threadSafeDevice);
+    ~ShaderModuleCache();
+
+    // Loads, reflects and creates the module on first use, cached by path afterwards
+    const ShaderModule* getShader(const std::string& path);
+
+    const ProgramLayout* getProgramLayout(const std::vector<const ShaderModule*>& stages,
+                                          const ProgramLayoutOptions& options = {});
+
+    // Deduplicated by the create info, owned by the cache. pNextHash stands in for the pNext
+    // chain, callers must give chains that differ different hashes.
+    VkDescriptorSetLayout getDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+                                                 VkDescriptorSetLayoutCreateFlags flags = 0,
+                                                 const void* pNext = nullptr, uint64_t pNextHash = 0);
+    VkPipelineLayout getPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts,
+                                       const std::vector<VkPushConstantRange>& pushConstants);
+
+    uint32_t getSetLayoutCount() const { return static_cast<uint32_t>(m_SetLayouts.size()); }
+    uint32_t getPipelineLayoutCount() const { return static_cast<uint32_t>(m_PipelineLayouts.size()); }
+
+private:
+    // Full keys kept next to each cached object, equal hashes are told apart by comparing them
+    struct ProgramKey {
+        std::vector<uint32_t> stageIds;
+        std::map<uint32_t, VkDescriptorSetLayout> setOverrides;
+        std::map<std::pair<uint32_t, uint32_t>, VkSampler> immutableSamplers;
+        bool operator==(const ProgramKey& other) const;
+    };
+    struct SetLayoutKey {
+        VkDescriptorSetLayoutCreateFlags flags;
+        uint64_t pNextHash;
+        std::vector<VkDescriptorSetLayoutBinding> bindings;     // sorted, pImmutableSamplers not compared
+        std::vector<std::vector<VkSampler>> immutableSamplers;  // per binding, empty if none
+        bool operator==(const SetLayoutKey& other) const;
+    };
+    struct PipelineLayoutKey {
+        std::vector<VkDescriptorSetLayout> setLayouts;
+        std::vector<VkPushConstantRange> pushConstants;
+        bool operator==(const PipelineLayoutKey& other) const;
+    };
+    struct ProgramEntry {
+        ProgramKey key;
+        std::unique_ptr<ProgramLayout> program;
+    };
+    struct SetLayoutEntry {
+        SetLayoutKey key;
+        VkDescriptorSetLayout layout;
+    };
+    struct PipelineLayoutEntry {
+        PipelineLayoutKey key;
+        VkPipelineLayout layout;
+    };
+
+    void reflect(const std::vector<char>& code, ShaderModule& shader);
+    VkDescriptorSetLayout getDescriptorSetLayoutLocked(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+                                                       VkDescriptorSetLayoutCreateFlags flags,
+                                                       const void* pNext, uint64_t pNextHash);
+    VkPipelineLayout getPipelineLayoutLocked(const std::vector<VkDescriptorSetLayout>& setLayouts,
+                                             const std::vector<VkPushConstantRange>& pushConstants);
+
+    ThreadSafeGfxDevice m_device;
+    VkDevice m_VkDevice{VK_NULL_HANDLE};
+    std::mutex m_mutex;
+    std::unordered_map<std::string, std::unique_ptr<ShaderModule>> m_Shaders;
+    // By hash of the key
+    std::unordered_multimap<uint64_t, ProgramEntry> m_Programs;
+    std::unordered_multimap<uint64_t, SetLayoutEntry> m_SetLayouts;
+    std::unordered_multimap<uint64_t, PipelineLayoutEntry> m_PipelineLayouts;
+    static constexpr LogTag m_TAG{"ShaderModuleCache"};
+};
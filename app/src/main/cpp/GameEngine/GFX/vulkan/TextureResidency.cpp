@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "TextureResidency.h"
+
+TextureResidency::TextureResidency(const TextureStreamingConfig& config)
+    : m_Config(config)
+{
+    updateStats();
+}
+
+uint32_t TextureResidency::addTexture(std::vector<uint64_t> levelBytes, uint32_t size, float priority)
+{
+    Texture texture;
+    texture.levelBytes = std::move(levelBytes);
+    texture.size = size;
+    texture.priority = priority;
+    texture.active = true;
+    const auto levelCount = static_cast<uint32_t>(texture.levelBytes.size());
+    texture.tailMip = levelCount - 1;
+    for (uint32_t level = 0; level < levelCount; level++) {
+        if (std::max(size >> level, 1u) <= m_Config.residentTailSize) {
+            texture.tailMip = level;
+            break;
+        }
+    }
+    texture.residentMip = texture.tailMip;
+    texture.desiredMip = texture.tailMip;
+    m_ResidentBytes += getBytes(texture, texture.tailMip, levelCount);
+
+    uint32_t id;
+    if (!m_FreeIds.empty()) {
+        id = m_FreeIds.back();
+        m_FreeIds.pop_back();
+        m_Textures[id] = std::move(texture);
+    } else {
+        id = static_cast<uint32_t>(m_Textures.size());
+        m_Textures.push_back(std::move(texture));
+    }
+    updateStats();
+    return id;
+}
+
+void TextureResidency::removeTexture(uint32_t texture)
+{
+    Texture& removed = m_Textures[texture];
+    m_ResidentBytes -= getBytes(removed, removed.residentMip, static_cast<uint32_t>(removed.levelBytes.size()));
+    removed.active = false;
+    // An id with a load in flight is reused once the load ended
+    if (!removed.loading) {
+        m_FreeIds.push_back(texture);
+    }
+    updateStats();
+}
+
+void TextureResidency::reportUsage(uint32_t texture, float screenSize)
+{
+    Texture& used = m_Textures[texture];
+    uint32_t mip = used.tailMip;
+    if (screenSize > 0.0f) {
+        // One texel per pixel: level n is 2^n times smaller than the full size level
+        const float level = std::floor(std::log2(used.size / screenSize) + m_Config.mipBias);
+        mip = static_cast<uint32_t>(std::min(std::max(level, 0.0f), static_cast<float>(used.tailMip)));
+    }
+    used.reportedMip = std::min(used.reportedMip, mip);
+}
+
+void TextureResidency::beginFrame()
+{
+    m_Frame++;
+    m_Stats.uploads = 0;
+    m_Stats.evictions = 0;
+    for (Texture& texture : m_Textures) {
+        if (!texture.active) {
+            continue;
+        }
+        if (texture.reportedMip != kInvalid) {
+            texture.desiredMip = texture.reportedMip;
+            texture.lastUsedFrame = m_Frame;
+            texture.reportedMip = kInvalid;
+        } else if (!isRecentlyUsed(texture)) {
+            texture.desiredMip = texture.tailMip;
+        }
+    }
+    updateStats();
+}
+
+std::vector<TextureResidency::LoadRequest> TextureResidency::takeLoadRequests()
+{
+    std::vector<uint32_t> candidates;
+    for (uint32_t id = 0; id < m_Textures.size(); id++) {
+        const Texture& texture = m_Textures[id];
+        if (texture.active && !texture.loading && texture.desiredMip < texture.residentMip &&
+            texture.retryFrame <= m_Frame) {
+            candidates.push_back(id);
+        }
+    }
+    // Most important first, then the ones missing the most detail, then the most recently drawn
+    std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) {
+        const Texture& textureA = m_Textures[a];
+        const Texture& textureB = m_Textures[b];
+        if (textureA.priority != textureB.priority) {
+            return textureA.priority > textureB.priority;
+        }
+        const uint32_t missingA = textureA.residentMip - textureA.desiredMip;
+        const uint32_t missingB = textureB.residentMip - textureB.desiredMip;
+        if (missingA != missingB) {
+            return missingA > missingB;
+        }
+        return textureA.lastUsedFrame > textureB.lastUsedFrame;
+    });
+
+    std::vector<LoadRequest> requests;
+    for (uint32_t id : candidates) {
+        if (m_LoadsInFlight >= m_Config.maxLoadsInFlight) {
+            break;
+        }
+        Texture& texture = m_Textures[id];
+        texture.loading = true;
+        m_LoadsInFlight++;
+        requests.push_back({ id, texture.desiredMip, texture.residentMip });
+    }
+    updateStats();
+    return requests;
+}
+
+uint32_t TextureResidency::beginUpload(const LoadRequest& request, std::vector<Eviction>& evictions)
+{
+    Texture& texture = m_Textures[request.texture];
+    if (!texture.active) {
+        return kInvalid;
+    }
+    // Loaded levels the texture no longer needs (zoomed out meanwhile) are not uploaded
+    uint32_t firstMip = std::max(request.firstMip, texture.desiredMip);
+    if (firstMip >= texture.residentMip) {
+        return kInvalid;
+    }
+
+    const uint32_t residentMip = texture.residentMip;
+    const uint64_t needBytes = getBytes(texture, firstMip, residentMip);
+    if (m_ResidentBytes + needBytes > m_Config.budgetBytes) {
+        makeRoom(needBytes, request.texture, texture.priority, evictions);
+    }
+    // Whatever didn't fit, the finer levels are dropped
+    while (firstMip < residentMip && m_ResidentBytes + getBytes(texture, firstMip, residentMip) > m_Config.budgetBytes) {
+        firstMip++;
+    }
+    if (firstMip == residentMip) {
+        return kInvalid;
+    }
+    return firstMip;
+}
+
+void TextureResidency::endLoad(uint32_t texture, uint32_t residentMip)
+{
+    Texture& loaded = m_Textures[texture];
+    loaded.loading = false;
+    m_LoadsInFlight--;
+    if (!loaded.active) {
+        m_FreeIds.push_back(texture);
+    } else if (residentMip == kInvalid) {
+        // Didn't fit or the read failed, either won't change right away
+        loaded.retryFrame = m_Frame + m_Config.retryFrames;
+    } else if (residentMip < loaded.residentMip) {
+        m_ResidentBytes += getBytes(loaded, residentMip, loaded.residentMip);
+        loaded.residentMip = residentMip;
+        m_Stats.uploads++;
+    }
+    updateStats();
+}
+
+void TextureResidency::setBudget(uint64_t budgetBytes, std::vector<Eviction>& evictions)
+{
+    m_Config.budgetBytes = budgetBytes;
+    if (m_ResidentBytes > budgetBytes) {
+        makeRoom(0, kInvalid, std::numeric_limits<float>::max(), evictions);
+    }
+    updateStats();
+}
+
+uint64_t TextureResidency::getBytes(const Texture& texture, uint32_t firstMip, uint32_t lastMip) const
+{
+    uint64_t bytes = 0;
+    for (uint32_t level = firstMip; level < lastMip; level++) {
+        bytes += texture.levelBytes[level];
+    }
+    return bytes;
+}
+
+bool TextureResidency::isRecentlyUsed(const Texture& texture) const
+{
+    return texture.lastUsedFrame > 0 && m_Frame - texture.lastUsedFrame < m_Config.unusedFrames;
+}
+
+uint32_t TextureResidency::getKeepMip(const Texture& texture) const
+{
+    return isRecentlyUsed(texture) ? texture.desiredMip : texture.tailMip;
+}
+
+void TextureResidency::evict(uint32_t texture, uint32_t firstMip, std::vector<Eviction>& evictions)
+{
+    Texture& evicted = m_Textures[texture];
+    if (firstMip <= evicted.residentMip) {
+        return;
+    }
+    m_ResidentBytes -= getBytes(evicted, evicted.residentMip, firstMip);
+    evicted.residentMip = firstMip;
+    m_Stats.evictions++;
+    // One image change per texture, however many levels went
+    for (Eviction& eviction : evictions) {
+        if (eviction.texture == texture) {
+            eviction.firstMip = firstMip;
+            return;
+        }
+    }
+    evictions.push_back({ texture, firstMip });
+}
+
+void TextureResidency::makeRoom(uint64_t needBytes, uint32_t requester, float priority, std::vector<Eviction>& evictions)
+{
+    auto fits = [&]() { return m_ResidentBytes + needBytes <= m_Config.budgetBytes; };
+
+    // Levels nothing draws: of textures unused for a while, least recently used first, and of
+    // textures drawn coarser than resident
+    std::vector<uint32_t> candidates;
+    for (uint32_t id = 0; id < m_Textures.size(); id++) {
+        const Texture& texture = m_Textures[id];
+        if (id != requester && texture.active && !texture.loading && texture.residentMip < getKeepMip(texture)) {
+            candidates.push_back(id);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) {
+        const Texture& textureA = m_Textures[a];
+        const Texture& textureB = m_Textures[b];
+        if (textureA.lastUsedFrame != textureB.lastUsedFrame) {
+            return textureA.lastUsedFrame < textureB.lastUsedFrame;
+        }
+        return textureA.priority < textureB.priority;
+    });
+    for (uint32_t id : candidates) {
+        const uint32_t keepMip = getKeepMip(m_Textures[id]);
+        while (!fits() && m_Textures[id].residentMip < keepMip) {
+            evict(id, m_Textures[id].residentMip + 1, evictions);
+        }
+        if (fits()) {
+            return;
+        }
+    }
+
+    // Then detail that is drawn, one level at a time from the least important texture
+    while (!fits()) {
+        uint32_t victim = kInvalid;
+        for (uint32_t id = 0; id < m_Textures.size(); id++) {
+            const Texture& texture = m_Textures[id];
+            if (id == requester || !texture.active || texture.loading || texture.residentMip >= texture.tailMip ||
+                texture.priority >= priority) {
+                continue;
+            }
+            if (victim == kInvalid || texture.priority < m_Textures[victim].priority ||
+                (texture.priority == m_Textures[victim].priority &&
+                 texture.lastUsedFrame < m_Textures[victim].lastUsedFrame)) {
+                victim = id;
+            }
+        }
+        if (victim == kInvalid) {
+            return;
+        }
+        evict(victim, m_Textures[victim].residentMip + 1, evictions);
+    }
+}
+
+void TextureResidency::updateStats()
+{
+    m_Stats.residentBytes = m_ResidentBytes;
+    m_Stats.budgetBytes = m_Config.budgetBytes;
+    m_Stats.textures = 0;
+    m_Stats.pendingRequests = 0;
+    for (const Texture& texture : m_Textures) {
+        if (texture.active) {
+            m_Stats.textures++;
+            if (texture.desiredMip < texture.residentMip) {
+                m_Stats.pendingRequests++;
+            }
+        }
+    }
+    m_Stats.loadsInFlight = m_LoadsInFlight;
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+struct TextureStreamingConfig {
+    // Mip levels resident across all streamed textures, tails included
+    uint64_t budgetBytes{128ull << 20};
+    // Levels this size or smaller load with the texture and are never evicted
+    uint32_t residentTailSize{64};
+    // File reads at a time, and uploads (image reallocations) per frame to bound the hitch
+    uint32_t maxLoadsInFlight{4};
+    uint32_t maxUploadsPerFrame{2};
+    // A texture not drawn for this many frames gives up the levels above its tail first
+    uint32_t unusedFrames{60};
+    // Frames before a load that didn't fit the budget or failed is requested again
+    uint32_t retryFrames{30};
+    // Added to the mip picked from the screen size, positive streams less
+    float mipBias{0.0f};
+};
+
+struct TextureStreamingStats {
+    uint64_t residentBytes{0};
+    uint64_t budgetBytes{0};
+    uint32_t textures{0};
+    // Textures drawn at a finer mip than is resident, loading or waiting for room
+    uint32_t pendingRequests{0};
+    uint32_t loadsInFlight{0};
+    // This frame
+    uint32_t uploads{0};
+    uint32_t evictions{0};
+};
+
+// Decides which mip levels of streamed textures are resident, backend independent. Draws report
+// how large a texture appears on screen, that picks the finest level worth having. Loads are
+// requested for textures drawn finer than resident, most important first. An upload that doesn't
+// fit the budget evicts levels: first those of textures not drawn for a while (least recently
+// used first), then those drawn coarser than resident, then, one level at a time, those of textures
+// with a lower priority. Textures only ever hold a contiguous range from some level to the last.
+class TextureResidency {
+public:
+    static constexpr uint32_t kInvalid = ~0u;
+
+    struct LoadRequest {
+        uint32_t texture;
+        // Levels firstMip up to (excluding) lastMip, lastMip being the resident level at request time
+        uint32_t firstMip;
+        uint32_t lastMip;
+    };
+
+    struct Eviction {
+        uint32_t texture;
+        // The new first resident level
+        uint32_t firstMip;
+    };
+
+    explicit TextureResidency(const TextureStreamingConfig& config);
+
+    // levelBytes[0] is the full size level, size its larger dimension. The tail is resident
+    // from the start, see getTailMip.
+    uint32_t addTexture(std::vector<uint64_t> levelBytes, uint32_t size, float priority);
+    void removeTexture(uint32_t texture);
+
+    uint32_t getTailMip(uint32_t texture) const { return m_Textures[texture].tailMip; }
+    uint32_t getResidentMip(uint32_t texture) const { return m_Textures[texture].residentMip; }
+    uint32_t getDesiredMip(uint32_t texture) const { return m_Textures[texture].desiredMip; }
+
+    // From draws of this frame: the texture covers about screenSize pixels along its larger axis
+    void reportUsage(uint32_t texture, float screenSize);
+
+    // Folds the usage reported since the last call into the desired levels
+    void beginFrame();
+    // Textures to load next, marked as loading until endLoad
+    std::vector<LoadRequest> takeLoadRequests();
+    // The first level to upload for a completed load, kInvalid to drop it. Evicts what is needed
+    // to make room, the caller has to apply the evictions before the upload.
+    uint32_t beginUpload(const LoadRequest& request, std::vector<Eviction>& evictions);
+    // residentMip is what beginUpload returned, kInvalid when nothing was uploaded
+    void endLoad(uint32_t texture, uint32_t residentMip);
+    // Evictions that bring the resident size back under a lowered budget
+    void setBudget(uint64_t budgetBytes, std::vector<Eviction>& evictions);
+
+    const TextureStreamingStats& getStats() const { return m_Stats; }
+
+private:
+    struct Texture {
+        std::vector<uint64_t> levelBytes;
+        uint32_t size{0};
+        float priority{1.0f};
+        uint32_t tailMip{0};
+        uint32_t residentMip{0};
+        uint32_t desiredMip{0};
+        uint32_t reportedMip{kInvalid};
+        uint64_t lastUsedFrame{0};
+        uint64_t retryFrame{0};
+        bool loading{false};
+        bool active{false};
+    };
+
+    uint64_t getBytes(const Texture& texture, uint32_t firstMip, uint32_t lastMip) const;
+    // The level a texture can be reduced to without hurting what is drawn now
+    uint32_t getKeepMip(const Texture& texture) const;
+    bool isRecentlyUsed(const Texture& texture) const;
+    void evict(uint32_t texture, uint32_t firstMip, std::vector<Eviction>& evictions);
+    // Evicts until needBytes more fit, skipping the requesting texture
+    void makeRoom(uint64_t needBytes, uint32_t requester, float priority, std::vector<Eviction>& evictions);
+    void updateStats();
+
+    TextureStreamingConfig m_Config;
+    std::vector<Texture> m_Textures;
+    std::vector<uint32_t> m_FreeIds;
+    uint64_t m_Frame{0};
+    uint64_t m_ResidentBytes{0};
+    uint32_t m_LoadsInFlight{0};
+    TextureStreamingStats m_Stats{};
+};
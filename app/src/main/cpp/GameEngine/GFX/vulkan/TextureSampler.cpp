@@ -2,9 +2,7 @@
 //#include "GfxTypes.h"
 #include "GfxUtils.h"
 
-std::string TextureSampler::m_TAG = "TextureSampler";
-
-VkSamplerCreateInfo getLinearConfig()
+static VkSamplerCreateInfo getLinearConfig()
 {
     VkSamplerCreateInfo samplerCreateInfo = {};
     samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -29,7 +27,13 @@ VkSamplerCreateInfo getLinearConfig()
     return samplerCreateInfo;
 }
 
-TextureSampler::TextureSampler(const ThreadSafeGfxDevice& threadSafeDevice, GfxSamplerType type): m_device(threadSafeDevice) {
+// Shared by every MIN_SAMPLER create info, has to outlive them
+static const VkSamplerReductionModeCreateInfoEXT s_MinReduction = {
+    VK_STRUCTURE_TYPE_SAMPLER_REDUCTION_MODE_CREATE_INFO_EXT, nullptr, VK_SAMPLER_REDUCTION_MODE_MIN_EXT
+};
+
+VkSamplerCreateInfo TextureSampler::getCreateInfo(GfxSamplerType type)
+{
     VkSamplerCreateInfo samplerCreateInfo = getLinearConfig();
     switch (type) {
         case GfxSamplerType::LINEAR_SAMPLER: {
@@ -47,11 +51,14 @@ TextureSampler::TextureSampler(const ThreadSafeGfxDevice& threadSafeDevice, GfxS
             samplerCreateInfo.addressModeU = samplerCreateInfo.addressModeV = samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
         } break;
         case GfxSamplerType::MIN_SAMPLER: {
-            LOGE(m_TAG ,"Not implemented.");
+            // Linear filtering returns the min of the footprint instead of the weighted average (depth pyramids)
+            samplerCreateInfo.pNext = &s_MinReduction;
+            samplerCreateInfo.addressModeU = samplerCreateInfo.addressModeV = samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+            samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
         } break;
         case GfxSamplerType::ANISO_SAMPLER: {
             samplerCreateInfo.anisotropyEnable = VK_TRUE;
-            samplerCreateInfo.maxAnisotropy = 16;
+            samplerCreateInfo.maxAnisotropy = 16;      // SamplerCache clamps it to maxSamplerAnisotropy
         } break;
         default: {
             LOGE(m_TAG,"Unkown sampler type.");
@@ -59,11 +66,27 @@ TextureSampler::TextureSampler(const ThreadSafeGfxDevice& threadSafeDevice, GfxS
             break;
         }
     }
+    return samplerCreateInfo;
+}
+
+TextureSampler::TextureSampler(const ThreadSafeGfxDevice& threadSafeDevice, GfxSamplerType type)
+    : m_type(type), m_device(threadSafeDevice) {
+    // The VkSampler is owned by the device's sampler cache, identical states share one sampler
     auto dev = m_device.lock();
     if(dev != nullptr) {
-        CHECK_VK(vkCreateSampler(dev->getDevice(), &samplerCreateInfo, nullptr, &m_sampler));
+        m_sampler = dev->getSampler(type);
     }
 
     //const std::string samplerLabel = "sensing_sampler_" + getSamplerName(type);
     //dev->setDebugLabel(samplerLabel, VK_OBJECT_TYPE_SAMPLER, reinterpret_cast<uint64_t>(m_sampler));
-}
\ No newline at end of file
+}
+
+GfxSamplerType TextureSampler::getType() const
+{
+    return m_type;
+}
+
+VkSampler TextureSampler::getVkSampler() const
+{
+    return m_sampler;
+}
@@ -10,13 +10,15 @@ public:
     TextureSampler(const ThreadSafeGfxDevice& threadSafeDevice, GfxSamplerType type);
     ~TextureSampler(){};
 
+    static VkSamplerCreateInfo getCreateInfo(GfxSamplerType type);
+
     GfxSamplerType getType() const ;
 
     VkSampler getVkSampler() const;
 
 private:
-    VkSampler m_sampler;
+    VkSampler m_sampler{VK_NULL_HANDLE};
     GfxSamplerType m_type;
     ThreadSafeGfxDevice m_device;
-    static std::string m_TAG;
+    static constexpr LogTag m_TAG{"TextureSampler"};
 };
@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+
+#include "TextureStreamer.h"
+#include "GfxUtils.h"
+#include "../../Utils/JobSystem.h"
+#include "../../Utils/Profiler.h"
+
+TextureStreamer::TextureStreamer(const ThreadSafeGfxDevice& threadSafeDevice, JobSystem& jobSystem,
+                                 const TextureStreamingConfig& config)
+    : m_Device(threadSafeDevice)
+    , m_JobSystem(jobSystem)
+    , m_Config(config)
+    , m_Residency(config)
+{
+    LOGD(m_TAG,__FUNCTION__);
+    if (m_Device.lock() == nullptr) {
+        throw std::runtime_error("TextureStreamer created without a device");
+    }
+}
+
+uint32_t TextureStreamer::addTexture(const std::string& filename, float priority)
+{
+    PROFILE_FUNCTION();
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        LOGE(m_TAG,"%s: can't open", filename.c_str());
+        return TextureResidency::kInvalid;
+    }
+    const auto fileSize = static_cast<uint64_t>(file.tellg());
+    std::vector<uint8_t> headerData(static_cast<size_t>(std::min<uint64_t>(fileSize, kKtx2MaxHeaderSize)));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(headerData.data()), static_cast<std::streamsize>(headerData.size()));
+    Ktx2Image header;
+    std::string error;
+    if (!file || !readKtx2Header(headerData.data(), headerData.size(), fileSize, header, error)) {
+        LOGE(m_TAG,"%s: %s", filename.c_str(), file ? error.c_str() : "read failed");
+        return TextureResidency::kInvalid;
+    }
+    auto dev = m_Device.lock();
+    if (!dev->isTextureFormatSupported(static_cast<VkFormat>(header.vkFormat))) {
+        LOGW(m_TAG,"%s: format %u can't be sampled on this device", filename.c_str(), header.vkFormat);
+        return TextureResidency::kInvalid;
+    }
+
+    std::vector<uint64_t> levelBytes;
+    for (const Ktx2Image::Level& level : header.levels) {
+        levelBytes.push_back(level.size);
+    }
+    const uint32_t handle = m_Residency.addTexture(std::move(levelBytes), std::max(header.width, header.height), priority);
+
+    // The tail is loaded right away, a streamed texture always has something to sample
+    const uint32_t tailMip = m_Residency.getTailMip(handle);
+    const auto levelCount = static_cast<uint32_t>(header.levels.size());
+    Ktx2Image tail;
+    std::vector<size_t> offsets;
+    if (!readLevels(filename, header, tailMip, levelCount, tail.file, offsets)) {
+        LOGE(m_TAG,"%s: read failed", filename.c_str());
+        m_Residency.removeTexture(handle);
+        return TextureResidency::kInvalid;
+    }
+    tail.vkFormat = header.vkFormat;
+    tail.formatInfo = header.formatInfo;
+    tail.width = header.levels[tailMip].width;
+    tail.height = header.levels[tailMip].height;
+    for (uint32_t level = tailMip; level < levelCount; level++) {
+        const Ktx2Image::Level& source = header.levels[level];
+        tail.levels.push_back({ offsets[level - tailMip], source.size, source.width, source.height });
+    }
+    auto texture = dev->uploadTexture(filename, tail);
+    if (!texture) {
+        m_Residency.removeTexture(handle);
+        return TextureResidency::kInvalid;
+    }
+
+    if (handle >= m_Textures.size()) {
+        m_Textures.resize(handle + 1);
+    }
+    StreamedTexture& streamed = m_Textures[handle];
+    streamed.filename = filename;
+    streamed.header = std::move(header);
+    streamed.texture = std::move(texture);
+    streamed.firstMip = tailMip;
+    return handle;
+}
+
+void TextureStreamer::removeTexture(uint32_t handle)
+{
+    // The texture's image and id go once frames in flight are done with them
+    m_Textures[handle] = StreamedTexture{};
+    // A load in flight is dropped when it completes, evictions not applied yet are moot
+    m_PendingEvictions.erase(std::remove_if(m_PendingEvictions.begin(), m_PendingEvictions.end(),
+                                            [handle](const TextureResidency::Eviction& eviction) {
+                                                return eviction.texture == handle;
+                                            }),
+                             m_PendingEvictions.end());
+    m_Residency.removeTexture(handle);
+}
+
+void TextureStreamer::reportUsage(uint32_t handle, float screenSize)
+{
+    m_Residency.reportUsage(handle, screenSize);
+}
+
+uint32_t TextureStreamer::getTextureId(uint32_t handle) const
+{
+    return m_Textures[handle].texture->getTextureId();
+}
+
+void TextureStreamer::setBudget(uint64_t budgetBytes)
+{
+    m_Residency.setBudget(budgetBytes, m_PendingEvictions);
+}
+
+void TextureStreamer::update(VkCommandBuffer commandBuffer)
+{
+    PROFILE_FUNCTION();
+    m_Residency.beginFrame();
+
+    std::vector<TextureResidency::Eviction> evictions;
+    evictions.swap(m_PendingEvictions);
+    auto applyEvictions = [&]() {
+        for (const TextureResidency::Eviction& eviction : evictions) {
+            replaceImage(commandBuffer, eviction.texture, eviction.firstMip, nullptr);
+        }
+        evictions.clear();
+    };
+    applyEvictions();
+
+    // Loads complete in any order, each upload is an image reallocation so only a few per frame
+    uint32_t uploads = 0;
+    for (auto it = m_Loads.begin(); it != m_Loads.end();) {
+        Load& load = **it;
+        if (!load.done.load(std::memory_order_acquire) || (!load.failed && uploads >= m_Config.maxUploadsPerFrame)) {
+            ++it;
+            continue;
+        }
+        uint32_t firstMip = TextureResidency::kInvalid;
+        if (load.failed) {
+            LOGE(m_TAG,"%s: reading levels %u-%u failed", m_Textures[load.request.texture].filename.c_str(),
+                 load.request.firstMip, load.request.lastMip - 1);
+        } else {
+            firstMip = m_Residency.beginUpload(load.request, evictions);
+            // Frees the memory first, the new image needs it
+            applyEvictions();
+            if (firstMip != TextureResidency::kInvalid) {
+                replaceImage(commandBuffer, load.request.texture, firstMip, &load);
+                uploads++;
+            }
+        }
+        m_Residency.endLoad(load.request.texture, firstMip);
+        it = m_Loads.erase(it);
+    }
+
+    for (const TextureResidency::LoadRequest& request : m_Residency.takeLoadRequests()) {
+        auto load = std::make_shared<Load>();
+        load->request = request;
+        const StreamedTexture& streamed = m_Textures[request.texture];
+        m_JobSystem.submit([load, filename = streamed.filename, header = streamed.header]() {
+            load->failed = !readLevels(filename, header, load->request.firstMip, load->request.lastMip, load->data,
+                                       load->offsets);
+            load->done.store(true, std::memory_order_release);
+        });
+        m_Loads.push_back(std::move(load));
+    }
+
+    const TextureStreamingStats& stats = m_Residency.getStats();
+    if (stats.uploads > 0 || stats.evictions > 0) {
+        LOGD(m_TAG,"%u uploads, %u evictions, %llu of %llu bytes resident, %u pending, %u loading", stats.uploads,
+             stats.evictions, static_cast<unsigned long long>(stats.residentBytes),
+             static_cast<unsigned long long>(stats.budgetBytes), stats.pendingRequests, stats.loadsInFlight);
+    }
+}
+
+bool TextureStreamer::readLevels(const std::string& filename, const Ktx2Image& header, uint32_t firstMip,
+                                 uint32_t lastMip, std::vector<uint8_t>& data, std::vector<size_t>& offsets)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    const size_t alignment = header.formatInfo.bytesPerBlock;
+    data.clear();
+    offsets.clear();
+    for (uint32_t level = firstMip; level < lastMip; level++) {
+        const Ktx2Image::Level& source = header.levels[level];
+        const size_t offset = (data.size() + alignment - 1) / alignment * alignment;
+        offsets.push_back(offset);
+        data.resize(offset + source.size);
+        file.seekg(static_cast<std::streamoff>(source.offset));
+        file.read(reinterpret_cast<char*>(data.data() + offset), static_cast<std::streamsize>(source.size));
+    }
+    return static_cast<bool>(file);
+}
+
+void TextureStreamer::replaceImage(VkCommandBuffer commandBuffer, uint32_t handle, uint32_t firstMip, const Load* load)
+{
+    auto dev = m_Device.lock();
+    StreamedTexture& streamed = m_Textures[handle];
+    const Ktx2Image& header = streamed.header;
+    const VkImage oldImage = streamed.texture->getImage();
+    const uint32_t oldFirstMip = streamed.firstMip;
+    const auto levelCount = static_cast<uint32_t>(header.levels.size());
+    const uint32_t mipLevels = levelCount - firstMip;
+    const Ktx2Image::Level& base = header.levels[firstMip];
+
+    GfxTextureDesc desc = streamed.texture->getDesc();
+    desc.width = base.width;
+    desc.height = base.height;
+    desc.mipLevels = mipLevels;
+    auto texture = dev->createTexture(desc);
+    const VkImage image = texture->getImage();
+
+    // Earlier frames may still sample the old image, reads only, so waiting for them is enough
+    std::array<VkImageMemoryBarrier, 2> barriers = {};
+    for (VkImageMemoryBarrier& barrier : barriers) {
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    }
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[0].image = image;
+    barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+    barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barriers[1].image = oldImage;
+    barriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount - oldFirstMip, 0, 1 };
+    barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+    // Levels both images hold are copied on the GPU, the same extents at other level indices
+    std::vector<VkImageCopy> copies;
+    for (uint32_t level = std::max(firstMip, oldFirstMip); level < levelCount; level++) {
+        VkImageCopy copy = {};
+        copy.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - oldFirstMip, 0, 1 };
+        copy.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - firstMip, 0, 1 };
+        copy.extent = { header.levels[level].width, header.levels[level].height, 1 };
+        copies.push_back(copy);
+    }
+    vkCmdCopyImage(commandBuffer, oldImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copies.size()), copies.data());
+
+    // Levels the old image didn't have come from the load, finer ones it dropped are skipped. The
+    // staging buffer is dropped once the copy is recorded, the deletion queue keeps it until it ran.
+    if (load != nullptr && firstMip < oldFirstMip) {
+        const size_t begin = load->offsets[firstMip - load->request.firstMip];
+        GfxBufferDesc stagingDesc;
+        stagingDesc.name = streamed.filename + " staging";
+        stagingDesc.size = load->data.size() - begin;
+        stagingDesc.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        stagingDesc.memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        auto staging = dev->createBuffer(stagingDesc);
+        memcpy(staging->getMapped(), load->data.data() + begin, static_cast<size_t>(stagingDesc.size));
+
+        std::vector<VkBufferImageCopy> regions;
+        for (uint32_t level = firstMip; level < oldFirstMip; level++) {
+            VkBufferImageCopy region = {};
+            region.bufferOffset = load->offsets[level - load->request.firstMip] - begin;
+            region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - firstMip, 0, 1 };
+            region.imageExtent = { header.levels[level].width, header.levels[level].height, 1 };
+            regions.push_back(region);
+        }
+        vkCmdCopyBufferToImage(commandBuffer, staging->getBuffer(), image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               static_cast<uint32_t>(regions.size()), regions.data());
+    }
+
+    VkImageMemoryBarrier& barrier = barriers[0];
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &barrier);
+
+    // A new id, the old one may still be read by frames in flight. The old texture is released
+    // after this frame, the last one copying from it.
+    texture->setTextureId(dev->addTexture(texture->getSRV()));
+    streamed.texture = std::move(texture);
+    streamed.firstMip = firstMip;
+}
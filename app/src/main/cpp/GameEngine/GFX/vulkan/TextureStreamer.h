@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "../../Utils/Definitions.h"
+#include "../../Utils/Ktx2.h"
+#include "GfxDevice.h"
+#include "TextureResidency.h"
+
+class JobSystem;
+
+// Streams the mip levels of KTX2 textures (Utils/Ktx2.h), residency decided by TextureResidency.
+// Adding a texture reads only the header and uploads the tail (the levels of residentTailSize and
+// smaller), finer levels are read on the job system once draws report they need them.
+// Mobile GPUs have no sparse residency, so a texture is one image holding exactly its resident
+// levels: an upload or eviction creates a new image, copies the levels both have on the GPU, copies
+// the new ones from a staging buffer, and the texture gets a new id. The old texture and the staging
+// buffer are dropped right away, the device's DeletionQueue destroys them once no frame uses them.
+class TextureStreamer {
+public:
+    NONCOPYABLE(TextureStreamer);
+    TextureStreamer(const ThreadSafeGfxDevice& threadSafeDevice, JobSystem& jobSystem,
+                    const TextureStreamingConfig& config);
+
+    // Returns the handle for the other calls, kInvalid when the file can't be read or the device
+    // can't sample its format. Higher priorities keep their levels when the budget is short.
+    uint32_t addTexture(const std::string& filename, float priority = 1.0f);
+    void removeTexture(uint32_t handle);
+
+    // The texture is drawn covering about screenSize pixels along its larger axis this frame
+    void reportUsage(uint32_t handle, float screenSize);
+    // Once per frame into the frame's command buffer, before any draw sampling streamed textures:
+    // applies finished loads and evictions, then starts new loads
+    void update(VkCommandBuffer commandBuffer);
+
+    // The id to draw with (GfxDevice::addTexture), changes whenever the resident levels do
+    uint32_t getTextureId(uint32_t handle) const;
+    const std::shared_ptr<GfxTexture>& getTexture(uint32_t handle) const { return m_Textures[handle].texture; }
+
+    // Evicts down to the new budget with the next update
+    void setBudget(uint64_t budgetBytes);
+    const TextureStreamingStats& getStats() const { return m_Residency.getStats(); }
+
+private:
+    struct StreamedTexture {
+        std::string filename;
+        // Header and level index only, offsets are into the file
+        Ktx2Image header;
+        std::shared_ptr<GfxTexture> texture;
+        // First level the image holds, its level 0
+        uint32_t firstMip{0};
+    };
+
+    // Filled by a job, owned by the streamer once done
+    struct Load {
+        TextureResidency::LoadRequest request{};
+        std::vector<uint8_t> data;
+        // Per level from request.firstMip, into data
+        std::vector<size_t> offsets;
+        bool failed{false};
+        std::atomic<bool> done{false};
+    };
+
+    // Levels firstMip up to (excluding) lastMip, each starting at a multiple of the block size
+    static bool readLevels(const std::string& filename, const Ktx2Image& header, uint32_t firstMip, uint32_t lastMip,
+                           std::vector<uint8_t>& data, std::vector<size_t>& offsets);
+    // New image holding the levels from firstMip, the ones missing from the current image come from load
+    void replaceImage(VkCommandBuffer commandBuffer, uint32_t handle, uint32_t firstMip, const Load* load);
+
+    ThreadSafeGfxDevice m_Device;
+    JobSystem& m_JobSystem;
+    TextureStreamingConfig m_Config;
+    TextureResidency m_Residency;
+    // Indexed by the residency's texture ids, which are the handles
+    std::vector<StreamedTexture> m_Textures;
+    std::vector<std::shared_ptr<Load>> m_Loads;
+    std::vector<TextureResidency::Eviction> m_PendingEvictions;
+    static constexpr LogTag m_TAG{"TextureStreamer"};
+};
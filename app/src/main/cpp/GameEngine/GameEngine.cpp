@@ -1,9 +1,19 @@
+#include <cmath>
 #include <android/log.h>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 #include "GameEngine.h"
 #include "Utils/Definitions.h"
+#include "Utils/Profiler.h"
 #include "GFX/IGfxDevice.h"
 
-std::string GameEngine::m_TAG = "GameEngine";
+namespace {
+constexpr uint64_t kStepNs = 16666667;
+constexpr double kCameraOrbitSeconds = 8.0;
+constexpr float kCameraDistance = 6.0f;
+constexpr float kCameraHeight = 2.0f;
+}
+
 std::shared_ptr<GameEngine> GameEngine::s_GameEngine = nullptr;
 GameEngine::~GameEngine() {
  LOGD(m_TAG,__FUNCTION__);
@@ -11,7 +21,23 @@ GameEngine::~GameEngine() {
 
 GameEngine::GameEngine() {
     LOGD(m_TAG,__FUNCTION__);
+    m_Renderer = std::make_shared<Renderer>();
+    m_EventHandler = std::make_shared<EventHandler>();
+    m_Simulation = std::make_unique<Simulation>(kStepNs, [this](FrameState& state, double stepSeconds) {
+        updateCamera(state, stepSeconds);
+    });
 }
+
+void GameEngine::updateCamera(FrameState& state, double stepSeconds) const
+{
+    // From the tick rather than accumulated, the orbit doesn't drift with rounding
+    const double turns = static_cast<double>(state.tick) * stepSeconds / kCameraOrbitSeconds;
+    const float angle = static_cast<float>(turns - static_cast<uint64_t>(turns)) * glm::two_pi<float>();
+    state.view = glm::lookAt(glm::vec3(std::cos(angle) * kCameraDistance, kCameraHeight, std::sin(angle) * kCameraDistance),
+                             glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    state.projection = glm::perspective(glm::radians(45.0f), m_AspectRatio.load(), 0.1f, 100.0f);
+}
+
 std::shared_ptr<GameEngine> GameEngine::getGameEngine() {
     if (s_GameEngine == nullptr)
     {
@@ -41,31 +67,87 @@ void GameEngine::cleanup()
 void GameEngine::run(android_app *pApp)
 {
     pApp->onAppCmd= [](android_app *pApp, int32_t cmd){
-        switch (cmd) {
-            case APP_CMD_INIT_WINDOW: {
-                pApp->userData = GameEngine::getGameEngine().get();
-                auto engine = reinterpret_cast<GameEngine *>(pApp->userData);
-                engine->init(pApp->window, pApp->activity->assetManager);
-                break;
-            }
-            case APP_CMD_TERM_WINDOW: {
-                if (pApp->userData != nullptr) {
-                    //
-                    auto engine = reinterpret_cast<GameEngine *>(pApp->userData);
-                    engine->cleanup();
-
-                }
-                break;
-            }
-            default:
-                break;
-        }
+        pApp->userData = GameEngine::getGameEngine().get();
+        auto engine = reinterpret_cast<GameEngine *>(pApp->userData);
+        engine->handleCommand(pApp, cmd);
     };
 
     while(!pApp->destroyRequested)
     {
-        m_EventHandler->handleEvents(pApp);
+        // Without a window or while paused there is nothing to do until the next command,
+        // block in the looper instead of spinning
+        int timeout = isRendering() ? 0 : -1;
+        int events = 0;
+        android_poll_source *source = nullptr;
+        int result;
+        while ((result = ALooper_pollOnce(timeout, nullptr, &events, reinterpret_cast<void **>(&source))) >= 0 ||
+               result == ALOOPER_POLL_CALLBACK)
+        {
+            if (result >= 0 && source != nullptr)
+            {
+                source->process(pApp, source);
+            }
+            if (pApp->destroyRequested)
+            {
+                return;
+            }
+            source = nullptr;
+            timeout = isRendering() ? 0 : -1;
+        }
+
+        if (isRendering())
+        {
+            frame(pApp);
+        }
+    }
+}
 
-        //m_
+void GameEngine::handleCommand(android_app *pApp, int32_t cmd)
+{
+    switch (cmd) {
+        case APP_CMD_INIT_WINDOW: {
+            init(pApp->window, pApp->activity->assetManager);
+            m_HasWindow = true;
+            const int32_t width = ANativeWindow_getWidth(pApp->window);
+            const int32_t height = ANativeWindow_getHeight(pApp->window);
+            if (width > 0 && height > 0) {
+                m_AspectRatio = static_cast<float>(width) / static_cast<float>(height);
+            }
+            // The first frame is drawn before any update ran, start it from the camera too
+            FrameState state = m_Simulation->waitForFrame();
+            updateCamera(state, kStepNs / 1e9);
+            m_Simulation->setState(state);
+            m_Simulation->resetTime(m_Clock.nowNs());
+            break;
+        }
+        case APP_CMD_TERM_WINDOW: {
+            m_HasWindow = false;
+            cleanup();
+            break;
+        }
+        case APP_CMD_RESUME: {
+            m_Resumed = true;
+            // The time spent paused is not simulated
+            m_Simulation->resetTime(m_Clock.nowNs());
+            break;
+        }
+        case APP_CMD_PAUSE: {
+            m_Resumed = false;
+            break;
+        }
+        default:
+            break;
     }
-}
\ No newline at end of file
+}
+
+void GameEngine::frame(android_app *pApp)
+{
+    PROFILE_ZONE("GameEngine::frame");
+    m_EventHandler->handleEvents(pApp);
+
+    // The update for this frame ran while the previous one was recorded. Its state is copied
+    // into the device before the update for the next frame starts overwriting it.
+    m_Renderer->setFrameState(m_Simulation->waitForFrame());
+    m_Simulation->requestFrame(m_Clock.nowNs());
+    m_Renderer->endFrame();
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <functional>
 
@@ -9,6 +10,9 @@
 #include <game-activity/native_app_glue/android_native_app_glue.h>
 
 #include "EventHandler.h"
+#include "Simulation.h"
+#include "Utils/Clock.h"
+#include "Utils/Definitions.h"
 #include "Renderer/Renderer.h"
 
 
@@ -29,9 +33,18 @@ public:
     void reset(ANativeWindow *newWindow, AAssetManager *newManager);
     void init(ANativeWindow *newWindow, AAssetManager *newManager);
     void cleanup();
+    // Main loop, returns when the activity is destroyed. Sleeps in the looper while there is
+    // nothing to draw.
     void run(android_app* app);
+    // Game logic runs here, at a fixed 60 Hz
+    Simulation& getSimulation() { return *m_Simulation; }
 private:
     GameEngine();
+    void handleCommand(android_app* app, int32_t cmd);
+    void frame(android_app* app);
+    bool isRendering() const { return m_HasWindow && m_Resumed && m_Renderer->isReady(); }
+    // Default camera until a scene drives one, orbits the origin. Runs on the update thread.
+    void updateCamera(FrameState& state, double stepSeconds) const;
 
 private:
     static std::shared_ptr<GameEngine> s_GameEngine;
@@ -42,5 +55,11 @@ private:
     std::shared_ptr<Renderer> m_Renderer;
     std::shared_ptr<FileManager> m_FileManager;
     std::shared_ptr<EventHandler> m_EventHandler;
-    static std::string m_TAG;
+    // Of the current window, read by the update thread so declared before the simulation
+    std::atomic<float> m_AspectRatio{1.0f};
+    std::unique_ptr<Simulation> m_Simulation;
+    SteadyClock m_Clock;
+    bool m_HasWindow{false};
+    bool m_Resumed{false};
+    static constexpr LogTag m_TAG{"GameEngine"};
 };
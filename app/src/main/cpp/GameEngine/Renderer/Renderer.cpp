@@ -6,7 +6,15 @@
 #include "Renderer.h"
 #include "../GFX/vulkan/GfxDevice.h"
 
-std::string Renderer::m_TAG = "Renderer";
+Renderer::Renderer()
+{
+    LOGD(m_TAG,__FUNCTION__);
+}
+
+Renderer::~Renderer()
+{
+    LOGD(m_TAG,__FUNCTION__);
+}
 
 std::string Renderer::toStringBackend(BackEnd backend)
 {
@@ -49,6 +57,16 @@ void Renderer::resize(ANativeWindow *newWindow)
     }
 }
 
+void Renderer::endFrame()
+{
+    m_Device->draw();
+}
+
+void Renderer::setFrameState(const FrameState& state)
+{
+    m_Device->setFrameState(state);
+}
+
 void Renderer::shutdown() {
     m_Device->deInit();
 }
@@ -29,6 +29,9 @@ public:
 
     void beginFrame();
     void endFrame();
+    // State the next endFrame() draws
+    void setFrameState(const FrameState& state);
+    bool isReady() const { return m_Device != nullptr && m_Device->isInitialized(); }
 
     void resize(ANativeWindow *newWindow);
 
@@ -37,5 +40,5 @@ private:
 private:
     std::shared_ptr<IGfxDevice> m_Device;
     std::unique_ptr<ANativeWindow, ANativeWindowDeleter> m_MainWindow;
-    static std::string m_TAG;
+    static constexpr LogTag m_TAG{"Renderer"};
 };
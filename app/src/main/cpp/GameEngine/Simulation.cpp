@@ -0,0 +1,115 @@
+#include <chrono>
+
+#include "Simulation.h"
+#include "Utils/Profiler.h"
+
+Simulation::Simulation(uint64_t stepNs, UpdateFunc update)
+    : m_Timestep(stepNs)
+    , m_Update(std::move(update))
+{
+    LOGD(m_TAG,"%.2f ms steps", stepNs / 1e6);
+    m_Thread = std::thread(&Simulation::run, this);
+}
+
+Simulation::~Simulation()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_Stop = true;
+    }
+    m_Requested.notify_one();
+    m_Thread.join();
+}
+
+void Simulation::requestFrame(uint64_t timeNs)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_RequestTimeNs = timeNs;
+        m_HasRequest = true;
+    }
+    m_Requested.notify_one();
+}
+
+const FrameState& Simulation::waitForFrame()
+{
+    PROFILE_FUNCTION();
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_Done.wait(lock, [this] { return !m_HasRequest && !m_Busy; });
+    return m_Output;
+}
+
+void Simulation::resetTime(uint64_t timeNs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_ResetTimeNs = timeNs;
+    m_HasReset = true;
+}
+
+void Simulation::setState(const FrameState& state)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_Done.wait(lock, [this] { return !m_HasRequest && !m_Busy; });
+    m_Previous = state;
+    m_Current = state;
+    m_Output = state;
+}
+
+void Simulation::setUpdate(UpdateFunc update)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_Done.wait(lock, [this] { return !m_HasRequest && !m_Busy; });
+    m_Update = std::move(update);
+}
+
+SimulationStats Simulation::getStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_Stats;
+}
+
+void Simulation::run()
+{
+    for (;;) {
+        uint64_t timeNs = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_Requested.wait(lock, [this] { return m_HasRequest || m_Stop; });
+            if (m_Stop) {
+                return;
+            }
+            if (m_HasReset) {
+                m_Timestep.reset(m_ResetTimeNs);
+                m_HasReset = false;
+            }
+            timeNs = m_RequestTimeNs;
+            m_HasRequest = false;
+            m_Busy = true;
+        }
+
+        PROFILE_ZONE("Simulation::update");
+        auto start = std::chrono::steady_clock::now();
+        const uint32_t steps = m_Timestep.advance(timeNs);
+        for (uint32_t i = 0; i < steps; i++) {
+            // Only the last two steps are blended, earlier ones of a catch-up are skipped over
+            std::swap(m_Previous, m_Current);
+            m_Current = m_Previous;
+            m_Current.tick = m_Previous.tick + 1;
+            if (m_Update) {
+                m_Update(m_Current, m_Timestep.getStepSeconds());
+            }
+        }
+        interpolateFrameState(m_Previous, m_Current, m_Timestep.getAlpha(), m_Output);
+        double updateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_Stats.ticks += steps;
+            m_Stats.frames++;
+            m_Stats.droppedNs = m_Timestep.getDroppedNs();
+            m_Stats.updateMs = updateMs;
+            m_Busy = false;
+        }
+        m_Done.notify_all();
+    }
+}
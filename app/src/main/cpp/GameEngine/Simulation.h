@@ -0,0 +1,70 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "EntityComponent/FrameState.h"
+#include "Utils/Definitions.h"
+#include "Utils/FixedTimestep.h"
+
+struct SimulationStats {
+    uint64_t ticks{0};
+    uint64_t frames{0};
+    uint64_t droppedNs{0};      // time skipped after stalls, see FixedTimestep
+    double updateMs{0.0};       // steps and interpolation of the last frame
+};
+
+// Runs the game update at a fixed rate on its own thread, one frame ahead of rendering:
+//
+//   render thread:  waitForFrame(N) -> copy state -> requestFrame(N+1) -> record / submit N
+//   update thread:                                   steps up to N+1, interpolates
+//
+// The update for the next frame overlaps recording of the current one. The state a frame
+// draws is blended between the last two steps, so motion is smooth at any display rate while
+// the simulation itself only ever sees the fixed step.
+class Simulation {
+public:
+    // Advances state by one step, runs on the update thread
+    using UpdateFunc = std::function<void(FrameState& state, double stepSeconds)>;
+
+    NONCOPYABLE(Simulation);
+    Simulation(uint64_t stepNs, UpdateFunc update);
+    ~Simulation();
+
+    // Starts the update for a frame shown at timeNs, returns right away
+    void requestFrame(uint64_t timeNs);
+    // Blocks until the requested frame is ready. The state stays valid until the next
+    // requestFrame(), before the first request it is the initial state.
+    const FrameState& waitForFrame();
+    // After a pause, the next request starts from timeNs instead of catching up
+    void resetTime(uint64_t timeNs);
+
+    // Replace the state or the update outright, e.g. when a level loads. Wait for a running update.
+    void setState(const FrameState& state);
+    void setUpdate(UpdateFunc update);
+    SimulationStats getStats();
+
+private:
+    void run();
+
+    FixedTimestep m_Timestep;
+    UpdateFunc m_Update;
+    FrameState m_Previous;
+    FrameState m_Current;
+    FrameState m_Output;
+    SimulationStats m_Stats;
+
+    std::mutex m_mutex;
+    std::condition_variable m_Requested;
+    std::condition_variable m_Done;
+    uint64_t m_RequestTimeNs{0};
+    uint64_t m_ResetTimeNs{0};
+    bool m_HasRequest{false};
+    bool m_HasReset{false};
+    bool m_Busy{false};
+    bool m_Stop{false};
+    std::thread m_Thread;
+    static constexpr LogTag m_TAG{"Simulation"};
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Definitions.h"
+
+struct BenchmarkResult {
+    std::string name;
+    uint32_t iterations{0};
+    double minMs{0.0};
+    double medianMs{0.0};
+    double meanMs{0.0};
+    double maxMs{0.0};
+};
+
+// Times `iterations` calls of func after one untimed warm-up call. Results go to the log under
+// the "Benchmark" tag so they can be grepped from logcat / stdout.
+template<class Func>
+BenchmarkResult runBenchmark(const std::string& name, uint32_t iterations, Func&& func)
+{
+    func();
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    for (uint32_t i = 0; i < iterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        func();
+        samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    BenchmarkResult result;
+    result.name = name;
+    result.iterations = iterations;
+    if (samples.empty()) {
+        return result;
+    }
+    std::sort(samples.begin(), samples.end());
+    result.minMs = samples.front();
+    result.maxMs = samples.back();
+    result.medianMs = samples[samples.size() / 2];
+    for (double sample : samples) {
+        result.meanMs += sample;
+    }
+    result.meanMs /= samples.size();
+
+    static constexpr LogTag tag{"Benchmark"};
+    LOGI(tag,"%s : %u iterations, min %.4f ms, median %.4f ms, mean %.4f ms, max %.4f ms", name.c_str(),
+         iterations, result.minMs, result.medianMs, result.meanMs, result.maxMs);
+    return result;
+}
@@ -0,0 +1,134 @@
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+
+#include "ChromeTrace.h"
+
+namespace {
+void appendEscaped(std::string& out, const std::string& text)
+{
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out += ' ';
+        } else {
+            out += c;
+        }
+    }
+}
+}
+
+ChromeTrace::Zone::Zone(ChromeTrace& trace, const char* name, const char* category)
+    : m_Trace(trace)
+    , m_Name(name)
+    , m_Category(category)
+    , m_StartNs(trace.isCapturing() ? nowNs() : 0)
+{
+}
+
+ChromeTrace::Zone::~Zone()
+{
+    if (m_StartNs != 0) {
+        m_Trace.addCpuZone(m_Name, m_Category, m_StartNs, nowNs());
+    }
+}
+
+ChromeTrace::ChromeTrace(size_t maxEvents)
+    : m_MaxEvents(maxEvents)
+{
+}
+
+void ChromeTrace::start()
+{
+    LOGD(m_TAG,"capture started");
+    m_Capturing.store(true, std::memory_order_relaxed);
+}
+
+void ChromeTrace::stop()
+{
+    m_Capturing.store(false, std::memory_order_relaxed);
+    LOGD(m_TAG,"capture stopped, %zu events, %zu dropped", getEventCount(), getDroppedCount());
+}
+
+void ChromeTrace::addZone(const std::string& name, const char* category, uint32_t process, uint32_t thread,
+                          uint64_t startNs, uint64_t durationNs)
+{
+    if (!isCapturing()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_Events.size() >= m_MaxEvents) {
+        m_Dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    m_Events.push_back({ name, category, process, thread, startNs, durationNs });
+}
+
+void ChromeTrace::addCpuZone(const char* name, const char* category, uint64_t startNs, uint64_t endNs)
+{
+    addZone(name, category, kCpuProcess, currentThreadId(), startNs, endNs > startNs ? endNs - startNs : 0);
+}
+
+std::string ChromeTrace::toJson() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::string json;
+    json.reserve(128 + m_Events.size() * 96);
+    json += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+    json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"args\":{\"name\":\"GPU\"}}";
+    char buffer[160];
+    for (const Event& event : m_Events) {
+        json += ",\n{\"name\":\"";
+        appendEscaped(json, event.name);
+        // Complete events, microseconds
+        snprintf(buffer, sizeof(buffer), "\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%" PRIu64 ".%03u,\"dur\":%" PRIu64 ".%03u}",
+                 event.category, event.process, event.thread,
+                 event.startNs / 1000, static_cast<uint32_t>(event.startNs % 1000),
+                 event.durationNs / 1000, static_cast<uint32_t>(event.durationNs % 1000));
+        json += buffer;
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+bool ChromeTrace::write(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        LOGE(m_TAG,"Could not open %s", path.c_str());
+        return false;
+    }
+    std::string json = toJson();
+    file.write(json.data(), static_cast<std::streamsize>(json.size()));
+    LOGI(m_TAG,"wrote %zu events to %s", getEventCount(), path.c_str());
+    return file.good();
+}
+
+void ChromeTrace::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_Events.clear();
+    m_Dropped.store(0, std::memory_order_relaxed);
+}
+
+size_t ChromeTrace::getEventCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_Events.size();
+}
+
+uint64_t ChromeTrace::nowNs()
+{
+    static SteadyClock clock;
+    return clock.nowNs();
+}
+
+uint32_t ChromeTrace::currentThreadId()
+{
+    static std::atomic<uint32_t> nextId{1};
+    thread_local uint32_t id = nextId.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
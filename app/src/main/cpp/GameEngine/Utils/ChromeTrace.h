@@ -0,0 +1,72 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Definitions.h"
+#include "Clock.h"
+
+// Collects timed zones and writes them in the Chrome trace event format, load the file in
+// chrome://tracing or ui.perfetto.dev. Zones are only kept between start() and stop(), the
+// buffer is bounded so a forgotten capture can't grow without limit.
+// Times are SteadyClock nanoseconds, GPU zones have to be converted to it before adding.
+class ChromeTrace {
+public:
+    // Shown as separate processes, CPU threads and GPU queues as their threads
+    static constexpr uint32_t kCpuProcess = 1;
+    static constexpr uint32_t kGpuProcess = 2;
+
+    struct Event {
+        std::string name;
+        const char* category;
+        uint32_t process;
+        uint32_t thread;
+        uint64_t startNs;
+        uint64_t durationNs;
+    };
+
+    // Times the enclosing scope on the calling thread
+    class Zone {
+    public:
+        NONCOPYABLE(Zone);
+        Zone(ChromeTrace& trace, const char* name, const char* category = "cpu");
+        ~Zone();
+
+    private:
+        ChromeTrace& m_Trace;
+        const char* m_Name;
+        const char* m_Category;
+        uint64_t m_StartNs;
+    };
+
+    NONCOPYABLE(ChromeTrace);
+    explicit ChromeTrace(size_t maxEvents = 1 << 16);
+
+    void start();
+    void stop();
+    bool isCapturing() const { return m_Capturing.load(std::memory_order_relaxed); }
+
+    void addZone(const std::string& name, const char* category, uint32_t process, uint32_t thread,
+                 uint64_t startNs, uint64_t durationNs);
+    void addCpuZone(const char* name, const char* category, uint64_t startNs, uint64_t endNs);
+
+    std::string toJson() const;
+    bool write(const std::string& path) const;
+    void clear();
+    size_t getEventCount() const;
+    size_t getDroppedCount() const { return m_Dropped.load(std::memory_order_relaxed); }
+
+    static uint64_t nowNs();
+    // Small stable id of the calling thread, trace viewers sort tracks by it
+    static uint32_t currentThreadId();
+
+private:
+    mutable std::mutex m_mutex;
+    std::vector<Event> m_Events;
+    size_t m_MaxEvents;
+    std::atomic<bool> m_Capturing{false};
+    std::atomic<size_t> m_Dropped{0};
+    static constexpr LogTag m_TAG{"ChromeTrace"};
+};
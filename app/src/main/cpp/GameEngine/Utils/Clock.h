@@ -0,0 +1,44 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+// Nanosecond time source. Code that paces itself against real time takes a Clock, so it can
+// run against SimulatedClock without waiting.
+class Clock {
+public:
+    virtual ~Clock() = default;
+    virtual uint64_t nowNs() const = 0;
+    virtual void sleepUntilNs(uint64_t timeNs) = 0;
+};
+
+// CLOCK_MONOTONIC on Android, the same time base VK_GOOGLE_display_timing reports in
+class SteadyClock : public Clock {
+public:
+    uint64_t nowNs() const override
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+    void sleepUntilNs(uint64_t timeNs) override
+    {
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(timeNs)));
+    }
+};
+
+// Only moves when told to, sleeping jumps straight to the wake up time
+class SimulatedClock : public Clock {
+public:
+    explicit SimulatedClock(uint64_t startNs = 0) : m_NowNs(startNs) {}
+    uint64_t nowNs() const override { return m_NowNs; }
+    void sleepUntilNs(uint64_t timeNs) override
+    {
+        if (timeNs > m_NowNs) {
+            m_NowNs = timeNs;
+        }
+    }
+    void advance(uint64_t ns) { m_NowNs += ns; }
+
+private:
+    uint64_t m_NowNs;
+};
@@ -1,10 +1,23 @@
 #pragma once
-#include "../../../../../../../../AppData/Local/Android/Sdk/ndk/25.1.8937393/toolchains/llvm/prebuilt/windows-x86_64/sysroot/usr/include/android/log.h"
+#include "Log.h"
 
-#define LOGI(TAG,...) __android_log_print(ANDROID_LOG_INFO,TAG.c_str(),__VA_ARGS__)
-#define LOGD(TAG,...) __android_log_print(ANDROID_LOG_DEBUG,TAG.c_str(),__VA_ARGS__)
-#define LOGW(TAG,...) __android_log_print(ANDROID_LOG_WARNING,TAG.c_str(),__VA_ARGS__)
-#define LOGE(TAG,...) __android_log_print(ANDROID_LOG_ERROR, TAG.c_str(),__VA_ARGS__)
+// TAG is a LogTag, formatting and output happen on the logger thread (Utils/Log.h)
+#if GAMEENGINE_LOG_LEVEL <= 0
+#define LOGD(TAG,...) GAMEENGINE_LOG(LogLevel::Debug,TAG,__VA_ARGS__)
+#else
+#define LOGD(TAG,...) GAMEENGINE_LOG_DISABLED(__VA_ARGS__)
+#endif
+#if GAMEENGINE_LOG_LEVEL <= 1
+#define LOGI(TAG,...) GAMEENGINE_LOG(LogLevel::Info,TAG,__VA_ARGS__)
+#else
+#define LOGI(TAG,...) GAMEENGINE_LOG_DISABLED(__VA_ARGS__)
+#endif
+#if GAMEENGINE_LOG_LEVEL <= 2
+#define LOGW(TAG,...) GAMEENGINE_LOG(LogLevel::Warning,TAG,__VA_ARGS__)
+#else
+#define LOGW(TAG,...) GAMEENGINE_LOG_DISABLED(__VA_ARGS__)
+#endif
+#define LOGE(TAG,...) GAMEENGINE_LOG(LogLevel::Error,TAG,__VA_ARGS__)
 
 #define NONCOPYABLE(className)                          \
     className(const className&) = delete;               \
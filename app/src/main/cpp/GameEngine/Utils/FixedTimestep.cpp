@@ -0,0 +1,37 @@
+#include "FixedTimestep.h"
+
+FixedTimestep::FixedTimestep(uint64_t stepNs, uint32_t maxSteps)
+    : m_StepNs(stepNs > 0 ? stepNs : 1)
+    , m_MaxSteps(maxSteps > 0 ? maxSteps : 1)
+{
+}
+
+uint32_t FixedTimestep::advance(uint64_t nowNs)
+{
+    if (!m_Started) {
+        reset(nowNs);
+        return 0;
+    }
+    if (nowNs > m_LastNs) {
+        m_AccumulatorNs += nowNs - m_LastNs;
+        m_LastNs = nowNs;
+    }
+
+    uint64_t steps = m_AccumulatorNs / m_StepNs;
+    if (steps > m_MaxSteps) {
+        // Keep the fraction so interpolation stays continuous
+        m_DroppedNs += (steps - m_MaxSteps) * m_StepNs;
+        m_AccumulatorNs -= (steps - m_MaxSteps) * m_StepNs;
+        steps = m_MaxSteps;
+    }
+    m_AccumulatorNs -= steps * m_StepNs;
+    m_Tick += steps;
+    return static_cast<uint32_t>(steps);
+}
+
+void FixedTimestep::reset(uint64_t nowNs)
+{
+    m_LastNs = nowNs;
+    m_AccumulatorNs = 0;
+    m_Started = true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+
+// Accumulator for a fixed simulation rate. Each advance() hands out the whole steps that fit
+// into the time passed since the last call, the remainder carries over and becomes the
+// interpolation factor between the last two steps.
+class FixedTimestep {
+public:
+    // maxSteps bounds the catch-up after a stall (spiral of death), the rest of the time is dropped
+    explicit FixedTimestep(uint64_t stepNs, uint32_t maxSteps = 8);
+
+    // Steps to run to reach nowNs, times from one clock
+    uint32_t advance(uint64_t nowNs);
+    // Forgets the accumulated time, the next advance() starts counting from nowNs. After a
+    // pause, so the simulation doesn't fast forward through it.
+    void reset(uint64_t nowNs);
+
+    // Fraction of a step between the last step and nowNs, 0..1
+    float getAlpha() const { return static_cast<float>(static_cast<double>(m_AccumulatorNs) / m_StepNs); }
+    uint64_t getStepNs() const { return m_StepNs; }
+    double getStepSeconds() const { return m_StepNs / 1e9; }
+    uint64_t getTick() const { return m_Tick; }
+    uint64_t getDroppedNs() const { return m_DroppedNs; }
+
+private:
+    uint64_t m_StepNs;
+    uint32_t m_MaxSteps;
+    uint64_t m_LastNs{0};
+    uint64_t m_AccumulatorNs{0};
+    uint64_t m_Tick{0};
+    uint64_t m_DroppedNs{0};
+    bool m_Started{false};
+};
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+// FNV-1a, used to key the GPU object caches (layouts, pipelines, samplers, descriptor sets).
+// Only feed it trivially copyable data without padding holes, or zero the structs first.
+class Hasher {
+public:
+    static constexpr uint64_t kOffsetBasis = 14695981039346656037ull;
+    static constexpr uint64_t kPrime = 1099511628211ull;
+
+    Hasher& data(const void* bytes, size_t size)
+    {
+        const auto* p = static_cast<const uint8_t*>(bytes);
+        for (size_t i = 0; i < size; i++)
+        {
+            m_hash ^= p[i];
+            m_hash *= kPrime;
+        }
+        return *this;
+    }
+
+    template<class T>
+    Hasher& value(const T& v)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "hash only trivially copyable values");
+        return data(&v, sizeof(T));
+    }
+
+    Hasher& string(const std::string& s)
+    {
+        value(s.size());
+        return data(s.data(), s.size());
+    }
+
+    uint64_t get() const { return m_hash; }
+
+private:
+    uint64_t m_hash{kOffsetBasis};
+};
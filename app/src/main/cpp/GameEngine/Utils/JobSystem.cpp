@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+#include "JobSystem.h"
+
+JobSystem::JobSystem(uint32_t threadCount)
+{
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency() - 1);
+    }
+    LOGD(m_TAG,"Starting %u worker threads", threadCount);
+    for (uint32_t i = 0; i < threadCount; i++) {
+        m_Threads.emplace_back(&JobSystem::workerLoop, this);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_Stop = true;
+    }
+    m_JobAvailable.notify_all();
+    for (auto& thread : m_Threads) {
+        thread.join();
+    }
+}
+
+void JobSystem::submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_Jobs.push_back(std::move(job));
+    }
+    m_JobAvailable.notify_one();
+}
+
+void JobSystem::wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_Idle.wait(lock, [this] { return m_Jobs.empty() && m_ActiveJobs == 0; });
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t slots,
+                            const std::function<void(uint32_t index, uint32_t slot)>& func)
+{
+    if (count == 0) {
+        return;
+    }
+    struct Batch {
+        std::atomic<uint32_t> next{0};
+        std::atomic<uint32_t> done{0};
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    // Helpers that start after the last index was taken only touch the batch, it outlives this call.
+    // func is only called before the index is counted done, so never after this call returned.
+    auto batch = std::make_shared<Batch>();
+    auto run = [batch, count, &func](uint32_t slot) {
+        for (uint32_t index = batch->next++; index < count; index = batch->next++) {
+            // After a throw the remaining indices are only counted, so the wait below still ends
+            if (!batch->failed) {
+                try {
+                    func(index, slot);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(batch->mutex);
+                    if (!batch->error) {
+                        batch->error = std::current_exception();
+                    }
+                    batch->failed = true;
+                }
+            }
+            if (++batch->done == count) {
+                std::lock_guard<std::mutex> lock(batch->mutex);
+                batch->finished.notify_all();
+            }
+        }
+    };
+    slots = std::min({ slots, count, getThreadCount() + 1 });
+    for (uint32_t slot = 1; slot < slots; slot++) {
+        submit([run, slot] { run(slot); });
+    }
+    run(0);
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->finished.wait(lock, [&batch, count] { return batch->done == count; });
+    // First exception from any thread, the caller's included, once every helper is done with func
+    if (batch->error) {
+        std::rethrow_exception(batch->error);
+    }
+}
+
+void JobSystem::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_JobAvailable.wait(lock, [this] { return m_Stop || !m_Jobs.empty(); });
+        // Pending jobs are still run on shutdown, owners may be waiting on them
+        if (m_Jobs.empty()) {
+            return;
+        }
+        auto job = std::move(m_Jobs.front());
+        m_Jobs.pop_front();
+        m_ActiveJobs++;
+        lock.unlock();
+        job();
+        lock.lock();
+        m_ActiveJobs--;
+        if (m_Jobs.empty() && m_ActiveJobs == 0) {
+            m_Idle.notify_all();
+        }
+    }
+}
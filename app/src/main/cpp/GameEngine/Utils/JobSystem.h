@@ -0,0 +1,45 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Definitions.h"
+
+// Fixed pool of worker threads consuming a FIFO of jobs.
+// Used for work that must not stall the frame (pipeline compiles, decoding, recording).
+class JobSystem {
+public:
+    NONCOPYABLE(JobSystem);
+    // 0 picks hardware_concurrency - 1, leaving a core for the calling thread
+    explicit JobSystem(uint32_t threadCount = 0);
+    ~JobSystem();
+
+    void submit(std::function<void()> job);
+    // Blocks until the queue is drained and every worker is idle
+    void wait();
+    // Runs func(index, slot) for every index in [0, count) on up to `slots` threads, the caller's
+    // included, and returns once all ran. A slot is only ever on one thread at a time, so per slot
+    // resources (command pools) need no lock. The caller takes indices too: jobs queued earlier
+    // (pipeline compiles, texture loads) can slow the batch down to serial but never stall it.
+    // If func throws, the remaining indices are skipped and the first exception is rethrown once
+    // no thread is inside func any more.
+    void parallelFor(uint32_t count, uint32_t slots, const std::function<void(uint32_t index, uint32_t slot)>& func);
+    uint32_t getThreadCount() const { return static_cast<uint32_t>(m_Threads.size()); }
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> m_Threads;
+    std::deque<std::function<void()>> m_Jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_JobAvailable;
+    std::condition_variable m_Idle;
+    uint32_t m_ActiveJobs{0};
+    bool m_Stop{false};
+    static constexpr LogTag m_TAG{"JobSystem"};
+};
@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "Ktx2.h"
+
+namespace {
+const uint8_t kIdentifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+// Identifier, 9 header fields, the 4 + 2 x 64 bit index of the descriptor / key value / global data
+constexpr size_t kHeaderSize = 12 + 9 * 4 + 4 * 4 + 2 * 8;
+// Byte offset, byte length and uncompressed byte length per level
+constexpr size_t kLevelIndexEntrySize = 3 * 8;
+
+const uint8_t kAstcBlockSizes[14][2] = {
+    {4, 4}, {5, 4}, {5, 5}, {6, 5}, {6, 6}, {8, 5}, {8, 6},
+    {8, 8}, {10, 5}, {10, 6}, {10, 8}, {10, 10}, {12, 10}, {12, 12},
+};
+
+// Khronos data format descriptor values
+constexpr uint32_t kDfdModelRgbsda = 1;
+constexpr uint32_t kDfdModelEtc2 = 161;
+constexpr uint32_t kDfdModelAstc = 162;
+constexpr uint32_t kDfdPrimariesBt709 = 1;
+constexpr uint32_t kDfdTransferLinear = 1;
+constexpr uint32_t kDfdTransferSrgb = 2;
+constexpr uint32_t kDfdChannelEtc2Color = 2;
+constexpr uint32_t kDfdChannelAlpha = 15;
+constexpr uint32_t kDfdQualifierLinear = 0x10;
+constexpr uint32_t kDfdFlagAlphaPremultiplied = 1;
+
+uint32_t readU32(const uint8_t* data)
+{
+    return uint32_t(data[0]) | uint32_t(data[1]) << 8 | uint32_t(data[2]) << 16 | uint32_t(data[3]) << 24;
+}
+
+uint64_t readU64(const uint8_t* data)
+{
+    return uint64_t(readU32(data)) | uint64_t(readU32(data + 4)) << 32;
+}
+
+void writeU32(std::vector<uint8_t>& out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++) {
+        out.push_back(uint8_t(value >> (i * 8)));
+    }
+}
+
+void writeU64(std::vector<uint8_t>& out, uint64_t value)
+{
+    writeU32(out, uint32_t(value));
+    writeU32(out, uint32_t(value >> 32));
+}
+
+void patchU64(std::vector<uint8_t>& out, size_t offset, uint64_t value)
+{
+    for (int i = 0; i < 8; i++) {
+        out[offset + i] = uint8_t(value >> (i * 8));
+    }
+}
+
+void pad(std::vector<uint8_t>& out, size_t alignment)
+{
+    out.resize((out.size() + alignment - 1) / alignment * alignment, 0);
+}
+
+struct DfdSample {
+    uint32_t bitOffset;
+    uint32_t bitLength;
+    uint32_t channel;
+    uint32_t upper;
+};
+
+// One basic descriptor block, what readers use to interpret the format without a VkFormat table
+void writeDataFormatDescriptor(std::vector<uint8_t>& out, uint32_t vkFormat, const TextureFormatInfo& info,
+                               bool premultipliedAlpha)
+{
+    uint32_t model = kDfdModelRgbsda;
+    std::vector<DfdSample> samples;
+    switch (info.compression) {
+        case TextureCompression::None: {
+            const uint32_t alphaChannel = kDfdChannelAlpha | (info.srgb ? kDfdQualifierLinear : 0);
+            samples = {{0, 8, 0, 255}, {8, 8, 1, 255}, {16, 8, 2, 255}, {24, 8, alphaChannel, 255}};
+            break;
+        }
+        case TextureCompression::Etc2:
+            model = kDfdModelEtc2;
+            if (vkFormat == kVkFormatEtc2R8G8B8A8UnormBlock || vkFormat == kVkFormatEtc2R8G8B8A8SrgbBlock) {
+                samples = {{0, 64, kDfdChannelAlpha, 0xFFFFFFFF}, {64, 64, kDfdChannelEtc2Color, 0xFFFFFFFF}};
+            } else {
+                samples = {{0, 64, kDfdChannelEtc2Color, 0xFFFFFFFF}};
+            }
+            break;
+        case TextureCompression::Astc:
+            model = kDfdModelAstc;
+            samples = {{0, 128, 0, 0xFFFFFFFF}};
+            break;
+    }
+
+    const uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+    writeU32(out, 4 + blockSize);
+    // Khronos vendor, basic descriptor type
+    writeU32(out, 0);
+    writeU32(out, 2 | blockSize << 16);
+    writeU32(out, model | kDfdPrimariesBt709 << 8 | (info.srgb ? kDfdTransferSrgb : kDfdTransferLinear) << 16 |
+                      (premultipliedAlpha ? kDfdFlagAlphaPremultiplied : 0) << 24);
+    const bool compressed = info.compression != TextureCompression::None;
+    writeU32(out, compressed ? (info.blockWidth - 1) | (info.blockHeight - 1) << 8 : 0);
+    writeU32(out, info.bytesPerBlock);
+    writeU32(out, 0);
+    for (const DfdSample& sample : samples) {
+        writeU32(out, sample.bitOffset | (sample.bitLength - 1) << 16 | sample.channel << 24);
+        writeU32(out, 0);
+        writeU32(out, 0);
+        writeU32(out, sample.upper);
+    }
+}
+}
+
+bool getTextureFormatInfo(uint32_t vkFormat, TextureFormatInfo& info)
+{
+    info = TextureFormatInfo{};
+    switch (vkFormat) {
+        case kVkFormatR8G8B8A8Unorm:
+        case kVkFormatR8G8B8A8Srgb:
+            info.srgb = vkFormat == kVkFormatR8G8B8A8Srgb;
+            return true;
+        case kVkFormatEtc2R8G8B8UnormBlock:
+        case kVkFormatEtc2R8G8B8SrgbBlock:
+        case kVkFormatEtc2R8G8B8A1UnormBlock:
+        case kVkFormatEtc2R8G8B8A1SrgbBlock:
+        case kVkFormatEtc2R8G8B8A8UnormBlock:
+        case kVkFormatEtc2R8G8B8A8SrgbBlock:
+            info.compression = TextureCompression::Etc2;
+            info.blockWidth = 4;
+            info.blockHeight = 4;
+            // Color and EAC alpha block for RGBA8, color only otherwise
+            info.bytesPerBlock = vkFormat >= kVkFormatEtc2R8G8B8A8UnormBlock ? 16 : 8;
+            // Unorm and srgb alternate
+            info.srgb = (vkFormat - kVkFormatEtc2R8G8B8UnormBlock) % 2 == 1;
+            return true;
+        default:
+            break;
+    }
+    if (vkFormat >= kVkFormatAstc4x4UnormBlock && vkFormat <= kVkFormatAstc12x12SrgbBlock) {
+        const uint32_t index = vkFormat - kVkFormatAstc4x4UnormBlock;
+        info.compression = TextureCompression::Astc;
+        info.blockWidth = kAstcBlockSizes[index / 2][0];
+        info.blockHeight = kAstcBlockSizes[index / 2][1];
+        info.bytesPerBlock = 16;
+        info.srgb = index % 2 == 1;
+        return true;
+    }
+    return false;
+}
+
+size_t getTextureLevelSize(const TextureFormatInfo& info, uint32_t width, uint32_t height)
+{
+    const size_t blocksX = (width + info.blockWidth - 1) / info.blockWidth;
+    const size_t blocksY = (height + info.blockHeight - 1) / info.blockHeight;
+    return blocksX * blocksY * info.bytesPerBlock;
+}
+
+bool readKtx2Header(const uint8_t* data, size_t size, uint64_t fileSize, Ktx2Image& image, std::string& error)
+{
+    if (size < kHeaderSize || memcmp(data, kIdentifier, sizeof(kIdentifier)) != 0) {
+        error = "not a KTX2 file";
+        return false;
+    }
+    const uint8_t* header = data + sizeof(kIdentifier);
+    const uint32_t vkFormat = readU32(header);
+    const uint32_t width = readU32(header + 8);
+    const uint32_t height = readU32(header + 12);
+    const uint32_t depth = readU32(header + 16);
+    const uint32_t layerCount = readU32(header + 20);
+    const uint32_t faceCount = readU32(header + 24);
+    // 0 asks the loader to generate the mips, the level index still has one entry
+    const uint32_t levelCount = std::max(readU32(header + 28), 1u);
+    const uint32_t supercompression = readU32(header + 32);
+
+    TextureFormatInfo formatInfo;
+    if (!getTextureFormatInfo(vkFormat, formatInfo)) {
+        error = "unsupported format " + std::to_string(vkFormat);
+        return false;
+    }
+    if (supercompression != 0) {
+        error = "supercompression scheme " + std::to_string(supercompression) + " not supported";
+        return false;
+    }
+    if (width == 0 || height == 0 || depth > 1 || layerCount > 1 || faceCount != 1) {
+        error = "only 2D textures are supported";
+        return false;
+    }
+    uint32_t maxLevels = 1;
+    while ((std::max(width, height) >> maxLevels) > 0) {
+        maxLevels++;
+    }
+    if (levelCount > maxLevels || size < kHeaderSize + levelCount * kLevelIndexEntrySize) {
+        error = "bad level count";
+        return false;
+    }
+
+    std::vector<Ktx2Image::Level> levels(levelCount);
+    for (uint32_t level = 0; level < levelCount; level++) {
+        const uint8_t* entry = data + kHeaderSize + level * kLevelIndexEntrySize;
+        const uint64_t offset = readU64(entry);
+        const uint64_t levelSize = readU64(entry + 8);
+        const uint32_t levelWidth = std::max(width >> level, 1u);
+        const uint32_t levelHeight = std::max(height >> level, 1u);
+        if (offset > fileSize || levelSize > fileSize - offset ||
+            levelSize != getTextureLevelSize(formatInfo, levelWidth, levelHeight)) {
+            error = "level " + std::to_string(level) + " out of bounds or of the wrong size";
+            return false;
+        }
+        levels[level] = {static_cast<size_t>(offset), static_cast<size_t>(levelSize), levelWidth, levelHeight};
+    }
+
+    image.vkFormat = vkFormat;
+    image.width = width;
+    image.height = height;
+    image.formatInfo = formatInfo;
+    image.levels = std::move(levels);
+    return true;
+}
+
+bool readKtx2(std::vector<uint8_t> file, Ktx2Image& image, std::string& error)
+{
+    if (!readKtx2Header(file.data(), file.size(), file.size(), image, error)) {
+        return false;
+    }
+    image.file = std::move(file);
+    return true;
+}
+
+std::vector<uint8_t> writeKtx2(uint32_t vkFormat, uint32_t width, uint32_t height,
+                               const std::vector<std::vector<uint8_t>>& levels, const std::string& writer,
+                               bool premultipliedAlpha)
+{
+    TextureFormatInfo info;
+    if (!getTextureFormatInfo(vkFormat, info)) {
+        throw std::invalid_argument("unsupported format " + std::to_string(vkFormat));
+    }
+    if (levels.empty()) {
+        throw std::invalid_argument("no levels");
+    }
+    for (size_t level = 0; level < levels.size(); level++) {
+        const uint32_t levelWidth = std::max(width >> level, 1u);
+        const uint32_t levelHeight = std::max(height >> level, 1u);
+        if (levels[level].size() != getTextureLevelSize(info, levelWidth, levelHeight)) {
+            throw std::invalid_argument("level " + std::to_string(level) + " has the wrong size");
+        }
+    }
+
+    std::vector<uint8_t> out(kIdentifier, kIdentifier + sizeof(kIdentifier));
+    writeU32(out, vkFormat);
+    // typeSize, 1 for block compressed and 8 bit formats
+    writeU32(out, 1);
+    writeU32(out, width);
+    writeU32(out, height);
+    writeU32(out, 0);
+    writeU32(out, 0);
+    writeU32(out, 1);
+    writeU32(out, static_cast<uint32_t>(levels.size()));
+    writeU32(out, 0);
+
+    const size_t indexOffset = out.size();
+    out.resize(kHeaderSize + levels.size() * kLevelIndexEntrySize, 0);
+
+    const size_t dfdOffset = out.size();
+    writeDataFormatDescriptor(out, vkFormat, info, premultipliedAlpha);
+    const size_t dfdSize = out.size() - dfdOffset;
+
+    const size_t kvdOffset = out.size();
+    const std::string key = "KTXwriter";
+    writeU32(out, static_cast<uint32_t>(key.size() + 1 + writer.size() + 1));
+    out.insert(out.end(), key.begin(), key.end());
+    out.push_back(0);
+    out.insert(out.end(), writer.begin(), writer.end());
+    out.push_back(0);
+    pad(out, 4);
+    const size_t kvdSize = out.size() - kvdOffset;
+
+    // Level data starts at a multiple of the block size, which is a multiple of 4 for all formats here
+    for (size_t level = levels.size(); level-- > 0;) {
+        pad(out, info.bytesPerBlock);
+        const size_t entry = kHeaderSize + level * kLevelIndexEntrySize;
+        patchU64(out, entry, out.size());
+        patchU64(out, entry + 8, levels[level].size());
+        patchU64(out, entry + 16, levels[level].size());
+        out.insert(out.end(), levels[level].begin(), levels[level].end());
+    }
+
+    // dfdByteOffset, dfdByteLength, kvdByteOffset, kvdByteLength, no supercompression global data
+    std::vector<uint8_t> index;
+    writeU32(index, static_cast<uint32_t>(dfdOffset));
+    writeU32(index, static_cast<uint32_t>(dfdSize));
+    writeU32(index, static_cast<uint32_t>(kvdOffset));
+    writeU32(index, static_cast<uint32_t>(kvdSize));
+    writeU64(index, 0);
+    writeU64(index, 0);
+    std::copy(index.begin(), index.end(), out.begin() + indexOffset);
+    return out;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Formats of KTX2 files are VkFormat values, named after them so the reader and the tools don't
+// need the Vulkan headers. Only formats both renderers upload as they are stored.
+constexpr uint32_t kVkFormatR8G8B8A8Unorm = 37;
+constexpr uint32_t kVkFormatR8G8B8A8Srgb = 43;
+constexpr uint32_t kVkFormatEtc2R8G8B8UnormBlock = 147;
+constexpr uint32_t kVkFormatEtc2R8G8B8SrgbBlock = 148;
+constexpr uint32_t kVkFormatEtc2R8G8B8A1UnormBlock = 149;
+constexpr uint32_t kVkFormatEtc2R8G8B8A1SrgbBlock = 150;
+constexpr uint32_t kVkFormatEtc2R8G8B8A8UnormBlock = 151;
+constexpr uint32_t kVkFormatEtc2R8G8B8A8SrgbBlock = 152;
+// ASTC LDR, unorm / srgb pairs of 4x4, 5x4, 5x5, 6x5, 6x6, 8x5, 8x6, 8x8, 10x5, 10x6, 10x8, 10x10,
+// 12x10 and 12x12 blocks
+constexpr uint32_t kVkFormatAstc4x4UnormBlock = 157;
+constexpr uint32_t kVkFormatAstc12x12SrgbBlock = 184;
+
+enum class TextureCompression {
+    None,
+    Etc2,
+    Astc,
+};
+
+struct TextureFormatInfo {
+    TextureCompression compression{TextureCompression::None};
+    // Texels per block, 1x1 when uncompressed
+    uint32_t blockWidth{1};
+    uint32_t blockHeight{1};
+    uint32_t bytesPerBlock{4};
+    bool srgb{false};
+};
+
+// Describes a supported format, false for anything else
+bool getTextureFormatInfo(uint32_t vkFormat, TextureFormatInfo& info);
+
+// Bytes of one level, whole blocks including the ones covering the right and bottom edge
+size_t getTextureLevelSize(const TextureFormatInfo& info, uint32_t width, uint32_t height);
+
+// A 2D texture and its mip chain read from a KTX2 container. Keeps the file, the levels point
+// into it. Supercompressed files (BasisLZ, Zstd), arrays, cube maps and 3D textures are rejected,
+// the cooker doesn't write them and decompressing at load time would undo the point of the format.
+struct Ktx2Image {
+    struct Level {
+        size_t offset;
+        size_t size;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    uint32_t vkFormat{0};
+    uint32_t width{0};
+    uint32_t height{0};
+    TextureFormatInfo formatInfo{};
+    // Level 0 (full size) first
+    std::vector<Level> levels;
+    std::vector<uint8_t> file;
+
+    const uint8_t* getLevelData(size_t level) const { return file.data() + levels[level].offset; }
+};
+
+// Header and level index of the largest file readKtx2Header accepts, 32 levels
+constexpr size_t kKtx2MaxHeaderSize = 80 + 32 * 24;
+
+// Validates the header and level index, error says why a file was refused
+bool readKtx2(std::vector<uint8_t> file, Ktx2Image& image, std::string& error);
+
+// The same from the start of a fileSize bytes file, at most kKtx2MaxHeaderSize of it, for reading
+// levels one at a time (streaming). Doesn't fill image.file, level offsets are file offsets.
+bool readKtx2Header(const uint8_t* data, size_t size, uint64_t fileSize, Ktx2Image& image, std::string& error);
+
+// Serialises a mip chain, levels[0] the full size image. Writes the data format descriptor
+// matching the format and stores levels smallest first, as the specification recommends for
+// streaming. Throws std::invalid_argument when a level doesn't have the size of its format.
+// premultipliedAlpha sets the descriptor flag saying colors are multiplied by alpha.
+std::vector<uint8_t> writeKtx2(uint32_t vkFormat, uint32_t width, uint32_t height,
+                               const std::vector<std::vector<uint8_t>>& levels,
+                               const std::string& writer = "GameEngine", bool premultipliedAlpha = false);
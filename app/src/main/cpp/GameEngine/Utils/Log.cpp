@@ -0,0 +1,124 @@
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#endif
+
+#include "Log.h"
+
+namespace {
+// logcat's entry limit
+constexpr size_t kMessageSize = 4068;
+// The writer thread sleeps this long at most, producers only wake it when it does
+constexpr auto kIdleWait = std::chrono::milliseconds(100);
+}
+
+std::atomic<LogLevel> Logger::s_Level{static_cast<LogLevel>(GAMEENGINE_LOG_LEVEL)};
+
+Logger& Logger::get()
+{
+    // Never destroyed, static destructors may still log. Queued messages are written at exit.
+    static Logger* logger = [] {
+        Logger* created = new Logger();
+        std::atexit([] { Logger::get().flush(); });
+        return created;
+    }();
+    return *logger;
+}
+
+Logger::Logger()
+{
+    for (size_t i = 0; i < kSlotCount; i++) {
+        m_Slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    std::thread(&Logger::run, this).detach();
+}
+
+Logger::Slot* Logger::beginWrite(uint64_t& position)
+{
+    // Bounded multi-producer queue: a slot is free for the write at `position` when its
+    // sequence equals it, and readable once the sequence is one past it
+    position = m_WritePosition.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot& slot = m_Slots[position & (kSlotCount - 1)];
+        const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        const int64_t difference = static_cast<int64_t>(sequence - position);
+        if (difference == 0) {
+            if (m_WritePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                return &slot;
+            }
+        } else if (difference < 0) {
+            return nullptr;
+        } else {
+            position = m_WritePosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void Logger::endWrite(Slot* slot, uint64_t position)
+{
+    slot->sequence.store(position + 1, std::memory_order_release);
+    // Only the first message after the writer went idle pays for the wake up
+    if (m_Sleeping.load(std::memory_order_relaxed) && m_Sleeping.exchange(false, std::memory_order_relaxed)) {
+        m_Wake.notify_one();
+    }
+}
+
+void Logger::run()
+{
+    for (;;) {
+        if (drain()) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_WakeMutex);
+        m_Sleeping.store(true, std::memory_order_relaxed);
+        // A message committed between drain() and here is picked up after the timeout at worst
+        m_Wake.wait_for(lock, kIdleWait);
+        m_Sleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
+bool Logger::drain()
+{
+    std::lock_guard<std::mutex> lock(m_ReadMutex);
+    char message[kMessageSize];
+    bool wrote = false;
+    for (;;) {
+        Slot& slot = m_Slots[m_ReadPosition & (kSlotCount - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != m_ReadPosition + 1) {
+            break;
+        }
+        slot.formatFunc(slot, message, sizeof(message));
+        write(slot.level, slot.tag, message);
+        slot.sequence.store(m_ReadPosition + kSlotCount, std::memory_order_release);
+        m_ReadPosition++;
+        wrote = true;
+    }
+
+    const uint64_t dropped = m_Dropped.load(std::memory_order_relaxed);
+    if (dropped != m_ReportedDropped) {
+        snprintf(message, sizeof(message), "%llu messages dropped, the log ring was full",
+                 static_cast<unsigned long long>(dropped - m_ReportedDropped));
+        write(LogLevel::Warning, "Logger", message);
+        m_ReportedDropped = dropped;
+    }
+    return wrote;
+}
+
+void Logger::flush()
+{
+    drain();
+}
+
+void Logger::write(LogLevel level, const char* tag, const char* message)
+{
+#ifdef __ANDROID__
+    static constexpr int kPriorities[] = { ANDROID_LOG_DEBUG, ANDROID_LOG_INFO, ANDROID_LOG_WARN, ANDROID_LOG_ERROR };
+    __android_log_write(kPriorities[static_cast<int>(level)], tag, message);
+#else
+    static constexpr char kLetters[] = { 'D', 'I', 'W', 'E' };
+    fprintf(stdout, "%c/%s: %s\n", kLetters[static_cast<int>(level)], tag, message);
+#endif
+}
@@ -0,0 +1,241 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+enum class LogLevel : uint8_t {
+    Debug = 0,
+    Info,
+    Warning,
+    Error,
+    None
+};
+
+// Messages below this level are compiled out, 0 keeps Debug. Release builds (NDEBUG) start at Info.
+#ifndef GAMEENGINE_LOG_LEVEL
+#ifdef NDEBUG
+#define GAMEENGINE_LOG_LEVEL 1
+#else
+#define GAMEENGINE_LOG_LEVEL 0
+#endif
+#endif
+
+// Compile-time tag, a class declares `static constexpr LogTag m_TAG{"ClassName"};`
+struct LogTag {
+    constexpr explicit LogTag(const char* tagName) : name(tagName) {}
+    const char* name;
+};
+
+// The LOG* macros copy the format pointer and the raw arguments into a lock-free ring, a
+// background thread formats and writes them (logcat on Android, stdout on host builds).
+// Formats have to be string literals, string arguments are copied since the caller's buffer
+// may be gone by the time the message is formatted. A full ring drops messages rather than
+// blocking the caller, the drop count is logged once space frees up. Warnings and errors that
+// find the ring full, and messages whose strings don't fit a slot (dumps), are formatted and
+// written on the calling thread instead.
+class Logger {
+public:
+    static constexpr size_t kSlotSize = 256;
+    static constexpr size_t kSlotCount = 1024;     // a power of two
+
+    static Logger& get();
+
+    static bool isEnabled(LogLevel level) { return level >= s_Level.load(std::memory_order_relaxed); }
+    // Runtime filter on top of GAMEENGINE_LOG_LEVEL
+    static void setLevel(LogLevel level) { s_Level.store(level, std::memory_order_relaxed); }
+
+    template<typename... Args>
+    void log(LogLevel level, const LogTag& tag, const char* format, const Args&... args);
+
+    // Writes everything queued so far on the calling thread, e.g. before a crash report
+    void flush();
+    uint64_t getDroppedCount() const { return m_Dropped.load(std::memory_order_relaxed); }
+
+    // Never called, gives the LOG* macros printf format checking
+    __attribute__((format(printf, 1, 2))) static void checkFormat(const char*, ...) {}
+
+private:
+    struct Slot;
+    using FormatFunc = int (*)(const Slot& slot, char* out, size_t size);
+    struct SlotHeader {
+        std::atomic<uint64_t> sequence{0};
+        const char* tag{nullptr};
+        const char* format{nullptr};
+        FormatFunc formatFunc{nullptr};
+        LogLevel level{LogLevel::Debug};
+    };
+    // The payload fills what the header leaves of kSlotSize, pointer sizes differ between ABIs
+    struct Slot : SlotHeader {
+        char payload[kSlotSize - sizeof(SlotHeader)];
+    };
+    static_assert(sizeof(Slot) == kSlotSize, "log slot layout");
+    // Every argument takes 8 bytes at the front of the payload, copied strings follow
+    static constexpr size_t kArgumentSize = 8;
+
+    template<typename T>
+    struct Argument {
+        static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value,
+                      "log arguments are printf arguments, pass .c_str() for strings");
+        static_assert(sizeof(T) <= kArgumentSize, "log argument too large");
+        static void store(char* at, T value, char*&, char*) { memcpy(at, &value, sizeof(T)); }
+        static T load(const char* at, const char*)
+        {
+            T value;
+            memcpy(&value, at, sizeof(T));
+            return value;
+        }
+    };
+
+    Logger();
+    Slot* beginWrite(uint64_t& position);
+    void endWrite(Slot* slot, uint64_t position);
+    void run();
+    bool drain();
+    void write(LogLevel level, const char* tag, const char* message);
+
+    // Bytes an argument copies behind the others, called with the decayed type so string
+    // literals and char buffers count as strings too
+    template<typename T>
+    static size_t stringBytes(T) { return 0; }
+
+    template<typename... Args>
+    void writeNow(LogLevel level, const LogTag& tag, const char* format, const Args&... args)
+    {
+        // Everything logged before it goes first
+        if constexpr (sizeof...(Args) == 0) {
+            flush();
+            write(level, tag.name, format);
+        } else {
+            std::string message(static_cast<size_t>(snprintf(nullptr, 0, format, args...)), '\0');
+            snprintf(&message[0], message.size() + 1, format, args...);
+            flush();
+            write(level, tag.name, message.c_str());
+        }
+    }
+
+    template<typename... Args, size_t... I>
+    static void pack(Slot& slot, std::index_sequence<I...>, const Args&... args)
+    {
+        char* strings = slot.payload + kArgumentSize * sizeof...(Args);
+        slot.payload[sizeof(slot.payload) - 1] = '\0';
+        (void)strings;
+        (Argument<std::decay_t<Args>>::store(slot.payload + kArgumentSize * I, args, strings, slot.payload), ...);
+    }
+
+    template<typename... Args, size_t... I>
+    static int formatArguments(const Slot& slot, char* out, size_t size, std::index_sequence<I...>)
+    {
+        return snprintf(out, size, slot.format, Argument<Args>::load(slot.payload + kArgumentSize * I, slot.payload)...);
+    }
+
+    template<typename... Args>
+    static int formatSlot(const Slot& slot, char* out, size_t size)
+    {
+        if constexpr (sizeof...(Args) == 0) {
+            // Plain text such as __FUNCTION__
+            return snprintf(out, size, "%s", slot.format);
+        } else {
+            return formatArguments<Args...>(slot, out, size, std::index_sequence_for<Args...>{});
+        }
+    }
+
+    static std::atomic<LogLevel> s_Level;
+
+    Slot m_Slots[kSlotCount];
+    alignas(64) std::atomic<uint64_t> m_WritePosition{0};
+    alignas(64) uint64_t m_ReadPosition{0};
+    std::atomic<uint64_t> m_Dropped{0};
+    uint64_t m_ReportedDropped{0};
+
+    std::mutex m_ReadMutex;
+    std::mutex m_WakeMutex;
+    std::condition_variable m_Wake;
+    std::atomic<bool> m_Sleeping{false};
+};
+
+// Strings are copied behind the arguments, truncated to the space left. The last payload byte
+// stays '\0' for strings that don't fit at all.
+template<>
+struct Logger::Argument<const char*> {
+    static void store(char* at, const char* value, char*& strings, char* payload)
+    {
+        char* last = payload + sizeof(Slot::payload) - 1;
+        const char* text = value != nullptr ? value : "(null)";
+        size_t length = strlen(text);
+        if (length > static_cast<size_t>(last - strings)) {
+            length = static_cast<size_t>(last - strings);
+        }
+        memcpy(strings, text, length);
+        strings[length] = '\0';
+        uint32_t offset = static_cast<uint32_t>(strings - payload);
+        memcpy(at, &offset, sizeof(offset));
+        strings = length < static_cast<size_t>(last - strings) ? strings + length + 1 : last;
+    }
+    static const char* load(const char* at, const char* payload)
+    {
+        uint32_t offset;
+        memcpy(&offset, at, sizeof(offset));
+        return payload + offset;
+    }
+};
+template<>
+struct Logger::Argument<char*> : Logger::Argument<const char*> {};
+
+template<>
+inline size_t Logger::stringBytes<const char*>(const char* value) { return (value != nullptr ? strlen(value) : 6) + 1; }
+template<>
+inline size_t Logger::stringBytes<char*>(char* value) { return stringBytes<const char*>(value); }
+
+template<typename... Args>
+void Logger::log(LogLevel level, const LogTag& tag, const char* format, const Args&... args)
+{
+    static_assert(kArgumentSize * sizeof...(Args) < sizeof(Slot::payload), "too many log arguments");
+    if constexpr (sizeof...(Args) > 0) {
+        const size_t strings = (stringBytes<std::decay_t<const Args&>>(args) + ...);
+        if (strings > sizeof(Slot::payload) - 1 - kArgumentSize * sizeof...(Args)) {
+            writeNow(level, tag, format, args...);
+            return;
+        }
+    }
+    uint64_t position = 0;
+    Slot* slot = beginWrite(position);
+    if (slot == nullptr) {
+        // Warnings and errors are worth the stall, the rest is counted as dropped
+        if (level >= LogLevel::Warning) {
+            writeNow(level, tag, format, args...);
+        } else {
+            m_Dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        return;
+    }
+    slot->tag = tag.name;
+    slot->format = format;
+    slot->level = level;
+    slot->formatFunc = &formatSlot<std::decay_t<Args>...>;
+    pack(*slot, std::index_sequence_for<Args...>{}, args...);
+    endWrite(slot, position);
+}
+
+#define GAMEENGINE_LOG(level, TAG, ...)                                 \
+    do {                                                                \
+        if (Logger::isEnabled(level)) {                                 \
+            Logger::get().log(level, TAG, __VA_ARGS__);                 \
+        }                                                               \
+        if (false) {                                                    \
+            Logger::checkFormat(__VA_ARGS__);                           \
+        }                                                               \
+    } while (0)
+
+#define GAMEENGINE_LOG_DISABLED(...)                                    \
+    do {                                                                \
+        if (false) {                                                    \
+            Logger::checkFormat(__VA_ARGS__);                           \
+        }                                                               \
+    } while (0)
@@ -0,0 +1,82 @@
+#include "Profiler.h"
+
+#ifdef GAMEENGINE_PROFILE
+
+#include "ChromeTrace.h"
+
+std::mutex Profiler::s_BuffersMutex;
+std::vector<std::unique_ptr<Profiler::ThreadBuffer>> Profiler::s_Buffers;
+
+// Hands the thread's buffer back when the thread exits. Buffers live as long as the process,
+// so flush never races a thread going away.
+struct Profiler::ThreadOwner {
+    ThreadBuffer* buffer{nullptr};
+    ~ThreadOwner()
+    {
+        if (buffer != nullptr) {
+            buffer->owned.store(false, std::memory_order_release);
+        }
+    }
+};
+
+Profiler::ThreadBuffer& Profiler::threadBuffer()
+{
+    thread_local ThreadOwner owner;
+    if (owner.buffer == nullptr) {
+        std::lock_guard<std::mutex> lock(s_BuffersMutex);
+        for (auto& buffer : s_Buffers) {
+            bool owned = false;
+            if (buffer->owned.compare_exchange_strong(owned, true, std::memory_order_acquire)) {
+                owner.buffer = buffer.get();
+                break;
+            }
+        }
+        if (owner.buffer == nullptr) {
+            s_Buffers.push_back(std::make_unique<ThreadBuffer>());
+            owner.buffer = s_Buffers.back().get();
+        }
+    }
+    return *owner.buffer;
+}
+
+void Profiler::record(const char* name, uint64_t startNs, uint64_t endNs)
+{
+    ThreadBuffer& buffer = threadBuffer();
+    const uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    if (head - buffer.tail.load(std::memory_order_acquire) >= kBufferEvents) {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer.events[head & (kBufferEvents - 1)] = { name, startNs, endNs, ChromeTrace::currentThreadId() };
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::flush(ChromeTrace& trace)
+{
+    const bool capturing = trace.isCapturing();
+
+    std::lock_guard<std::mutex> lock(s_BuffersMutex);
+    for (auto& buffer : s_Buffers) {
+        const uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t tail = buffer->tail.load(std::memory_order_relaxed);
+        // Zones closed after the capture stopped are dropped with the rest
+        for (; capturing && tail != head; tail++) {
+            const ZoneEvent& event = buffer->events[tail & (kBufferEvents - 1)];
+            trace.addZone(event.name, "cpu", ChromeTrace::kCpuProcess, event.threadId, event.startNs,
+                          event.endNs > event.startNs ? event.endNs - event.startNs : 0);
+        }
+        buffer->tail.store(head, std::memory_order_release);
+    }
+}
+
+uint64_t Profiler::getDroppedCount()
+{
+    std::lock_guard<std::mutex> lock(s_BuffersMutex);
+    uint64_t dropped = 0;
+    for (auto& buffer : s_Buffers) {
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+#endif
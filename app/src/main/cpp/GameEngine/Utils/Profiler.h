@@ -0,0 +1,94 @@
+#pragma once
+// CPU zone profiler. Everything here compiles to nothing unless GAMEENGINE_PROFILE is defined,
+// which the build does for Debug (or every configuration with -DGAMEENGINE_PROFILE=ON).
+//
+//  PROFILE_FUNCTION();                 times the rest of the enclosing function
+//  PROFILE_ZONE("name");               times the rest of the enclosing scope, name must be a literal
+//  PROFILE_FRAME(trace);               once per frame, moves the recorded zones into a ChromeTrace
+//
+// Zones are always recorded, flushing drops them unless the trace captures. Zones from before
+// the first flush (init) are kept, up to the size of a thread's buffer.
+
+#ifdef GAMEENGINE_PROFILE
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <time.h>
+
+#include "Definitions.h"
+
+class ChromeTrace;
+
+class Profiler {
+public:
+    struct ZoneEvent {
+        const char* name;
+        uint64_t startNs;
+        uint64_t endNs;
+        uint32_t threadId;
+    };
+
+    class Zone {
+    public:
+        NONCOPYABLE(Zone);
+        explicit Zone(const char* name)
+            : m_Name(name)
+            , m_StartNs(nowNs())
+        {
+        }
+        ~Zone() { record(m_Name, m_StartNs, nowNs()); }
+
+    private:
+        const char* m_Name;
+        uint64_t m_StartNs;
+    };
+
+    // CLOCK_MONOTONIC like SteadyClock, a vDSO call without a syscall. The ARM virtual counter
+    // would be cheaper still, but needs a frequency conversion against this clock anyway.
+    static uint64_t nowNs()
+    {
+        timespec time;
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        return static_cast<uint64_t>(time.tv_sec) * 1000000000ull + static_cast<uint64_t>(time.tv_nsec);
+    }
+    static void record(const char* name, uint64_t startNs, uint64_t endNs);
+    // Drains every thread's buffer, into the trace while it captures
+    static void flush(ChromeTrace& trace);
+    static uint64_t getDroppedCount();
+
+private:
+    static constexpr uint32_t kBufferEvents = 4096;     // per thread, a power of two
+
+    // Written by its thread only, read by flush. Full buffers drop new zones, nothing in them
+    // is ever overwritten while flush copies it. Buffers of exited threads go to new ones.
+    struct ThreadBuffer {
+        ZoneEvent events[kBufferEvents];
+        std::atomic<uint64_t> head{0};      // zones written
+        std::atomic<uint64_t> tail{0};      // zones read
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<bool> owned{true};
+    };
+    struct ThreadOwner;
+
+    static ThreadBuffer& threadBuffer();
+
+    static std::mutex s_BuffersMutex;
+    static std::vector<std::unique_ptr<ThreadBuffer>> s_Buffers;
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_ZONE(name) Profiler::Zone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__FUNCTION__)
+#define PROFILE_FRAME(trace) Profiler::flush(trace)
+
+#else
+
+#define PROFILE_ZONE(name) do {} while (0)
+#define PROFILE_FUNCTION() do {} while (0)
+#define PROFILE_FRAME(trace) do {} while (0)
+
+#endif
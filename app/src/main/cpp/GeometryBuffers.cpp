@@ -0,0 +1,75 @@
+#include "GeometryBuffers.h"
+
+#include "GlState.h"
+#include "Model.h"
+
+GeometryBuffers::GeometryBuffers()
+        : vao_(0),
+          vbo_(0),
+          ibo_(0),
+          uploadedVersion_(0),
+          uploadCount_(0) {}
+
+GeometryBuffers::~GeometryBuffers() {
+    if (vao_) {
+        GlState &state = GlState::current();
+        state.deleteVertexArray(vao_);
+        state.deleteBuffer(vbo_);
+        state.deleteBuffer(ibo_);
+    }
+}
+
+void GeometryBuffers::update(const Model &model) {
+    if (vao_ && (model.getUsage() == GeometryUsage::Static || uploadedVersion_ == model.getVersion())) {
+        return;
+    }
+
+    GlState &state = GlState::current();
+    if (!vao_) {
+        glGenVertexArrays(1, &vao_);
+        glGenBuffers(1, &vbo_);
+        glGenBuffers(1, &ibo_);
+
+        // The vertex array records the attribute layout and the index buffer binding, it never
+        // changes afterwards. Attribute pointers are offsets into the bound array buffer.
+        state.bindVertexArray(vao_);
+        state.bindBuffer(GL_ARRAY_BUFFER, vbo_);
+        glVertexAttribPointer(
+                kPositionLocation,
+                3,
+                GL_FLOAT,
+                GL_FALSE,
+                sizeof(Vertex),
+                nullptr);
+        glEnableVertexAttribArray(kPositionLocation);
+        glVertexAttribPointer(
+                kUVLocation,
+                2,
+                GL_FLOAT,
+                GL_FALSE,
+                sizeof(Vertex),
+                reinterpret_cast<const void *>(sizeof(Vector3)));
+        glEnableVertexAttribArray(kUVLocation);
+        state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
+    } else {
+        state.bindVertexArray(vao_);
+        state.bindBuffer(GL_ARRAY_BUFFER, vbo_);
+    }
+
+    // Respecifying the whole store with glBufferData orphans the old one: draws already queued
+    // keep reading it, the driver frees it once they complete
+    const GLenum usage = model.getUsage() == GeometryUsage::Static ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW;
+    glBufferData(
+            GL_ARRAY_BUFFER,
+            model.getVertexCount() * sizeof(Vertex),
+            model.getVertexData(),
+            usage);
+    glBufferData(
+            GL_ELEMENT_ARRAY_BUFFER,
+            model.getIndexCount() * sizeof(Index),
+            model.getIndexData(),
+            usage);
+
+    uploadedVersion_ = model.getVersion();
+    uploadCount_++;
+}
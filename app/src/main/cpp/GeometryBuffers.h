@@ -0,0 +1,61 @@
+#ifndef ANDROIDGLINVESTIGATIONS_GEOMETRYBUFFERS_H
+#define ANDROIDGLINVESTIGATIONS_GEOMETRYBUFFERS_H
+
+#include <cstdint>
+#include <GLES3/gl3.h>
+
+#include "GlState.h"
+
+class Model;
+
+/*!
+ * The GL objects holding a model's geometry: a vertex buffer, an index buffer and a vertex array
+ * object capturing the attribute layout, so a draw needs a single vertex array bind. Static models
+ * are uploaded once. Dynamic models respecify (orphan) their buffers whenever the model data
+ * changes, the driver hands out fresh storage instead of stalling on draws still reading the old
+ * contents.
+ *
+ * Attribute locations are fixed (see @a kPositionLocation and @a kUVLocation) and bound by every
+ * Shader before linking, so the same vertex array works with any shader.
+ */
+class GeometryBuffers {
+public:
+    //! The attribute location of the position, a Vector3
+    static constexpr GLuint kPositionLocation = 0;
+
+    //! The attribute location of the uv coordinates, a Vector2
+    static constexpr GLuint kUVLocation = 1;
+
+    GeometryBuffers();
+
+    ~GeometryBuffers();
+
+    GeometryBuffers(const GeometryBuffers &) = delete;
+
+    GeometryBuffers &operator=(const GeometryBuffers &) = delete;
+
+    /*!
+     * Uploads the model's geometry if it changed since the last call. Needs a current GL context.
+     * @param model the model these buffers belong to
+     */
+    void update(const Model &model);
+
+    /*!
+     * Binds the vertex array, and with it the buffers and attribute layout
+     */
+    inline void bind() const { GlState::current().bindVertexArray(vao_); }
+
+    /*!
+     * @return how often the buffers were (re)specified, 1 for a static model
+     */
+    constexpr uint32_t getUploadCount() const { return uploadCount_; }
+
+private:
+    GLuint vao_;
+    GLuint vbo_;
+    GLuint ibo_;
+    uint32_t uploadedVersion_;
+    uint32_t uploadCount_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_GEOMETRYBUFFERS_H
@@ -0,0 +1,183 @@
+#include "GlState.h"
+
+GlState &GlState::current() {
+    static GlState state;
+    return state;
+}
+
+GlState::GlState() {
+    invalidate();
+}
+
+void GlState::invalidate() {
+    program_ = kUnknown;
+    activeUnit_ = kUnknown;
+    for (auto &unit: textures_) {
+        for (auto &texture: unit) {
+            texture = kUnknown;
+        }
+    }
+    for (auto &buffer: buffers_) {
+        buffer = kUnknown;
+    }
+    vertexArray_ = kUnknown;
+    blendEnabled_ = kUnknown;
+    blendSource_ = kUnknown;
+    blendDestination_ = kUnknown;
+    depthTest_ = kUnknown;
+    depthWrite_ = kUnknown;
+    depthFunction_ = kUnknown;
+}
+
+int GlState::getTextureTargetIndex(GLenum target) {
+    switch (target) {
+        case GL_TEXTURE_2D:
+            return 0;
+        case GL_TEXTURE_CUBE_MAP:
+            return 1;
+        case GL_TEXTURE_2D_ARRAY:
+            return 2;
+        case GL_TEXTURE_3D:
+            return 3;
+        default:
+            return -1;
+    }
+}
+
+int GlState::getBufferTargetIndex(GLenum target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER:
+            return 0;
+        case GL_ELEMENT_ARRAY_BUFFER:
+            return 1;
+        case GL_UNIFORM_BUFFER:
+            return 2;
+        case GL_PIXEL_UNPACK_BUFFER:
+            return 3;
+        default:
+            return -1;
+    }
+}
+
+void GlState::useProgram(GLuint program) {
+    if (change(program_, program)) {
+        glUseProgram(program);
+    }
+}
+
+void GlState::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+    const int targetIndex = getTextureTargetIndex(target);
+    if (unit >= kMaxTextureUnits || targetIndex < 0) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit_ = unit;
+        glBindTexture(target, texture);
+        stats_.issued += 2;
+        return;
+    }
+
+    // The active unit only matters for the bind, leave it alone when there's nothing to bind
+    GLuint &cached = textures_[unit][targetIndex];
+    if (cached == texture) {
+        stats_.eliminated++;
+        return;
+    }
+    if (change(activeUnit_, unit)) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    cached = texture;
+    stats_.issued++;
+    glBindTexture(target, texture);
+}
+
+void GlState::bindBuffer(GLenum target, GLuint buffer) {
+    const int targetIndex = getBufferTargetIndex(target);
+    if (targetIndex < 0) {
+        stats_.issued++;
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if (change(buffers_[targetIndex], buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void GlState::bindVertexArray(GLuint vertexArray) {
+    if (change(vertexArray_, vertexArray)) {
+        glBindVertexArray(vertexArray);
+        // Each vertex array has its own index buffer binding
+        buffers_[getBufferTargetIndex(GL_ELEMENT_ARRAY_BUFFER)] = kUnknown;
+    }
+}
+
+void GlState::setBlend(bool enabled, GLenum sourceFactor, GLenum destinationFactor) {
+    if (change(blendEnabled_, enabled)) {
+        if (enabled) {
+            glEnable(GL_BLEND);
+        } else {
+            glDisable(GL_BLEND);
+        }
+    }
+    if (!enabled) {
+        return;
+    }
+    if (blendSource_ == sourceFactor && blendDestination_ == destinationFactor) {
+        stats_.eliminated++;
+        return;
+    }
+    blendSource_ = sourceFactor;
+    blendDestination_ = destinationFactor;
+    stats_.issued++;
+    glBlendFunc(sourceFactor, destinationFactor);
+}
+
+void GlState::setDepth(bool testEnabled, bool writeEnabled, GLenum function) {
+    if (change(depthTest_, testEnabled)) {
+        if (testEnabled) {
+            glEnable(GL_DEPTH_TEST);
+        } else {
+            glDisable(GL_DEPTH_TEST);
+        }
+    }
+    if (change(depthWrite_, writeEnabled)) {
+        glDepthMask(writeEnabled ? GL_TRUE : GL_FALSE);
+    }
+    if (testEnabled && change(depthFunction_, function)) {
+        glDepthFunc(function);
+    }
+}
+
+void GlState::deleteProgram(GLuint program) {
+    glDeleteProgram(program);
+    // A program in use stays in use until something else is, unlike other objects
+    if (program_ == program) {
+        program_ = kUnknown;
+    }
+}
+
+void GlState::deleteTexture(GLuint texture) {
+    glDeleteTextures(1, &texture);
+    for (auto &unit: textures_) {
+        for (auto &bound: unit) {
+            if (bound == texture) {
+                bound = 0;
+            }
+        }
+    }
+}
+
+void GlState::deleteBuffer(GLuint buffer) {
+    glDeleteBuffers(1, &buffer);
+    for (auto &bound: buffers_) {
+        if (bound == buffer) {
+            bound = 0;
+        }
+    }
+}
+
+void GlState::deleteVertexArray(GLuint vertexArray) {
+    glDeleteVertexArrays(1, &vertexArray);
+    if (vertexArray_ == vertexArray) {
+        vertexArray_ = 0;
+        buffers_[getBufferTargetIndex(GL_ELEMENT_ARRAY_BUFFER)] = kUnknown;
+    }
+}
@@ -0,0 +1,126 @@
+#ifndef ANDROIDGLINVESTIGATIONS_GLSTATE_H
+#define ANDROIDGLINVESTIGATIONS_GLSTATE_H
+
+#include <cstdint>
+#include <GLES3/gl3.h>
+
+/*!
+ * Counters of the state calls that went through @a GlState
+ */
+struct GlStateStats {
+    //! calls passed on to GL
+    uint64_t issued = 0;
+    //! calls dropped because they'd set what was already set
+    uint64_t eliminated = 0;
+};
+
+/*!
+ * Shadows the GL state the renderer changes per draw: program, textures per unit, buffer
+ * bindings, vertex array, blending and depth. A call that wouldn't change anything never reaches
+ * the driver, each that does costs validation on the next draw. Sorting draws by state, like
+ * SpriteBatch does, makes most of them redundant.
+ *
+ * There's one instance for the one GL context of the app. Everything changing this state has to
+ * go through it, code that calls GL directly must call @a invalidate afterwards. So must the
+ * owner of the context when it's (re)created.
+ */
+class GlState {
+public:
+    //! Texture units tracked, binds on higher units go straight to GL
+    static constexpr GLuint kMaxTextureUnits = 16;
+
+    /*!
+     * @return the state of the current context
+     */
+    static GlState &current();
+
+    /*!
+     * Forgets everything, the next call of each kind goes to GL
+     */
+    void invalidate();
+
+    void useProgram(GLuint program);
+
+    /*!
+     * Binds a texture to a unit, making the unit active if the texture changes
+     * @param unit the texture unit, 0 for GL_TEXTURE0
+     * @param target GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_ARRAY or GL_TEXTURE_3D
+     * @param texture the texture, 0 to unbind
+     */
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+
+    /*!
+     * Binds a buffer. The index buffer binding belongs to the bound vertex array, it's forgotten
+     * whenever that changes.
+     */
+    void bindBuffer(GLenum target, GLuint buffer);
+
+    void bindVertexArray(GLuint vertexArray);
+
+    /*!
+     * Enables blending with the given factors, or disables it
+     */
+    void setBlend(bool enabled, GLenum sourceFactor = GL_ONE, GLenum destinationFactor = GL_ZERO);
+
+    /*!
+     * Sets depth testing and writes
+     */
+    void setDepth(bool testEnabled, bool writeEnabled, GLenum function = GL_LESS);
+
+    //! Call when deleting GL objects, GL unbinds deleted objects implicitly
+    void deleteProgram(GLuint program);
+
+    void deleteTexture(GLuint texture);
+
+    void deleteBuffer(GLuint buffer);
+
+    void deleteVertexArray(GLuint vertexArray);
+
+    inline const GlStateStats &getStats() const { return stats_; }
+
+    inline void resetStats() { stats_ = GlStateStats(); }
+
+private:
+    //! The value of state not known to match anything
+    static constexpr GLuint kUnknown = 0xffffffff;
+
+    //! Texture targets tracked per unit
+    static constexpr int kTextureTargets = 4;
+
+    //! Buffer targets tracked
+    static constexpr int kBufferTargets = 4;
+
+    GlState();
+
+    static int getTextureTargetIndex(GLenum target);
+
+    static int getBufferTargetIndex(GLenum target);
+
+    /*!
+     * Counts a call and returns whether it has to be made
+     */
+    inline bool change(GLuint &cached, GLuint value) {
+        if (cached == value) {
+            stats_.eliminated++;
+            return false;
+        }
+        cached = value;
+        stats_.issued++;
+        return true;
+    }
+
+    GLuint program_;
+    GLuint activeUnit_;
+    GLuint textures_[kMaxTextureUnits][kTextureTargets];
+    GLuint buffers_[kBufferTargets];
+    GLuint vertexArray_;
+    GLuint blendEnabled_;
+    GLuint blendSource_;
+    GLuint blendDestination_;
+    GLuint depthTest_;
+    GLuint depthWrite_;
+    GLuint depthFunction_;
+    GlStateStats stats_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_GLSTATE_H
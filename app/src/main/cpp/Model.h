@@ -1,7 +1,9 @@
 #ifndef ANDROIDGLINVESTIGATIONS_MODEL_H
 #define ANDROIDGLINVESTIGATIONS_MODEL_H
 
+#include <memory>
 #include <vector>
+#include "GeometryBuffers.h"
 #include "TextureAsset.h"
 
 union Vector3 {
@@ -31,20 +33,52 @@ struct Vertex {
 
 typedef uint16_t Index;
 
+/*!
+ * How often a model's geometry changes. Static geometry is uploaded to the GPU once, dynamic
+ * geometry again after every @a Model::setGeometry.
+ */
+enum class GeometryUsage {
+    Static,
+    Dynamic
+};
+
 class Model {
 public:
     inline Model(
             std::vector<Vertex> vertices,
             std::vector<Index> indices,
-            std::shared_ptr<TextureAsset> spTexture)
+            std::shared_ptr<TextureAsset> spTexture,
+            GeometryUsage usage = GeometryUsage::Static)
             : vertices_(std::move(vertices)),
               indices_(std::move(indices)),
-              spTexture_(std::move(spTexture)) {}
+              spTexture_(std::move(spTexture)),
+              usage_(usage),
+              version_(1),
+              spBuffers_(std::make_shared<GeometryBuffers>()) {}
+
+    /*!
+     * Replaces the geometry of a dynamic model, it's uploaded again on the next draw
+     * @param vertices the new vertices
+     * @param indices the new indices
+     */
+    inline void setGeometry(std::vector<Vertex> vertices, std::vector<Index> indices) {
+        vertices_ = std::move(vertices);
+        indices_ = std::move(indices);
+        version_++;
+        if (spBuffers_.use_count() > 1) {
+            // A copy still draws the old geometry, stop sharing buffers with it
+            spBuffers_ = std::make_shared<GeometryBuffers>();
+        }
+    }
 
     inline const Vertex *getVertexData() const {
         return vertices_.data();
     }
 
+    inline size_t getVertexCount() const {
+        return vertices_.size();
+    }
+
     inline const size_t getIndexCount() const {
         return indices_.size();
     }
@@ -57,10 +91,28 @@ public:
         return *spTexture_;
     }
 
+    constexpr GeometryUsage getUsage() const { return usage_; }
+
+    /*!
+     * @return a counter bumped by every @a setGeometry
+     */
+    constexpr uint32_t getVersion() const { return version_; }
+
+    /*!
+     * @return the GPU copy of the geometry. Copies of a model share it, it's created empty and
+     *     filled by @a GeometryBuffers::update once a GL context is current.
+     */
+    inline GeometryBuffers &getBuffers() const {
+        return *spBuffers_;
+    }
+
 private:
     std::vector<Vertex> vertices_;
     std::vector<Index> indices_;
     std::shared_ptr<TextureAsset> spTexture_;
+    GeometryUsage usage_;
+    uint32_t version_;
+    std::shared_ptr<GeometryBuffers> spBuffers_;
 };
 
 #endif //ANDROIDGLINVESTIGATIONS_MODEL_H
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "Renderer.h"
 
+#include <chrono>
 #include <game-activity/native_app_glue/android_native_app_glue.h>
 #include <GLES3/gl3.h>
 #include <memory>
@@ -7,7 +8,10 @@
 #include <android/imagedecoder.h>
 
 #include "AndroidOut.h"
+#include "DrawBenchmark.h"
+#include "GlState.h"
 #include "Shader.h"
+#include "ShaderCache.h"
 #include "Utility.h"
 #include "TextureAsset.h"
 
@@ -84,6 +88,12 @@ static constexpr float kProjectionNearPlane = -1.f;
  */
 static constexpr float kProjectionFarPlane = 1.f;
 
+//! The number of sprites in the demo row drawn through the sprite batch
+static constexpr int kDemoSpriteCount = 16;
+
+//! The width and height of each demo sprite
+static constexpr float kDemoSpriteSize = 0.25f;
+
 Renderer::~Renderer() {
     if (display_ != EGL_NO_DISPLAY) {
         eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
@@ -142,6 +152,23 @@ void Renderer::render() {
         }
     }
 
+    // Sprites are collected into the batch and drawn once per atlas page and state, not once
+    // each. This row of small robots is a single draw.
+    spriteBatch_->begin();
+    for (int i = 0; i < kDemoSpriteCount; i++) {
+        float x = (i - (kDemoSpriteCount - 1) / 2.f) * kDemoSpriteSize;
+        spriteBatch_->draw(
+                *shader_,
+                BlendMode::Alpha,
+                *atlas_,
+                robotRegion_,
+                x,
+                -kProjectionHalfHeight + kDemoSpriteSize,
+                kDemoSpriteSize / 2,
+                kDemoSpriteSize / 2);
+    }
+    spriteBatch_->end();
+
     // Present the rendered image. This is an implicit glFlush.
     auto swapResult = eglSwapBuffers(display_, surface_);
     assert(swapResult == EGL_TRUE);
@@ -211,6 +238,9 @@ void Renderer::initRenderer() {
     surface_ = surface;
     context_ = context;
 
+    // Nothing tracked from a previous context applies to this one
+    GlState::current().invalidate();
+
     // make width and height invalid so it gets updated the first frame in @a updateRenderArea()
     width_ = -1;
     height_ = -1;
@@ -220,9 +250,21 @@ void Renderer::initRenderer() {
     PRINT_GL_STRING(GL_VERSION);
     PRINT_GL_STRING_AS_LIST(GL_EXTENSIONS);
 
+    // Linked programs are cached as driver binaries. The log line compares a cold start (first
+    // launch, or after a driver update) with a warm one.
+    shaderCache_ = std::make_unique<ShaderCache>(
+            std::string(app_->activity->internalDataPath) + "/shader_cache");
+    auto shaderLoadStart = std::chrono::steady_clock::now();
     shader_ = std::unique_ptr<Shader>(
-            Shader::loadShader(vertex, fragment, "inPosition", "inUV", "uProjection"));
+            Shader::loadShader(vertex, fragment, "inPosition", "inUV", "uProjection", shaderCache_.get()));
     assert(shader_);
+    aout << "Shader loaded in "
+         << std::chrono::duration<double, std::milli>(
+                 std::chrono::steady_clock::now() - shaderLoadStart).count()
+         << " ms, " << (shaderCache_->getHitCount() ? "warm" : "cold")
+         << " (cache hits " << shaderCache_->getHitCount()
+         << ", misses " << shaderCache_->getMissCount()
+         << ", rejected " << shaderCache_->getRejectedCount() << ")" << std::endl;
 
     // Note: there's only one shader in this demo, so I'll activate it here. For a more complex game
     // you'll want to track the active shader and activate/deactivate it as necessary
@@ -232,11 +274,17 @@ void Renderer::initRenderer() {
     glClearColor(CORNFLOWER_BLUE);
 
     // enable alpha globally for now, you probably don't want to do this in a game
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    GlState::current().setBlend(true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     // get some demo models into memory
     createModels();
+
+#ifdef GLES_DRAW_BENCHMARK
+    // The projection is only set on the first render, any will do for timing
+    float identityMatrix[16];
+    shader_->setProjectionMatrix(Utility::buildIdentityMatrix(identityMatrix));
+    runDrawBenchmark(*shader_, TextureAsset::loadAsset(app_->activity->assetManager, "android_robot.png"));
+#endif
 }
 
 void Renderer::updateRenderArea() {
@@ -282,11 +330,22 @@ void Renderer::createModels() {
     //
     // Note: there is no texture management in this sample, so if you reuse an image be careful not
     // to load it repeatedly. Since you get a shared_ptr you can safely reuse it in many models.
+    //
+    // The KTX2 version is cooked from the png by tools/texture_cooker (ETC2 with offline mips). It's
+    // cooked with --linear, this demo renders to a non-sRGB surface and so samples the png as is.
     auto assetManager = app_->activity->assetManager;
-    auto spAndroidRobotTexture = TextureAsset::loadAsset(assetManager, "android_robot.png");
+    auto spAndroidRobotTexture = TextureAsset::loadAsset(assetManager, "android_robot.ktx2");
+    if (!spAndroidRobotTexture) {
+        spAndroidRobotTexture = TextureAsset::loadAsset(assetManager, "android_robot.png");
+    }
 
     // Create a model and put it in the back of the render list.
     models_.emplace_back(vertices, indices, spAndroidRobotTexture);
+
+    // Small images for sprites go into a shared atlas instead of textures of their own
+    atlas_ = std::make_unique<TextureAtlas>();
+    atlas_->addAsset(assetManager, "android_robot.png", robotRegion_);
+    spriteBatch_ = std::make_unique<SpriteBatch>();
 }
 
 void Renderer::handleInput() {
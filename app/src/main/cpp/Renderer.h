@@ -6,6 +6,9 @@
 
 #include "Model.h"
 #include "Shader.h"
+#include "ShaderCache.h"
+#include "SpriteBatch.h"
+#include "TextureAtlas.h"
 
 struct android_app;
 
@@ -67,8 +70,13 @@ private:
 
     bool shaderNeedsNewProjectionMatrix_;
 
+    std::unique_ptr<ShaderCache> shaderCache_;
     std::unique_ptr<Shader> shader_;
     std::vector<Model> models_;
+
+    std::unique_ptr<TextureAtlas> atlas_;
+    std::unique_ptr<SpriteBatch> spriteBatch_;
+    AtlasRegion robotRegion_;
 };
 
 #endif //ANDROIDGLINVESTIGATIONS_RENDERER_H
\ No newline at end of file
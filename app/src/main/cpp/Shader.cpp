@@ -1,7 +1,9 @@
 #include "Shader.h"
 
 #include "AndroidOut.h"
+#include "GeometryBuffers.h"
 #include "Model.h"
+#include "ShaderCache.h"
 #include "Utility.h"
 
 Shader *Shader::loadShader(
@@ -9,18 +11,74 @@ Shader *Shader::loadShader(
         const std::string &fragmentSource,
         const std::string &positionAttributeName,
         const std::string &uvAttributeName,
-        const std::string &projectionMatrixUniformName) {
-    Shader *shader = nullptr;
+        const std::string &projectionMatrixUniformName,
+        ShaderCache *cache) {
+    // A cached binary skips compiling and linking, everything it depends on goes into the key
+    GLuint program = 0;
+    std::string cacheKey;
+    if (cache) {
+        const std::string keyParts[] = {
+                vertexSource,
+                fragmentSource,
+                positionAttributeName,
+                uvAttributeName
+        };
+        cacheKey = ShaderCache::makeKey(keyParts, sizeof(keyParts) / sizeof(keyParts[0]));
+        program = cache->loadProgram(cacheKey);
+    }
+    if (!program) {
+        program = linkProgram(
+                vertexSource,
+                fragmentSource,
+                positionAttributeName,
+                uvAttributeName,
+                cache != nullptr);
+        if (!program) {
+            return nullptr;
+        }
+        if (cache) {
+            cache->storeProgram(cacheKey, program);
+        }
+    }
+
+    // Get the attribute and uniform locations by name. The attributes were bound before linking,
+    // unless the shader overrides them with layout=, which is checked here
+    GLint positionAttribute = glGetAttribLocation(program, positionAttributeName.c_str());
+    GLint uvAttribute = glGetAttribLocation(program, uvAttributeName.c_str());
+    GLint projectionMatrixUniform = glGetUniformLocation(
+            program,
+            projectionMatrixUniformName.c_str());
+
+    // Only create a new shader if all the attributes are found, at the shared locations
+    if (positionAttribute != GLint(GeometryBuffers::kPositionLocation)
+        || uvAttribute != GLint(GeometryBuffers::kUVLocation)
+        || projectionMatrixUniform == -1) {
+        glDeleteProgram(program);
+        return nullptr;
+    }
+
+    return new Shader(
+            program,
+            positionAttribute,
+            uvAttribute,
+            projectionMatrixUniform);
+}
 
+GLuint Shader::linkProgram(
+        const std::string &vertexSource,
+        const std::string &fragmentSource,
+        const std::string &positionAttributeName,
+        const std::string &uvAttributeName,
+        bool retrievable) {
     GLuint vertexShader = loadShader(GL_VERTEX_SHADER, vertexSource);
     if (!vertexShader) {
-        return nullptr;
+        return 0;
     }
 
     GLuint fragmentShader = loadShader(GL_FRAGMENT_SHADER, fragmentSource);
     if (!fragmentShader) {
         glDeleteShader(vertexShader);
-        return nullptr;
+        return 0;
     }
 
     GLuint program = glCreateProgram();
@@ -28,6 +86,19 @@ Shader *Shader::loadShader(
         glAttachShader(program, vertexShader);
         glAttachShader(program, fragmentShader);
 
+        // Every shader uses the same attribute locations so one vertex array object per model
+        // works with all of them
+        glBindAttribLocation(
+                program,
+                GeometryBuffers::kPositionLocation,
+                positionAttributeName.c_str());
+        glBindAttribLocation(program, GeometryBuffers::kUVLocation, uvAttributeName.c_str());
+
+        // Ask the driver to keep the binary around for the shader cache
+        if (retrievable) {
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+
         glLinkProgram(program);
         GLint linkStatus = GL_FALSE;
         glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
@@ -44,28 +115,7 @@ Shader *Shader::loadShader(
             }
 
             glDeleteProgram(program);
-        } else {
-            // Get the attribute and uniform locations by name. You may also choose to hardcode
-            // indices with layout= in your shader, but it is not done in this sample
-            GLint positionAttribute = glGetAttribLocation(program, positionAttributeName.c_str());
-            GLint uvAttribute = glGetAttribLocation(program, uvAttributeName.c_str());
-            GLint projectionMatrixUniform = glGetUniformLocation(
-                    program,
-                    projectionMatrixUniformName.c_str());
-
-            // Only create a new shader if all the attributes are found.
-            if (positionAttribute != -1
-                && uvAttribute != -1
-                && projectionMatrixUniform != -1) {
-
-                shader = new Shader(
-                        program,
-                        positionAttribute,
-                        uvAttribute,
-                        projectionMatrixUniform);
-            } else {
-                glDeleteProgram(program);
-            }
+            program = 0;
         }
     }
 
@@ -73,7 +123,7 @@ Shader *Shader::loadShader(
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
 
-    return shader;
+    return program;
 }
 
 GLuint Shader::loadShader(GLenum shaderType, const std::string &shaderSource) {
@@ -108,14 +158,32 @@ GLuint Shader::loadShader(GLenum shaderType, const std::string &shaderSource) {
 }
 
 void Shader::activate() const {
-    glUseProgram(program_);
+    GlState::current().useProgram(program_);
 }
 
 void Shader::deactivate() const {
-    glUseProgram(0);
+    GlState::current().bindVertexArray(0);
+    GlState::current().useProgram(0);
 }
 
 void Shader::drawModel(const Model &model) const {
+    // Uploads on the first draw, and after the geometry of a dynamic model changed
+    GeometryBuffers &buffers = model.getBuffers();
+    buffers.update(model);
+    buffers.bind();
+
+    // Setup the texture, models sharing one in a row only bind it once
+    GlState::current().bindTexture(0, GL_TEXTURE_2D, model.getTexture().getTextureID());
+
+    // Draw as indexed triangles, from the start of the bound index buffer
+    glDrawElements(GL_TRIANGLES, model.getIndexCount(), GL_UNSIGNED_SHORT, nullptr);
+}
+
+void Shader::drawModelClientArrays(const Model &model) const {
+    // Client side pointers only work without a vertex array object or array buffer bound
+    GlState::current().bindVertexArray(0);
+    GlState::current().bindBuffer(GL_ARRAY_BUFFER, 0);
+
     // The position attribute is 3 floats
     glVertexAttribPointer(
             position_, // attrib
@@ -139,8 +207,7 @@ void Shader::drawModel(const Model &model) const {
     glEnableVertexAttribArray(uv_);
 
     // Setup the texture
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, model.getTexture().getTextureID());
+    GlState::current().bindTexture(0, GL_TEXTURE_2D, model.getTexture().getTextureID());
 
     // Draw as indexed triangles
     glDrawElements(GL_TRIANGLES, model.getIndexCount(), GL_UNSIGNED_SHORT, model.getIndexData());
@@ -4,7 +4,10 @@
 #include <string>
 #include <GLES3/gl3.h>
 
+#include "GlState.h"
+
 class Model;
+class ShaderCache;
 
 /*!
  * A class representing a simple shader program. It consists of vertex and fragment components. The
@@ -25,6 +28,8 @@ public:
      * @param positionAttributeName The name of the position attribute in your vertex program
      * @param uvAttributeName The name of the uv coordinate attribute in your vertex program
      * @param projectionMatrixUniformName The name of your model/view/projection matrix uniform
+     * @param cache Where to look for and store the linked program binary, or null to always
+     *     compile
      * @return a valid Shader on success, otherwise null.
      */
     static Shader *loadShader(
@@ -32,11 +37,12 @@ public:
             const std::string &fragmentSource,
             const std::string &positionAttributeName,
             const std::string &uvAttributeName,
-            const std::string &projectionMatrixUniformName);
+            const std::string &projectionMatrixUniformName,
+            ShaderCache *cache = nullptr);
 
     inline ~Shader() {
         if (program_) {
-            glDeleteProgram(program_);
+            GlState::current().deleteProgram(program_);
             program_ = 0;
         }
     }
@@ -52,11 +58,19 @@ public:
     void deactivate() const;
 
     /*!
-     * Renders a single model
+     * Renders a single model from its GPU buffers, uploading them first if needed. Leaves the
+     * model's vertex array bound.
      * @param model a model to render
      */
     void drawModel(const Model &model) const;
 
+    /*!
+     * Renders a single model from client side arrays, the driver copies the geometry on every
+     * draw. Only kept as the baseline of the draw benchmark.
+     * @param model a model to render
+     */
+    void drawModelClientArrays(const Model &model) const;
+
     /*!
      * Sets the model/view/projection matrix in the shader.
      * @param projectionMatrix sixteen floats, column major, defining an OpenGL projection matrix.
@@ -64,6 +78,18 @@ public:
     void setProjectionMatrix(float *projectionMatrix) const;
 
 private:
+    /*!
+     * Helper function to compile and link a program with the attributes at their shared locations
+     * @param retrievable Whether the program binary will be read back for a cache
+     * @return the id of the program, or 0 in the case of an error
+     */
+    static GLuint linkProgram(
+            const std::string &vertexSource,
+            const std::string &fragmentSource,
+            const std::string &positionAttributeName,
+            const std::string &uvAttributeName,
+            bool retrievable);
+
     /*!
      * Helper function to load a shader of a given type
      * @param shaderType The OpenGL shader type. Should either be GL_VERTEX_SHADER or GL_FRAGMENT_SHADER
@@ -0,0 +1,148 @@
+#include "ShaderCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+#include <vector>
+
+#include "AndroidOut.h"
+
+//! Marks a cache file, bump it when the layout changes
+static constexpr uint32_t kCacheMagic = 0x31424750; // "PGB1"
+
+//! The largest binary accepted from a cache file
+static constexpr uint32_t kMaxBinarySize = 64 * 1024 * 1024;
+
+/*!
+ * Precedes the binary in each cache file
+ */
+struct CacheHeader {
+    uint32_t magic;
+    uint32_t format;
+    uint32_t length;
+};
+
+/*!
+ * 64 bit FNV-1a, continuing from @a hash
+ */
+static uint64_t hashBytes(const void *data, size_t size, uint64_t hash) {
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+ShaderCache::ShaderCache(std::string directory)
+        : directory_(std::move(directory)),
+          supported_(false),
+          hits_(0),
+          misses_(0),
+          rejected_(0) {
+    // Some drivers advertise no binary formats at all, there's nothing to cache then
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    supported_ = formatCount > 0;
+    if (!supported_) {
+        aout << "Program binaries not supported, shaders are compiled on every launch" << std::endl;
+    }
+    mkdir(directory_.c_str(), 0700);
+}
+
+std::string ShaderCache::makeKey(const std::string *parts, size_t count) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < count; i++) {
+        // Hash the terminator too, so moving text from one part to the next changes the key
+        hash = hashBytes(parts[i].c_str(), parts[i].size() + 1, hash);
+    }
+    for (GLenum name: {GL_RENDERER, GL_VERSION}) {
+        const char *value = reinterpret_cast<const char *>(glGetString(name));
+        if (value) {
+            hash = hashBytes(value, strlen(value) + 1, hash);
+        }
+    }
+
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", (unsigned long long) hash);
+    return key;
+}
+
+std::string ShaderCache::getPath(const std::string &key) const {
+    return directory_ + "/" + key + ".bin";
+}
+
+GLuint ShaderCache::loadProgram(const std::string &key) {
+    if (!supported_) {
+        return 0;
+    }
+
+    std::ifstream file(getPath(key), std::ios::binary);
+    CacheHeader header{};
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) || header.magic != kCacheMagic) {
+        misses_++;
+        return 0;
+    }
+    // Anything this large is a corrupt entry, not a program
+    if (header.length == 0 || header.length > kMaxBinarySize) {
+        misses_++;
+        return 0;
+    }
+    std::vector<char> binary(header.length);
+    if (!file.read(binary.data(), binary.size())) {
+        misses_++;
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, binary.data(), GLsizei(binary.size()));
+    GLint linkStatus = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+    if (linkStatus != GL_TRUE) {
+        // Normal after a driver update, the entry is useless from now on
+        aout << "Cached program " << key << " rejected by the driver" << std::endl;
+        glDeleteProgram(program);
+        file.close();
+        remove(getPath(key).c_str());
+        rejected_++;
+        return 0;
+    }
+
+    hits_++;
+    return program;
+}
+
+void ShaderCache::storeProgram(const std::string &key, GLuint program) {
+    if (!supported_) {
+        return;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+    if (length <= 0) {
+        return;
+    }
+
+    // Write to a temporary first, a launch killed halfway through mustn't leave a torn entry
+    const std::string path = getPath(key);
+    const std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        CacheHeader header{kCacheMagic, format, uint32_t(length)};
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(binary.data(), length);
+        if (!file) {
+            aout << "Failed to write " << temporaryPath << std::endl;
+            remove(temporaryPath.c_str());
+            return;
+        }
+    }
+    rename(temporaryPath.c_str(), path.c_str());
+}
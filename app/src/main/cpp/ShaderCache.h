@@ -0,0 +1,66 @@
+#ifndef ANDROIDGLINVESTIGATIONS_SHADERCACHE_H
+#define ANDROIDGLINVESTIGATIONS_SHADERCACHE_H
+
+#include <cstdint>
+#include <GLES3/gl3.h>
+#include <string>
+
+/*!
+ * Stores linked programs as driver binaries (glGetProgramBinary) in a directory, so later
+ * launches skip compiling and linking. Entries are keyed by a hash of everything that affects
+ * the binary: the sources, the attribute bindings and the GL_RENDERER and GL_VERSION strings. A
+ * driver update changes the key, and a binary the driver rejects anyway is deleted, the caller
+ * then compiles from source.
+ */
+class ShaderCache {
+public:
+    /*!
+     * @param directory where binaries are kept, created if missing. Typically under the app's
+     *     internal data path.
+     */
+    explicit ShaderCache(std::string directory);
+
+    /*!
+     * Builds the cache key of a program. Needs a current GL context.
+     * @param parts the sources and anything else that decides what the program is
+     * @param count the number of parts
+     * @return the key, a hex string
+     */
+    static std::string makeKey(const std::string *parts, size_t count);
+
+    /*!
+     * Creates a program from a cached binary
+     * @param key the program's key from @a makeKey
+     * @return a linked program, or 0 if there's no entry or the driver rejected it
+     */
+    GLuint loadProgram(const std::string &key);
+
+    /*!
+     * Stores a linked program. Link it with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set, some drivers
+     * don't keep the binary otherwise.
+     * @param key the program's key from @a makeKey
+     * @param program the linked program
+     */
+    void storeProgram(const std::string &key, GLuint program);
+
+    constexpr uint32_t getHitCount() const { return hits_; }
+
+    constexpr uint32_t getMissCount() const { return misses_; }
+
+    /*!
+     * @return how many cached binaries the driver refused, e.g. after an update that kept the
+     *     version string
+     */
+    constexpr uint32_t getRejectedCount() const { return rejected_; }
+
+private:
+    std::string getPath(const std::string &key) const;
+
+    std::string directory_;
+    bool supported_;
+    uint32_t hits_;
+    uint32_t misses_;
+    uint32_t rejected_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_SHADERCACHE_H
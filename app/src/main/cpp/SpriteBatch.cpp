@@ -0,0 +1,211 @@
+#include "SpriteBatch.h"
+
+#include <algorithm>
+
+#include "GeometryBuffers.h"
+#include "Shader.h"
+#include "TextureAtlas.h"
+
+//! Frames of vertices the stream buffer holds before it's orphaned
+static constexpr uint32_t kStreamFrames = 3;
+
+SpriteBatch::SpriteBatch(uint32_t maxSpritesPerDraw)
+        : maxSpritesPerDraw_(std::clamp(maxSpritesPerDraw, 1u, 16384u)),
+          vertexBuffer_(GL_ARRAY_BUFFER, GLsizeiptr(maxSpritesPerDraw_) * 4 * sizeof(Vertex) * kStreamFrames),
+          vao_(0),
+          indexBuffer_(0) {
+    // Every quad uses the same index pattern, so one static index buffer serves all batches
+    std::vector<Index> indices;
+    indices.reserve(maxSpritesPerDraw_ * 6);
+    for (uint32_t i = 0; i < maxSpritesPerDraw_; i++) {
+        const Index first = Index(i * 4);
+        indices.insert(indices.end(), {
+                first, Index(first + 1), Index(first + 2),
+                first, Index(first + 2), Index(first + 3)
+        });
+    }
+
+    GlState &state = GlState::current();
+    glGenVertexArrays(1, &vao_);
+    state.bindVertexArray(vao_);
+    glGenBuffers(1, &indexBuffer_);
+    state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer_);
+    glBufferData(
+            GL_ELEMENT_ARRAY_BUFFER,
+            indices.size() * sizeof(Index),
+            indices.data(),
+            GL_STATIC_DRAW);
+    glEnableVertexAttribArray(GeometryBuffers::kPositionLocation);
+    glEnableVertexAttribArray(GeometryBuffers::kUVLocation);
+    state.bindVertexArray(0);
+}
+
+SpriteBatch::~SpriteBatch() {
+    if (vao_) {
+        GlState::current().deleteVertexArray(vao_);
+        GlState::current().deleteBuffer(indexBuffer_);
+    }
+}
+
+void SpriteBatch::begin() {
+    sprites_.clear();
+    shaders_.clear();
+}
+
+void SpriteBatch::draw(
+        const Shader &shader,
+        BlendMode blend,
+        GLuint texture,
+        float x,
+        float y,
+        float halfWidth,
+        float halfHeight,
+        float u0,
+        float v0,
+        float u1,
+        float v1,
+        int32_t layer) {
+    // Layer, then shader, blend mode and texture. Shaders get a small number in order of first
+    // use, a batch rarely has more than a handful.
+    uint32_t shaderNumber = 0;
+    while (shaderNumber < shaders_.size() && shaders_[shaderNumber] != &shader) {
+        shaderNumber++;
+    }
+    if (shaderNumber == shaders_.size()) {
+        shaders_.push_back(&shader);
+    }
+    const uint64_t biasedLayer = uint64_t(std::clamp(layer, -32768, 32767) + 32768);
+    const uint64_t key = biasedLayer << 48
+                         | uint64_t(shaderNumber & 0xff) << 40
+                         | uint64_t(blend) << 32
+                         | texture;
+
+    sprites_.push_back(Sprite{
+            key,
+            uint32_t(sprites_.size()),
+            &shader,
+            blend,
+            texture,
+            {
+                    Vertex(Vector3{x - halfWidth, y + halfHeight, 0}, Vector2{u0, v0}),
+                    Vertex(Vector3{x + halfWidth, y + halfHeight, 0}, Vector2{u1, v0}),
+                    Vertex(Vector3{x + halfWidth, y - halfHeight, 0}, Vector2{u1, v1}),
+                    Vertex(Vector3{x - halfWidth, y - halfHeight, 0}, Vector2{u0, v1})
+            }});
+}
+
+void SpriteBatch::draw(
+        const Shader &shader,
+        BlendMode blend,
+        const TextureAtlas &atlas,
+        const AtlasRegion &region,
+        float x,
+        float y,
+        float halfWidth,
+        float halfHeight,
+        int32_t layer) {
+    draw(shader,
+         blend,
+         atlas.getPage(region.page).getTextureID(),
+         x,
+         y,
+         halfWidth,
+         halfHeight,
+         region.u0,
+         region.v0,
+         region.u1,
+         region.v1,
+         layer);
+}
+
+void SpriteBatch::applyState(const Sprite &sprite, const Sprite *previous) {
+    GlState &state = GlState::current();
+    if (!previous || previous->shader != sprite.shader) {
+        sprite.shader->activate();
+        stats_.stateChanges++;
+    }
+    if (!previous || previous->blend != sprite.blend) {
+        switch (sprite.blend) {
+            case BlendMode::Opaque:
+                state.setBlend(false);
+                break;
+            case BlendMode::Alpha:
+                state.setBlend(true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                break;
+            case BlendMode::Additive:
+                state.setBlend(true, GL_SRC_ALPHA, GL_ONE);
+                break;
+        }
+        stats_.stateChanges++;
+    }
+    if (!previous || previous->texture != sprite.texture) {
+        state.bindTexture(0, GL_TEXTURE_2D, sprite.texture);
+        stats_.stateChanges++;
+    }
+}
+
+void SpriteBatch::end() {
+    stats_ = SpriteBatchStats();
+    stats_.sprites = uint32_t(sprites_.size());
+    if (sprites_.empty()) {
+        return;
+    }
+
+    // Sort pointers, the sprites themselves are too big to move around. Ties keep the order they
+    // were added in.
+    sorted_.clear();
+    for (const auto &sprite: sprites_) {
+        sorted_.push_back(&sprite);
+    }
+    std::sort(sorted_.begin(), sorted_.end(), [](const Sprite *a, const Sprite *b) {
+        return a->key != b->key ? a->key < b->key : a->order < b->order;
+    });
+
+    // One write for the whole frame, each batch then points its attributes at its own range
+    vertices_.clear();
+    vertices_.reserve(sorted_.size() * 4);
+    for (const Sprite *sprite: sorted_) {
+        vertices_.insert(vertices_.end(), sprite->corners, sprite->corners + 4);
+    }
+    const GLintptr baseOffset = vertexBuffer_.write(
+            vertices_.data(),
+            GLsizeiptr(vertices_.size() * sizeof(Vertex)),
+            sizeof(Vertex));
+
+    // The stream buffer is still bound to GL_ARRAY_BUFFER, the attribute pointers refer to it
+    GlState::current().bindVertexArray(vao_);
+    const Sprite *previous = nullptr;
+    for (size_t first = 0; first < sorted_.size();) {
+        size_t last = first + 1;
+        while (last < sorted_.size()
+               && sorted_[last]->key == sorted_[first]->key
+               && last - first < maxSpritesPerDraw_) {
+            last++;
+        }
+
+        applyState(*sorted_[first], previous);
+        const GLintptr offset = baseOffset + GLintptr(first * 4 * sizeof(Vertex));
+        glVertexAttribPointer(
+                GeometryBuffers::kPositionLocation,
+                3,
+                GL_FLOAT,
+                GL_FALSE,
+                sizeof(Vertex),
+                reinterpret_cast<const void *>(offset));
+        glVertexAttribPointer(
+                GeometryBuffers::kUVLocation,
+                2,
+                GL_FLOAT,
+                GL_FALSE,
+                sizeof(Vertex),
+                reinterpret_cast<const void *>(offset + sizeof(Vector3)));
+        glDrawElements(GL_TRIANGLES, GLsizei((last - first) * 6), GL_UNSIGNED_SHORT, nullptr);
+        stats_.drawCalls++;
+
+        previous = sorted_[first];
+        first = last;
+    }
+    GlState::current().bindVertexArray(0);
+    sprites_.clear();
+    shaders_.clear();
+}
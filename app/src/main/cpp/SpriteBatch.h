@@ -0,0 +1,137 @@
+#ifndef ANDROIDGLINVESTIGATIONS_SPRITEBATCH_H
+#define ANDROIDGLINVESTIGATIONS_SPRITEBATCH_H
+
+#include <cstdint>
+#include <GLES3/gl3.h>
+#include <vector>
+
+#include "Model.h"
+#include "StreamBuffer.h"
+
+class Shader;
+struct AtlasRegion;
+class TextureAtlas;
+
+/*!
+ * How a sprite is blended with what's behind it
+ */
+enum class BlendMode {
+    Opaque,
+    Alpha,
+    Additive
+};
+
+/*!
+ * Counters of the last @a SpriteBatch::end
+ */
+struct SpriteBatchStats {
+    uint32_t sprites = 0;
+    uint32_t drawCalls = 0;
+    uint32_t stateChanges = 0;
+};
+
+/*!
+ * Collects sprites between @a begin and @a end and draws them with as few draws as possible.
+ * Sprites are sorted by layer, shader, blend mode and texture, quads of one run of equal state
+ * are written into a streaming vertex buffer and drawn together.
+ *
+ * Sorting only keeps the submission order between sprites of the same state. Where sprites with
+ * different textures have to overlap in a given order, put them on different layers, or better,
+ * into the same atlas page.
+ */
+class SpriteBatch {
+public:
+    /*!
+     * @param maxSpritesPerDraw quads per draw, at most 16384 to fit 16 bit indices
+     */
+    explicit SpriteBatch(uint32_t maxSpritesPerDraw = 16384);
+
+    ~SpriteBatch();
+
+    SpriteBatch(const SpriteBatch &) = delete;
+
+    SpriteBatch &operator=(const SpriteBatch &) = delete;
+
+    /*!
+     * Starts collecting sprites, dropping any not drawn yet
+     */
+    void begin();
+
+    /*!
+     * Adds an axis aligned sprite
+     * @param shader the shader to draw with, it needs its projection set before @a end
+     * @param blend how to blend it
+     * @param texture the texture, usually an atlas page
+     * @param x the center
+     * @param y the center
+     * @param halfWidth half the width
+     * @param halfHeight half the height
+     * @param u0 the uv of the top left corner
+     * @param v0 the uv of the top left corner
+     * @param u1 the uv of the bottom right corner
+     * @param v1 the uv of the bottom right corner
+     * @param layer sprites on lower layers are drawn first
+     */
+    void draw(
+            const Shader &shader,
+            BlendMode blend,
+            GLuint texture,
+            float x,
+            float y,
+            float halfWidth,
+            float halfHeight,
+            float u0,
+            float v0,
+            float u1,
+            float v1,
+            int32_t layer = 0);
+
+    /*!
+     * Adds a sprite showing an atlas region
+     */
+    void draw(
+            const Shader &shader,
+            BlendMode blend,
+            const TextureAtlas &atlas,
+            const AtlasRegion &region,
+            float x,
+            float y,
+            float halfWidth,
+            float halfHeight,
+            int32_t layer = 0);
+
+    /*!
+     * Sorts and draws everything added since @a begin. Leaves the last shader active, the last
+     * blend state set and no vertex array bound.
+     */
+    void end();
+
+    inline const SpriteBatchStats &getStats() const { return stats_; }
+
+private:
+    struct Sprite {
+        uint64_t key;
+        uint32_t order;
+        const Shader *shader;
+        BlendMode blend;
+        GLuint texture;
+        Vertex corners[4];
+    };
+
+    /*!
+     * Sets the GL state a batch needs if the previous batch used a different one
+     */
+    void applyState(const Sprite &sprite, const Sprite *previous);
+
+    uint32_t maxSpritesPerDraw_;
+    std::vector<Sprite> sprites_;
+    std::vector<const Shader *> shaders_;
+    std::vector<const Sprite *> sorted_;
+    std::vector<Vertex> vertices_;
+    StreamBuffer vertexBuffer_;
+    GLuint vao_;
+    GLuint indexBuffer_;
+    SpriteBatchStats stats_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_SPRITEBATCH_H
@@ -0,0 +1,57 @@
+#include "StreamBuffer.h"
+
+#include <cstring>
+
+#include "AndroidOut.h"
+#include "GlState.h"
+
+StreamBuffer::StreamBuffer(GLenum target, GLsizeiptr size)
+        : target_(target),
+          buffer_(0),
+          size_(size),
+          offset_(0),
+          orphanCount_(0) {
+    glGenBuffers(1, &buffer_);
+    GlState::current().bindBuffer(target_, buffer_);
+    glBufferData(target_, size_, nullptr, GL_STREAM_DRAW);
+}
+
+StreamBuffer::~StreamBuffer() {
+    if (buffer_) {
+        GlState::current().deleteBuffer(buffer_);
+        buffer_ = 0;
+    }
+}
+
+GLintptr StreamBuffer::write(const void *data, GLsizeiptr size, GLsizeiptr alignment) {
+    GlState::current().bindBuffer(target_, buffer_);
+
+    GLintptr offset = (offset_ + alignment - 1) / alignment * alignment;
+    if (size > size_) {
+        // Too big to ever fit, start over with room for it
+        size_ = size;
+        offset = size_;
+    }
+    if (offset + size > size_) {
+        glBufferData(target_, size_, nullptr, GL_STREAM_DRAW);
+        offset = 0;
+        orphanCount_++;
+    }
+
+    // Unsynchronized is safe, this range wasn't written since the buffer was last orphaned
+    void *mapped = glMapBufferRange(
+            target_,
+            offset,
+            size,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (mapped) {
+        memcpy(mapped, data, size);
+        glUnmapBuffer(target_);
+    } else {
+        aout << "Failed to map stream buffer, falling back to glBufferSubData" << std::endl;
+        glBufferSubData(target_, offset, size, data);
+    }
+
+    offset_ = offset + size;
+    return offset;
+}
@@ -0,0 +1,53 @@
+#ifndef ANDROIDGLINVESTIGATIONS_STREAMBUFFER_H
+#define ANDROIDGLINVESTIGATIONS_STREAMBUFFER_H
+
+#include <cstdint>
+#include <GLES3/gl3.h>
+
+/*!
+ * A buffer for geometry rebuilt every frame, e.g. sprite batches or debug lines. Each write goes
+ * to the next unused range, mapped unsynchronized: nothing a queued draw may still read is ever
+ * overwritten. When the buffer is full it's orphaned, the driver swaps in new storage and frees
+ * the old one once the draws using it complete, and writing starts over at the beginning.
+ */
+class StreamBuffer {
+public:
+    /*!
+     * @param target GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER
+     * @param size the size in bytes, ideally enough for a few frames of data
+     */
+    StreamBuffer(GLenum target, GLsizeiptr size);
+
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer &) = delete;
+
+    StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+    /*!
+     * Copies data into the buffer and leaves it bound to its target. Binding an index buffer
+     * changes the bound vertex array, bind the one to draw with first (or none).
+     * @param data the data to copy
+     * @param size the size in bytes, a larger write than the whole buffer grows it
+     * @param alignment the alignment of the returned offset, e.g. the vertex stride
+     * @return the byte offset of the data in the buffer, for glVertexAttribPointer or
+     *     glDrawElements
+     */
+    GLintptr write(const void *data, GLsizeiptr size, GLsizeiptr alignment = 4);
+
+    constexpr GLuint getBufferID() const { return buffer_; }
+
+    /*!
+     * @return how often the buffer was orphaned, ideally at most once every few frames
+     */
+    constexpr uint32_t getOrphanCount() const { return orphanCount_; }
+
+private:
+    GLenum target_;
+    GLuint buffer_;
+    GLsizeiptr size_;
+    GLintptr offset_;
+    uint32_t orphanCount_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_STREAMBUFFER_H
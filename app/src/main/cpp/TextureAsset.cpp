@@ -1,19 +1,89 @@
 #include <android/imagedecoder.h>
+#include <cstring>
 #include "TextureAsset.h"
 #include "AndroidOut.h"
+#include "GlState.h"
 #include "Utility.h"
+#include "Utils/Ktx2.h"
 
-std::shared_ptr<TextureAsset>
-TextureAsset::loadAsset(AAssetManager *assetManager, const std::string &assetPath) {
+namespace {
+// GL_KHR_texture_compression_astc_ldr, not in gl3.h. Block sizes are in the order of the VkFormats.
+constexpr GLenum kCompressedRgbaAstc4x4 = 0x93B0;
+constexpr GLenum kCompressedSrgb8Alpha8Astc4x4 = 0x93D0;
+
+/*!
+ * The internal format for a KTX2 format, 0 if there's none
+ */
+GLenum getInternalFormat(uint32_t vkFormat) {
+    switch (vkFormat) {
+        case kVkFormatR8G8B8A8Unorm:
+            return GL_RGBA8;
+        case kVkFormatR8G8B8A8Srgb:
+            return GL_SRGB8_ALPHA8;
+        case kVkFormatEtc2R8G8B8UnormBlock:
+            return GL_COMPRESSED_RGB8_ETC2;
+        case kVkFormatEtc2R8G8B8SrgbBlock:
+            return GL_COMPRESSED_SRGB8_ETC2;
+        case kVkFormatEtc2R8G8B8A1UnormBlock:
+            return GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2;
+        case kVkFormatEtc2R8G8B8A1SrgbBlock:
+            return GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2;
+        case kVkFormatEtc2R8G8B8A8UnormBlock:
+            return GL_COMPRESSED_RGBA8_ETC2_EAC;
+        case kVkFormatEtc2R8G8B8A8SrgbBlock:
+            return GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC;
+        default:
+            break;
+    }
+    if (vkFormat >= kVkFormatAstc4x4UnormBlock && vkFormat <= kVkFormatAstc12x12SrgbBlock) {
+        const uint32_t index = vkFormat - kVkFormatAstc4x4UnormBlock;
+        return (index % 2 ? kCompressedSrgb8Alpha8Astc4x4 : kCompressedRgbaAstc4x4) + index / 2;
+    }
+    return 0;
+}
+
+bool isAstcSupported() {
+    GLint major = 0;
+    GLint minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major > 3 || (major == 3 && minor >= 2)) {
+        return true;
+    }
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; i < extensionCount; i++) {
+        auto extension = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+        if (extension && strcmp(extension, "GL_KHR_texture_compression_astc_ldr") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool endsWith(const std::string &text, const std::string &suffix) {
+    return text.size() >= suffix.size()
+           && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+}
+
+bool TextureAsset::decodeAsset(
+        AAssetManager *assetManager,
+        const std::string &assetPath,
+        ImageData &outImage) {
     // Get the image from asset manager
-    auto pAndroidRobotPng = AAssetManager_open(
+    auto pAsset = AAssetManager_open(
             assetManager,
             assetPath.c_str(),
             AASSET_MODE_BUFFER);
+    if (!pAsset) {
+        aout << "Failed to open " << assetPath << std::endl;
+        return false;
+    }
 
     // Make a decoder to turn it into a texture
     AImageDecoder *pAndroidDecoder = nullptr;
-    auto result = AImageDecoder_createFromAAsset(pAndroidRobotPng, &pAndroidDecoder);
+    auto result = AImageDecoder_createFromAAsset(pAsset, &pAndroidDecoder);
     assert(result == ANDROID_IMAGE_DECODER_SUCCESS);
 
     // make sure we get 8 bits per channel out. RGBA order.
@@ -29,24 +99,45 @@ TextureAsset::loadAsset(AAssetManager *assetManager, const std::string &assetPat
     auto stride = AImageDecoder_getMinimumStride(pAndroidDecoder);
 
     // Get the bitmap data of the image
-    auto upAndroidImageData = std::make_unique<std::vector<uint8_t>>(height * stride);
+    std::vector<uint8_t> imageData(height * stride);
     auto decodeResult = AImageDecoder_decodeImage(
             pAndroidDecoder,
-            upAndroidImageData->data(),
+            imageData.data(),
             stride,
-            upAndroidImageData->size());
+            imageData.size());
     assert(decodeResult == ANDROID_IMAGE_DECODER_SUCCESS);
 
+    // cleanup helpers
+    AImageDecoder_delete(pAndroidDecoder);
+    AAsset_close(pAsset);
+
+    // Rows may be padded, GL and the atlas packer want them tight
+    const size_t rowSize = size_t(width) * 4;
+    outImage.width = width;
+    outImage.height = height;
+    if (stride == rowSize) {
+        outImage.pixels = std::move(imageData);
+    } else {
+        outImage.pixels.resize(rowSize * height);
+        for (int32_t row = 0; row < height; row++) {
+            memcpy(outImage.pixels.data() + row * rowSize, imageData.data() + row * stride, rowSize);
+        }
+    }
+    return decodeResult == ANDROID_IMAGE_DECODER_SUCCESS;
+}
+
+std::shared_ptr<TextureAsset>
+TextureAsset::createTexture(GLsizei width, GLsizei height, const uint8_t *pixels, bool mipmaps) {
     // Get an opengl texture
     GLuint textureId;
     glGenTextures(1, &textureId);
-    glBindTexture(GL_TEXTURE_2D, textureId);
+    GlState::current().bindTexture(0, GL_TEXTURE_2D, textureId);
 
     // Clamp to the edge, you'll get odd results alpha blending if you don't
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     // Load the texture into VRAM
@@ -59,22 +150,113 @@ TextureAsset::loadAsset(AAssetManager *assetManager, const std::string &assetPat
             0, // border (always 0)
             GL_RGBA, // format
             GL_UNSIGNED_BYTE, // type
-            upAndroidImageData->data() // Data to upload
+            pixels // Data to upload
     );
 
     // generate mip levels. Not really needed for 2D, but good to do
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    // cleanup helpers
-    AImageDecoder_delete(pAndroidDecoder);
-    AAsset_close(pAndroidRobotPng);
+    if (mipmaps) {
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
 
     // Create a shared pointer so it can be cleaned up easily/automatically
     return std::shared_ptr<TextureAsset>(new TextureAsset(textureId));
 }
 
+bool TextureAsset::isFormatSupported(uint32_t vkFormat) {
+    TextureFormatInfo info;
+    if (!getInternalFormat(vkFormat) || !getTextureFormatInfo(vkFormat, info)) {
+        return false;
+    }
+    if (info.compression == TextureCompression::Astc) {
+        // Asked once, the answer doesn't change between contexts of one device
+        static const bool astcSupported = isAstcSupported();
+        return astcSupported;
+    }
+    return true;
+}
+
+std::shared_ptr<TextureAsset> TextureAsset::createTexture(const Ktx2Image &image) {
+    if (!isFormatSupported(image.vkFormat)) {
+        aout << "KTX2 format " << image.vkFormat << " isn't supported" << std::endl;
+        return nullptr;
+    }
+    const GLenum internalFormat = getInternalFormat(image.vkFormat);
+    const auto levelCount = static_cast<GLsizei>(image.levels.size());
+
+    GLuint textureId;
+    glGenTextures(1, &textureId);
+    GlState::current().bindTexture(0, GL_TEXTURE_2D, textureId);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(
+            GL_TEXTURE_2D,
+            GL_TEXTURE_MIN_FILTER,
+            levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // Immutable storage for the whole chain, the driver allocates once and knows it's complete
+    glTexStorage2D(GL_TEXTURE_2D, levelCount, internalFormat, image.width, image.height);
+    for (GLsizei level = 0; level < levelCount; level++) {
+        const Ktx2Image::Level &levelInfo = image.levels[level];
+        if (image.formatInfo.compression == TextureCompression::None) {
+            glTexSubImage2D(
+                    GL_TEXTURE_2D,
+                    level,
+                    0,
+                    0,
+                    levelInfo.width,
+                    levelInfo.height,
+                    GL_RGBA,
+                    GL_UNSIGNED_BYTE,
+                    image.getLevelData(level));
+        } else {
+            glCompressedTexSubImage2D(
+                    GL_TEXTURE_2D,
+                    level,
+                    0,
+                    0,
+                    levelInfo.width,
+                    levelInfo.height,
+                    internalFormat,
+                    static_cast<GLsizei>(levelInfo.size),
+                    image.getLevelData(level));
+        }
+    }
+
+    return std::shared_ptr<TextureAsset>(new TextureAsset(textureId));
+}
+
+std::shared_ptr<TextureAsset>
+TextureAsset::loadAsset(AAssetManager *assetManager, const std::string &assetPath) {
+    if (endsWith(assetPath, ".ktx2")) {
+        auto pAsset = AAssetManager_open(assetManager, assetPath.c_str(), AASSET_MODE_BUFFER);
+        if (!pAsset) {
+            aout << "Failed to open " << assetPath << std::endl;
+            return nullptr;
+        }
+        auto pData = static_cast<const uint8_t *>(AAsset_getBuffer(pAsset));
+        std::vector<uint8_t> file(pData, pData + AAsset_getLength(pAsset));
+        AAsset_close(pAsset);
+
+        Ktx2Image ktx2Image;
+        std::string error;
+        if (!readKtx2(std::move(file), ktx2Image, error)) {
+            aout << "Failed to read " << assetPath << ": " << error << std::endl;
+            return nullptr;
+        }
+        return createTexture(ktx2Image);
+    }
+
+    ImageData image;
+    if (!decodeAsset(assetManager, assetPath, image)) {
+        return nullptr;
+    }
+    return createTexture(image.width, image.height, image.pixels.data(), true);
+}
+
 TextureAsset::~TextureAsset() {
     // return texture resources
-    glDeleteTextures(1, &textureID_);
+    GlState::current().deleteTexture(textureID_);
     textureID_ = 0;
-}
\ No newline at end of file
+}
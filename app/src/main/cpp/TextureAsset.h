@@ -1,16 +1,65 @@
 #ifndef ANDROIDGLINVESTIGATIONS_TEXTUREASSET_H
 #define ANDROIDGLINVESTIGATIONS_TEXTUREASSET_H
 
+#include <cstdint>
 #include <memory>
 #include <android/asset_manager.h>
 #include <GLES3/gl3.h>
 #include <string>
 #include <vector>
 
+struct Ktx2Image;
+
+/*!
+ * Decoded image pixels, tightly packed RGBA 8888
+ */
+struct ImageData {
+    int32_t width = 0;
+    int32_t height = 0;
+    std::vector<uint8_t> pixels;
+};
+
 class TextureAsset {
 public:
     /*!
-     * Loads a texture asset from the assets/ directory
+     * Decodes an image from the assets/ directory without creating a texture
+     * @param assetManager Asset manager to use
+     * @param assetPath The path to the asset
+     * @param outImage the decoded image
+     * @return true on success
+     */
+    static bool decodeAsset(AAssetManager *assetManager, const std::string &assetPath, ImageData &outImage);
+
+    /*!
+     * Creates a texture with clamped edges
+     * @param width the width in pixels
+     * @param height the height in pixels
+     * @param pixels RGBA 8888 data to upload, or null to leave the contents undefined
+     * @param mipmaps whether to generate and sample mip levels
+     * @return a shared pointer to a texture asset, resources will be reclaimed when it's cleaned up
+     */
+    static std::shared_ptr<TextureAsset>
+    createTexture(GLsizei width, GLsizei height, const uint8_t *pixels, bool mipmaps);
+
+    /*!
+     * Creates a texture from a KTX2 image, uploading its levels as they are stored. Compressed
+     * formats stay compressed in video memory and no mips are generated at runtime.
+     * @param image the image, see @a isFormatSupported
+     * @return a shared pointer to a texture asset, or null if the format isn't supported
+     */
+    static std::shared_ptr<TextureAsset> createTexture(const Ktx2Image &image);
+
+    /*!
+     * Whether a KTX2 format can be uploaded to the current context. ETC2 is part of GLES 3.0, ASTC
+     * needs GLES 3.2 or the KHR_texture_compression_astc_ldr extension.
+     * @param vkFormat the VkFormat value stored in the KTX2 file
+     */
+    static bool isFormatSupported(uint32_t vkFormat);
+
+    /*!
+     * Loads a texture asset from the assets/ directory. Paths ending in .ktx2 are uploaded as
+     * stored (see texture_cooker), anything else is decoded by the platform and mipmapped on the
+     * GPU.
      * @param assetManager Asset manager to use
      * @param assetPath The path to the asset
      * @return a shared pointer to a texture asset, resources will be reclaimed when it's cleaned up
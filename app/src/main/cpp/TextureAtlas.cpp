@@ -0,0 +1,180 @@
+#include "TextureAtlas.h"
+
+#include <algorithm>
+
+#include "AndroidOut.h"
+#include "GlState.h"
+
+SkylinePacker::SkylinePacker(int32_t width, int32_t height)
+        : width_(width),
+          height_(height),
+          usedArea_(0),
+          skyline_{{0, 0, width}} {}
+
+int32_t SkylinePacker::fit(size_t index, int32_t width, int32_t height) const {
+    if (skyline_[index].x + width > width_) {
+        return -1;
+    }
+
+    // The rectangle rests on the highest segment it spans
+    int32_t y = 0;
+    int32_t widthLeft = width;
+    for (size_t i = index; widthLeft > 0; i++) {
+        if (i == skyline_.size()) {
+            return -1;
+        }
+        y = std::max(y, skyline_[i].y);
+        if (y + height > height_) {
+            return -1;
+        }
+        widthLeft -= skyline_[i].width;
+    }
+    return y;
+}
+
+bool SkylinePacker::insert(int32_t width, int32_t height, int32_t &outX, int32_t &outY) {
+    size_t bestIndex = skyline_.size();
+    int32_t bestBottom = height_ + 1;
+    int32_t bestWidth = width_ + 1;
+    for (size_t i = 0; i < skyline_.size(); i++) {
+        int32_t y = fit(i, width, height);
+        if (y < 0) {
+            continue;
+        }
+        // Lowest top edge first, then the narrowest segment to keep wide gaps for wide images
+        if (y + height < bestBottom || (y + height == bestBottom && skyline_[i].width < bestWidth)) {
+            bestIndex = i;
+            bestBottom = y + height;
+            bestWidth = skyline_[i].width;
+        }
+    }
+    if (bestIndex == skyline_.size()) {
+        return false;
+    }
+
+    outX = skyline_[bestIndex].x;
+    outY = bestBottom - height;
+    skyline_.insert(skyline_.begin() + bestIndex, Segment{outX, bestBottom, width});
+
+    // Cut the segments now covered by the new one
+    for (size_t i = bestIndex + 1; i < skyline_.size();) {
+        const Segment &previous = skyline_[i - 1];
+        const int32_t previousEnd = previous.x + previous.width;
+        if (skyline_[i].x >= previousEnd) {
+            break;
+        }
+        const int32_t shrink = previousEnd - skyline_[i].x;
+        skyline_[i].x += shrink;
+        skyline_[i].width -= shrink;
+        if (skyline_[i].width > 0) {
+            break;
+        }
+        skyline_.erase(skyline_.begin() + i);
+    }
+
+    // Merge neighbours at the same height
+    for (size_t i = 0; i + 1 < skyline_.size();) {
+        if (skyline_[i].y == skyline_[i + 1].y) {
+            skyline_[i].width += skyline_[i + 1].width;
+            skyline_.erase(skyline_.begin() + i + 1);
+        } else {
+            i++;
+        }
+    }
+
+    usedArea_ += int64_t(width) * height;
+    return true;
+}
+
+float SkylinePacker::getOccupancy() const {
+    return float(double(usedArea_) / (double(width_) * height_));
+}
+
+TextureAtlas::TextureAtlas(int32_t pageSize, int32_t padding)
+        : pageSize_(pageSize),
+          padding_(padding) {}
+
+bool TextureAtlas::add(const std::string &name, const ImageData &image, AtlasRegion &outRegion) {
+    if (const AtlasRegion *existing = find(name)) {
+        outRegion = *existing;
+        return true;
+    }
+
+    if (image.width <= 0 || image.height <= 0) {
+        return false;
+    }
+    const int32_t paddedWidth = image.width + 2 * padding_;
+    const int32_t paddedHeight = image.height + 2 * padding_;
+    if (paddedWidth > pageSize_ || paddedHeight > pageSize_) {
+        aout << "Image " << name << " doesn't fit an atlas page" << std::endl;
+        return false;
+    }
+
+    // Earlier pages first, they may still have holes for small images
+    int32_t x = 0;
+    int32_t y = 0;
+    uint32_t page = 0;
+    while (page < pages_.size() && !pages_[page].packer.insert(paddedWidth, paddedHeight, x, y)) {
+        page++;
+    }
+    if (page == pages_.size()) {
+        pages_.push_back(Page{
+                TextureAsset::createTexture(pageSize_, pageSize_, nullptr, false),
+                SkylinePacker(pageSize_, pageSize_)});
+        pages_.back().packer.insert(paddedWidth, paddedHeight, x, y);
+        aout << "Atlas page " << page << " created" << std::endl;
+    }
+
+    // Repeat the edge pixels into the padding
+    std::vector<uint8_t> padded(size_t(paddedWidth) * paddedHeight * 4);
+    for (int32_t row = 0; row < paddedHeight; row++) {
+        const int32_t sourceRow = std::clamp(row - padding_, 0, image.height - 1);
+        for (int32_t column = 0; column < paddedWidth; column++) {
+            const int32_t sourceColumn = std::clamp(column - padding_, 0, image.width - 1);
+            const uint8_t *source = &image.pixels[(size_t(sourceRow) * image.width + sourceColumn) * 4];
+            std::copy(source, source + 4, &padded[(size_t(row) * paddedWidth + column) * 4]);
+        }
+    }
+
+    GlState::current().bindTexture(0, GL_TEXTURE_2D, pages_[page].spTexture->getTextureID());
+    glTexSubImage2D(
+            GL_TEXTURE_2D,
+            0,
+            x,
+            y,
+            paddedWidth,
+            paddedHeight,
+            GL_RGBA,
+            GL_UNSIGNED_BYTE,
+            padded.data());
+
+    AtlasRegion region;
+    region.page = page;
+    region.u0 = float(x + padding_) / pageSize_;
+    region.v0 = float(y + padding_) / pageSize_;
+    region.u1 = float(x + padding_ + image.width) / pageSize_;
+    region.v1 = float(y + padding_ + image.height) / pageSize_;
+    region.width = image.width;
+    region.height = image.height;
+    regions_.emplace(name, region);
+    outRegion = region;
+    return true;
+}
+
+bool TextureAtlas::addAsset(
+        AAssetManager *assetManager,
+        const std::string &assetPath,
+        AtlasRegion &outRegion) {
+    if (const AtlasRegion *existing = find(assetPath)) {
+        outRegion = *existing;
+        return true;
+    }
+    ImageData image;
+    return TextureAsset::decodeAsset(assetManager, assetPath, image)
+           && add(assetPath, image, outRegion);
+}
+
+const AtlasRegion *TextureAtlas::find(const std::string &name) const {
+    auto it = regions_.find(name);
+    return it != regions_.end() ? &it->second : nullptr;
+}
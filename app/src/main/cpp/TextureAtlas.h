@@ -0,0 +1,117 @@
+#ifndef ANDROIDGLINVESTIGATIONS_TEXTUREATLAS_H
+#define ANDROIDGLINVESTIGATIONS_TEXTUREATLAS_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "TextureAsset.h"
+
+/*!
+ * Packs rectangles into a fixed size area with the skyline bottom-left heuristic: the used area
+ * is tracked as a list of horizontal segments, each rectangle goes where its top edge ends up
+ * lowest. Fast, and wastes little space for sprites of similar heights.
+ */
+class SkylinePacker {
+public:
+    SkylinePacker(int32_t width, int32_t height);
+
+    /*!
+     * Finds room for a rectangle and marks it used
+     * @param width the width of the rectangle
+     * @param height the height of the rectangle
+     * @param outX the left edge of the placed rectangle
+     * @param outY the top edge of the placed rectangle
+     * @return false if there's no room left
+     */
+    bool insert(int32_t width, int32_t height, int32_t &outX, int32_t &outY);
+
+    /*!
+     * @return the fraction of the area covered by inserted rectangles
+     */
+    float getOccupancy() const;
+
+private:
+    struct Segment {
+        int32_t x;
+        int32_t y;
+        int32_t width;
+    };
+
+    /*!
+     * @return the y the rectangle would be placed at on top of segment @a index, or -1 if it
+     *     doesn't fit there
+     */
+    int32_t fit(size_t index, int32_t width, int32_t height) const;
+
+    int32_t width_;
+    int32_t height_;
+    int64_t usedArea_;
+    std::vector<Segment> skyline_;
+};
+
+/*!
+ * Where an image ended up in an atlas. The uvs cover the image without its padding.
+ */
+struct AtlasRegion {
+    uint32_t page = 0;
+    float u0 = 0.f;
+    float v0 = 0.f;
+    float u1 = 0.f;
+    float v1 = 0.f;
+    int32_t width = 0;
+    int32_t height = 0;
+};
+
+/*!
+ * Merges small images into shared texture pages at runtime, so sprites using any of them can be
+ * drawn together. Each image is surrounded by a copy of its edge pixels so linear filtering
+ * never picks up a neighbour. Pages have no mip levels for the same reason.
+ */
+class TextureAtlas {
+public:
+    /*!
+     * @param pageSize the width and height of each page
+     * @param padding the edge pixels repeated around each image
+     */
+    explicit TextureAtlas(int32_t pageSize = 2048, int32_t padding = 2);
+
+    /*!
+     * Adds an image, opening a new page when the current ones are full. Needs a current GL
+     * context. Adding a name again returns the existing region.
+     * @param name the name to look the image up by
+     * @param image the pixels
+     * @param outRegion where the image was placed
+     * @return false if the image doesn't fit on an empty page
+     */
+    bool add(const std::string &name, const ImageData &image, AtlasRegion &outRegion);
+
+    /*!
+     * Decodes an image from the assets/ directory and adds it, under its path
+     */
+    bool addAsset(AAssetManager *assetManager, const std::string &assetPath, AtlasRegion &outRegion);
+
+    /*!
+     * @return the region of a previously added image or null
+     */
+    const AtlasRegion *find(const std::string &name) const;
+
+    inline const TextureAsset &getPage(uint32_t page) const { return *pages_[page].spTexture; }
+
+    inline size_t getPageCount() const { return pages_.size(); }
+
+private:
+    struct Page {
+        std::shared_ptr<TextureAsset> spTexture;
+        SkylinePacker packer;
+    };
+
+    int32_t pageSize_;
+    int32_t padding_;
+    std::vector<Page> pages_;
+    std::unordered_map<std::string, AtlasRegion> regions_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_TEXTUREATLAS_H
@@ -0,0 +1,26 @@
+#version 450
+
+// Vertex in EntityComponent/Mesh.h
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 col;
+layout(location = 2) in vec2 tex;
+
+// GfxDevice::UboViewProjection, one buffer per swap chain image
+layout(set = 0, binding = 0) uniform UboViewProjection {
+    mat4 projection;
+    mat4 view;
+} uboViewProjection;
+
+// Model pushed per draw, the fragment stage's push constants follow at offset 64
+layout(push_constant) uniform PModel {
+    mat4 model;
+} pModel;
+
+layout(location = 0) out vec3 fragCol;
+layout(location = 1) out vec2 fragTex;
+
+void main() {
+    gl_Position = uboViewProjection.projection * uboViewProjection.view * pModel.model * vec4(pos, 1.0);
+    fragCol = col;
+    fragTex = tex;
+}
@@ -0,0 +1,13 @@
+#version 450
+
+layout(location = 0) in vec3 fragCol;
+layout(location = 1) in vec2 fragTex;
+
+// One set per texture (GfxDevice::addTexture), the sampler is immutable in the set layout
+layout(set = 1, binding = 0) uniform sampler2D textureSampler;
+
+layout(location = 0) out vec4 outColour;
+
+void main() {
+    outColour = texture(textureSampler, fragTex);
+}
@@ -0,0 +1,19 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec3 fragCol;
+layout(location = 1) in vec2 fragTex;
+
+// BindlessTextureTable, partially bound so only written slots may be sampled
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+// Follows the vertex stage's Model matrix in the same push constant range
+layout(push_constant) uniform Material {
+    layout(offset = 64) uint textureIndex;
+} material;
+
+layout(location = 0) out vec4 outColour;
+
+void main() {
+    outColour = texture(textures[nonuniformEXT(material.textureIndex)], fragTex);
+}
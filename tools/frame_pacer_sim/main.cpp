@@ -0,0 +1,193 @@
+// FramePacer (GFX/vulkan/FramePacer.h) against a simulated FIFO display, no device and no sleeping:
+//
+//   frame_pacer_sim [--frames n] [--refresh-hz f] [--images n]
+//
+// Every scenario runs --frames (default 600) frames on a SimulatedClock. The display flips at
+// --refresh-hz (default 60) and shows at most one queued image per vsync, in present order, never
+// before its desired present time. With --images (default 3) swap chain images, acquire blocks
+// while all but one are queued or on screen. A frame is ready `work` after it started (CPU and GPU
+// back to back, no overlap with the next frame). With display timing, the feedback of every
+// frame already on screen is passed to the pacer before the next frame starts, as
+// vkGetPastPresentationTimingGOOGLE would return it.
+//
+// Reports per scenario: frames per second, mean latency from frame start to on screen, the
+// present intervals in refresh cycles (min / max, and how many differ from the most common one),
+// misses the pacer counted and its swap interval at the end.
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "GFX/vulkan/FramePacer.h"
+#include "Utils/Clock.h"
+#include "Utils/Log.h"
+
+namespace {
+constexpr uint64_t kMs = 1000000;
+
+struct Display {
+    uint64_t refreshNs{16666667};
+    uint32_t images{3};
+    uint64_t lastVsyncNs{0};        // last flip processed
+    uint64_t lastShownNs{0};        // flip the image on screen was shown at
+    struct Queued {
+        uint32_t presentId;
+        uint64_t startNs;
+        uint64_t readyNs;
+        uint64_t desiredNs;
+    };
+    std::deque<Queued> queue;
+    std::vector<PresentTiming> timings;     // shown, not yet handed to the pacer
+    std::vector<uint64_t> shownNs;
+    std::vector<uint64_t> latencyNs;
+
+    uint64_t firstVsyncAtOrAfter(uint64_t timeNs) const
+    {
+        return (timeNs + refreshNs - 1) / refreshNs * refreshNs;
+    }
+
+    // Flips every vsync up to timeNs
+    void runUntil(uint64_t timeNs)
+    {
+        for (uint64_t vsync = lastVsyncNs + refreshNs; vsync <= timeNs; vsync += refreshNs) {
+            lastVsyncNs = vsync;
+            if (queue.empty() || queue.front().readyNs > vsync || queue.front().desiredNs > vsync) {
+                continue;
+            }
+            const Queued image = queue.front();
+            queue.pop_front();
+            PresentTiming timing;
+            timing.presentId = image.presentId;
+            timing.desiredPresentTimeNs = image.desiredNs;
+            timing.actualPresentTimeNs = vsync;
+            // Had it asked for no particular time: the first flip after it was ready and after the
+            // image before it
+            timing.earliestPresentTimeNs = std::max(firstVsyncAtOrAfter(image.readyNs), lastShownNs + refreshNs);
+            timing.presentMarginNs = timing.earliestPresentTimeNs - std::min(image.readyNs, timing.earliestPresentTimeNs);
+            timings.push_back(timing);
+            shownNs.push_back(vsync);
+            latencyNs.push_back(vsync - image.startNs);
+            lastShownNs = vsync;
+        }
+    }
+
+    // The image on screen is held too, acquire waits for a flip while the rest are queued
+    void acquire(SimulatedClock& clock)
+    {
+        while (queue.size() + 1 >= images) {
+            clock.sleepUntilNs(lastVsyncNs + refreshNs);
+            runUntil(clock.nowNs());
+        }
+    }
+};
+
+struct Scenario {
+    std::string name;
+    FramePacerConfig config;
+    bool displayTiming{false};
+    std::function<uint64_t(uint32_t frame)> workNs;
+};
+
+void run(const Scenario& scenario, uint32_t frames, uint64_t refreshNs, uint32_t images)
+{
+    SimulatedClock clock(refreshNs * 10);
+    Display display;
+    display.refreshNs = refreshNs;
+    display.images = images;
+    display.lastVsyncNs = clock.nowNs() / refreshNs * refreshNs;
+    display.lastShownNs = display.lastVsyncNs;
+
+    FramePacer pacer(scenario.config, clock);
+    pacer.setRefreshDuration(refreshNs);
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        if (scenario.displayTiming) {
+            for (const PresentTiming& timing : display.timings) {
+                pacer.onPresentTiming(timing);
+            }
+        }
+        display.timings.clear();
+
+        pacer.waitForNextFrame();
+        display.runUntil(clock.nowNs());
+        display.acquire(clock);
+        const uint64_t startNs = clock.nowNs();
+        clock.advance(scenario.workNs(frame));
+        display.runUntil(clock.nowNs());
+        const PresentTarget target = pacer.getPresentTarget();
+        display.queue.push_back({ target.presentId, startNs, clock.nowNs(), scenario.displayTiming ? target.desiredPresentTimeNs : 0 });
+    }
+    // Show what is still queued
+    display.runUntil(clock.nowNs() + refreshNs * (images + 4) * 4);
+
+    const uint64_t elapsedNs = display.shownNs.back() - display.shownNs.front();
+    std::map<uint64_t, uint32_t> intervals;
+    for (size_t i = 1; i < display.shownNs.size(); i++) {
+        intervals[(display.shownNs[i] - display.shownNs[i - 1] + refreshNs / 2) / refreshNs]++;
+    }
+    uint32_t commonCount = 0;
+    for (const auto& interval : intervals) {
+        commonCount = std::max(commonCount, interval.second);
+    }
+    uint64_t latencySum = 0;
+    for (uint64_t latency : display.latencyNs) {
+        latencySum += latency;
+    }
+    const FramePacerStats& stats = pacer.getStats();
+    printf("%-38s %7.1f %9.2f %5llu-%-3llu %7u %7llu %5u\n", scenario.name.c_str(),
+           (display.shownNs.size() - 1) / (elapsedNs / 1e9),
+           latencySum / 1e6 / display.latencyNs.size(),
+           static_cast<unsigned long long>(intervals.begin()->first),
+           static_cast<unsigned long long>(intervals.rbegin()->first),
+           static_cast<uint32_t>(display.shownNs.size() - 1) - commonCount,
+           static_cast<unsigned long long>(stats.missedFrames), stats.swapInterval);
+}
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t frames = 600;
+    double refreshHz = 60.0;
+    uint32_t images = 3;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc) {
+            frames = std::max(2u, static_cast<uint32_t>(std::stoul(argv[++i])));
+        } else if (arg == "--refresh-hz" && i + 1 < argc) {
+            refreshHz = std::max(1.0, std::stod(argv[++i]));
+        } else if (arg == "--images" && i + 1 < argc) {
+            images = std::max(2u, static_cast<uint32_t>(std::stoul(argv[++i])));
+        } else {
+            fprintf(stderr, "usage: frame_pacer_sim [--frames n] [--refresh-hz f] [--images n]\n");
+            return 1;
+        }
+    }
+    Logger::setLevel(LogLevel::Warning);
+    const uint64_t refreshNs = static_cast<uint64_t>(1e9 / refreshHz);
+
+    FramePacerConfig fifo;
+    FramePacerConfig fifo30 = fifo;
+    fifo30.targetFrameIntervalNs = refreshNs * 2;
+    auto steady = [](uint64_t workNs) { return [workNs](uint32_t) { return workNs; }; };
+    // A 25 ms hitch every 120 frames
+    auto spikes = [](uint32_t frame) { return frame % 120 == 60 ? 25 * kMs : 8 * kMs; };
+    const std::vector<Scenario> scenarios = {
+        { "8 ms, no display timing", fifo, false, steady(8 * kMs) },
+        { "8 ms, display timing", fifo, true, steady(8 * kMs) },
+        { "14 ms, no display timing", fifo, false, steady(14 * kMs) },
+        { "14 ms, display timing", fifo, true, steady(14 * kMs) },
+        { "8 ms, 30 fps target, display timing", fifo30, true, steady(8 * kMs) },
+        { "20 ms, display timing", fifo, true, steady(20 * kMs) },
+        { "8 ms + 25 ms spikes, display timing", fifo, true, spikes },
+    };
+
+    printf("%.1f Hz FIFO, %u images, %u frames\n", refreshHz, images, frames);
+    printf("%-38s %7s %9s %9s %7s %7s %5s\n", "", "fps", "latency", "vsyncs", "uneven", "missed", "swap");
+    for (const Scenario& scenario : scenarios) {
+        run(scenario, frames, refreshNs, images);
+    }
+    Logger::get().flush();
+    return 0;
+}
@@ -0,0 +1,508 @@
+// Frame timings of the Vulkan device rendering headless (DeviceConfig::headless), for CI and
+// regression runs on machines without a display:
+//
+//   render_benchmark [--frames n] [--warmup n] [--width w] [--height h] [--msaa 1|2|4]
+//                    [--device name] [--assets dir] [--checksums file] [--expect file] [--draws n]
+//                    [--graph-passes n] [--texture file] [--cluster-check]
+//
+// Before any device work, compiles a small render graph and fails the run unless culling, subpass
+// merging, barriers and memory aliasing come out as expected, then times RenderGraph::compile on a
+// synthetic frame of --graph-passes (default 64, 0 skips) passes.
+//
+// Renders --frames (default 300) frames of a camera orbiting the origin of a field of spheres, a
+// cluster mesh (GfxDevice::addClusterMesh), after --warmup (default 30) untimed ones, on the first
+// device whose name contains --device (default "llvmpipe", Mesa's lavapipe). Reports the median,
+// 95th percentile and maximum of draw()'s CPU wait, record and submit times and of the GPU frame
+// time from timestamp queries. The device loads Shaders/*.spv from the working directory, --assets
+// changes into the directory holding them first. The spheres sample --texture (default
+// android_robot.ktx2 next to the shaders) through the TextureStreamer, untextured when the file
+// can't be read or the device can't sample its format.
+//
+// Draw submission scaling: records the main pass with --draws (default 5000, 0 skips) stand-in
+// draws on 1, 2, 4 ... up to every core (GfxDevice::benchmarkRecording) and reports the median
+// recording time per thread count.
+//
+// Then draws until the texture streamer has no load left (at most kSettleFrames), so the images
+// don't depend on when loads finished, and draws kChecksumFrames fixed camera positions, reads
+// each image back and hashes it.
+// --checksums writes the hashes, one "frame hash" line each, --expect compares them with such a
+// file and fails on any difference. Only compare results of the same driver and version,
+// rasterization isn't bit exact across implementations.
+//
+// --cluster-check then draws the sphere field from kClusterCheckFrames camera positions. Each frame
+// the meshlets cluster_cull.comp left visible are compared with ClusterCuller::cull on the CPU, any
+// difference fails the run. Meshlets within kCullTolerance of a plane or cone boundary are only
+// reported, the GPU may round differently there. Independently of either culler every triangle of a
+// meshlet the GPU culled is tested on its own: one inside the frustum and facing the camera fails
+// the run.
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "glm/gtc/constants.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "EntityComponent/FrameState.h"
+#include "EntityComponent/Meshlet.h"
+#include "GFX/vulkan/GfxDevice.h"
+#include "GFX/vulkan/GpuProfiler.h"
+#include "GFX/vulkan/RenderGraph.h"
+#include "GFX/vulkan/TextureStreamer.h"
+#include "Utils/Hash.h"
+#include "Utils/Log.h"
+
+namespace {
+constexpr uint32_t kChecksumFrames = 4;
+constexpr uint32_t kSettleFrames = 600;
+constexpr uint32_t kClusterCheckFrames = 8;
+constexpr float kCullTolerance = 1e-4f;
+
+FrameState orbitCamera(uint64_t tick, VkExtent2D size)
+{
+    // One turn every 240 frames, independent of the frame rate so checksummed frames repeat
+    const float angle = static_cast<float>(tick % 240) * (glm::two_pi<float>() / 240.0f);
+    FrameState state;
+    state.tick = tick;
+    state.view = glm::lookAt(glm::vec3(std::cos(angle) * 6.0f, 2.0f, std::sin(angle) * 6.0f), glm::vec3(0.0f),
+                             glm::vec3(0.0f, 1.0f, 0.0f));
+    state.projection = glm::perspective(glm::radians(45.0f),
+                                        static_cast<float>(size.width) / static_cast<float>(size.height), 0.1f,
+                                        100.0f);
+    return state;
+}
+
+void report(const char* name, std::vector<double> samples)
+{
+    if (samples.empty()) {
+        printf("%-8s %10s %10s %10s\n", name, "n/a", "n/a", "n/a");
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    const size_t p95 = std::min(samples.size() - 1, samples.size() * 95 / 100);
+    printf("%-8s %10.3f %10.3f %10.3f\n", name, samples[samples.size() / 2], samples[p95], samples.back());
+}
+
+// 8x8 spheres in the ground plane, most of them outside the frustum of the orbiting camera and
+// each with clusters facing away from it
+void makeSphereField(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    const uint32_t rings = 24;
+    const uint32_t segments = 48;
+    for (int z = 0; z < 8; z++) {
+        for (int x = 0; x < 8; x++) {
+            const glm::vec3 center(static_cast<float>(x) * 4.0f - 14.0f, 0.0f, static_cast<float>(z) * 4.0f - 14.0f);
+            const auto first = static_cast<uint32_t>(vertices.size());
+            for (uint32_t ring = 0; ring <= rings; ring++) {
+                const float polar = static_cast<float>(ring) * glm::pi<float>() / rings;
+                for (uint32_t segment = 0; segment <= segments; segment++) {
+                    const float azimuth = static_cast<float>(segment) * glm::two_pi<float>() / segments;
+                    const glm::vec3 normal(std::sin(polar) * std::cos(azimuth), std::cos(polar),
+                                           std::sin(polar) * std::sin(azimuth));
+                    vertices.push_back({ center + normal, normal * 0.5f + 0.5f,
+                                         glm::vec2(static_cast<float>(segment) / segments,
+                                                   static_cast<float>(ring) / rings) });
+                }
+            }
+            for (uint32_t ring = 0; ring < rings; ring++) {
+                for (uint32_t segment = 0; segment < segments; segment++) {
+                    const uint32_t a = first + ring * (segments + 1) + segment;
+                    const uint32_t b = a + segments + 1;
+                    indices.insert(indices.end(), { a, a + 1, b, a + 1, b + 1, b });
+                }
+            }
+        }
+    }
+}
+
+// Distance of the meshlet to the closest decision of ClusterCuller::isVisible
+float cullMargin(const Meshlet& meshlet, const glm::vec4 planes[6], const glm::vec3& cameraPosition)
+{
+    float margin = std::numeric_limits<float>::max();
+    for (int i = 0; i < 6; i++) {
+        margin = std::min(margin, std::abs(glm::dot(glm::vec3(planes[i]), meshlet.center) + planes[i].w +
+                                           meshlet.radius));
+    }
+    if (meshlet.coneCutoff < 1.0f) {
+        const glm::vec3 toApex = glm::normalize(meshlet.coneApex - cameraPosition);
+        margin = std::min(margin, std::abs(glm::dot(toApex, meshlet.coneAxis) - meshlet.coneCutoff));
+    }
+    return margin;
+}
+
+// Brute force reference for a culled meshlet: true when one of its triangles lies inside every
+// plane and faces the camera, each by more than kCullTolerance. Object space, like the planes.
+bool hasVisibleTriangle(const Meshlet& meshlet, const std::vector<Vertex>& vertices,
+                        const std::vector<uint32_t>& indices, const glm::vec4 planes[6],
+                        const glm::vec3& cameraPosition)
+{
+    for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3) {
+        const glm::vec3 p[3] = { vertices[indices[i]].position, vertices[indices[i + 1]].position,
+                                 vertices[indices[i + 2]].position };
+        bool inside = true;
+        for (int plane = 0; plane < 6 && inside; plane++) {
+            float distance = -std::numeric_limits<float>::max();
+            for (const glm::vec3& corner : p) {
+                distance = std::max(distance, glm::dot(glm::vec3(planes[plane]), corner) + planes[plane].w);
+            }
+            inside = distance > kCullTolerance;
+        }
+        const glm::vec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+        const glm::vec3 toTriangle = p[0] - cameraPosition;
+        if (inside && glm::length(normal) > 0.0f && glm::length(toTriangle) > 0.0f &&
+            glm::dot(glm::normalize(toTriangle), glm::normalize(normal)) < -kCullTolerance) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Culls the cluster mesh on the GPU and the CPU from several camera positions, false on any
+// difference beyond kCullTolerance or any visible triangle the GPU culled
+bool checkClusterCulling(GfxDevice& device, VkExtent2D size, uint32_t mesh, const std::vector<Vertex>& vertices,
+                         const glm::mat4& model)
+{
+    const std::vector<uint32_t> indices = device.getClusterIndices(mesh);
+
+    bool passed = true;
+    std::vector<DrawIndexedCommand> cpuDraws;
+    for (uint32_t frame = 0; frame < kClusterCheckFrames; frame++) {
+        const FrameState state = orbitCamera(frame * 240 / kClusterCheckFrames, size);
+        device.setFrameState(state);
+        device.draw();
+        const std::vector<DrawIndexedCommand> gpuDraws = device.readClusterDraws(mesh);
+        // Of the level this frame drew, with LODs it changes with the camera
+        const std::vector<Meshlet> meshlets = device.getClusterMeshlets(mesh);
+
+        const glm::mat4 viewProjection = state.projection * state.view;
+        const glm::vec3 cameraPosition = glm::vec3(glm::inverse(state.view)[3]);
+        cpuDraws.clear();
+        ClusterCuller::cull(meshlets, viewProjection, model, cameraPosition, 0, cpuDraws);
+        glm::vec4 planes[6];
+        ClusterCuller::extractFrustumPlanes(viewProjection * model, planes);
+        const glm::vec3 localCamera = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.0f));
+
+        // The CPU merges adjacent visible meshlets, a meshlet is visible when a draw covers it
+        uint32_t visible = 0, mismatches = 0, borderline = 0;
+        size_t draw = 0;
+        for (size_t i = 0; i < meshlets.size(); i++) {
+            const Meshlet& meshlet = meshlets[i];
+            while (draw < cpuDraws.size() && cpuDraws[draw].firstIndex + cpuDraws[draw].indexCount <= meshlet.firstIndex) {
+                draw++;
+            }
+            const bool cpuVisible = draw < cpuDraws.size() && cpuDraws[draw].firstIndex <= meshlet.firstIndex;
+            const DrawIndexedCommand& gpu = gpuDraws[i];
+            if (gpu.firstIndex != meshlet.firstIndex || gpu.indexCount != meshlet.indexCount) {
+                fprintf(stderr, "frame %u meshlet %zu: GPU draws indices %u+%u, meshlet has %u+%u\n", frame, i,
+                        gpu.firstIndex, gpu.indexCount, meshlet.firstIndex, meshlet.indexCount);
+                mismatches++;
+                continue;
+            }
+            visible += gpu.instanceCount != 0 ? 1 : 0;
+            if (gpu.instanceCount == 0 && hasVisibleTriangle(meshlet, vertices, indices, planes, localCamera)) {
+                fprintf(stderr, "frame %u meshlet %zu: culled on the GPU with a visible triangle\n", frame, i);
+                mismatches++;
+                continue;
+            }
+            if ((gpu.instanceCount != 0) == cpuVisible) {
+                continue;
+            }
+            if (cullMargin(meshlet, planes, localCamera) < kCullTolerance) {
+                borderline++;
+            } else {
+                fprintf(stderr, "frame %u meshlet %zu: %s on the GPU, %s on the CPU\n", frame, i,
+                        gpu.instanceCount != 0 ? "visible" : "culled", cpuVisible ? "visible" : "culled");
+                mismatches++;
+            }
+        }
+        printf("cluster check %u: %u of %zu meshlets visible, %u mismatches, %u borderline\n", frame, visible,
+               meshlets.size(), mismatches, borderline);
+        passed = passed && mismatches == 0;
+    }
+    return passed;
+}
+
+// Compiles a small deferred frame with a compute post chain, pure CPU, and checks what compile()
+// made of it: the unread debug pass culled, lighting merged into the g-buffer render pass as a
+// second subpass, the barriers around the compute passes and the transient textures sharing memory
+bool checkRenderGraph()
+{
+    const RGTextureDesc color = { VK_FORMAT_R8G8B8A8_UNORM, 256, 256, VK_SAMPLE_COUNT_1_BIT };
+    const RGTextureDesc depthDesc = { VK_FORMAT_D32_SFLOAT, 256, 256, VK_SAMPLE_COUNT_1_BIT };
+    auto noop = [](VkCommandBuffer) {};
+
+    RenderGraph graph;
+    const uint32_t backbuffer = graph.importTexture("backbuffer", color, VK_IMAGE_LAYOUT_UNDEFINED,
+                                                    VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    graph.markOutput(backbuffer);
+    const uint32_t albedo = graph.createTexture("albedo", color);
+    const uint32_t depth = graph.createTexture("depth", depthDesc);
+    const uint32_t lit = graph.createTexture("lit", color);
+    const uint32_t blurred = graph.createTexture("blurred", color);
+    const uint32_t sharpened = graph.createTexture("sharpened", color);
+    const uint32_t debug = graph.createTexture("debug", color);
+
+    const uint32_t gbuffer = graph.addPass("gbuffer", noop);
+    graph.writeColor(gbuffer, albedo, true);
+    graph.writeDepth(gbuffer, depth, true);
+    const uint32_t lighting = graph.addPass("lighting", noop);
+    graph.readAttachment(lighting, albedo);
+    graph.readDepth(lighting, depth);
+    graph.writeColor(lighting, lit, true);
+    const uint32_t debugView = graph.addPass("debug", noop);
+    graph.writeColor(debugView, debug, true);
+    const uint32_t blur = graph.addComputePass("blur", noop);
+    graph.readTexture(blur, lit, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    graph.writeStorage(blur, blurred);
+    const uint32_t sharpen = graph.addComputePass("sharpen", noop);
+    graph.readStorage(sharpen, blurred);
+    graph.writeStorage(sharpen, sharpened);
+    const uint32_t composite = graph.addPass("composite", noop);
+    graph.readTexture(composite, sharpened);
+    graph.writeColor(composite, backbuffer, true);
+    graph.compile();
+
+    // blurred and sharpened: UNDEFINED -> GENERAL each, blurred write -> read, sharpened -> sampled
+    constexpr uint32_t kExpectedBarriers = 4;
+    const RenderGraphStats& stats = graph.getStats();
+    bool passed = true;
+    auto expect = [&passed](bool condition, const char* what) {
+        if (!condition) {
+            fprintf(stderr, "render graph: %s\n", what);
+            passed = false;
+        }
+    };
+    expect(graph.isCulled(debugView) && stats.culledPasses == 1, "only the unread debug pass should be culled");
+    expect(graph.getSubpass(lighting) == 1 && stats.renderPasses == 2 && stats.subpasses == 3,
+           "lighting should merge into the g-buffer render pass");
+    expect(stats.barriers == kExpectedBarriers, "unexpected barrier count around the compute passes");
+    expect(stats.aliasSlots < stats.transientTextures && stats.aliasedBytes < stats.transientBytes,
+           "transient textures with disjoint lifetimes should share memory");
+    printf("render graph: %u passes, %u culled, %u render passes, %u subpasses, %u barriers, "
+           "%u transient textures in %u memory blocks\n", stats.passes, stats.culledPasses, stats.renderPasses,
+           stats.subpasses, stats.barriers, stats.transientTextures, stats.aliasSlots);
+    if (!passed) {
+        fprintf(stderr, "%s", graph.dump().c_str());
+    }
+    return passed;
+}
+
+std::vector<uint64_t> readChecksums(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error(path + ": can't open");
+    }
+    std::vector<uint64_t> checksums;
+    uint32_t frame = 0;
+    std::string hash;
+    while (file >> frame >> hash) {
+        checksums.resize(std::max<size_t>(checksums.size(), frame + 1));
+        checksums[frame] = std::stoull(hash, nullptr, 16);
+    }
+    return checksums;
+}
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t frames = 300;
+    uint32_t warmup = 30;
+    DeviceConfig config;
+    config.headless = true;
+    config.physicalDeviceName = "llvmpipe";
+    std::string assets;
+    std::string checksumsPath;
+    std::string expectPath;
+    uint32_t recordDraws = 5000;
+    std::string texturePath;
+    bool clusterCheck = false;
+    uint32_t graphPasses = 64;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc) {
+            frames = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+        } else if (arg == "--warmup" && i + 1 < argc) {
+            warmup = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--width" && i + 1 < argc) {
+            config.headlessExtent.width = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+        } else if (arg == "--height" && i + 1 < argc) {
+            config.headlessExtent.height = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+        } else if (arg == "--msaa" && i + 1 < argc) {
+            config.msaaSamples = static_cast<VkSampleCountFlagBits>(std::stoul(argv[++i]));
+        } else if (arg == "--device" && i + 1 < argc) {
+            config.physicalDeviceName = argv[++i];
+        } else if (arg == "--assets" && i + 1 < argc) {
+            assets = argv[++i];
+        } else if (arg == "--checksums" && i + 1 < argc) {
+            checksumsPath = argv[++i];
+        } else if (arg == "--expect" && i + 1 < argc) {
+            expectPath = argv[++i];
+        } else if (arg == "--draws" && i + 1 < argc) {
+            recordDraws = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--texture" && i + 1 < argc) {
+            texturePath = argv[++i];
+        } else if (arg == "--graph-passes" && i + 1 < argc) {
+            graphPasses = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--cluster-check") {
+            clusterCheck = true;
+        } else {
+            fprintf(stderr, "usage: render_benchmark [--frames n] [--warmup n] [--width w] [--height h] "
+                            "[--msaa 1|2|4] [--device name] [--assets dir] [--checksums file] [--expect file] "
+                            "[--draws n] [--graph-passes n] [--texture file] [--cluster-check]\n");
+            return 1;
+        }
+    }
+    // Device setup is chatty, the results go to stdout
+    Logger::setLevel(LogLevel::Warning);
+
+    bool mismatch = false;
+    // Pure CPU, no device needed
+    if (!checkRenderGraph()) {
+        fprintf(stderr, "RenderGraph::compile did not cull, merge, synchronize or alias as expected\n");
+        mismatch = true;
+    }
+    if (graphPasses > 0) {
+        // The synthetic frame adds a composite pass
+        const BenchmarkResult result = RenderGraph::benchmarkCompile(graphPasses - 1, 200);
+        printf("%s: median %.4f ms, max %.4f ms\n", result.name.c_str(), result.medianMs, result.maxMs);
+    }
+
+    try {
+        if (!assets.empty()) {
+            // Output paths stay relative to where the benchmark was started
+            checksumsPath = checksumsPath.empty() ? checksumsPath : std::filesystem::absolute(checksumsPath).string();
+            expectPath = expectPath.empty() ? expectPath : std::filesystem::absolute(expectPath).string();
+            texturePath = texturePath.empty() ? texturePath : std::filesystem::absolute(texturePath).string();
+            std::filesystem::current_path(assets);
+        }
+        // The default is one of the APK assets, next to the shaders
+        texturePath = texturePath.empty() ? "android_robot.ktx2" : texturePath;
+        GfxDevice device(config);
+        device.init();
+        const VkExtent2D size = device.getDisplaySize();
+
+        // Everything below draws the sphere field
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        makeSphereField(vertices, indices);
+        const glm::mat4 model(1.0f);
+        const uint32_t sphereField = device.addClusterMesh(vertices, indices, model);
+        const uint32_t texture = device.getTextureStreamer().addTexture(texturePath);
+        if (texture != TextureResidency::kInvalid) {
+            device.setClusterStreamedTexture(sphereField, texture);
+        } else {
+            fprintf(stderr, "%s not streamed, the spheres are drawn untextured\n", texturePath.c_str());
+        }
+
+        for (uint32_t i = 0; i < warmup; i++) {
+            device.setFrameState(orbitCamera(i, size));
+            device.draw();
+        }
+
+        std::vector<double> waitMs, recordMs, submitMs, gpuMs;
+        uint64_t gpuFrame = device.getGpuFrameStats().frame;
+        const auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < frames; i++) {
+            device.setFrameState(orbitCamera(warmup + i, size));
+            device.draw();
+            const CpuFrameStats& cpu = device.getCpuFrameStats();
+            waitMs.push_back(cpu.waitMs);
+            recordMs.push_back(cpu.recordMs);
+            submitMs.push_back(cpu.submitMs);
+            // Results trail the CPU by a few frames, take each one once
+            const GpuFrameStats& gpu = device.getGpuFrameStats();
+            if (gpu.frame != gpuFrame && gpu.gpuMs > 0.0) {
+                gpuMs.push_back(gpu.gpuMs);
+                gpuFrame = gpu.frame;
+            }
+        }
+        // Everything submitted has finished once the first readback returns
+        std::vector<uint8_t> texels = device.readbackFrame();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        printf("%ux%u, MSAA %u requested, %u frames after %u warm-up, %.1f frames/s\n", size.width, size.height,
+               static_cast<unsigned>(config.msaaSamples), frames, warmup, frames / seconds);
+        printf("%-8s %10s %10s %10s\n", "ms", "median", "p95", "max");
+        report("wait", waitMs);
+        report("record", recordMs);
+        report("submit", submitMs);
+        report("gpu", gpuMs);
+
+        if (recordDraws > 0) {
+            const uint32_t maxThreads = device.getMaxRecordThreads();
+            std::vector<uint32_t> threadCounts;
+            for (uint32_t threads = 1; threads < maxThreads; threads *= 2) {
+                threadCounts.push_back(threads);
+            }
+            threadCounts.push_back(maxThreads);
+
+            printf("%-8s %10s %10s %9s\n", "threads", "ms", "draws/ms", "speedup");
+            const std::vector<BenchmarkResult> results = device.benchmarkRecording(recordDraws, threadCounts, 50);
+            for (size_t i = 0; i < results.size(); i++) {
+                printf("%-8u %10.3f %10.1f %8.2fx\n", threadCounts[i], results[i].medianMs,
+                       recordDraws / results[i].medianMs, results.front().medianMs / results[i].medianMs);
+            }
+        }
+
+        uint32_t settleFrames = 0;
+        for (; settleFrames < kSettleFrames; settleFrames++) {
+            const TextureStreamingStats& streaming = device.getTextureStreamingStats();
+            if (streaming.pendingRequests == 0 && streaming.loadsInFlight == 0) {
+                break;
+            }
+            device.setFrameState(orbitCamera(0, size));
+            device.draw();
+        }
+        const TextureStreamingStats& streaming = device.getTextureStreamingStats();
+        printf("streaming: %u textures, %" PRIu64 " of %" PRIu64 " KiB resident, %u pending after %u frames\n",
+               streaming.textures, streaming.residentBytes >> 10, streaming.budgetBytes >> 10,
+               streaming.pendingRequests, settleFrames);
+
+        std::vector<uint64_t> checksums;
+        for (uint32_t i = 0; i < kChecksumFrames; i++) {
+            device.setFrameState(orbitCamera(i * 240 / kChecksumFrames, size));
+            device.draw();
+            texels = device.readbackFrame();
+            checksums.push_back(Hasher().data(texels.data(), texels.size()).get());
+            printf("checksum %u %016" PRIx64 "\n", i, checksums.back());
+        }
+        if (clusterCheck && !checkClusterCulling(device, size, sphereField, vertices, model)) {
+            fprintf(stderr, "GPU cluster culling differs from ClusterCuller::cull\n");
+            mismatch = true;
+        }
+        device.deInit();
+
+        if (!checksumsPath.empty()) {
+            std::ofstream file(checksumsPath);
+            for (uint32_t i = 0; i < kChecksumFrames; i++) {
+                file << i << ' ' << std::hex << checksums[i] << std::dec << '\n';
+            }
+            if (!file) {
+                throw std::runtime_error(checksumsPath + ": write failed");
+            }
+        }
+        if (!expectPath.empty()) {
+            const std::vector<uint64_t> expected = readChecksums(expectPath);
+            for (uint32_t i = 0; i < kChecksumFrames; i++) {
+                if (i >= expected.size() || expected[i] != checksums[i]) {
+                    fprintf(stderr, "frame %u differs from %s\n", i, expectPath.c_str());
+                    mismatch = true;
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        Logger::get().flush();
+        return 1;
+    }
+    Logger::get().flush();
+    return mismatch ? 1 : 0;
+}
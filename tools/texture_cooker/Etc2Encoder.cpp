@@ -0,0 +1,413 @@
+#include <algorithm>
+#include <climits>
+
+#include "Etc2Encoder.h"
+
+namespace {
+// Intensity modifier pairs, a texel index picks +small, +large, -small or -large
+const int kColorTables[8][2] = {
+    {2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183},
+};
+
+const int kAlphaTables[16][8] = {
+    {-3, -6, -9, -15, 2, 5, 8, 14},
+    {-3, -7, -10, -13, 2, 6, 9, 12},
+    {-2, -5, -8, -13, 1, 4, 7, 12},
+    {-2, -4, -6, -13, 1, 3, 5, 12},
+    {-3, -6, -8, -12, 2, 5, 7, 11},
+    {-3, -7, -9, -11, 2, 6, 8, 10},
+    {-4, -7, -8, -11, 3, 6, 7, 10},
+    {-3, -5, -8, -11, 2, 4, 7, 10},
+    {-2, -6, -8, -10, 1, 5, 7, 9},
+    {-2, -5, -8, -10, 1, 4, 7, 9},
+    {-2, -4, -8, -10, 1, 3, 7, 9},
+    {-2, -5, -7, -10, 1, 4, 6, 9},
+    {-3, -4, -7, -10, 2, 3, 6, 9},
+    {-1, -2, -3, -10, 0, 1, 2, 9},
+    {-4, -6, -8, -9, 3, 5, 7, 8},
+    {-3, -5, -7, -9, 2, 4, 6, 8},
+};
+// Table and index of a zero modifier, for blocks of a single alpha value
+constexpr int kExactAlphaTable = 13;
+constexpr int kExactAlphaIndex = 4;
+
+int clamp255(int value)
+{
+    return std::min(std::max(value, 0), 255);
+}
+
+int colorModifier(int table, int index)
+{
+    const int magnitude = kColorTables[table][index & 1];
+    return (index & 2) ? -magnitude : magnitude;
+}
+
+int expand4(int value)
+{
+    return value * 17;
+}
+
+int expand5(int value)
+{
+    return (value << 3) | (value >> 2);
+}
+
+// Texel positions (y * 4 + x) of a sub block, flipped blocks split into top and bottom halves
+void getSubBlock(bool flip, int subBlock, int positions[8])
+{
+    int count = 0;
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            if ((flip ? y / 2 : x / 2) == subBlock) {
+                positions[count++] = y * 4 + x;
+            }
+        }
+    }
+}
+
+struct SubBlockFit {
+    uint32_t error{UINT_MAX};
+    int table{0};
+    int indices[8]{};
+};
+
+// Best table and texel indices for a base color, the base is already expanded to 8 bits
+SubBlockFit fitSubBlock(const uint8_t* texels, const int positions[8], const int base[3])
+{
+    SubBlockFit best;
+    for (int table = 0; table < 8; table++) {
+        SubBlockFit fit;
+        fit.table = table;
+        fit.error = 0;
+        for (int i = 0; i < 8 && fit.error < best.error; i++) {
+            const uint8_t* texel = texels + positions[i] * 4;
+            uint32_t bestError = UINT_MAX;
+            for (int index = 0; index < 4; index++) {
+                const int modifier = colorModifier(table, index);
+                uint32_t error = 0;
+                for (int c = 0; c < 3; c++) {
+                    const int delta = clamp255(base[c] + modifier) - texel[c];
+                    error += delta * delta;
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    fit.indices[i] = index;
+                }
+            }
+            fit.error += bestError;
+        }
+        if (fit.error < best.error) {
+            best = fit;
+        }
+    }
+    return best;
+}
+
+void getAverage(const uint8_t* texels, const int positions[8], int average[3])
+{
+    for (int c = 0; c < 3; c++) {
+        int sum = 0;
+        for (int i = 0; i < 8; i++) {
+            sum += texels[positions[i] * 4 + c];
+        }
+        average[c] = (sum + 4) / 8;
+    }
+}
+
+// The quantized average and its neighbours along the gray axis, modifiers shift all channels alike
+template <typename Expand>
+SubBlockFit fitQuantized(const uint8_t* texels, const int positions[8], const int quantized[3], int maxValue,
+                         Expand expand, int chosen[3])
+{
+    SubBlockFit best;
+    for (int shift = -1; shift <= 1; shift++) {
+        int candidate[3];
+        int base[3];
+        for (int c = 0; c < 3; c++) {
+            candidate[c] = std::min(std::max(quantized[c] + shift, 0), maxValue);
+            base[c] = expand(candidate[c]);
+        }
+        SubBlockFit fit = fitSubBlock(texels, positions, base);
+        if (fit.error < best.error) {
+            best = fit;
+            std::copy(candidate, candidate + 3, chosen);
+        }
+    }
+    return best;
+}
+
+struct ColorBlock {
+    uint32_t error{UINT_MAX};
+    uint64_t bits{0};
+};
+
+uint64_t packIndices(bool flip, const SubBlockFit fits[2])
+{
+    uint64_t bits = 0;
+    for (int subBlock = 0; subBlock < 2; subBlock++) {
+        int positions[8];
+        getSubBlock(flip, subBlock, positions);
+        for (int i = 0; i < 8; i++) {
+            const int x = positions[i] % 4;
+            const int y = positions[i] / 4;
+            // Texels are numbered column major
+            const int bit = x * 4 + y;
+            const int index = fits[subBlock].indices[i];
+            bits |= uint64_t(index >> 1) << (16 + bit);
+            bits |= uint64_t(index & 1) << bit;
+        }
+    }
+    return bits;
+}
+
+ColorBlock encodeSplit(const uint8_t* texels, bool flip)
+{
+    int positions[2][8];
+    int average[2][3];
+    for (int subBlock = 0; subBlock < 2; subBlock++) {
+        getSubBlock(flip, subBlock, positions[subBlock]);
+        getAverage(texels, positions[subBlock], average[subBlock]);
+    }
+    const uint64_t flipBit = uint64_t(flip) << 32;
+
+    // Individual mode: two 4 bit base colors
+    ColorBlock best;
+    {
+        SubBlockFit fits[2];
+        int chosen[2][3];
+        for (int subBlock = 0; subBlock < 2; subBlock++) {
+            int quantized[3];
+            for (int c = 0; c < 3; c++) {
+                quantized[c] = (average[subBlock][c] * 15 + 127) / 255;
+            }
+            fits[subBlock] = fitQuantized(texels, positions[subBlock], quantized, 15, expand4, chosen[subBlock]);
+        }
+        best.error = fits[0].error + fits[1].error;
+        best.bits = uint64_t(chosen[0][0]) << 60 | uint64_t(chosen[1][0]) << 56 |
+                    uint64_t(chosen[0][1]) << 52 | uint64_t(chosen[1][1]) << 48 |
+                    uint64_t(chosen[0][2]) << 44 | uint64_t(chosen[1][2]) << 40 |
+                    uint64_t(fits[0].table) << 37 | uint64_t(fits[1].table) << 34 |
+                    flipBit | packIndices(flip, fits);
+    }
+
+    // Differential mode: a 5 bit base color and a 3 bit signed offset for the second sub block.
+    // Offsets are clamped rather than leaving the mode, sums outside 0..31 would select T or H mode.
+    {
+        SubBlockFit fits[2];
+        int first[3];
+        int quantized[3];
+        for (int c = 0; c < 3; c++) {
+            quantized[c] = (average[0][c] * 31 + 127) / 255;
+        }
+        fits[0] = fitQuantized(texels, positions[0], quantized, 31, expand5, first);
+        int second[3];
+        int base[3];
+        for (int c = 0; c < 3; c++) {
+            const int target = (average[1][c] * 31 + 127) / 255;
+            second[c] = std::min(std::max(target, first[c] - 4), first[c] + 3);
+            second[c] = std::min(std::max(second[c], 0), 31);
+            base[c] = expand5(second[c]);
+        }
+        fits[1] = fitSubBlock(texels, positions[1], base);
+        const uint32_t error = fits[0].error + fits[1].error;
+        if (error < best.error) {
+            best.error = error;
+            best.bits = uint64_t(first[0]) << 59 | uint64_t((second[0] - first[0]) & 7) << 56 |
+                        uint64_t(first[1]) << 51 | uint64_t((second[1] - first[1]) & 7) << 48 |
+                        uint64_t(first[2]) << 43 | uint64_t((second[2] - first[2]) & 7) << 40 |
+                        uint64_t(fits[0].table) << 37 | uint64_t(fits[1].table) << 34 |
+                        uint64_t(1) << 33 | flipBit | packIndices(flip, fits);
+        }
+    }
+    return best;
+}
+
+void storeBigEndian(uint64_t bits, uint8_t out[8])
+{
+    for (int i = 0; i < 8; i++) {
+        out[i] = uint8_t(bits >> (56 - i * 8));
+    }
+}
+
+uint64_t loadBigEndian(const uint8_t block[8])
+{
+    uint64_t bits = 0;
+    for (int i = 0; i < 8; i++) {
+        bits = bits << 8 | block[i];
+    }
+    return bits;
+}
+
+void gatherBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY,
+                 uint8_t texels[64])
+{
+    for (uint32_t y = 0; y < 4; y++) {
+        const uint32_t sourceY = std::min(blockY * 4 + y, height - 1);
+        for (uint32_t x = 0; x < 4; x++) {
+            const uint32_t sourceX = std::min(blockX * 4 + x, width - 1);
+            std::copy_n(rgba + (size_t(sourceY) * width + sourceX) * 4, 4, texels + (y * 4 + x) * 4);
+        }
+    }
+}
+}
+
+void Etc2Encoder::encodeColorBlock(const uint8_t texels[64], uint8_t out[8])
+{
+    ColorBlock best = encodeSplit(texels, false);
+    ColorBlock flipped = encodeSplit(texels, true);
+    storeBigEndian(flipped.error < best.error ? flipped.bits : best.bits, out);
+}
+
+void Etc2Encoder::encodeAlphaBlock(const uint8_t texels[64], uint8_t out[8])
+{
+    int minAlpha = 255;
+    int maxAlpha = 0;
+    for (int i = 0; i < 16; i++) {
+        minAlpha = std::min<int>(minAlpha, texels[i * 4 + 3]);
+        maxAlpha = std::max<int>(maxAlpha, texels[i * 4 + 3]);
+    }
+
+    int bestBase = minAlpha;
+    int bestMultiplier = 1;
+    int bestTable = kExactAlphaTable;
+    int bestIndices[16];
+    std::fill(bestIndices, bestIndices + 16, kExactAlphaIndex);
+
+    if (minAlpha != maxAlpha) {
+        uint32_t bestError = UINT_MAX;
+        for (int table = 0; table < 16 && bestError > 0; table++) {
+            const int* modifiers = kAlphaTables[table];
+            const int low = *std::min_element(modifiers, modifiers + 8);
+            const int high = *std::max_element(modifiers, modifiers + 8);
+            for (int multiplier = 1; multiplier < 16; multiplier++) {
+                // Center the table's range on the block's range
+                const int center = ((minAlpha + maxAlpha) - multiplier * (low + high)) / 2;
+                for (int base = std::max(center - 1, 0); base <= std::min(center + 1, 255); base++) {
+                    uint32_t error = 0;
+                    int indices[16];
+                    for (int i = 0; i < 16 && error < bestError; i++) {
+                        uint32_t texelError = UINT_MAX;
+                        for (int index = 0; index < 8; index++) {
+                            const int delta = clamp255(base + modifiers[index] * multiplier) - texels[i * 4 + 3];
+                            if (uint32_t(delta * delta) < texelError) {
+                                texelError = delta * delta;
+                                indices[i] = index;
+                            }
+                        }
+                        error += texelError;
+                    }
+                    if (error < bestError) {
+                        bestError = error;
+                        bestBase = base;
+                        bestMultiplier = multiplier;
+                        bestTable = table;
+                        std::copy(indices, indices + 16, bestIndices);
+                    }
+                }
+            }
+        }
+    }
+
+    uint64_t bits = uint64_t(bestBase) << 56 | uint64_t(bestMultiplier) << 52 | uint64_t(bestTable) << 48;
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            bits |= uint64_t(bestIndices[y * 4 + x]) << (45 - 3 * (x * 4 + y));
+        }
+    }
+    storeBigEndian(bits, out);
+}
+
+void Etc2Encoder::decodeColorBlock(const uint8_t block[8], uint8_t texels[64])
+{
+    const uint64_t bits = loadBigEndian(block);
+    const bool flip = (bits >> 32) & 1;
+    int base[2][3];
+    for (int c = 0; c < 3; c++) {
+        const int shift = 59 - c * 8;
+        if ((bits >> 33) & 1) {
+            const int first = int(bits >> shift) & 31;
+            int delta = int(bits >> (shift - 3)) & 7;
+            delta = delta >= 4 ? delta - 8 : delta;
+            base[0][c] = expand5(first);
+            base[1][c] = expand5(first + delta);
+        } else {
+            base[0][c] = expand4(int(bits >> (shift + 1)) & 15);
+            base[1][c] = expand4(int(bits >> (shift - 3)) & 15);
+        }
+    }
+    const int tables[2] = {int(bits >> 37) & 7, int(bits >> 34) & 7};
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            const int subBlock = flip ? y / 2 : x / 2;
+            const int bit = x * 4 + y;
+            const int index = int((bits >> (16 + bit)) & 1) << 1 | int((bits >> bit) & 1);
+            const int modifier = colorModifier(tables[subBlock], index);
+            for (int c = 0; c < 3; c++) {
+                texels[(y * 4 + x) * 4 + c] = uint8_t(clamp255(base[subBlock][c] + modifier));
+            }
+        }
+    }
+}
+
+void Etc2Encoder::decodeAlphaBlock(const uint8_t block[8], uint8_t texels[64])
+{
+    const uint64_t bits = loadBigEndian(block);
+    const int base = int(bits >> 56) & 255;
+    const int multiplier = int(bits >> 52) & 15;
+    const int* modifiers = kAlphaTables[(bits >> 48) & 15];
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            const int index = int(bits >> (45 - 3 * (x * 4 + y))) & 7;
+            texels[(y * 4 + x) * 4 + 3] = uint8_t(clamp255(base + modifiers[index] * multiplier));
+        }
+    }
+}
+
+std::vector<uint8_t> Etc2Encoder::encodeImage(const uint8_t* rgba, uint32_t width, uint32_t height, bool withAlpha)
+{
+    const uint32_t blocksX = (width + 3) / 4;
+    const uint32_t blocksY = (height + 3) / 4;
+    const size_t blockSize = withAlpha ? 16 : 8;
+    std::vector<uint8_t> out(size_t(blocksX) * blocksY * blockSize);
+    uint8_t texels[64];
+    for (uint32_t blockY = 0; blockY < blocksY; blockY++) {
+        for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+            gatherBlock(rgba, width, height, blockX, blockY, texels);
+            uint8_t* block = out.data() + (size_t(blockY) * blocksX + blockX) * blockSize;
+            // The alpha block comes first
+            if (withAlpha) {
+                encodeAlphaBlock(texels, block);
+                block += 8;
+            }
+            encodeColorBlock(texels, block);
+        }
+    }
+    return out;
+}
+
+std::vector<uint8_t> Etc2Encoder::decodeImage(const uint8_t* blocks, uint32_t width, uint32_t height, bool withAlpha)
+{
+    const uint32_t blocksX = (width + 3) / 4;
+    const uint32_t blocksY = (height + 3) / 4;
+    const size_t blockSize = withAlpha ? 16 : 8;
+    std::vector<uint8_t> rgba(size_t(width) * height * 4);
+    uint8_t texels[64];
+    for (uint32_t blockY = 0; blockY < blocksY; blockY++) {
+        for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+            const uint8_t* block = blocks + (size_t(blockY) * blocksX + blockX) * blockSize;
+            std::fill(texels, texels + 64, 255);
+            if (withAlpha) {
+                decodeAlphaBlock(block, texels);
+                block += 8;
+            }
+            decodeColorBlock(block, texels);
+            for (uint32_t y = 0; y < 4 && blockY * 4 + y < height; y++) {
+                for (uint32_t x = 0; x < 4 && blockX * 4 + x < width; x++) {
+                    std::copy_n(texels + (y * 4 + x) * 4, 4,
+                                rgba.data() + ((size_t(blockY) * 4 + y) * width + blockX * 4 + x) * 4);
+                }
+            }
+        }
+    }
+    return rgba;
+}
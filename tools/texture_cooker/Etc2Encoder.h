@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// ETC2 encoder for the texture cooker. Color blocks use the individual and differential modes
+// shared with ETC1, picking the better split (2x4 or 4x2) and intensity table per sub block.
+// The T, H and planar modes ETC2 added are never emitted, decoders handle the result either way,
+// it only costs quality on blocks with two distinct colors or smooth gradients.
+// Alpha goes into an EAC block searched over all tables and multipliers.
+//
+// Blocks are 4x4 RGBA8 texels, row major. Edge blocks of images that aren't a multiple of 4
+// repeat the last row / column.
+class Etc2Encoder {
+public:
+    // 8 bytes, VK_FORMAT_ETC2_R8G8B8_*_BLOCK
+    static void encodeColorBlock(const uint8_t texels[64], uint8_t out[8]);
+    // 8 bytes, the alpha half of VK_FORMAT_ETC2_R8G8B8A8_*_BLOCK
+    static void encodeAlphaBlock(const uint8_t texels[64], uint8_t out[8]);
+
+    // Only the modes encodeColorBlock writes, alpha is left alone
+    static void decodeColorBlock(const uint8_t block[8], uint8_t texels[64]);
+    static void decodeAlphaBlock(const uint8_t block[8], uint8_t texels[64]);
+
+    // A whole level, RGBA blocks when withAlpha and RGB blocks otherwise
+    static std::vector<uint8_t> encodeImage(const uint8_t* rgba, uint32_t width, uint32_t height, bool withAlpha);
+    // Back to RGBA8, alpha 255 for RGB blocks
+    static std::vector<uint8_t> decodeImage(const uint8_t* blocks, uint32_t width, uint32_t height, bool withAlpha);
+};
@@ -0,0 +1,386 @@
+#include <png.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define IMAGE_PIPELINE_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define IMAGE_PIPELINE_NEON 1
+#endif
+
+#include "ImagePipeline.h"
+
+namespace {
+// One RGBA texel per vector, both instruction sets are part of the baseline of their 64 bit ABI
+#if IMAGE_PIPELINE_SSE2
+using Float4 = __m128;
+inline Float4 zero4() { return _mm_setzero_ps(); }
+inline Float4 load4(const float* p) { return _mm_loadu_ps(p); }
+inline void store4(float* p, Float4 v) { _mm_storeu_ps(p, v); }
+inline Float4 madd4(Float4 acc, Float4 v, float w) { return _mm_add_ps(acc, _mm_mul_ps(v, _mm_set1_ps(w))); }
+#elif IMAGE_PIPELINE_NEON
+using Float4 = float32x4_t;
+inline Float4 zero4() { return vdupq_n_f32(0.0f); }
+inline Float4 load4(const float* p) { return vld1q_f32(p); }
+inline void store4(float* p, Float4 v) { vst1q_f32(p, v); }
+inline Float4 madd4(Float4 acc, Float4 v, float w) { return vmlaq_n_f32(acc, v, w); }
+#else
+struct Float4 {
+    float v[4];
+};
+inline Float4 zero4() { return {}; }
+inline Float4 load4(const float* p)
+{
+    Float4 r;
+    memcpy(r.v, p, sizeof(r.v));
+    return r;
+}
+inline void store4(float* p, Float4 v) { memcpy(p, v.v, sizeof(v.v)); }
+inline Float4 madd4(Float4 acc, Float4 v, float w)
+{
+    for (int i = 0; i < 4; i++) {
+        acc.v[i] += v.v[i] * w;
+    }
+    return acc;
+}
+#endif
+
+constexpr float kPi = 3.14159265358979f;
+constexpr float kKaiserWidth = 3.0f;
+constexpr float kKaiserAlpha = 4.0f;
+// Levels smaller than this many texels per thread aren't worth waking threads for
+constexpr uint32_t kMinTexelsPerThread = 16 * 1024;
+
+// Premultiplied linear RGBA
+struct LinearImage {
+    uint32_t width{0};
+    uint32_t height{0};
+    std::vector<float> texels;
+
+    LinearImage() = default;
+    LinearImage(uint32_t w, uint32_t h) : width(w), height(h), texels(size_t(w) * h * 4) {}
+    float* row(uint32_t y) { return texels.data() + size_t(y) * width * 4; }
+    const float* row(uint32_t y) const { return texels.data() + size_t(y) * width * 4; }
+};
+
+constexpr uint32_t kEncodeBuckets = 4096;
+
+struct ColorTables {
+    float srgbToLinear[256];
+    // Linear value from which code i + 1 is the nearest sRGB code, so encoding rounds exactly like
+    // the curve evaluated in full precision would. 256 entries, the last one never reached.
+    float srgbThresholds[256];
+    // Lowest code of each equal linear range, the thresholds finish from there in a step or two
+    uint8_t srgbBucketCodes[kEncodeBuckets];
+};
+
+float decodeSrgb(float v)
+{
+    return v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+}
+
+const ColorTables& getColorTables()
+{
+    static const ColorTables tables = [] {
+        ColorTables t;
+        for (int i = 0; i < 256; i++) {
+            t.srgbToLinear[i] = decodeSrgb(i / 255.0f);
+        }
+        for (int i = 0; i < 255; i++) {
+            t.srgbThresholds[i] = decodeSrgb((i + 0.5f) / 255.0f);
+        }
+        t.srgbThresholds[255] = 2.0f;
+        for (uint32_t i = 0; i < kEncodeBuckets; i++) {
+            const float bucketStart = float(i) / kEncodeBuckets;
+            t.srgbBucketCodes[i] = static_cast<uint8_t>(
+                std::upper_bound(t.srgbThresholds, t.srgbThresholds + 255, bucketStart) - t.srgbThresholds);
+        }
+        return t;
+    }();
+    return tables;
+}
+
+// linear in [0, 1]
+uint8_t encodeSrgb(const ColorTables& tables, float linear)
+{
+    const uint32_t bucket = std::min(static_cast<uint32_t>(linear * kEncodeBuckets), kEncodeBuckets - 1);
+    uint32_t code = tables.srgbBucketCodes[bucket];
+    while (linear >= tables.srgbThresholds[code]) {
+        code++;
+    }
+    return static_cast<uint8_t>(code);
+}
+
+uint8_t encodeUnorm(float value)
+{
+    return static_cast<uint8_t>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+}
+
+uint32_t getRowThreads(uint32_t width, uint32_t height, uint32_t threads)
+{
+    const uint64_t texels = uint64_t(width) * height;
+    return static_cast<uint32_t>(std::max<uint64_t>(1, std::min<uint64_t>(threads, texels / kMinTexelsPerThread)));
+}
+
+LinearImage toLinear(const Image& image, bool srgb, uint32_t threads)
+{
+    const ColorTables& tables = getColorTables();
+    LinearImage linear(image.width, image.height);
+    parallelFor(image.height, getRowThreads(image.width, image.height, threads), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t y = begin; y < end; y++) {
+            const uint8_t* source = image.rgba.data() + size_t(y) * image.width * 4;
+            float* out = linear.row(y);
+            for (uint32_t x = 0; x < image.width; x++, source += 4, out += 4) {
+                const float alpha = source[3] * (1.0f / 255.0f);
+                for (int c = 0; c < 3; c++) {
+                    out[c] = (srgb ? tables.srgbToLinear[source[c]] : source[c] * (1.0f / 255.0f)) * alpha;
+                }
+                out[3] = alpha;
+            }
+        }
+    });
+    return linear;
+}
+
+Image toBytes(const LinearImage& linear, const MipOptions& options, uint32_t threads)
+{
+    const ColorTables& tables = getColorTables();
+    Image image;
+    image.width = linear.width;
+    image.height = linear.height;
+    image.rgba.resize(size_t(linear.width) * linear.height * 4);
+    parallelFor(linear.height, getRowThreads(linear.width, linear.height, threads), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t y = begin; y < end; y++) {
+            const float* source = linear.row(y);
+            uint8_t* out = image.rgba.data() + size_t(y) * linear.width * 4;
+            for (uint32_t x = 0; x < linear.width; x++, source += 4, out += 4) {
+                const float alpha = std::min(std::max(source[3], 0.0f), 1.0f);
+                const float scale = options.premultiplyAlpha ? 1.0f : (alpha > 0.0f ? 1.0f / alpha : 0.0f);
+                for (int c = 0; c < 3; c++) {
+                    // Filter overshoot can leave a premultiplied color above its alpha
+                    const float value = std::min(std::min(std::max(source[c], 0.0f), alpha) * scale, 1.0f);
+                    out[c] = options.srgb ? encodeSrgb(tables, value) : encodeUnorm(value);
+                }
+                out[3] = encodeUnorm(alpha);
+            }
+        }
+    });
+    return image;
+}
+
+float besselI0(float x)
+{
+    // Power series, converges quickly for the arguments a Kaiser window uses
+    float sum = 1.0f;
+    float term = 1.0f;
+    const float halfSquared = x * x * 0.25f;
+    for (int k = 1; k < 32 && term > sum * 1e-8f; k++) {
+        term *= halfSquared / float(k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+float kaiserSinc(float t)
+{
+    if (std::fabs(t) >= kKaiserWidth) {
+        return 0.0f;
+    }
+    const float sinc = t == 0.0f ? 1.0f : std::sin(kPi * t) / (kPi * t);
+    const float ratio = t / kKaiserWidth;
+    return sinc * besselI0(kKaiserAlpha * std::sqrt(1.0f - ratio * ratio)) / besselI0(kKaiserAlpha);
+}
+
+// Source texels and weights per destination texel along one axis, edges clamp
+struct FilterTaps {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> indices;
+    std::vector<float> weights;
+};
+
+FilterTaps computeTaps(uint32_t sourceSize, uint32_t size, MipFilter filter)
+{
+    // Filters are defined on destination texels, t is the distance in destination texels
+    const float scale = float(sourceSize) / float(size);
+    const float support = filter == MipFilter::Box ? 0.5f : kKaiserWidth;
+    FilterTaps taps;
+    taps.offsets.push_back(0);
+    for (uint32_t x = 0; x < size; x++) {
+        const float center = (x + 0.5f) * scale;
+        const int first = static_cast<int>(std::floor(center - support * scale));
+        const int last = static_cast<int>(std::ceil(center + support * scale));
+        const size_t start = taps.weights.size();
+        float sum = 0.0f;
+        for (int i = first; i <= last; i++) {
+            const float t = (i + 0.5f - center) / scale;
+            const float weight = filter == MipFilter::Box ? (std::fabs(t) < 0.5f ? 1.0f : 0.0f) : kaiserSinc(t);
+            if (weight == 0.0f) {
+                continue;
+            }
+            taps.indices.push_back(static_cast<uint32_t>(std::min(std::max(i, 0), int(sourceSize) - 1)));
+            taps.weights.push_back(weight);
+            sum += weight;
+        }
+        for (size_t i = start; i < taps.weights.size(); i++) {
+            taps.weights[i] /= sum;
+        }
+        taps.offsets.push_back(static_cast<uint32_t>(taps.weights.size()));
+    }
+    return taps;
+}
+
+// Halves both axes (down to 1), separable: rows into a half width image, then columns
+LinearImage downsample(const LinearImage& source, MipFilter filter, uint32_t threads)
+{
+    const uint32_t width = std::max(source.width / 2, 1u);
+    const uint32_t height = std::max(source.height / 2, 1u);
+    const FilterTaps columnTaps = computeTaps(source.width, width, filter);
+    const FilterTaps rowTaps = computeTaps(source.height, height, filter);
+
+    LinearImage horizontal(width, source.height);
+    parallelFor(source.height, getRowThreads(source.width, source.height, threads), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t y = begin; y < end; y++) {
+            const float* in = source.row(y);
+            float* out = horizontal.row(y);
+            for (uint32_t x = 0; x < width; x++) {
+                Float4 sum = zero4();
+                for (uint32_t tap = columnTaps.offsets[x]; tap < columnTaps.offsets[x + 1]; tap++) {
+                    sum = madd4(sum, load4(in + size_t(columnTaps.indices[tap]) * 4), columnTaps.weights[tap]);
+                }
+                store4(out + size_t(x) * 4, sum);
+            }
+        }
+    });
+
+    LinearImage level(width, height);
+    parallelFor(height, getRowThreads(width, source.height, threads), [&](uint32_t begin, uint32_t end) {
+        for (uint32_t y = begin; y < end; y++) {
+            float* out = level.row(y);
+            // Whole rows at a time, the source rows are read front to back
+            for (uint32_t tap = rowTaps.offsets[y]; tap < rowTaps.offsets[y + 1]; tap++) {
+                const float* in = horizontal.row(rowTaps.indices[tap]);
+                const float weight = rowTaps.weights[tap];
+                for (uint32_t x = 0; x < width; x++) {
+                    store4(out + size_t(x) * 4, madd4(load4(out + size_t(x) * 4), load4(in + size_t(x) * 4), weight));
+                }
+            }
+            // Negative lobes ring, keep a valid premultiplied texel so the error doesn't feed the next level
+            if (filter != MipFilter::Box) {
+                for (uint32_t x = 0; x < width; x++, out += 4) {
+                    out[3] = std::min(std::max(out[3], 0.0f), 1.0f);
+                    for (int c = 0; c < 3; c++) {
+                        out[c] = std::min(std::max(out[c], 0.0f), out[3]);
+                    }
+                }
+            }
+        }
+    });
+    return level;
+}
+}
+
+uint32_t resolveThreadCount(uint32_t threads)
+{
+    return threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+void parallelFor(uint32_t count, uint32_t threads, const std::function<void(uint32_t, uint32_t)>& body)
+{
+    threads = std::min(resolveThreadCount(threads), count);
+    if (threads <= 1) {
+        body(0, count);
+        return;
+    }
+    // Several chunks per thread, so an uneven split (or a busy core) doesn't leave the others idle
+    const uint32_t chunk = std::max(1u, count / (threads * 4));
+    std::atomic<uint32_t> next{0};
+    auto worker = [&]() {
+        for (;;) {
+            const uint32_t begin = next.fetch_add(chunk);
+            if (begin >= count) {
+                return;
+            }
+            body(begin, std::min(begin + chunk, count));
+        }
+    };
+    std::vector<std::thread> pool;
+    for (uint32_t i = 1; i < threads; i++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : pool) {
+        thread.join();
+    }
+}
+
+const char* getSimdName()
+{
+#if IMAGE_PIPELINE_SSE2
+    return "SSE2";
+#elif IMAGE_PIPELINE_NEON
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
+
+Image decodePng(const std::string& path)
+{
+    png_image png;
+    memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_file(&png, path.c_str())) {
+        throw std::runtime_error(path + ": " + png.message);
+    }
+    png.format = PNG_FORMAT_RGBA;
+    Image image;
+    image.width = png.width;
+    image.height = png.height;
+    image.rgba.resize(PNG_IMAGE_SIZE(png));
+    if (!png_image_finish_read(&png, nullptr, image.rgba.data(), 0, nullptr)) {
+        throw std::runtime_error(path + ": " + png.message);
+    }
+    return image;
+}
+
+std::vector<Image> decodePngs(const std::vector<std::string>& paths, uint32_t threads)
+{
+    std::vector<Image> images(paths.size());
+    std::vector<std::exception_ptr> errors(paths.size());
+    parallelFor(static_cast<uint32_t>(paths.size()), threads, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            try {
+                images[i] = decodePng(paths[i]);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        }
+    });
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    return images;
+}
+
+std::vector<Image> buildMipChain(const Image& image, const MipOptions& options)
+{
+    const uint32_t threads = resolveThreadCount(options.threads);
+    LinearImage level = toLinear(image, options.srgb, threads);
+    std::vector<Image> chain;
+    chain.push_back(options.premultiplyAlpha ? toBytes(level, options, threads) : image);
+    while (options.mips && (level.width > 1 || level.height > 1)) {
+        level = downsample(level, options.filter, threads);
+        chain.push_back(toBytes(level, options, threads));
+    }
+    return chain;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Host side decode and mip generation for the cooker, the device loads the result as stored.
+// Filtering happens on linear light, alpha premultiplied float texels, so neither the sRGB curve
+// nor transparent texels (often black) bleed into the smaller levels. Work is split across threads
+// by image (decode) and by rows (conversion, filtering); the inner loops filter one RGBA texel per
+// SSE2 / NEON vector.
+
+struct Image {
+    uint32_t width{0};
+    uint32_t height{0};
+    std::vector<uint8_t> rgba;
+};
+
+enum class MipFilter {
+    // 2x2 average, the reference
+    Box,
+    // Kaiser windowed sinc (width 3, alpha 4), sharper smaller levels with little ringing
+    Kaiser,
+};
+
+struct MipOptions {
+    MipFilter filter{MipFilter::Box};
+    // Colors are sRGB encoded, filtering decodes them first
+    bool srgb{true};
+    // Only level 0 when false
+    bool mips{true};
+    // Store colors multiplied by alpha, for blending with ONE, ONE_MINUS_SRC_ALPHA
+    bool premultiplyAlpha{false};
+    // 0 uses every hardware thread
+    uint32_t threads{0};
+};
+
+// Throws std::runtime_error with the libpng message
+Image decodePng(const std::string& path);
+
+// PNG is a single deflate stream, so images are decoded in parallel, not tiles of one image
+std::vector<Image> decodePngs(const std::vector<std::string>& paths, uint32_t threads = 0);
+
+// Levels down to 1x1, levels[0] the image itself (premultiplied when asked for). Odd sizes round
+// down, filter taps follow the exact scale so the last row / column isn't dropped.
+std::vector<Image> buildMipChain(const Image& image, const MipOptions& options);
+
+// Calls body with disjoint [begin, end) ranges covering [0, count), from up to threads threads
+// including the calling one
+void parallelFor(uint32_t count, uint32_t threads, const std::function<void(uint32_t, uint32_t)>& body);
+
+uint32_t resolveThreadCount(uint32_t threads);
+
+// The vector instruction set the filters were compiled for
+const char* getSimdName();
@@ -0,0 +1,149 @@
+// Throughput of the cooker's decode and mip pipeline (ImagePipeline.h) across thread counts:
+//
+//   texture_cooker_benchmark [--iterations n] [--batch n] [--max-threads n] [input.png ...]
+//
+// Decoding is measured on a batch of files (the inputs repeated up to --batch, default 8), mip
+// generation on each filter with the first input. Thread counts double from 1 up to --max-threads
+// (default: all hardware threads). Without inputs a 2048x2048 RGBA test image is written to the
+// temp directory first. Reports the median time and megapixels per second of level 0 input.
+#include <png.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ImagePipeline.h"
+
+namespace {
+template<class Func>
+double medianMs(uint32_t iterations, Func&& func)
+{
+    func();
+    std::vector<double> samples;
+    for (uint32_t i = 0; i < iterations; i++) {
+        const auto start = std::chrono::steady_clock::now();
+        func();
+        samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+// Smooth gradients, noise and a soft edged transparent disc, so every filter path has work
+std::string writeTestImage()
+{
+    const uint32_t size = 2048;
+    std::vector<uint8_t> rgba(size_t(size) * size * 4);
+    uint32_t seed = 1;
+    for (uint32_t y = 0; y < size; y++) {
+        for (uint32_t x = 0; x < size; x++) {
+            seed = seed * 1664525u + 1013904223u;
+            uint8_t* texel = rgba.data() + (size_t(y) * size + x) * 4;
+            texel[0] = static_cast<uint8_t>(x * 255 / size);
+            texel[1] = static_cast<uint8_t>(y * 255 / size);
+            texel[2] = static_cast<uint8_t>(seed >> 24);
+            const float dx = x - size * 0.5f;
+            const float dy = y - size * 0.5f;
+            const float distance = std::sqrt(dx * dx + dy * dy) / (size * 0.5f);
+            texel[3] = static_cast<uint8_t>(std::min(std::max((1.0f - distance) * 8.0f, 0.0f), 1.0f) * 255.0f);
+        }
+    }
+    const std::string path = (std::filesystem::temp_directory_path() / "texture_cooker_benchmark.png").string();
+    png_image png;
+    memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+    png.width = size;
+    png.height = size;
+    png.format = PNG_FORMAT_RGBA;
+    if (!png_image_write_to_file(&png, path.c_str(), 0, rgba.data(), 0, nullptr)) {
+        throw std::runtime_error(path + ": " + png.message);
+    }
+    return path;
+}
+
+void report(const char* name, uint32_t threads, double ms, double baselineMs, uint64_t pixels)
+{
+    printf("%-14s %7u %10.2f %10.1f %8.2fx\n", name, threads, ms, pixels / (ms * 1000.0), baselineMs / ms);
+}
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t iterations = 5;
+    uint32_t batch = 8;
+    uint32_t maxThreads = resolveThreadCount(0);
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--iterations" && i + 1 < argc) {
+            iterations = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batch = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+        } else if (arg == "--max-threads" && i + 1 < argc) {
+            maxThreads = std::max(1u, static_cast<uint32_t>(std::stoul(argv[++i])));
+        } else if (arg.rfind("--", 0) == 0) {
+            fprintf(stderr, "usage: texture_cooker_benchmark [--iterations n] [--batch n] [--max-threads n] "
+                            "[input.png ...]\n");
+            return 1;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+
+    try {
+        if (inputs.empty()) {
+            inputs.push_back(writeTestImage());
+        }
+        std::vector<std::string> files;
+        while (files.size() < std::max<size_t>(batch, inputs.size())) {
+            files.push_back(inputs[files.size() % inputs.size()]);
+        }
+        const std::vector<Image> images = decodePngs(files, 1);
+        uint64_t batchPixels = 0;
+        for (const Image& image : images) {
+            batchPixels += uint64_t(image.width) * image.height;
+        }
+        const Image& source = images.front();
+        const uint64_t sourcePixels = uint64_t(source.width) * source.height;
+
+        std::vector<uint32_t> threadCounts;
+        for (uint32_t threads = 1; threads < maxThreads; threads *= 2) {
+            threadCounts.push_back(threads);
+        }
+        threadCounts.push_back(maxThreads);
+
+        printf("%s, %u hardware threads, %zu files of %ux%u (first), median of %u\n", getSimdName(),
+               resolveThreadCount(0), files.size(), source.width, source.height, iterations);
+        printf("%-14s %7s %10s %10s %9s\n", "case", "threads", "ms", "MPixel/s", "speedup");
+
+        double baseline = 0.0;
+        for (uint32_t threads : threadCounts) {
+            const double ms = medianMs(iterations, [&] { decodePngs(files, threads); });
+            baseline = threads == 1 ? ms : baseline;
+            report("decode", threads, ms, baseline, batchPixels);
+        }
+        const std::pair<const char*, MipFilter> filters[] = {{"mips box", MipFilter::Box},
+                                                             {"mips kaiser", MipFilter::Kaiser}};
+        for (const auto& filter : filters) {
+            for (uint32_t threads : threadCounts) {
+                MipOptions options;
+                options.filter = filter.second;
+                options.threads = threads;
+                const double ms = medianMs(iterations, [&] { buildMipChain(source, options); });
+                baseline = threads == 1 ? ms : baseline;
+                report(filter.first, threads, ms, baseline, sourcePixels);
+            }
+        }
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
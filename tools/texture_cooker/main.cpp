@@ -0,0 +1,153 @@
+// Cooks PNG images into KTX2 textures with a full mip chain, ready for upload as stored:
+//
+//   texture_cooker [--format etc2|rgba8] [--filter box|kaiser] [--linear] [--premultiply] [--no-mips]
+//                  [--threads n] [--verify] input.png output.ktx2 [input.png output.ktx2 ...]
+//
+// etc2 (the default) writes ETC2 RGB8 for opaque images and ETC2 RGBA8 (EAC alpha) otherwise,
+// supported by every GLES 3 and most Vulkan Android devices. rgba8 keeps the image uncompressed,
+// mips still generated offline. Colors are sRGB unless --linear is given, for data like normal
+// maps. --premultiply stores colors multiplied by alpha. Several pairs are decoded in parallel,
+// --threads limits the threads (default: all). --verify decodes the result again and prints the
+// PSNR of the full size level.
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Etc2Encoder.h"
+#include "ImagePipeline.h"
+#include "Utils/Ktx2.h"
+
+namespace {
+bool hasAlpha(const Image& image)
+{
+    for (size_t i = 3; i < image.rgba.size(); i += 4) {
+        if (image.rgba[i] != 255) {
+            return true;
+        }
+    }
+    return false;
+}
+
+double psnr(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b)
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < a.size(); i++) {
+        const double delta = double(a[i]) - double(b[i]);
+        sum += delta * delta;
+    }
+    if (sum == 0.0) {
+        return INFINITY;
+    }
+    return 10.0 * std::log10(255.0 * 255.0 / (sum / a.size()));
+}
+
+void usage()
+{
+    fprintf(stderr, "usage: texture_cooker [--format etc2|rgba8] [--filter box|kaiser] [--linear] [--premultiply] "
+                    "[--no-mips] [--threads n] [--verify] input.png output.ktx2 [input.png output.ktx2 ...]\n");
+}
+
+void cook(const Image& image, const std::string& path, const std::string& format, const MipOptions& mipOptions,
+          bool verify)
+{
+    const std::vector<Image> chain = buildMipChain(image, mipOptions);
+    const bool srgb = mipOptions.srgb;
+
+    const bool alpha = hasAlpha(chain.front());
+    uint32_t vkFormat;
+    if (format == "rgba8") {
+        vkFormat = srgb ? kVkFormatR8G8B8A8Srgb : kVkFormatR8G8B8A8Unorm;
+    } else if (alpha) {
+        vkFormat = srgb ? kVkFormatEtc2R8G8B8A8SrgbBlock : kVkFormatEtc2R8G8B8A8UnormBlock;
+    } else {
+        vkFormat = srgb ? kVkFormatEtc2R8G8B8SrgbBlock : kVkFormatEtc2R8G8B8UnormBlock;
+    }
+
+    std::vector<std::vector<uint8_t>> levels;
+    for (const Image& level : chain) {
+        if (format == "rgba8") {
+            levels.push_back(level.rgba);
+        } else {
+            levels.push_back(Etc2Encoder::encodeImage(level.rgba.data(), level.width, level.height, alpha));
+        }
+    }
+
+    const std::vector<uint8_t> file = writeKtx2(vkFormat, chain[0].width, chain[0].height, levels,
+                                                "texture_cooker", mipOptions.premultiplyAlpha && alpha);
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+    if (!out) {
+        throw std::runtime_error(path + ": write failed");
+    }
+
+    size_t uncompressed = 0;
+    for (const Image& level : chain) {
+        uncompressed += level.rgba.size();
+    }
+    printf("%s: %ux%u, %zu levels, format %u, %zu bytes (%zu as RGBA8)\n", path.c_str(), chain[0].width,
+           chain[0].height, chain.size(), vkFormat, file.size(), uncompressed);
+
+    if (verify && format == "etc2") {
+        std::vector<uint8_t> decoded =
+            Etc2Encoder::decodeImage(levels[0].data(), chain[0].width, chain[0].height, alpha);
+        printf("level 0 PSNR %.2f dB\n", psnr(chain[0].rgba, decoded));
+    }
+}
+}
+
+int main(int argc, char** argv)
+{
+    std::string format = "etc2";
+    std::string filter = "box";
+    MipOptions mipOptions;
+    bool verify = false;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--format" && i + 1 < argc) {
+            format = argv[++i];
+        } else if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            mipOptions.threads = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (arg == "--linear") {
+            mipOptions.srgb = false;
+        } else if (arg == "--premultiply") {
+            mipOptions.premultiplyAlpha = true;
+        } else if (arg == "--no-mips") {
+            mipOptions.mips = false;
+        } else if (arg == "--verify") {
+            verify = true;
+        } else if (arg.rfind("--", 0) == 0) {
+            usage();
+            return 1;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.empty() || paths.size() % 2 != 0 || (format != "etc2" && format != "rgba8") ||
+        (filter != "box" && filter != "kaiser")) {
+        usage();
+        return 1;
+    }
+    mipOptions.filter = filter == "kaiser" ? MipFilter::Kaiser : MipFilter::Box;
+
+    try {
+        std::vector<std::string> inputs;
+        for (size_t i = 0; i < paths.size(); i += 2) {
+            inputs.push_back(paths[i]);
+        }
+        const std::vector<Image> images = decodePngs(inputs, mipOptions.threads);
+        for (size_t i = 0; i < images.size(); i++) {
+            cook(images[i], paths[i * 2 + 1], format, mipOptions, verify);
+        }
+    } catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}